@@ -1,804 +1,1535 @@
-/*
- *****************************************************************************
- # $Id: amb.c,v 1.17 2008/03/05 19:44:57 avaccari Exp $
- #
- # Copyright (C) 1999
- # Associated Universities, Inc. Washington DC, USA.
- #
- # Correspondence concerning ALMA should be addressed as follows:
- #        Internet email: mmaswgrp@nrao.edu
- ****************************************************************************
- *
- *  AMB.C 
- *
- *  Implementation file for ALMA Monitor and Control Bus Slave library.  This
- *  file makes use of libraries for the support of Dallas Semiconductor device
- *  used for a unique serial number.  It is also intended to be the basis for
- *  slave implementations on hardware other than the suggested interface.
- *
- *****************************************************************************
- */
-
-/* Version of AMB protocol */
-#define PROTOCOL_VERSION_MAJOR 1
-#define PROTOCOL_VERSION_MINOR 1
-#define PROTOCOL_VERSION_PATCH 2
-
-/* Version of SOFTWARE */
-#define SW_VERSION_MAJOR 1
-#define SW_VERSION_MINOR 2
-#define SW_VERSION_PATCH 3
-/* Version of HARDWARE */
-#define HW_VERSION_MAJOR 1
-#define HW_VERSION_MINOR 6
-
-/* REVISION HISTORY */
-/*
- * Version 01.01.02 - Released as Ver_1_1_2
-           01.02.03   Patch by Andrea Vaccari - NRAO NTC
-		   			  Changed code to assure that any RCA is not serviced more than once in
-					  case the register addresses overlap
- * Version 01.02.02 - Fixed bug to allow use of NodeID at RCA 0. Jeff Kern
- * Version 01.01.01 - Released as Ver_1_1_1
-		   			  Patch by Andrea Vaccari - NRAO NTC
-		   			  Added the function "amb_unregister_last_function" declaration in the
-		   			  amb.h file.
- * Version 01.01.00 - Released as Ver_1_1_0
-					  Minor change by Andrea Vaccari - NRAO NTC
-					  Added the function "amb_unregister_last_function".
-					  If any callback function has been registered, this function will
-                      unregister the last registered function.
- * Version 01.00.01 - Released as Ver_1_0_1
-		              Patch by Andrea Vaccari - NRAO Tucson
-      		          This patch modified the location of all the global variables
-                      and moved them from external memory to internal memory (IDATA).
-		              The result was an increased speed of execution.
- * Version 01.00.00 - Original Version developed by Mick Brooks - NRAO Tucson
-*/
-
-
-
- /* Include C167 register definitions */
-
-	#include <reg167.h>
-	#include <intrins.h>
-
-
-
-#include "amb.h"
- /* Include Dallas Semiconductor support for C167 */
-
-#include "..\..\libraries\ds1820\ds1820.h"
-
-
-
-/* Definitions of CAN controller structure */
-
- /* For Siemens C167CR */
-
-	/* Locations of CAN controller registers */
-	#define C1CSR   (*((uword volatile sdata *) 0xEF00)) /* Control/Status Register */
-	#define C1IR    (*((uword volatile sdata *) 0xEF02)) /* Interrupt Register */
-	#define C1BTR   (*((uword volatile sdata *) 0xEF04)) /* Bit Timing Register */
-	#define C1GMS   (*((uword volatile sdata *) 0xEF06)) /* Global Mask Short */
-	#define C1UGML  (*((uword volatile sdata *) 0xEF08)) /* Upper Global Mask Long */
-	#define C1LGML  (*((uword volatile sdata *) 0xEF0A)) /* Lower Global Mask Long */
-	#define C1UMLM  (*((uword volatile sdata *) 0xEF0C)) /* Upper Mask of Last Message */
-	#define C1LMLM  (*((uword volatile sdata *) 0xEF0E)) /* Lower Mask of Last Message */
-	/* 
-	 * Structure for a single 82527 CAN object
-	 * A total of 15 such object structures exists
-	 */
-
-	struct can_obj {
-	  uword  MCR;       /* Message Control Register */
-	  uword  UAR;       /* Upper Arbitration Register */
-	  uword  LAR;       /* Lower Arbitration Register */
-	  ubyte  MCFG;      /* Message Configuration Register */
-	  ubyte  Data[8];   /* Message Data 0 .. 7 */
-	  ubyte  Customer;  /* Reserved for application specific data */
-	} ;
-
-	/* Location of first CAN object */
-	#define CAN_OBJ ((struct can_obj volatile sdata *) 0xEF10)
-
-
-/*
- ****************************************************************************
- * Interrupt Vectors
- ****************************************************************************
- */
-
-#define XP0INT   0x40
-
-/* Local Function prototypes */
-static ubyte 	amb_get_node_address();
-static int		amb_get_serial_number();
-static int		amb_setup_CAN_hw();
-static void		amb_handle_transaction();
-static void		amb_transmit_monitor();
-
-/* All pertinent slave data */
-
-	static struct slave_node {
-
-	ubyte 		serial_number[8];	/* From hardware device */
-	ubyte 		node_address;		/* From DIP switch */
-	ulong		base_address;		/* From node address */
-
-	ubyte		revision_level[3];	/* Protocol version */
-	ubyte		sw_revision_level[3];	/* Software version */
-	ubyte		hw_revision_level[2];	/* Hardware version */
-	uword		num_errors;			/* Number of CAN errors */
-	ubyte		last_slave_error;	/* Last internal slave error */
-	ulong		num_transactions;	/* Number of completed transactions */
-
-	ubyte		identify_mode;		/* True when responding to identify broadcast */
-
-	ubyte		num_cbs;			/* No of callbacks registered */
-	CALLBACK_STRUCT	*cb_ops;		/* User supplied callbacks */
-} idata slave_node;
-
-/* Structure for sharing message data with callbacks */
-
-	static CAN_MSG_TYPE idata current_msg;
-
-
-
-/* Initialise routine */
-int amb_init_slave(void *cb_ops_memory){
-/* Point to callback memory */
-	slave_node.cb_ops = (CALLBACK_STRUCT *) cb_ops_memory;
-
-/* Initially we have no registered callbacks */
-	slave_node.num_cbs = 0;
-
-/* Get the address of this slave from the hardware */
-	slave_node.node_address = amb_get_node_address();
-
-/* Calculate the base address */
-	slave_node.base_address = ((ulong) (slave_node.node_address + 1)) * 262144;
-
-/* Try to get the serial number from the hardware */
-	if (amb_get_serial_number(slave_node.serial_number) != 0) {
-		return -1;
-	}
-
-	/* Initialise counters and status */
-	slave_node.revision_level[0] = PROTOCOL_VERSION_MAJOR;
-	slave_node.revision_level[1] = PROTOCOL_VERSION_MINOR;
-	slave_node.revision_level[2] = PROTOCOL_VERSION_PATCH;
-	slave_node.sw_revision_level[0] = SW_VERSION_MAJOR;
-	slave_node.sw_revision_level[1] = SW_VERSION_MINOR;
-	slave_node.sw_revision_level[2] = SW_VERSION_PATCH;
-	slave_node.hw_revision_level[0] = HW_VERSION_MAJOR;
-	slave_node.hw_revision_level[1] = HW_VERSION_MINOR;
-	slave_node.num_errors = 0;
-	slave_node.last_slave_error = 0x0;
-	slave_node.num_transactions = 0;
-
-	slave_node.identify_mode = FALSE;
-	
-/* Setup the CAN hardware */
-	return amb_setup_CAN_hw();
-}
-
-/* Register callback routine */
-int amb_register_function(ulong low_address, ulong high_address, read_or_write_func func){
-/* Store callback info */
-	slave_node.cb_ops[slave_node.num_cbs].low_address = low_address;
-	slave_node.cb_ops[slave_node.num_cbs].high_address = high_address;
-	slave_node.cb_ops[slave_node.num_cbs].cb_func = func;
-
-/* Increment the number of callbacks */
-	slave_node.num_cbs++;
-
-/* Always succeeds */
-	return 0;
-}
-
-/* Unregister last registered callback routine */
-int amb_unregister_last_function(void){
-
-/* If no function is registered, nothing to be done. */
-	if(!slave_node.num_cbs){
-		return 0;
-	}
-
-/* Decrement the number of callbacks. */
-	slave_node.num_cbs--;
-
-	return 0;
-}
-
-/* Startup routine */
-int amb_start(){
-	IEN = 1;
-
-/* Always succeeds */
-	return 0;
-}
-
-/* Read the slave address */
-ubyte amb_get_node_address(){
-	#ifdef AMBSI  /* Standard i/f, DIP switch on Port 3.1 to 3.6 */
-		return (P3 & 0x7e) >> 1;
-	#endif /* AMBSI */
-
-	#ifdef SK167  /* Starter Kit test board, DIP switch on Port 7.1 to 7.6 */
-		return (P7 & 0x7e) >> 1;
-	#endif /* SK167 */
-
-}
-
-/* Read the serial number from the Dallas Semiconductor device */
-int amb_get_serial_number(){
-
-		/* Initialise the 1-wire port (library defined) */
-		if (ds1820_init() != 0) {
-			slave_node.last_slave_error = NO_DS1820_E;
-			return -1;
-		}
-
-		/* read the serial number */
-		if (ds1820_get_sn(slave_node.serial_number) != 0) {
-			slave_node.last_slave_error = NO_SN_E;
-			return -1;
-		} else {
-			return 0;
-		}
-
-
-}
-
-/* Routine to setup an Intel 82527-like controller */
-int amb_setup_CAN_hw(){
-
-		ulong LAR, UAR;
-
-		/* Set up for the various arbitration registers */
-
-		/* calculate lower mask */
-  		LAR = 0x00000000;
-  		LAR += (slave_node.base_address & 0x0000001f) << 11;  /* ID  4.. 0 */
-  		LAR += (slave_node.base_address & 0x00001fe0) >>  5;  /* ID 12.. 5 */
-
-		/* calculate the upper mask */
-  		UAR = 0x00000000;
-  		UAR += (slave_node.base_address & 0x001fe000) >>  5;  /* ID 13..20 */
-  		UAR += (slave_node.base_address & 0x1fe00000) >> 21;  /* ID 21..28 */
-
-		/*  ------------ CAN Control/Status Register -------------- 
-  		 *  start the initialization of the CAN Module 
-		 */
-  		C1CSR  = 0x0041;  /* set INIT and CCE */
-
-	  	/*  ------------ Bit Timing Register ---------------------
-  		 *  baudrate =  1000.000 KBaud
-  		 *	 there are 5 time quanta before sample point
-  		 *	 there are 4 time quanta after sample point
-  		 *	 the (re)synchronization jump width is 2 time quanta
-		 */
-  		C1BTR  = 0x3440;  /* set Bit Timing Register */
-  		C1GMS  = 0xE0FF;  /* set Global Mask Short Register */
-  		C1UGML = 0xFFFF;  /* set Upper Global Mask Long Register */
-  		C1LGML = 0xF8FF;  /* set Lower Global Mask Long Register */
-
-	  	/*  ------------------------------------------------------------------------
-  		 *  ----------------- Configure Message Object 1 ---------------------------
-		 *  --- This message object is used to receive the global identify ---------
-		 *  --- broadcast message on ID 0x00000000 ---------------------------------
-  		 *  ------------------------------------------------------------------------
-  		 *  Message object 1 is valid
-  		 *  enable receive interrupt
-		 */
-  		CAN_OBJ[0].MCR  = 0x5599;    /* set Message Control Register */
-
-	  	/*
-  	 	 * message direction is receive
-  		 * extended 29-bit identifier
-    	 */
-  		CAN_OBJ[0].MCFG = 0x04;      /* set Message Configuration Register */
-
-	  	CAN_OBJ[0].UAR  = 0x0000;    /* set Upper Arbitration Register */
-  		CAN_OBJ[0].LAR  = 0x0000;    /* set Lower Arbitration Register */
-
-	  	/*  ------------------------------------------------------------------------
-  		 *  ----------------- Configure Message Object 2 ---------------------------
-		 *  --- This message object is used as a transmit object for the serial ----
-		 *  --- number.  It can be RTR'd quickly from the master -------------------
-  		 *  ------------------------------------------------------------------------
-  		 *  Message object 2 is valid
-		 */
-  		CAN_OBJ[1].MCR  = 0x5695;    /* set Message Control Register */
-
-	  	/* 
-		 * message direction is transmit
-  		 * extended 29-bit identifier
-  		 * 8 valid data bytes
-   		 */
-  		CAN_OBJ[1].MCFG = 0x8C;      /* set Message Configuration Register */
-
-	  	CAN_OBJ[1].UAR  = UAR;	 /* set Upper Arbitration Register of Object 2 */
-  		CAN_OBJ[1].LAR  = LAR;	 /* set Lower Arbitration Register of Object 2 */	
-  		//CAN_OBJ[1].LAR  = LAR+1;	 /* set Lower Arbitration Register of Object 2 */	
-
-	  	CAN_OBJ[1].Data[0] = slave_node.serial_number[0];   /* set data byte 0 */
-  		CAN_OBJ[1].Data[1] = slave_node.serial_number[1];   /* set data byte 1 */
-  		CAN_OBJ[1].Data[2] = slave_node.serial_number[2];   /* set data byte 2 */
-  		CAN_OBJ[1].Data[3] = slave_node.serial_number[3];   /* set data byte 3 */
-  		CAN_OBJ[1].Data[4] = slave_node.serial_number[4];   /* set data byte 4 */
-  		CAN_OBJ[1].Data[5] = slave_node.serial_number[5];   /* set data byte 5 */
-  		CAN_OBJ[1].Data[6] = slave_node.serial_number[6];   /* set data byte 6 */
-  		CAN_OBJ[1].Data[7] = slave_node.serial_number[7];   /* set data byte 7 */
-
-	  	/*  ------------------------------------------------------------------------
-  		 *  ----------------- Configure Message Object 3 ---------------------------
-		 *  --- This message object is used to transmit all monitor data back to ---
-		 *  --- the master. --------------------------------------------------------
-  		 *  ------------------------------------------------------------------------
-  		 *  Message object 3 is valid
-   		 */
-	  	CAN_OBJ[2].MCR  = 0x5695;    /* set Message Control Register */
-
-	  	/* 
-		 * message direction is transmit
-  		 * extended 29-bit identifier
-  		 * 0 valid data bytes
-      	 */
-  		CAN_OBJ[2].MCFG = 0x0C;      /* set Message Configuration Register */
-
-	  	CAN_OBJ[2].UAR  = 0x0000;    /* set Upper Arbitration Register */
-  		CAN_OBJ[2].LAR  = 0x0000;    /* set Lower Arbitration Register */
-  		
-	  	/*  ------------------------------------------------------------------------
-  		 *  ----------------- Configure Message Objects 4 to 14 --------------------
-		 *  --- These objects are not used at present ------------------------------
-  		 *  ------------------------------------------------------------------------
-		 */
-  	   	CAN_OBJ[3].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[4].MCR  = 0x5555;    /* set Message Control Register */
-	  	CAN_OBJ[5].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[6].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[7].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[8].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[9].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[10].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[11].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[12].MCR  = 0x5555;    /* set Message Control Register */
-  		CAN_OBJ[13].MCR  = 0x5555;    /* set Message Control Register */
-
-	  	/*  ------------------------------------------------------------------------
-  		 *  ----------------- Configure Message Object 15 --------------------------
-		 *  --- This object is used in Basic CAN mode to receive all M&C requests --
-  		 *  ------------------------------------------------------------------------
-  		 *  Message object 15 is valid
-  		 *  enable receive interrupt
-   		 */
-  		CAN_OBJ[14].MCR  = 0x5599;    /* set Message Control Register */
-
-	  	/* 
-		 * message direction is receive
-  		 * extended 29-bit identifier
-   	 	 */
-  		CAN_OBJ[14].MCFG = 0x04;      /* set Message Configuration Register */
-
-		/* Set the mask so that only the upper 11 bits are compared with the incoming identifier.
-		   This ensures that messages are correctly filtered for this slaves range of identifiers */
- 	 	C1UMLM = 0xE0FF;           /* set Upper Mask of Last Message */
-  		C1LMLM = 0x0000;           /* set Lower Mask of Last Message */
-
-	  	CAN_OBJ[14].UAR  = UAR; /* set Upper Arbitration Register of Basic CAN object */
-  		CAN_OBJ[14].LAR  = LAR; /* set Lower Arbitration Register of Basic CAN object */
-
-	    /*
-		 *  enable CAN interrupt
-  		 *  CAN interrupt priority level(ILVL) = 13
-  	 	 *  CAN interrupt group level (GLVL) = 3
-    	 */
-  		XP0IC = 0x0077;
-
-	  	/* ------------ CAN Control/Status Register --------------
-  		 *  reset CCE and INIT
-  		 * enable interrupt generation from CAN Module
-  		 * enable interrupt generation on a change of bit BOFF or EWARN
-		 * No status interrupts!
-   		 */
-  		C1CSR = 0x000A;
-
-	/* Always succeeds */
-	return 0;
-}
-
-/*
- ****************************************************************************
- *  This is the interrupt service routine for the CAN controller.
- *  It is executed if:
- *  - the busoff or the error warning status is reached 
- *    (EIE is set)
- *  - a message has been sent or received successfully or a bus 
- *    error occurred (SIE is set)
- *  - the bit INTPND (interrupt pending) in one of the message
- *    object control-registers is set (at Tx or Rx)
- * 
- ****************************************************************************
- */
-
-	void amb_can_isr(void) interrupt XP0INT{
-  	uword uwIntID;
-  	uword uwStatus;
-
-	  	while (uwIntID = C1IR & 0x00ff) {
-	    	switch (uwIntID & 0x00ff) {
-	     		case 1:  /* Status Change Interrupt
-    	     	     	 * The CAN controller has updated (not necessarily changed)
-        	    	  	 * the status in the Control Register.
-						 */
-
-					uwStatus = C1CSR;
-		            if (uwStatus & 0x8000) { /* if BOFF */
-        		    	/* 
-						 * Indicates when the CAN controller is in busoff state.
-						 * Increment error counter
-					 	 */
-						slave_node.num_errors++;
-					}
-
-		            if (uwStatus & 0x4000) { /* if EWRN */
-        		       /* 
-						* Indicates that the least one of the error counters in the
-                		* EML has reached the error warning limit of 96.
-					 	* Increment the error counter
-					 	*/
-						slave_node.num_errors++;
-            		}
-
- 		           if (uwStatus & 0x0800) { /* if TXOK */
-              			/* 
-					 	 * Indicates that a message has been transmitted successfully
-              	 		 * (error free and acknowledged by at least one other node). 
-					 	 */
-              			uwStatus &= 0xf7ff;
-              			C1CSR = uwStatus;     /* reset TXOK */
-
-				 		/* If we are responding to the identify broadcast, then we are done */
-						if (slave_node.identify_mode == TRUE) {
-							/* Turn status interrupts off */
-							C1CSR = 0x000A;
-							slave_node.identify_mode = FALSE;
-						}
-        		    }
-
-		            if (uwStatus & 0x1000) { /* if RXOK */
-        		      	/* Indicates that a message has been received successfully. */
-              			uwStatus &= 0xefff;
-		              	C1CSR = uwStatus;     /* reset RXOK */
-        		    }
-
-		            if (uwStatus & 0x0700) { /* if LEC */
-        			    switch ((uwStatus & 0x0700) >> 8) { /* LEC (Last Error Code) */
-               				case 1: /* Stuff Error
-                        			 * More than 5 equal bits in a sequence have occurred
-			                         * in a part of a received message where this is not
-                        			 * allowed. 
-									 */
-								/* Increment error counter */
-								slave_node.num_errors++;
-	               				break;
-
-			               case 2: /* Form Error
-            			            * A fixed format part of a received frame has the
-                        			* wrong format. 
-									*/
-								/* Increment error counter */
-				 			 	slave_node.num_errors++;
-        			          	break;
-
-			               case 3: /* Ack Error
-            			            * The message this CAN controller transmitted was
-                        			* not acknowledged by another node. 
-									*/
-								/* Increment error counter */
-								slave_node.num_errors++;
-                  				break;
-
-			               case 4: /* Bit1 Error
-                        			* During the transmission of a message (with the
-                        			* exception of the arbitration field), the device
-                        			* wanted to send a recessive level ("1"), but the
-                        			* monitored bus value was dominant.
-									*/
-								/* Increment error counter */
-					 			slave_node.num_errors++;
-
-								/* 
-								 * If we are responding to an identify request, this means a
-								 * duplicate slave address was transmitted simultaneously
-								 */
-								if (slave_node.identify_mode == TRUE) {
-									slave_node.last_slave_error = DUP_SLAVE_ADDR_E;
-								}
-				                break;
-
-			               case 5: /* Bit0 Error
-            			            * During the transmission of a message (or acknow-
-                        			* ledge bit, active error flag, or overload flag),
-                        			* the device wanted to send a dominant level ("0"),
-                        			* but the monitored bus value was recessive. During
-                        			* busoff recovery this staus is set each time a
-                        			* sequence of 11 recessive bits has been monitored.
-                        			* This enables the CPU to monitor the proceeding of
-                        			* the busoff recovery sequence (indicating the bus
-                        			* is not stuck at dominant or continously disturbed).
-									*/
-				               	if (uwStatus & 0x8000) { /* if Busoff status */
-									/* Increment error counter */
-						 			slave_node.num_errors++;
-                  				} else {
-									/* Increment error counter */
-									slave_node.num_errors++;
-                  				}
-                  				break;
-
-			               case 6: /* CRC Error
-                        			* The CRC check sum was incorrect in the message
-                        			* received.
-									*/
-								/* Increment error counter */
-					 			slave_node.num_errors++;
-                  				break;
-
-			               default:
-                  				break;
-               			}
-            		}
-            		break;
-
-				case 2: /* Message Object 15 Interrupt */
-    	     		if ((CAN_OBJ[14].MCR & 0x0c00) == 0x0800) { /* if MSGLST set */
-	        	    	/* 
-						 * Indicates that the CAN controller has stored a new
-   		     	    	 * message into object 15, while NEWDAT was still set,
-        	    	 	 * ie. the previously stored message is lost.
-					 	 */
-           			 	CAN_OBJ[14].MCR = 0xf7ff;    /* reset MSGLST */
-
-						/* 
-						 * Messages in this object are probably M&C data, so 
-						 * do something wih them  Increment error, because we missed
-						 * a message 
-						 */
-						slave_node.num_errors++;
-
-						if (slave_node.last_slave_error != DUP_SLAVE_ADDR_E) {
-							amb_handle_transaction();
-						}
-    	     		} else {
-        	       		/* 
-						 * The CAN controller has stored a new message
-        	   	     	 * into this object.
-						 * Messages in this object are probably M&C data, so
-						 * do something wih them.
-						 */
-						if (slave_node.last_slave_error != DUP_SLAVE_ADDR_E) {
-							amb_handle_transaction();
-						}
-            		}
-           			CAN_OBJ[14].MCR = 0x7dfd;      /* release buffer */
-            		break;
-
-				case 3: /* Message Object 1 Interrupt */
-        		 	if ((CAN_OBJ[0].MCR & 0x0300) == 0x0200) {    /* if NEWDAT set */
-             		 	if ((CAN_OBJ[0].MCR & 0x0c00) == 0x0800) { /* if MSGLST set */
-               				/* 
-					 		 * Indicates that the CAN controller has stored a new
-               				 * message into this object, while NEWDAT was still set,
-               				 * ie. the previously stored message is lost. 
-							 */
-
-			               	CAN_OBJ[0].MCR = 0xf7ff;  /* reset MSGLST */
-
-							/* We are responding to the identify broadcast */
-							slave_node.identify_mode = TRUE;
-
-							/* Turn status interrupts on */
-							C1CSR = 0x000E;
-
-					  		/* Send the serial number in message object 2 */
-							slave_node.num_transactions++;
-							CAN_OBJ[1].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
-
-							/* This is an error, because we missed a message */
-							slave_node.num_errors++;
-        		        } else {
-                			/* 
-							 * The CAN controller has stored a new message
-                 		  	 * into this object.
-						 	 */
-
-							/* We are responding to the identify broadcast */
-							slave_node.identify_mode = TRUE;
-
-							/* Turn status interrupts on */
-							C1CSR = 0x000E;
-
-							/* Send the serial number */
-							slave_node.num_transactions++;
-							CAN_OBJ[1].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
-		                }
-					
-						CAN_OBJ[0].MCR = 0xfdfd;  /* reset NEWDAT, INTPND */
-         			}
-	            	break;
-	     		default:
-    		        break;
-			}
-		}
-	}
-
-/* Routine to check if a callback should be run */
-
-void amb_handle_transaction(){
-	ulong incoming_ID;
-	ubyte i;
-	/* Get incoming ID from Object 15 */
-	incoming_ID = 0x0;
-  
-	    incoming_ID += ((ulong) (CAN_OBJ[14].LAR & 0xf800)) >> 11;  /* ID  4.. 0 */
-   		incoming_ID += ((ulong) (CAN_OBJ[14].LAR & 0x00ff)) <<  5;  /* ID 12.. 5 */
-   		incoming_ID += ((ulong) (CAN_OBJ[14].UAR & 0xff00)) <<  5;  /* ID 13..20 */
-  		incoming_ID += ((ulong) (CAN_OBJ[14].UAR & 0x00ff)) << 21;  /* ID 21..28 */
-
-	/* Calculate relative address from base address */
-	current_msg.relative_address = incoming_ID - slave_node.base_address;
- 	/* Ignore messages that are outside our range (>3FFFF OR <0)*/
-	if ((current_msg.relative_address > 262143) ||
-		(current_msg.relative_address < 0))
-		return;
- 
-	/* Get the message length */
-
-		current_msg.len = (CAN_OBJ[14].MCFG & 0xf0) >> 4;
-	/* This is a monitor request if data length is zero */
-	if (current_msg.len != 0) {
-		current_msg.dirn = CAN_CONTROL;
-		/* Control message: get the data */
-		for (i=0; i<current_msg.len; i++)
-				current_msg.data[i] = CAN_OBJ[14].Data[i];
-		switch (current_msg.relative_address) {	
-			case 0x31000: /*Device or software reset */
-				_trap_ (0x00);
-				return;
-				break;
-			case 0x31001: /* Software reset */
-				_trap_ (0x00);
-				return;
-				break;
-		}
-	} else {
-			current_msg.dirn = CAN_MONITOR;
-			/* Check for common monitor points */
-		switch (current_msg.relative_address ) {
-
- 			case 0x000: /* Slave hardware revision level */
-				/* In order to avoid confusion between the interrupts I use message 
-				   number 2 to respond to this request.
-				   Added JSK 10/06/2005 */
-				/* We are responding to the identify broadcast */
-				slave_node.identify_mode = TRUE;
-
-				/* Turn status interrupts on */
-				C1CSR = 0x000E;
-
-				/* Send the serial number */
-				slave_node.num_transactions++;
-				CAN_OBJ[1].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
-				return;
-				break;
-
-			case 0x30000: /* Slave protocol revision level */
-				current_msg.len = 3;
-				current_msg.data[0] = (ubyte) (slave_node.revision_level[0]);
-				current_msg.data[1] = (ubyte) (slave_node.revision_level[1]);
-				current_msg.data[2] = (ubyte) (slave_node.revision_level[2]);
-				amb_transmit_monitor();
-				slave_node.num_transactions++;
-				return;
-				break;
-			case 0x30001: /* Number of errors and last error */
-				current_msg.len = 4;
-				current_msg.data[0] = (ubyte) (slave_node.num_errors>>8);
-				current_msg.data[1] = (ubyte) (slave_node.num_errors);
-				current_msg.data[2] = 0x0;
-			 	/* LEC from CAN controller */
- 				current_msg.data[3] = C1CSR >> 8;
-				amb_transmit_monitor();
-				slave_node.num_transactions++;
-				return;
-				break;
-			case 0x30002: /* Number of transactions */
-				current_msg.len = 4;
-				current_msg.data[0] = (ubyte) (slave_node.num_transactions>>24);
-				current_msg.data[1] = (ubyte) (slave_node.num_transactions>>16);
-				current_msg.data[2] = (ubyte) (slave_node.num_transactions>>8);
-				current_msg.data[3] = (ubyte) (slave_node.num_transactions);
-				amb_transmit_monitor();
-				slave_node.num_transactions++;
-				return;
-				break;
-			case 0x30004: /* Slave software revision level */
-				current_msg.len = 3;
-				current_msg.data[0] = (ubyte) (slave_node.sw_revision_level[0]);
-				current_msg.data[1] = (ubyte) (slave_node.sw_revision_level[1]);
-				current_msg.data[2] = (ubyte) (slave_node.sw_revision_level[2]);
-				amb_transmit_monitor();
-				slave_node.num_transactions++;
-				return;
-				break;
-			case 0x30005: /* Slave hardware revision level */
-				current_msg.len = 2;
-				current_msg.data[0] = (ubyte) (slave_node.hw_revision_level[0]);
-				current_msg.data[1] = (ubyte) (slave_node.hw_revision_level[1]);
-				amb_transmit_monitor();
-				slave_node.num_transactions++;
-				return;
-				break;
-		}
-	}
-
-	/* For each registered callback, see if this message was in range */
-	for (i=0; i<slave_node.num_cbs; i++) {
-		if ((current_msg.relative_address >= slave_node.cb_ops[i].low_address) &&
-			(current_msg.relative_address <= slave_node.cb_ops[i].high_address)) {
-
-			/* Increment the transaction counter */
-			slave_node.num_transactions++;
-			(slave_node.cb_ops[i].cb_func)(&current_msg);
-
-			if (current_msg.dirn == CAN_MONITOR)
-				amb_transmit_monitor();
-
-			return;
-		}	
-	}
-}
-
-/* Routine to send monitor data back to master using CAN object 3 */
-void amb_transmit_monitor(){
-  	ubyte i;
-  	ulong TX_ID;
-		ulong v;
-  		CAN_OBJ[2].MCR = 0xfb7f;     /* set CPUUPD, reset MSGVAL */
-
-	/* Recalculate CAN message from relative address */
-	TX_ID = slave_node.base_address + current_msg.relative_address;
-
-	/* Calculate the arbitration registers */
-
-   		v = 0x00000000;
-   		v += (TX_ID & 0x0000001f) << 11;  /* ID  4.. 0 */
-   		v += (TX_ID & 0x00001fe0) >>  5;  /* ID 12.. 5 */
-   		CAN_OBJ[2].LAR  = v;
-
-	   	v = 0x00000000;
-   		v += (TX_ID & 0x001fe000) >>  5;  /* ID 13..20 */
-   		v += (TX_ID & 0x1fe00000) >> 21;  /* ID 21..28 */
-   		CAN_OBJ[2].UAR  = v;
-
-
-	/* set transmit direction and length */
-
-   		CAN_OBJ[2].MCFG = 0x0c | (current_msg.len << 4);
-
-	/* Copy data to CAN object 3 */
-   	for(i = 0; i < current_msg.len; i++) {
-
-      		CAN_OBJ[2].Data[i] = current_msg.data[i];
-	}
-  		CAN_OBJ[2].MCR  = 0xf6bf;  /* set NEWDAT, reset CPUUPD, set MSGVAL */
-	
-		/* Transmit the object */
-  		CAN_OBJ[2].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
-}
-
-
+/*
+ *****************************************************************************
+ # $Id: amb.c,v 1.17 2008/03/05 19:44:57 avaccari Exp $
+ #
+ # Copyright (C) 1999
+ # Associated Universities, Inc. Washington DC, USA.
+ #
+ # Correspondence concerning ALMA should be addressed as follows:
+ #        Internet email: mmaswgrp@nrao.edu
+ ****************************************************************************
+ *
+ *  AMB.C 
+ *
+ *  Implementation file for ALMA Monitor and Control Bus Slave library.  This
+ *  file makes use of libraries for the support of Dallas Semiconductor device
+ *  used for a unique serial number.  It is also intended to be the basis for
+ *  slave implementations on hardware other than the suggested interface.
+ *
+ *****************************************************************************
+ */
+
+/* Version of AMB protocol */
+#define PROTOCOL_VERSION_MAJOR 1
+#define PROTOCOL_VERSION_MINOR 1
+#define PROTOCOL_VERSION_PATCH 2
+
+/* Version of SOFTWARE */
+#define SW_VERSION_MAJOR 1
+#define SW_VERSION_MINOR 3
+#define SW_VERSION_PATCH 0
+/* Version of HARDWARE */
+#define HW_VERSION_MAJOR 1
+#define HW_VERSION_MINOR 6
+
+/* REVISION HISTORY */
+/*
+ * Version 01.03.00 - Minor change release
+					  CAN health counters and rates, busoff recovery, identify
+					  answers in the slot of the node address, segmented
+					  transfers (0x31002, 0x30016, 0x30017), warm restart and
+					  fast boot support, CAN interrupt profiling.
+					  New functions: amb_set_block_function, amb_get_function,
+					  amb_second_tick, amb_set_clock, amb_set_profile_hook,
+					  amb_set_reset_hook, amb_set_serial_number,
+					  amb_defer_serial_number, amb_read_serial_number.
+ * Version 01.01.02 - Released as Ver_1_1_2
+           01.02.03   Patch by Andrea Vaccari - NRAO NTC
+		   			  Changed code to assure that any RCA is not serviced more than once in
+					  case the register addresses overlap
+ * Version 01.02.02 - Fixed bug to allow use of NodeID at RCA 0. Jeff Kern
+ * Version 01.01.01 - Released as Ver_1_1_1
+		   			  Patch by Andrea Vaccari - NRAO NTC
+		   			  Added the function "amb_unregister_last_function" declaration in the
+		   			  amb.h file.
+ * Version 01.01.00 - Released as Ver_1_1_0
+					  Minor change by Andrea Vaccari - NRAO NTC
+					  Added the function "amb_unregister_last_function".
+					  If any callback function has been registered, this function will
+                      unregister the last registered function.
+ * Version 01.00.01 - Released as Ver_1_0_1
+		              Patch by Andrea Vaccari - NRAO Tucson
+      		          This patch modified the location of all the global variables
+                      and moved them from external memory to internal memory (IDATA).
+		              The result was an increased speed of execution.
+ * Version 01.00.00 - Original Version developed by Mick Brooks - NRAO Tucson
+*/
+
+
+
+ /* Include C167 register definitions */
+
+	#include <reg167.h>
+	#include <intrins.h>
+
+
+
+#include "amb.h"
+ /* Include Dallas Semiconductor support for C167 */
+
+#include "..\..\libraries\ds1820\ds1820.h"
+
+
+
+/* Definitions of CAN controller structure */
+
+ /* For Siemens C167CR */
+
+	/* Locations of CAN controller registers */
+	#define C1CSR   (*((uword volatile sdata *) 0xEF00)) /* Control/Status Register */
+	#define C1IR    (*((uword volatile sdata *) 0xEF02)) /* Interrupt Register */
+	#define C1BTR   (*((uword volatile sdata *) 0xEF04)) /* Bit Timing Register */
+	#define C1GMS   (*((uword volatile sdata *) 0xEF06)) /* Global Mask Short */
+	#define C1UGML  (*((uword volatile sdata *) 0xEF08)) /* Upper Global Mask Long */
+	#define C1LGML  (*((uword volatile sdata *) 0xEF0A)) /* Lower Global Mask Long */
+	#define C1UMLM  (*((uword volatile sdata *) 0xEF0C)) /* Upper Mask of Last Message */
+	#define C1LMLM  (*((uword volatile sdata *) 0xEF0E)) /* Lower Mask of Last Message */
+	/* 
+	 * Structure for a single 82527 CAN object
+	 * A total of 15 such object structures exists
+	 */
+
+	struct can_obj {
+	  uword  MCR;       /* Message Control Register */
+	  uword  UAR;       /* Upper Arbitration Register */
+	  uword  LAR;       /* Lower Arbitration Register */
+	  ubyte  MCFG;      /* Message Configuration Register */
+	  ubyte  Data[8];   /* Message Data 0 .. 7 */
+	  ubyte  Customer;  /* Reserved for application specific data */
+	} ;
+
+	/* Location of first CAN object */
+	#define CAN_OBJ ((struct can_obj volatile sdata *) 0xEF10)
+
+
+/*
+ ****************************************************************************
+ * Interrupt Vectors
+ ****************************************************************************
+ */
+
+#define XP0INT   0x40
+#define T5INT    0x25
+
+/*
+ * Identify broadcast answers are delayed to the slot of the node address,
+ * timed by GPT2 timer 5 (200 ns at 20 MHz). Only a node with the same
+ * address shares the slot: after a collision the answer is tried again in
+ * it, so a bus error clears while a duplicate address keeps colliding and
+ * is reported
+ */
+#define AMB_ID_SLOT		1000	/* Slot length in timer 5 counts: 200 us, an 8 byte extended frame with room to spare */
+#define AMB_ID_SLOTS	64		/* One per node address */
+#define AMB_ID_RETRIES	4		/* Tries after a collision before reporting a duplicate address */
+
+/* Count a CAN event, stopping at the top of the counter */
+#define AMB_COUNT(cls)	{ if (slave_node.can_count[cls] != 0xffff) slave_node.can_count[cls]++; }
+
+/* CAN health monitor points (snapshot and clear) */
+#define AMB_RATES			4	/* Bus errors, lost messages, identify requests and transactions */
+
+/* Segmented transfers, streamed with message object 4 */
+#define AMB_SEG_START_RCA	0x31002	/* Control: relative address, offset and length of the range */
+#define AMB_SEG_DATA_RCA	0x30016	/* Data frames: sequence number and AMB_SEG_PAYLOAD bytes */
+#define AMB_SEG_END_RCA		0x30017	/* End frame and monitor: status, frames, bytes and CRC */
+#define AMB_SEG_START_LEN	8
+#define AMB_SEG_END_LEN		7
+#define AMB_SEG_SLOT		8		/* Bytes per point when a range is read with monitor requests */
+
+/* Local Function prototypes */
+static ubyte 	amb_get_node_address();
+static int		amb_get_serial_number();
+static int		amb_setup_CAN_hw();
+static void		amb_handle_transaction();
+static void		amb_transmit_monitor();
+static void		amb_snapshot_counters();
+static void		amb_put_words(uword *words, ubyte num);
+static uword	amb_rate(ulong count, uword seconds);
+static void		amb_busoff_start();
+static void		amb_busoff_end();
+static void		amb_identify_schedule();
+static void		amb_identify_answer();
+static CALLBACK_STRUCT *amb_find_callback(ulong relative_address);
+static void		amb_segment_start();
+static void		amb_segment_next();
+static int		amb_segment_read(ulong relative_address, ulong offset, ubyte *data, ubyte len);
+static void		amb_segment_end(ubyte *data);
+static void		amb_segment_send(ulong relative_address, ubyte *data, ubyte len);
+static uword	amb_crc16(uword crc, ubyte *data, ubyte len);
+
+/* All pertinent slave data */
+
+	static struct slave_node {
+
+	ubyte 		serial_number[8];	/* From hardware device */
+	ubyte 		node_address;		/* From DIP switch */
+	ulong		base_address;		/* From node address */
+
+	ubyte		revision_level[3];	/* Protocol version */
+	ubyte		sw_revision_level[3];	/* Software version */
+	ubyte		hw_revision_level[2];	/* Hardware version */
+	uword		num_errors;			/* Number of CAN errors */
+	ubyte		last_slave_error;	/* Last internal slave error */
+	ulong		num_transactions;	/* Number of completed transactions */
+
+	ubyte		identify_mode;		/* True when responding to identify broadcast */
+
+	uword		can_count[AMB_CNT_CLASSES];	/* CAN events by class since the last snapshot */
+	uword		seconds;			/* Running seconds from amb_second_tick */
+
+	ubyte		bus_state;			/* AMB_BUS_ACTIVE or AMB_BUS_RECOVERING */
+	uword		busoff_count;		/* Number of busoff recoveries started */
+	ulong		busoff_start;		/* Clock at the start of the current recovery */
+	ulong		busoff_duration;	/* Length of the last completed recovery in us */
+	clock_func	clock;				/* Application clock (0 if not given) */
+	uword		tick_ns;			/* Clock period */
+
+	ubyte		id_retries;			/* Retries of the current identify answer */
+	ubyte		id_slot;			/* Slot of the current identify answer */
+	uword		id_collisions;		/* Identify answers that collided */
+	uword		id_retried;			/* Identify answers tried again */
+
+	ubyte		sn_given;			/* Serial number given by the application */
+	ubyte		sn_pending;			/* Serial number still to be read (amb_defer_serial_number) */
+	reset_func	reset_hook;			/* Called before a reset (0 if not given) */
+	profile_func	profile_hook;	/* Called on entry and exit of the CAN interrupt (0 if not given) */
+
+	ubyte		num_cbs;			/* No of callbacks registered */
+	CALLBACK_STRUCT	*cb_ops;		/* User supplied callbacks */
+} idata slave_node;
+
+/* Last snapshot of the CAN health counters, taken when 0x30010 is read */
+
+	static struct can_snapshot {
+
+	uword		can_count[AMB_CNT_CLASSES];	/* Counts over the snapshot interval */
+	uword		seconds;			/* Length of the snapshot interval */
+	uword		rates[AMB_RATES];	/* Events per second, times 100 */
+	uword		last_second;		/* Time of the snapshot */
+	ulong		last_transactions;	/* Transactions at the snapshot */
+} can_snapshot;
+
+/* Segmented transfer, started on 0x31002 */
+
+	static struct segment {
+
+	ubyte		status;				/* AMB_SEG_xxx */
+	ubyte		tx_busy;			/* A frame is waiting in message object 4 */
+	ubyte		end_pending;		/* The end frame is still to be sent */
+	ubyte		stop_pending;		/* The end frame of a replaced transfer is still to be sent */
+	ubyte		stop_frame[AMB_SEG_END_LEN];	/* That end frame */
+	ulong		relative_address;	/* Address the range is read from */
+	block_func	func;				/* Callback serving the range */
+	read_or_write_func	cb_func;	/* Callback read by amb_segment_read */
+	ulong		high_address;		/* Last address it serves */
+	ubyte		slot_valid;			/* The reply below is the one of slot_address */
+	ulong		slot_address;		/* Last point read by amb_segment_read */
+	ubyte		slot_len;			/* Its reply */
+	ubyte		slot[8];
+	ulong		offset;				/* Next byte to send */
+	uword		left;				/* Bytes still asked for */
+	uword		frames;				/* Data frames sent, the low byte is the sequence number */
+	uword		bytes;				/* Data bytes sent */
+	uword		crc;				/* CRC-16/CCITT of the bytes sent */
+} segment;
+
+/* Structure for sharing message data with callbacks */
+
+	static CAN_MSG_TYPE idata current_msg;
+
+
+
+/* Initialise routine */
+int amb_init_slave(void *cb_ops_memory){
+	ubyte i;
+
+/* Point to callback memory */
+	slave_node.cb_ops = (CALLBACK_STRUCT *) cb_ops_memory;
+
+/* Initially we have no registered callbacks */
+	slave_node.num_cbs = 0;
+
+/* Get the address of this slave from the hardware */
+	slave_node.node_address = amb_get_node_address();
+
+/* Calculate the base address */
+	slave_node.base_address = ((ulong) (slave_node.node_address + 1)) * 262144;
+
+/* Try to get the serial number from the hardware, unless it was given or
+   is read later (amb_read_serial_number) */
+	if (!slave_node.sn_given && !slave_node.sn_pending) {
+		if (amb_get_serial_number(slave_node.serial_number) != 0) {
+			return -1;
+		}
+	}
+	slave_node.sn_given = FALSE;
+
+	/* Initialise counters and status */
+	slave_node.revision_level[0] = PROTOCOL_VERSION_MAJOR;
+	slave_node.revision_level[1] = PROTOCOL_VERSION_MINOR;
+	slave_node.revision_level[2] = PROTOCOL_VERSION_PATCH;
+	slave_node.sw_revision_level[0] = SW_VERSION_MAJOR;
+	slave_node.sw_revision_level[1] = SW_VERSION_MINOR;
+	slave_node.sw_revision_level[2] = SW_VERSION_PATCH;
+	slave_node.hw_revision_level[0] = HW_VERSION_MAJOR;
+	slave_node.hw_revision_level[1] = HW_VERSION_MINOR;
+	slave_node.num_errors = 0;
+	slave_node.last_slave_error = 0x0;
+	slave_node.num_transactions = 0;
+
+	slave_node.identify_mode = FALSE;
+
+	for (i=0; i<AMB_CNT_CLASSES; i++) {
+		slave_node.can_count[i] = 0;
+	}
+	slave_node.seconds = 0;
+
+	slave_node.bus_state = AMB_BUS_ACTIVE;
+	slave_node.busoff_count = 0;
+	slave_node.busoff_duration = 0;
+	slave_node.clock = 0;
+
+	slave_node.id_retries = 0;
+	slave_node.id_slot = 0;
+	slave_node.id_collisions = 0;
+	slave_node.id_retried = 0;
+
+	slave_node.reset_hook = 0;
+	slave_node.profile_hook = 0;
+
+	segment.status = AMB_SEG_IDLE;
+	segment.tx_busy = FALSE;
+	segment.end_pending = FALSE;
+	segment.stop_pending = FALSE;
+	segment.frames = 0;
+	segment.bytes = 0;
+	segment.crc = 0xffff;
+
+	/* 
+	 * Timer 5 times the identify answers: counts up at fCPU/4, stopped
+	 * Timer 5 interrupt priority level (ILVL) = 13
+	 * Timer 5 interrupt group level (GLVL) = 2
+	 * Same level as CAN: neither can interrupt the other
+	 */
+	T5CON = 0x0000;
+	T5IC = 0x0076;
+	
+/* Setup the CAN hardware */
+	return amb_setup_CAN_hw();
+}
+
+/* Register callback routine */
+int amb_register_function(ulong low_address, ulong high_address, read_or_write_func func){
+/* Store callback info */
+	slave_node.cb_ops[slave_node.num_cbs].low_address = low_address;
+	slave_node.cb_ops[slave_node.num_cbs].high_address = high_address;
+	slave_node.cb_ops[slave_node.num_cbs].cb_func = func;
+	slave_node.cb_ops[slave_node.num_cbs].blk_func = 0;
+
+/* Increment the number of callbacks */
+	slave_node.num_cbs++;
+
+/* Always succeeds */
+	return 0;
+}
+
+/* Unregister last registered callback routine */
+int amb_unregister_last_function(void){
+
+/* If no function is registered, nothing to be done. */
+	if(!slave_node.num_cbs){
+		return 0;
+	}
+
+/* Decrement the number of callbacks. */
+	slave_node.num_cbs--;
+
+	return 0;
+}
+
+/* Callback registered for a relative address (0 if none) */
+read_or_write_func amb_get_function(ulong relative_address){
+	CALLBACK_STRUCT *cb;
+
+	cb = amb_find_callback(relative_address);
+
+	return cb ? cb->cb_func : 0;
+}
+
+/* Let the callback registered for a relative address serve byte ranges */
+int amb_set_block_function(ulong relative_address, block_func func){
+	CALLBACK_STRUCT *cb;
+
+	cb = amb_find_callback(relative_address);
+
+/* Nothing registered there */
+	if(!cb){
+		return -1;
+	}
+
+	cb->blk_func = func;
+
+	return 0;
+}
+
+/* Time base for the CAN rates */
+void amb_second_tick(void){
+	slave_node.seconds++;
+}
+
+/* Clock used to time the busoff recoveries */
+void amb_set_clock(clock_func clock, uword tick_ns){
+	slave_node.tick_ns = tick_ns;
+	slave_node.clock = clock;
+}
+
+/* Function called before a reset */
+void amb_set_reset_hook(reset_func hook){
+	slave_node.reset_hook = hook;
+}
+
+/* Function timing the CAN interrupt */
+void amb_set_profile_hook(profile_func hook){
+	slave_node.profile_hook = hook;
+}
+
+/* Serial number saved across a reset, or read after amb_start */
+void amb_set_serial_number(ubyte serial_number[8]){
+	ubyte i;
+
+	for (i=0; i<8; i++) {
+		slave_node.serial_number[i] = serial_number[i];
+	}
+
+	/* Not known when CAN was set up: put it in the identify answer now */
+	if (slave_node.sn_pending) {
+		CAN_OBJ[1].MCR = 0xfbff;  /* set CPUUPD */
+		for (i=0; i<8; i++) {
+			CAN_OBJ[1].Data[i] = serial_number[i];
+		}
+		CAN_OBJ[1].MCR = 0xf7ff;  /* reset CPUUPD */
+		slave_node.sn_pending = FALSE;
+		return;
+	}
+
+	slave_node.sn_given = TRUE;
+}
+
+/* Set up CAN without the serial number: the 1-Wire probing is left for later */
+void amb_defer_serial_number(void){
+	slave_node.sn_pending = TRUE;
+}
+
+/* Read the serial number put off with amb_defer_serial_number */
+int amb_read_serial_number(void){
+	ubyte serial_number[8];
+	ubyte i;
+
+	if (amb_get_serial_number() != 0) {
+		return -1;
+	}
+
+	for (i=0; i<8; i++) {
+		serial_number[i] = slave_node.serial_number[i];
+	}
+	amb_set_serial_number(serial_number);
+
+	return 0;
+}
+
+/* Startup routine */
+int amb_start(){
+	IEN = 1;
+
+/* Always succeeds */
+	return 0;
+}
+
+/* Read the slave address */
+ubyte amb_get_node_address(){
+	#ifdef AMBSI  /* Standard i/f, DIP switch on Port 3.1 to 3.6 */
+		return (P3 & 0x7e) >> 1;
+	#endif /* AMBSI */
+
+	#ifdef SK167  /* Starter Kit test board, DIP switch on Port 7.1 to 7.6 */
+		return (P7 & 0x7e) >> 1;
+	#endif /* SK167 */
+
+}
+
+/* Read the serial number from the Dallas Semiconductor device */
+int amb_get_serial_number(){
+
+		/* Initialise the 1-wire port (library defined) */
+		if (ds1820_init() != 0) {
+			slave_node.last_slave_error = NO_DS1820_E;
+			return -1;
+		}
+
+		/* read the serial number */
+		if (ds1820_get_sn(slave_node.serial_number) != 0) {
+			slave_node.last_slave_error = NO_SN_E;
+			return -1;
+		} else {
+			return 0;
+		}
+
+
+}
+
+/* Routine to setup an Intel 82527-like controller */
+int amb_setup_CAN_hw(){
+
+		ulong LAR, UAR;
+
+		/* Set up for the various arbitration registers */
+
+		/* calculate lower mask */
+  		LAR = 0x00000000;
+  		LAR += (slave_node.base_address & 0x0000001f) << 11;  /* ID  4.. 0 */
+  		LAR += (slave_node.base_address & 0x00001fe0) >>  5;  /* ID 12.. 5 */
+
+		/* calculate the upper mask */
+  		UAR = 0x00000000;
+  		UAR += (slave_node.base_address & 0x001fe000) >>  5;  /* ID 13..20 */
+  		UAR += (slave_node.base_address & 0x1fe00000) >> 21;  /* ID 21..28 */
+
+		/*  ------------ CAN Control/Status Register -------------- 
+  		 *  start the initialization of the CAN Module 
+		 */
+  		C1CSR  = 0x0041;  /* set INIT and CCE */
+
+	  	/*  ------------ Bit Timing Register ---------------------
+  		 *  baudrate =  1000.000 KBaud
+  		 *	 there are 5 time quanta before sample point
+  		 *	 there are 4 time quanta after sample point
+  		 *	 the (re)synchronization jump width is 2 time quanta
+		 */
+  		C1BTR  = 0x3440;  /* set Bit Timing Register */
+  		C1GMS  = 0xE0FF;  /* set Global Mask Short Register */
+  		C1UGML = 0xFFFF;  /* set Upper Global Mask Long Register */
+  		C1LGML = 0xF8FF;  /* set Lower Global Mask Long Register */
+
+	  	/*  ------------------------------------------------------------------------
+  		 *  ----------------- Configure Message Object 1 ---------------------------
+		 *  --- This message object is used to receive the global identify ---------
+		 *  --- broadcast message on ID 0x00000000 ---------------------------------
+  		 *  ------------------------------------------------------------------------
+  		 *  Message object 1 is valid
+  		 *  enable receive interrupt
+		 */
+  		CAN_OBJ[0].MCR  = 0x5599;    /* set Message Control Register */
+
+	  	/*
+  	 	 * message direction is receive
+  		 * extended 29-bit identifier
+    	 */
+  		CAN_OBJ[0].MCFG = 0x04;      /* set Message Configuration Register */
+
+	  	CAN_OBJ[0].UAR  = 0x0000;    /* set Upper Arbitration Register */
+  		CAN_OBJ[0].LAR  = 0x0000;    /* set Lower Arbitration Register */
+
+	  	/*  ------------------------------------------------------------------------
+  		 *  ----------------- Configure Message Object 2 ---------------------------
+		 *  --- This message object is used as a transmit object for the serial ----
+		 *  --- number.  It can be RTR'd quickly from the master -------------------
+  		 *  ------------------------------------------------------------------------
+  		 *  Message object 2 is valid
+		 */
+  		CAN_OBJ[1].MCR  = 0x5695;    /* set Message Control Register */
+
+	  	/* 
+		 * message direction is transmit
+  		 * extended 29-bit identifier
+  		 * 8 valid data bytes
+   		 */
+  		CAN_OBJ[1].MCFG = 0x8C;      /* set Message Configuration Register */
+
+	  	CAN_OBJ[1].UAR  = UAR;	 /* set Upper Arbitration Register of Object 2 */
+  		CAN_OBJ[1].LAR  = LAR;	 /* set Lower Arbitration Register of Object 2 */	
+  		//CAN_OBJ[1].LAR  = LAR+1;	 /* set Lower Arbitration Register of Object 2 */	
+
+	  	CAN_OBJ[1].Data[0] = slave_node.serial_number[0];   /* set data byte 0 */
+  		CAN_OBJ[1].Data[1] = slave_node.serial_number[1];   /* set data byte 1 */
+  		CAN_OBJ[1].Data[2] = slave_node.serial_number[2];   /* set data byte 2 */
+  		CAN_OBJ[1].Data[3] = slave_node.serial_number[3];   /* set data byte 3 */
+  		CAN_OBJ[1].Data[4] = slave_node.serial_number[4];   /* set data byte 4 */
+  		CAN_OBJ[1].Data[5] = slave_node.serial_number[5];   /* set data byte 5 */
+  		CAN_OBJ[1].Data[6] = slave_node.serial_number[6];   /* set data byte 6 */
+  		CAN_OBJ[1].Data[7] = slave_node.serial_number[7];   /* set data byte 7 */
+
+	  	/*  ------------------------------------------------------------------------
+  		 *  ----------------- Configure Message Object 3 ---------------------------
+		 *  --- This message object is used to transmit all monitor data back to ---
+		 *  --- the master. --------------------------------------------------------
+  		 *  ------------------------------------------------------------------------
+  		 *  Message object 3 is valid
+   		 */
+	  	CAN_OBJ[2].MCR  = 0x5695;    /* set Message Control Register */
+
+	  	/* 
+		 * message direction is transmit
+  		 * extended 29-bit identifier
+  		 * 0 valid data bytes
+      	 */
+  		CAN_OBJ[2].MCFG = 0x0C;      /* set Message Configuration Register */
+
+	  	CAN_OBJ[2].UAR  = 0x0000;    /* set Upper Arbitration Register */
+  		CAN_OBJ[2].LAR  = 0x0000;    /* set Lower Arbitration Register */
+  		
+	  	/*  ------------------------------------------------------------------------
+  		 *  ----------------- Configure Message Object 4 ---------------------------
+		 *  --- This message object streams the segmented transfers: its transmit --
+		 *  --- interrupt queues the next frame ------------------------------------
+  		 *  ------------------------------------------------------------------------
+  		 *  Message object 4 is valid
+  		 *  enable transmit interrupt
+   		 */
+	  	CAN_OBJ[3].MCR  = 0x55a5;    /* set Message Control Register */
+
+	  	/* 
+		 * message direction is transmit
+  		 * extended 29-bit identifier
+  		 * 0 valid data bytes
+      	 */
+  		CAN_OBJ[3].MCFG = 0x0C;      /* set Message Configuration Register */
+
+	  	CAN_OBJ[3].UAR  = 0x0000;    /* set Upper Arbitration Register */
+  		CAN_OBJ[3].LAR  = 0x0000;    /* set Lower Arbitration Register */
+
+	  	/*  ------------------------------------------------------------------------
+  		 *  ----------------- Configure Message Objects 5 to 14 --------------------
+		 *  --- These objects are not used at present ------------------------------
+  		 *  ------------------------------------------------------------------------
+		 */
+  		CAN_OBJ[4].MCR  = 0x5555;    /* set Message Control Register */
+	  	CAN_OBJ[5].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[6].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[7].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[8].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[9].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[10].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[11].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[12].MCR  = 0x5555;    /* set Message Control Register */
+  		CAN_OBJ[13].MCR  = 0x5555;    /* set Message Control Register */
+
+	  	/*  ------------------------------------------------------------------------
+  		 *  ----------------- Configure Message Object 15 --------------------------
+		 *  --- This object is used in Basic CAN mode to receive all M&C requests --
+  		 *  ------------------------------------------------------------------------
+  		 *  Message object 15 is valid
+  		 *  enable receive interrupt
+   		 */
+  		CAN_OBJ[14].MCR  = 0x5599;    /* set Message Control Register */
+
+	  	/* 
+		 * message direction is receive
+  		 * extended 29-bit identifier
+   	 	 */
+  		CAN_OBJ[14].MCFG = 0x04;      /* set Message Configuration Register */
+
+		/* Set the mask so that only the upper 11 bits are compared with the incoming identifier.
+		   This ensures that messages are correctly filtered for this slaves range of identifiers */
+ 	 	C1UMLM = 0xE0FF;           /* set Upper Mask of Last Message */
+  		C1LMLM = 0x0000;           /* set Lower Mask of Last Message */
+
+	  	CAN_OBJ[14].UAR  = UAR; /* set Upper Arbitration Register of Basic CAN object */
+  		CAN_OBJ[14].LAR  = LAR; /* set Lower Arbitration Register of Basic CAN object */
+
+	    /*
+		 *  enable CAN interrupt
+  		 *  CAN interrupt priority level(ILVL) = 13
+  	 	 *  CAN interrupt group level (GLVL) = 3
+    	 */
+  		XP0IC = 0x0077;
+
+	  	/* ------------ CAN Control/Status Register --------------
+  		 *  reset CCE and INIT
+  		 * enable interrupt generation from CAN Module
+  		 * enable interrupt generation on a change of bit BOFF or EWARN
+		 * No status interrupts!
+   		 */
+  		C1CSR = 0x000A;
+
+	/* Always succeeds */
+	return 0;
+}
+
+/*
+ ****************************************************************************
+ *  This is the interrupt service routine for the CAN controller.
+ *  It is executed if:
+ *  - the busoff or the error warning status is reached 
+ *    (EIE is set)
+ *  - a message has been sent or received successfully or a bus 
+ *    error occurred (SIE is set)
+ *  - the bit INTPND (interrupt pending) in one of the message
+ *    object control-registers is set (at Tx or Rx)
+ * 
+ ****************************************************************************
+ */
+
+	void amb_can_isr(void) interrupt XP0INT{
+  	uword uwIntID;
+  	uword uwStatus;
+
+		if (slave_node.profile_hook)
+			slave_node.profile_hook(TRUE);
+
+	  	while (uwIntID = C1IR & 0x00ff) {
+	    	switch (uwIntID & 0x00ff) {
+	     		case 1:  /* Status Change Interrupt
+    	     	     	 * The CAN controller has updated (not necessarily changed)
+        	    	  	 * the status in the Control Register.
+						 */
+
+					uwStatus = C1CSR;
+		            if (uwStatus & 0x8000) { /* if BOFF */
+        		    	/* 
+						 * Indicates when the CAN controller is in busoff state.
+						 * Increment error counter and start the recovery
+					 	 */
+						if (slave_node.bus_state == AMB_BUS_ACTIVE) {
+							slave_node.num_errors++;
+							AMB_COUNT(AMB_CNT_BUSOFF);
+							amb_busoff_start();
+							uwStatus = C1CSR;
+						}
+					} else if (slave_node.bus_state == AMB_BUS_RECOVERING) {
+						/* The recovery sequence is over */
+						amb_busoff_end();
+						uwStatus = C1CSR;
+					}
+
+		            if (uwStatus & 0x4000) { /* if EWRN */
+        		       /* 
+						* Indicates that the least one of the error counters in the
+                		* EML has reached the error warning limit of 96.
+					 	* Increment the error counter
+					 	*/
+						slave_node.num_errors++;
+						AMB_COUNT(AMB_CNT_WARNING);
+            		}
+
+ 		           if (uwStatus & 0x0800) { /* if TXOK */
+              			/* 
+					 	 * Indicates that a message has been transmitted successfully
+              	 		 * (error free and acknowledged by at least one other node). 
+					 	 */
+              			uwStatus &= 0xf7ff;
+              			C1CSR = uwStatus;     /* reset TXOK */
+
+				 		/* If we are responding to the identify broadcast, then we are done */
+						if (slave_node.identify_mode == TRUE) {
+							/* Turn status interrupts off */
+							C1CSR = 0x000A;
+							slave_node.identify_mode = FALSE;
+						}
+        		    }
+
+		            if (uwStatus & 0x1000) { /* if RXOK */
+        		      	/* Indicates that a message has been received successfully. */
+              			uwStatus &= 0xefff;
+		              	C1CSR = uwStatus;     /* reset RXOK */
+        		    }
+
+		            if (uwStatus & 0x0700) { /* if LEC */
+        			    switch ((uwStatus & 0x0700) >> 8) { /* LEC (Last Error Code) */
+               				case 1: /* Stuff Error
+                        			 * More than 5 equal bits in a sequence have occurred
+			                         * in a part of a received message where this is not
+                        			 * allowed. 
+									 */
+								/* Increment error counter */
+								slave_node.num_errors++;
+								AMB_COUNT(AMB_CNT_STUFF);
+	               				break;
+
+			               case 2: /* Form Error
+            			            * A fixed format part of a received frame has the
+                        			* wrong format. 
+									*/
+								/* Increment error counter */
+				 			 	slave_node.num_errors++;
+								AMB_COUNT(AMB_CNT_FORM);
+        			          	break;
+
+			               case 3: /* Ack Error
+            			            * The message this CAN controller transmitted was
+                        			* not acknowledged by another node. 
+									*/
+								/* Increment error counter */
+								slave_node.num_errors++;
+								AMB_COUNT(AMB_CNT_ACK);
+                  				break;
+
+			               case 4: /* Bit1 Error
+                        			* During the transmission of a message (with the
+                        			* exception of the arbitration field), the device
+                        			* wanted to send a recessive level ("1"), but the
+                        			* monitored bus value was dominant.
+									*/
+								/* Increment error counter */
+					 			slave_node.num_errors++;
+								AMB_COUNT(AMB_CNT_BIT1);
+
+								/* 
+								 * If we are responding to an identify request, another node
+								 * sent the same identifier at the same time. Stop the automatic
+								 * retransmission and try again in the same slot: only when that
+								 * keeps failing is it a duplicate slave address
+								 */
+								if (slave_node.identify_mode == TRUE) {
+									slave_node.id_collisions++;
+									CAN_OBJ[1].MCR = 0xdfff;  /* reset TXRQ */
+									slave_node.identify_mode = FALSE;
+									C1CSR = 0x000A;
+
+									if (slave_node.id_retries < AMB_ID_RETRIES) {
+										slave_node.id_retries++;
+										slave_node.id_retried++;
+										amb_identify_schedule();
+									} else {
+										slave_node.last_slave_error = DUP_SLAVE_ADDR_E;
+									}
+								}
+				                break;
+
+			               case 5: /* Bit0 Error
+            			            * During the transmission of a message (or acknow-
+                        			* ledge bit, active error flag, or overload flag),
+                        			* the device wanted to send a dominant level ("0"),
+                        			* but the monitored bus value was recessive. During
+                        			* busoff recovery this staus is set each time a
+                        			* sequence of 11 recessive bits has been monitored.
+                        			* This enables the CPU to monitor the proceeding of
+                        			* the busoff recovery sequence (indicating the bus
+                        			* is not stuck at dominant or continously disturbed).
+									*/
+				               	if (uwStatus & 0x8000) { /* if Busoff status */
+									/* Increment error counter */
+						 			slave_node.num_errors++;
+                  				} else {
+									/* Increment error counter */
+									slave_node.num_errors++;
+									AMB_COUNT(AMB_CNT_BIT0);
+                  				}
+                  				break;
+
+			               case 6: /* CRC Error
+                        			* The CRC check sum was incorrect in the message
+                        			* received.
+									*/
+								/* Increment error counter */
+					 			slave_node.num_errors++;
+								AMB_COUNT(AMB_CNT_CRC);
+                  				break;
+
+			               default:
+                  				break;
+               			}
+            		}
+            		break;
+
+				case 2: /* Message Object 15 Interrupt */
+    	     		if ((CAN_OBJ[14].MCR & 0x0c00) == 0x0800) { /* if MSGLST set */
+	        	    	/* 
+						 * Indicates that the CAN controller has stored a new
+   		     	    	 * message into object 15, while NEWDAT was still set,
+        	    	 	 * ie. the previously stored message is lost.
+					 	 */
+           			 	CAN_OBJ[14].MCR = 0xf7ff;    /* reset MSGLST */
+
+						/* 
+						 * Messages in this object are probably M&C data, so 
+						 * do something wih them  Increment error, because we missed
+						 * a message 
+						 */
+						slave_node.num_errors++;
+						AMB_COUNT(AMB_CNT_MSGLST);
+
+						if (slave_node.last_slave_error != DUP_SLAVE_ADDR_E) {
+							amb_handle_transaction();
+						}
+    	     		} else {
+        	       		/* 
+						 * The CAN controller has stored a new message
+        	   	     	 * into this object.
+						 * Messages in this object are probably M&C data, so
+						 * do something wih them.
+						 */
+						if (slave_node.last_slave_error != DUP_SLAVE_ADDR_E) {
+							amb_handle_transaction();
+						}
+            		}
+           			CAN_OBJ[14].MCR = 0x7dfd;      /* release buffer */
+            		break;
+
+				case 3: /* Message Object 1 Interrupt */
+        		 	if ((CAN_OBJ[0].MCR & 0x0300) == 0x0200) {    /* if NEWDAT set */
+             		 	if ((CAN_OBJ[0].MCR & 0x0c00) == 0x0800) { /* if MSGLST set */
+               				/* 
+					 		 * Indicates that the CAN controller has stored a new
+               				 * message into this object, while NEWDAT was still set,
+               				 * ie. the previously stored message is lost. 
+							 */
+
+			               	CAN_OBJ[0].MCR = 0xf7ff;  /* reset MSGLST */
+
+					  		/* Send the serial number in message object 2, in our slot */
+							slave_node.id_retries = 0;
+							amb_identify_schedule();
+
+							/* This is an error, because we missed a message */
+							slave_node.num_errors++;
+							AMB_COUNT(AMB_CNT_MSGLST);
+							AMB_COUNT(AMB_CNT_IDENTIFY);
+        		        } else {
+                			/* 
+							 * The CAN controller has stored a new message
+                 		  	 * into this object.
+						 	 */
+
+							/* Send the serial number, in our slot */
+							AMB_COUNT(AMB_CNT_IDENTIFY);
+							slave_node.id_retries = 0;
+							amb_identify_schedule();
+		                }
+					
+						CAN_OBJ[0].MCR = 0xfdfd;  /* reset NEWDAT, INTPND */
+         			}
+	            	break;
+
+				case 6: /* Message Object 4 Interrupt */
+					/* A segmented transfer frame went out: queue the next one */
+					CAN_OBJ[3].MCR = 0xfffd;  /* reset INTPND */
+					segment.tx_busy = FALSE;
+					amb_segment_next();
+	            	break;
+	     		default:
+    		        break;
+			}
+		}
+
+		if (slave_node.profile_hook)
+			slave_node.profile_hook(FALSE);
+	}
+
+/* Routine to check if a callback should be run */
+
+void amb_handle_transaction(){
+	ulong incoming_ID;
+	ubyte i;
+	/* Get incoming ID from Object 15 */
+	incoming_ID = 0x0;
+  
+	    incoming_ID += ((ulong) (CAN_OBJ[14].LAR & 0xf800)) >> 11;  /* ID  4.. 0 */
+   		incoming_ID += ((ulong) (CAN_OBJ[14].LAR & 0x00ff)) <<  5;  /* ID 12.. 5 */
+   		incoming_ID += ((ulong) (CAN_OBJ[14].UAR & 0xff00)) <<  5;  /* ID 13..20 */
+  		incoming_ID += ((ulong) (CAN_OBJ[14].UAR & 0x00ff)) << 21;  /* ID 21..28 */
+
+	/* Calculate relative address from base address */
+	current_msg.relative_address = incoming_ID - slave_node.base_address;
+ 	/* Ignore messages that are outside our range (>3FFFF OR <0)*/
+	if ((current_msg.relative_address > 262143) ||
+		(current_msg.relative_address < 0))
+		return;
+ 
+	/* Get the message length */
+
+		current_msg.len = (CAN_OBJ[14].MCFG & 0xf0) >> 4;
+	/* This is a monitor request if data length is zero */
+	if (current_msg.len != 0) {
+		current_msg.dirn = CAN_CONTROL;
+		/* Control message: get the data */
+		for (i=0; i<current_msg.len; i++)
+				current_msg.data[i] = CAN_OBJ[14].Data[i];
+		switch (current_msg.relative_address) {	
+			case 0x31000: /*Device or software reset */
+				if (slave_node.reset_hook)
+					slave_node.reset_hook(FALSE);
+				_trap_ (0x00);
+				return;
+				break;
+			case 0x31001: /* Software reset */
+				if (slave_node.reset_hook)
+					slave_node.reset_hook(TRUE);
+				_trap_ (0x00);
+				return;
+				break;
+			case AMB_SEG_START_RCA: /* Start or stop a segmented transfer */
+				if (current_msg.len >= AMB_SEG_START_LEN)
+					amb_segment_start();
+				slave_node.num_transactions++;
+				return;
+				break;
+		}
+	} else {
+			current_msg.dirn = CAN_MONITOR;
+			/* Check for common monitor points */
+		switch (current_msg.relative_address ) {
+
+ 			case 0x000: /* Slave hardware revision level */
+				/* Serial number not read yet: "initializing", as the
+				   application points starting up */
+				if (slave_node.sn_pending) {
+					current_msg.len = 0;
+					amb_transmit_monitor();
+					slave_node.num_transactions++;
+					return;
+				}
+
+				/* In order to avoid confusion between the interrupts I use message 
+				   number 2 to respond to this request.
+				   Added JSK 10/06/2005 */
+				/* We are responding to the identify broadcast */
+				slave_node.identify_mode = TRUE;
+
+				/* Turn status interrupts on */
+				C1CSR = 0x000E;
+
+				/* Send the serial number */
+				slave_node.num_transactions++;
+				AMB_COUNT(AMB_CNT_IDENTIFY);
+				CAN_OBJ[1].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
+				return;
+				break;
+
+			case 0x30000: /* Slave protocol revision level */
+				/* Not before the serial number, as 0x000 */
+				if (slave_node.sn_pending) {
+					current_msg.len = 0;
+					amb_transmit_monitor();
+					slave_node.num_transactions++;
+					return;
+				}
+
+				current_msg.len = 3;
+				current_msg.data[0] = (ubyte) (slave_node.revision_level[0]);
+				current_msg.data[1] = (ubyte) (slave_node.revision_level[1]);
+				current_msg.data[2] = (ubyte) (slave_node.revision_level[2]);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30001: /* Number of errors and last error */
+				current_msg.len = 4;
+				current_msg.data[0] = (ubyte) (slave_node.num_errors>>8);
+				current_msg.data[1] = (ubyte) (slave_node.num_errors);
+				current_msg.data[2] = 0x0;
+			 	/* LEC from CAN controller */
+ 				current_msg.data[3] = C1CSR >> 8;
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30002: /* Number of transactions */
+				current_msg.len = 4;
+				current_msg.data[0] = (ubyte) (slave_node.num_transactions>>24);
+				current_msg.data[1] = (ubyte) (slave_node.num_transactions>>16);
+				current_msg.data[2] = (ubyte) (slave_node.num_transactions>>8);
+				current_msg.data[3] = (ubyte) (slave_node.num_transactions);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30004: /* Slave software revision level */
+				current_msg.len = 3;
+				current_msg.data[0] = (ubyte) (slave_node.sw_revision_level[0]);
+				current_msg.data[1] = (ubyte) (slave_node.sw_revision_level[1]);
+				current_msg.data[2] = (ubyte) (slave_node.sw_revision_level[2]);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30005: /* Slave hardware revision level */
+				current_msg.len = 2;
+				current_msg.data[0] = (ubyte) (slave_node.hw_revision_level[0]);
+				current_msg.data[1] = (ubyte) (slave_node.hw_revision_level[1]);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30010: /* Take a snapshot of the CAN health counters and clear them. Stuff, form, ack and CRC errors */
+				amb_snapshot_counters();
+				amb_put_words(&can_snapshot.can_count[AMB_CNT_STUFF], 4);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30011: /* Snapshot: bit0 and bit1 errors, warning and busoff events */
+				amb_put_words(&can_snapshot.can_count[AMB_CNT_BIT0], 4);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30012: /* Snapshot: lost messages, identify requests and length of the interval in seconds */
+				amb_put_words(&can_snapshot.can_count[AMB_CNT_MSGLST], 2);
+				current_msg.len = 6;
+				current_msg.data[4] = (ubyte) (can_snapshot.seconds>>8);
+				current_msg.data[5] = (ubyte) (can_snapshot.seconds);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30013: /* Snapshot: bus errors, lost messages, identify requests and transactions per second, times 100 */
+				amb_put_words(can_snapshot.rates, AMB_RATES);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30014: /* Busoff recoveries, recovery state and length of the last recovery in us */
+				current_msg.len = 7;
+				current_msg.data[0] = (ubyte) (slave_node.busoff_count>>8);
+				current_msg.data[1] = (ubyte) (slave_node.busoff_count);
+				current_msg.data[2] = slave_node.bus_state;
+				current_msg.data[3] = (ubyte) (slave_node.busoff_duration>>24);
+				current_msg.data[4] = (ubyte) (slave_node.busoff_duration>>16);
+				current_msg.data[5] = (ubyte) (slave_node.busoff_duration>>8);
+				current_msg.data[6] = (ubyte) (slave_node.busoff_duration);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case 0x30015: /* Identify answers: collisions, retries and slot of the last one */
+				current_msg.len = 5;
+				current_msg.data[0] = (ubyte) (slave_node.id_collisions>>8);
+				current_msg.data[1] = (ubyte) (slave_node.id_collisions);
+				current_msg.data[2] = (ubyte) (slave_node.id_retried>>8);
+				current_msg.data[3] = (ubyte) (slave_node.id_retried);
+				current_msg.data[4] = slave_node.id_slot;
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+			case AMB_SEG_END_RCA: /* Segmented transfer: status, frames and bytes sent and CRC so far */
+				current_msg.len = AMB_SEG_END_LEN;
+				amb_segment_end(current_msg.data);
+				amb_transmit_monitor();
+				slave_node.num_transactions++;
+				return;
+				break;
+		}
+	}
+
+	/* For each registered callback, see if this message was in range */
+	for (i=0; i<slave_node.num_cbs; i++) {
+		if ((current_msg.relative_address >= slave_node.cb_ops[i].low_address) &&
+			(current_msg.relative_address <= slave_node.cb_ops[i].high_address)) {
+
+			/* Increment the transaction counter */
+			slave_node.num_transactions++;
+			(slave_node.cb_ops[i].cb_func)(&current_msg);
+
+			if (current_msg.dirn == CAN_MONITOR)
+				amb_transmit_monitor();
+
+			return;
+		}	
+	}
+}
+
+/* First registered callback in range of a relative address, as
+   amb_handle_transaction picks it (0 if none) */
+CALLBACK_STRUCT *amb_find_callback(ulong relative_address){
+	ubyte i;
+
+	for (i=0; i<slave_node.num_cbs; i++) {
+		if ((relative_address >= slave_node.cb_ops[i].low_address) &&
+			(relative_address <= slave_node.cb_ops[i].high_address)) {
+			return &slave_node.cb_ops[i];
+		}
+	}
+
+	return 0;
+}
+
+/* Routine to send monitor data back to master using CAN object 3 */
+void amb_transmit_monitor(){
+  	ubyte i;
+  	ulong TX_ID;
+		ulong v;
+  		CAN_OBJ[2].MCR = 0xfb7f;     /* set CPUUPD, reset MSGVAL */
+
+	/* Recalculate CAN message from relative address */
+	TX_ID = slave_node.base_address + current_msg.relative_address;
+
+	/* Calculate the arbitration registers */
+
+   		v = 0x00000000;
+   		v += (TX_ID & 0x0000001f) << 11;  /* ID  4.. 0 */
+   		v += (TX_ID & 0x00001fe0) >>  5;  /* ID 12.. 5 */
+   		CAN_OBJ[2].LAR  = v;
+
+	   	v = 0x00000000;
+   		v += (TX_ID & 0x001fe000) >>  5;  /* ID 13..20 */
+   		v += (TX_ID & 0x1fe00000) >> 21;  /* ID 21..28 */
+   		CAN_OBJ[2].UAR  = v;
+
+
+	/* set transmit direction and length */
+
+   		CAN_OBJ[2].MCFG = 0x0c | (current_msg.len << 4);
+
+	/* Copy data to CAN object 3 */
+   	for(i = 0; i < current_msg.len; i++) {
+
+      		CAN_OBJ[2].Data[i] = current_msg.data[i];
+	}
+  		CAN_OBJ[2].MCR  = 0xf6bf;  /* set NEWDAT, reset CPUUPD, set MSGVAL */
+	
+		/* Transmit the object */
+  		CAN_OBJ[2].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
+}
+
+/* Copy the CAN health counters to the snapshot, compute the rates over the
+   time since the previous snapshot and start counting again. Called from the
+   CAN interrupt, so the counters are not updated meanwhile */
+void amb_snapshot_counters(){
+	ubyte i;
+	ulong bus_errors;
+	ulong transactions;
+
+	can_snapshot.seconds = slave_node.seconds - can_snapshot.last_second;
+	can_snapshot.last_second = slave_node.seconds;
+
+	bus_errors = 0;
+	for (i=0; i<AMB_CNT_CLASSES; i++) {
+		can_snapshot.can_count[i] = slave_node.can_count[i];
+		slave_node.can_count[i] = 0;
+		if (i < AMB_CNT_BUS_ERRORS) {
+			bus_errors += can_snapshot.can_count[i];
+		}
+	}
+
+	transactions = slave_node.num_transactions - can_snapshot.last_transactions;
+	can_snapshot.last_transactions = slave_node.num_transactions;
+
+	can_snapshot.rates[0] = amb_rate(bus_errors, can_snapshot.seconds);
+	can_snapshot.rates[1] = amb_rate(can_snapshot.can_count[AMB_CNT_MSGLST], can_snapshot.seconds);
+	can_snapshot.rates[2] = amb_rate(can_snapshot.can_count[AMB_CNT_IDENTIFY], can_snapshot.seconds);
+	can_snapshot.rates[3] = amb_rate(transactions, can_snapshot.seconds);
+}
+
+/* Events per second times 100, stopping at 0xffff. 0 if no time went by */
+uword amb_rate(ulong count, uword seconds){
+	if (!seconds) {
+		return 0;
+	}
+
+	if (count > 0xffffffffL/100) {
+		return 0xffff;
+	}
+
+	count = (count*100 + seconds/2) / seconds;
+
+	return (count > 0xffff) ? 0xffff : (uword) count;
+}
+
+/* Write words to the monitor message, MSB first */
+void amb_put_words(uword *words, ubyte num){
+	ubyte i;
+
+	current_msg.len = 2*num;
+	for (i=0; i<num; i++) {
+		current_msg.data[2*i] = (ubyte) (words[i]>>8);
+		current_msg.data[2*i+1] = (ubyte) (words[i]);
+	}
+}
+
+/* The controller went busoff and set INIT. Clearing INIT starts the
+   recovery: the controller waits for 128 sequences of 11 recessive bits
+   (1.4 ms on a free 1 Mbit/s bus), resets its error counters and clears
+   BOFF, which raises a status change interrupt */
+void amb_busoff_start(){
+	slave_node.bus_state = AMB_BUS_RECOVERING;
+	slave_node.busoff_count++;
+	slave_node.busoff_start = slave_node.clock ? (slave_node.clock)() : 0;
+
+	/* The pending identify answer is lost with the bus */
+	slave_node.identify_mode = FALSE;
+	T5R = 0;
+
+	/* And so is the segmented transfer: the status tells the master */
+	if (segment.status == AMB_SEG_BUSY)
+		segment.status = AMB_SEG_STOPPED;
+	segment.tx_busy = FALSE;
+	segment.end_pending = FALSE;
+	segment.stop_pending = FALSE;
+
+	/* Reset INIT, keep the status change interrupts */
+	C1CSR = 0x000A;
+}
+
+/* Busoff recovery done: rebuild the message objects and go on */
+void amb_busoff_end(){
+	ulong ticks;
+
+	if (slave_node.clock) {
+		ticks = (slave_node.clock)() - slave_node.busoff_start;
+		slave_node.busoff_duration = (ticks/1000)*slave_node.tick_ns + ((ticks%1000)*slave_node.tick_ns)/1000;
+	}
+
+	/* Objects may have been left half way through a transfer */
+	amb_setup_CAN_hw();
+
+	slave_node.bus_state = AMB_BUS_ACTIVE;
+}
+
+/* Answer the identify broadcast in the slot of the node address, the
+   first time and after a collision alike */
+void amb_identify_schedule(){
+	T5R = 0;
+
+	slave_node.id_slot = slave_node.node_address & (AMB_ID_SLOTS-1);
+
+	if (slave_node.id_slot == 0) {
+		amb_identify_answer();
+		return;
+	}
+
+	T5 = (uword) -((uword) slave_node.id_slot*AMB_ID_SLOT);
+	T5IR = 0;
+	T5R = 1;
+}
+
+/* Send the serial number in message object 2 */
+void amb_identify_answer(){
+	/* No serial number yet: this node sits the identify round out */
+	if (slave_node.sn_pending) {
+		return;
+	}
+
+	/* We are responding to the identify broadcast */
+	slave_node.identify_mode = TRUE;
+
+	/* Turn status interrupts on */
+	C1CSR = 0x000E;
+
+	slave_node.num_transactions++;
+	CAN_OBJ[1].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
+}
+
+/* Timer 5 interrupt: our identify slot has come */
+void amb_identify_isr(void) interrupt T5INT{
+	T5R = 0;
+	amb_identify_answer();
+}
+
+/* Start the segmented transfer asked for on 0x31002, or stop the running
+   one if the length is 0. The range is served by the byte range function
+   of the first callback in range, as for the other messages, or read from
+   the callback with monitor requests if it has none */
+void amb_segment_start(){
+	CALLBACK_STRUCT *cb;
+	ulong address;
+	uword length;
+
+	address = ((ulong) current_msg.data[0] << 16) | ((ulong) current_msg.data[1] << 8) | current_msg.data[2];
+	length = ((uword) current_msg.data[6] << 8) | current_msg.data[7];
+
+	if (length == 0) {
+		if (segment.status == AMB_SEG_BUSY) {
+			segment.status = AMB_SEG_STOPPED;
+			segment.end_pending = TRUE;
+			amb_segment_next();
+		}
+		return;
+	}
+
+	/* The transfer this one replaces still gets its end frame, first */
+	if (segment.end_pending) {
+		if (segment.status == AMB_SEG_BUSY)
+			segment.status = AMB_SEG_STOPPED;
+		amb_segment_end(segment.stop_frame);
+		segment.stop_pending = TRUE;
+		segment.end_pending = FALSE;
+	}
+
+	segment.relative_address = address;
+	segment.offset = ((ulong) current_msg.data[3] << 16) | ((ulong) current_msg.data[4] << 8) | current_msg.data[5];
+	segment.left = length;
+	segment.frames = 0;
+	segment.bytes = 0;
+	segment.crc = 0xffff;
+
+	cb = amb_find_callback(address);
+	if (cb) {
+		segment.func = cb->blk_func ? cb->blk_func : amb_segment_read;
+		segment.cb_func = cb->cb_func;
+		segment.high_address = cb->high_address;
+	} else {
+		segment.func = 0;
+	}
+	segment.slot_valid = FALSE;
+
+	/* A frame still waiting in object 4 goes out first, then this one */
+	segment.status = segment.func ? AMB_SEG_BUSY : AMB_SEG_NO_FUNC;
+	segment.end_pending = TRUE;
+	amb_segment_next();
+}
+
+/* Queue the next frame of the segmented transfer, once the previous one
+   went out. The CAN interrupt runs it, so it never waits for the bus */
+void amb_segment_next(){
+	ubyte frame[8];
+	ubyte len;
+	int got;
+
+	if (segment.tx_busy)
+		return;
+
+	if (segment.stop_pending) {
+		segment.stop_pending = FALSE;
+		amb_segment_send(AMB_SEG_END_RCA, segment.stop_frame, AMB_SEG_END_LEN);
+		return;
+	}
+
+	if (segment.status == AMB_SEG_BUSY) {
+		if (segment.left != 0) {
+			len = (segment.left < AMB_SEG_PAYLOAD) ? (ubyte) segment.left : AMB_SEG_PAYLOAD;
+			got = (segment.func)(segment.relative_address, segment.offset, &frame[1], len);
+
+			if (got < 0) {
+				segment.status = AMB_SEG_ERROR;
+			} else if (got > 0) {
+				if (got > len)
+					got = len;
+
+				frame[0] = (ubyte) segment.frames;
+				segment.crc = amb_crc16(segment.crc, &frame[1], (ubyte) got);
+				segment.offset += got;
+				segment.bytes += got;
+				segment.frames++;
+
+				/* Fewer bytes than asked for: the data ends here */
+				segment.left = (got < len) ? 0 : segment.left - got;
+
+				amb_segment_send(AMB_SEG_DATA_RCA, frame, (ubyte) (got+1));
+				return;
+			} else {
+				segment.left = 0;
+			}
+		}
+
+		if (segment.status == AMB_SEG_BUSY)
+			segment.status = AMB_SEG_DONE;
+	}
+
+	if (segment.end_pending) {
+		segment.end_pending = FALSE;
+		amb_segment_end(frame);
+		amb_segment_send(AMB_SEG_END_RCA, frame, AMB_SEG_END_LEN);
+	}
+}
+
+/* Byte ranges of a callback with no byte range function: the monitor
+   replies of its points from the relative address on, AMB_SEG_SLOT bytes
+   each padded with zeros, up to the last point it serves. Each point is
+   read once per transfer, so it sees what a master reading it would */
+int amb_segment_read(ulong relative_address, ulong offset, ubyte *data, ubyte len){
+	CAN_MSG_TYPE msg;
+	ulong address;
+	ubyte got;
+	ubyte i;
+
+	got = 0;
+	while (got < len) {
+		address = relative_address + offset/AMB_SEG_SLOT;
+		if (address > segment.high_address)
+			break;
+
+		if (!segment.slot_valid || segment.slot_address != address) {
+			msg.relative_address = address;
+			msg.dirn = CAN_MONITOR;
+			msg.len = 0;
+			(segment.cb_func)(&msg);
+
+			segment.slot_len = (msg.len < 8) ? msg.len : 8;
+			for (i=0; i<segment.slot_len; i++)
+				segment.slot[i] = msg.data[i];
+			segment.slot_address = address;
+			segment.slot_valid = TRUE;
+		}
+
+		for (i = (ubyte) (offset%AMB_SEG_SLOT); (i<AMB_SEG_SLOT) && (got<len); i++) {
+			data[got++] = (i < segment.slot_len) ? segment.slot[i] : 0;
+			offset++;
+		}
+	}
+
+	return got;
+}
+
+/* Write the end frame: status, frames and bytes sent and CRC, MSB first */
+void amb_segment_end(ubyte *data){
+	data[0] = segment.status;
+	data[1] = (ubyte) (segment.frames>>8);
+	data[2] = (ubyte) (segment.frames);
+	data[3] = (ubyte) (segment.bytes>>8);
+	data[4] = (ubyte) (segment.bytes);
+	data[5] = (ubyte) (segment.crc>>8);
+	data[6] = (ubyte) (segment.crc);
+}
+
+/* Send a segmented transfer frame with CAN object 4 */
+void amb_segment_send(ulong relative_address, ubyte *data, ubyte len){
+  	ubyte i;
+  	ulong TX_ID;
+	ulong v;
+
+	segment.tx_busy = TRUE;
+
+	CAN_OBJ[3].MCR = 0xfb7f;     /* set CPUUPD, reset MSGVAL */
+
+	/* Calculate the arbitration registers */
+	TX_ID = slave_node.base_address + relative_address;
+
+   	v = 0x00000000;
+   	v += (TX_ID & 0x0000001f) << 11;  /* ID  4.. 0 */
+   	v += (TX_ID & 0x00001fe0) >>  5;  /* ID 12.. 5 */
+   	CAN_OBJ[3].LAR  = v;
+
+   	v = 0x00000000;
+   	v += (TX_ID & 0x001fe000) >>  5;  /* ID 13..20 */
+   	v += (TX_ID & 0x1fe00000) >> 21;  /* ID 21..28 */
+   	CAN_OBJ[3].UAR  = v;
+
+	/* set transmit direction and length */
+   	CAN_OBJ[3].MCFG = 0x0c | (len << 4);
+
+	/* Copy data to CAN object 4 */
+   	for(i = 0; i < len; i++) {
+   		CAN_OBJ[3].Data[i] = data[i];
+	}
+	CAN_OBJ[3].MCR  = 0xf6bf;  /* set NEWDAT, reset CPUUPD, set MSGVAL */
+
+	/* Transmit the object */
+	CAN_OBJ[3].MCR = 0xe7ff;  /* set TXRQ,reset CPUUPD */
+}
+
+/* CRC-16/CCITT (0x1021) of the bytes, on top of crc */
+uword amb_crc16(uword crc, ubyte *data, ubyte len){
+	ubyte i;
+	ubyte x;
+
+	for (i=0; i<len; i++) {
+		x = (ubyte) (crc>>8) ^ data[i];
+		x ^= x>>4;
+		crc = (crc<<8) ^ ((uword) x<<12) ^ ((uword) x<<5) ^ x;
+	}
+
+	return crc;
+}
+
+
@@ -1,126 +1,233 @@
-/*
- ****************************************************************************
- # $Id: amb.h,v 1.9 2004/11/18 19:57:56 avaccari Exp $
- #
- # Copyright (C) 1999
- # Associated Universities, Inc. Washington DC, USA.
- #
- # Correspondence concerning ALMA should be addressed as follows:
- #        Internet email: mmaswgrp@nrao.edu
- ****************************************************************************
- */
-/**
- ****************************************************************************
- *  AMB.H 
- *
- *  Header file for ALMA Monitor and Control Bus Slave library.  This
- *  file makes use of libraries for the support of Dallas Semiconductor device
- *  used for a unique serial number.  It is also intended to be the basis for
- *  slave implementations on hardware other than the suggested interface.
- *
- *****************************************************************************
- */
-
-#ifndef AMB_H
-	#define AMB_H
-	/* 
-	 * Some definitions of variable sizes to be used, which depend on
-	 * the micro architecture 
-	 */
-	#ifdef C167_ARCH
-
-		#define ulong unsigned long
-		#define uword unsigned int
-		#define ubyte unsigned char
-
-	#elif PIC_ARCH
-
-		#define ulong unsigned long
-		#define uword unsigned int
-		#define ubyte unsigned char
-
-	#endif /* ARCHITECTURE SWITCH */
-
-	#ifndef TRUE
-
-		#define TRUE  1
-		#define FALSE 0
-
-	#endif /* TRUE */
-
-	/* Define internal slave error codes */
-	#define DUP_SLAVE_ADDR_E	0x01	/* Duplicate slave address detected */
-	#define NO_DS1820_E			0x02	/* No DS1820 device found */
-	#define NO_SN_E				0x03	/* No serial number read */
-	#define ONEWIRE_CRC_E		0x04	/* CRC error on a 1-Wire bus transaction */
-
-	/* An enum for CAN message direction */
-	typedef enum {	CAN_MONITOR,
-					CAN_CONTROL
-	} CAN_DIRN_TYPE;
-
-	/* Configuration and current data structure for CAN messages */
-	typedef struct {
-		ulong				relative_address;	/* CAN ID - Slave base address */
-		ubyte				data[8];			/* Current value */
-		ubyte				len;				/* Amount of data */
-		CAN_DIRN_TYPE		dirn;				/* Direction of message */
-	} CAN_MSG_TYPE;
-
-	/* Callback function typedef */
-	typedef int(*read_or_write_func)(CAN_MSG_TYPE *message);
-
-	/* Callback info */
-	typedef struct {
-		ulong				low_address;	/* First RA in range */
-		ulong				high_address;	/* Last RA in range */
-		read_or_write_func	cb_func;		/* Function to call when message in range */
-	} CALLBACK_STRUCT;
-
-	/*
-	 ***************************************************************************
-	  Prototypes of global functions
-	 ***************************************************************************
-	 */
-
-	/**
-	 * Initialise slave node.  This routine must be called.  It reads the node
-	 * address and serial number and configures the CAN interface.  The user should
-	 * enable interrupts AFTER calling this routine.  The void * parameter should
-	 * contain the starting address of an array of CALLBACK_STRUCT.  This array
-	 * should contain enough elements for all of the functions to be registered.
-	 */
-	extern int amb_init_slave(void *cb_ops_memory);
-
-	/**
-	 * Register a callback function to be called when a CAN message with a 
-	 * relative address between low_address and high_address is received.
-	 * The callback is passed a pointer to a CAN_MSG_TYPE structure
-	 * Note that if the message is a monitor message, the called function
-	 * should set the message data length and data bytes before returning 
-	 */
-	extern int amb_register_function(ulong low_address, ulong high_address, read_or_write_func func);
-
-	/**
-	 * Unregister last registered function if any. This allows to roll back
-     * in case of error during the registration of the callback functions.
-     */
-	extern int amb_unregister_last_function(void);
-
-	/**
-	 * Start handling CAN interrupts. Currently this routine enables all
-	 * interrupts on the C167. 
-	 */
-	extern int amb_start();
-
-	/**
-	 * Utility functions for accessing internal counters and information 
-	 */
-
-	extern void amb_get_rev_level(ubyte	*major, ubyte *minor, ubyte *patch); /* Protocol version */
-	extern void amb_get_error_status(uword	*num_errors,		             /* Number of CAN errors */
-									 ubyte	*last_slave_error);	             /* Last internal slave error */
-	extern void amb_get_num_transactions(ulong *num_transactions);           /* Number of completed transactions */
-
-#endif /* AMB_H */
-
+/*
+ ****************************************************************************
+ # $Id: amb.h,v 1.9 2004/11/18 19:57:56 avaccari Exp $
+ #
+ # Copyright (C) 1999
+ # Associated Universities, Inc. Washington DC, USA.
+ #
+ # Correspondence concerning ALMA should be addressed as follows:
+ #        Internet email: mmaswgrp@nrao.edu
+ ****************************************************************************
+ */
+/**
+ ****************************************************************************
+ *  AMB.H 
+ *
+ *  Header file for ALMA Monitor and Control Bus Slave library.  This
+ *  file makes use of libraries for the support of Dallas Semiconductor device
+ *  used for a unique serial number.  It is also intended to be the basis for
+ *  slave implementations on hardware other than the suggested interface.
+ *
+ *****************************************************************************
+ */
+
+#ifndef AMB_H
+	#define AMB_H
+	/* 
+	 * Some definitions of variable sizes to be used, which depend on
+	 * the micro architecture 
+	 */
+	#ifdef C167_ARCH
+
+		#define ulong unsigned long
+		#define uword unsigned int
+		#define ubyte unsigned char
+
+	#elif PIC_ARCH
+
+		#define ulong unsigned long
+		#define uword unsigned int
+		#define ubyte unsigned char
+
+	#endif /* ARCHITECTURE SWITCH */
+
+	#ifndef TRUE
+
+		#define TRUE  1
+		#define FALSE 0
+
+	#endif /* TRUE */
+
+	/* Define internal slave error codes */
+	#define DUP_SLAVE_ADDR_E	0x01	/* Duplicate slave address detected */
+	#define NO_DS1820_E			0x02	/* No DS1820 device found */
+	#define NO_SN_E				0x03	/* No serial number read */
+	#define ONEWIRE_CRC_E		0x04	/* CRC error on a 1-Wire bus transaction */
+
+	/* CAN health counters, one per event class seen by the CAN interrupt */
+	#define AMB_CNT_STUFF		0		/* Stuff errors */
+	#define AMB_CNT_FORM		1		/* Form errors */
+	#define AMB_CNT_ACK			2		/* Acknowledge errors */
+	#define AMB_CNT_CRC			3		/* CRC errors */
+	#define AMB_CNT_BIT0		4		/* Bit0 errors (not counting the busoff recovery sequence) */
+	#define AMB_CNT_BIT1		5		/* Bit1 errors */
+	#define AMB_CNT_WARNING		6		/* Error warning limit reached */
+	#define AMB_CNT_BUSOFF		7		/* Busoff state reached */
+	#define AMB_CNT_MSGLST		8		/* Messages overwritten before being handled */
+	#define AMB_CNT_IDENTIFY	9		/* Identify requests answered */
+	#define AMB_CNT_CLASSES		10
+	#define AMB_CNT_BUS_ERRORS	8		/* The classes before this one are bus errors */
+
+	/* Busoff recovery state */
+	#define AMB_BUS_ACTIVE		0		/* Normal operation */
+	#define AMB_BUS_RECOVERING	1		/* Busoff: waiting for 128 sequences of 11 recessive bits */
+
+	/* Segmented transfer status, sent in the end frame (0x30017) */
+	#define AMB_SEG_IDLE		0		/* No transfer requested yet */
+	#define AMB_SEG_BUSY		1		/* Data frames being sent */
+	#define AMB_SEG_DONE		2		/* Range sent, or as much of it as the callback had */
+	#define AMB_SEG_NO_FUNC		3		/* No callback registered at that address */
+	#define AMB_SEG_ERROR		4		/* The callback failed */
+	#define AMB_SEG_STOPPED		5		/* Stopped by the master or by a busoff */
+	#define AMB_SEG_PAYLOAD		7		/* Data bytes per frame, after the sequence number */
+
+	/* An enum for CAN message direction */
+	typedef enum {	CAN_MONITOR,
+					CAN_CONTROL
+	} CAN_DIRN_TYPE;
+
+	/* Configuration and current data structure for CAN messages */
+	typedef struct {
+		ulong				relative_address;	/* CAN ID - Slave base address */
+		ubyte				data[8];			/* Current value */
+		ubyte				len;				/* Amount of data */
+		CAN_DIRN_TYPE		dirn;				/* Direction of message */
+	} CAN_MSG_TYPE;
+
+	/* Callback function typedef */
+	typedef int(*read_or_write_func)(CAN_MSG_TYPE *message);
+
+	/* Byte range callback typedef: copy len bytes from offset of the data
+	   served at relative_address. Returns the bytes copied, fewer than len
+	   at the end of the data, or -1 on error */
+	typedef int(*block_func)(ulong relative_address, ulong offset, ubyte *data, ubyte len);
+
+	/* Free running clock function typedef */
+	typedef ulong(*clock_func)(void);
+
+	/* Reset hook function typedef */
+	typedef void(*reset_func)(ubyte warm);
+
+	/* Profiling hook function typedef */
+	typedef void(*profile_func)(ubyte begin);
+
+	/* Callback info */
+	typedef struct {
+		ulong				low_address;	/* First RA in range */
+		ulong				high_address;	/* Last RA in range */
+		read_or_write_func	cb_func;		/* Function to call when message in range */
+		block_func			blk_func;		/* Function serving byte ranges (0 if none) */
+	} CALLBACK_STRUCT;
+
+	/*
+	 ***************************************************************************
+	  Prototypes of global functions
+	 ***************************************************************************
+	 */
+
+	/**
+	 * Initialise slave node.  This routine must be called.  It reads the node
+	 * address and serial number and configures the CAN interface.  The user should
+	 * enable interrupts AFTER calling this routine.  The void * parameter should
+	 * contain the starting address of an array of CALLBACK_STRUCT.  This array
+	 * should contain enough elements for all of the functions to be registered.
+	 */
+	extern int amb_init_slave(void *cb_ops_memory);
+
+	/**
+	 * Register a callback function to be called when a CAN message with a 
+	 * relative address between low_address and high_address is received.
+	 * The callback is passed a pointer to a CAN_MSG_TYPE structure
+	 * Note that if the message is a monitor message, the called function
+	 * should set the message data length and data bytes before returning 
+	 */
+	extern int amb_register_function(ulong low_address, ulong high_address, read_or_write_func func);
+
+	/**
+	 * Unregister last registered function if any. This allows to roll back
+     * in case of error during the registration of the callback functions.
+     */
+	extern int amb_unregister_last_function(void);
+
+	/**
+	 * Let the callback registered for a relative address (the one a message to
+	 * it would reach) serve byte ranges with func. Returns -1 if there is none.
+	 * A callback without one serves the monitor replies of its points from
+	 * the address asked for on, 8 bytes each padded with zeros, to its last
+	 * point, each point read once as a monitor message would.
+	 * Byte ranges go out with a segmented transfer. A control message on
+	 * 0x31002 (relative address and offset 3 bytes each, length 2 bytes, MSB
+	 * first) starts streaming the range on 0x30016, back to back frames of a
+	 * sequence number and up to AMB_SEG_PAYLOAD bytes. A frame on 0x30017
+	 * ends it: the status (AMB_SEG_xxx) then the frames and bytes sent and
+	 * the CRC-16/CCITT (0x1021, preset 0xFFFF) of the bytes, 2 bytes each MSB
+	 * first. 0x30017 can also be read as a monitor point.
+	 * A new request replaces the running one, which still gets its end frame
+	 * (AMB_SEG_STOPPED if it was not over) first; a length of 0 stops it.
+	 * The functions are called from the CAN interrupt
+	 */
+	extern int amb_set_block_function(ulong relative_address, block_func func);
+
+	/**
+	 * Get the callback registered for a relative address, the one a message
+	 * to it would reach (0 if none)
+	 */
+	extern read_or_write_func amb_get_function(ulong relative_address);
+
+	/**
+	 * Start handling CAN interrupts. Currently this routine enables all
+	 * interrupts on the C167. 
+	 */
+	extern int amb_start();
+
+	/**
+	 * Utility functions for accessing internal counters and information 
+	 */
+
+	extern void amb_get_rev_level(ubyte	*major, ubyte *minor, ubyte *patch); /* Protocol version */
+	extern void amb_get_error_status(uword	*num_errors,		             /* Number of CAN errors */
+									 ubyte	*last_slave_error);	             /* Last internal slave error */
+	extern void amb_get_num_transactions(ulong *num_transactions);           /* Number of completed transactions */
+
+	/**
+	 * Call once per second (from a timer interrupt with a lower priority than
+	 * CAN) to let the library compute the CAN error and traffic rates
+	 */
+	extern void amb_second_tick(void);
+
+	/**
+	 * Give the library a free running clock, ticking every tick_ns nanoseconds,
+	 * to time the busoff recoveries. It is called from the CAN interrupt
+	 */
+	extern void amb_set_clock(clock_func clock, uword tick_ns);
+
+	/**
+	 * Time the CAN interrupt: a function given with amb_set_profile_hook
+	 * (after amb_init_slave) is called on entry (begin = TRUE) and on exit
+	 * (begin = FALSE) of the interrupt, the callbacks run in between
+	 */
+	extern void amb_set_profile_hook(profile_func hook);
+
+	/**
+	 * Warm restart support. A function given with amb_set_reset_hook (after
+	 * amb_init_slave) is called from the CAN interrupt right before the reset
+	 * requested on 0x31000 (warm = FALSE) or 0x31001 (warm = TRUE), so the
+	 * application can save what it wants to keep. After the reset a serial
+	 * number given with amb_set_serial_number (before amb_init_slave) is used
+	 * in place of the one read from the 1-Wire bus, sparing the ROM search
+	 */
+	extern void amb_set_reset_hook(reset_func hook);
+	extern void amb_set_serial_number(ubyte serial_number[8]);
+
+	/**
+	 * Fast boot. After amb_defer_serial_number (before amb_init_slave) CAN is
+	 * set up without reading the 1-Wire bus. Until amb_read_serial_number
+	 * (after amb_start) has read it, or amb_set_serial_number has given it,
+	 * 0x00000 and 0x30000 are answered with no data ("initializing") and
+	 * the identify broadcast is not answered
+	 */
+	extern void amb_defer_serial_number(void);
+	extern int amb_read_serial_number(void);
+
+#endif /* AMB_H */
+
@@ -1,338 +1,1332 @@
-/*
- ****************************************************************************
- # $Id: ds1820.c,v 1.9 2006/05/26 18:25:26 avaccari Exp $
- #
- # Copyright (C) 1999
- # Associated Universities, Inc. Washington DC, USA.
- #
- # Correspondence concerning ALMA should be addressed as follows:
- #        Internet email: mmaswgrp@nrao.edu
- ****************************************************************************
- */
-/*
- ****************************************************************************
- *  DS1820.C 
- *
- *  Implementation file for DS1820 library for dealing with Dallas Semiconductor 
- *	 DS1820 Temperature sensor.  Much of the code in here is general to
- *  any 1-Wire device.  This code is written for a C167 micro and makes use
- *  of the Timer 2 in the general purpose timer unit.
- *
- ****************************************************************************
- */
-
-#include <reg167.h>
-#include <intrins.h>
-#include <math.h>
-
-#include "ds1820.h"
-
-/* Global */
-static ubyte ds1820Running=0;
-
-/* Reset one wire bus and test for presence pulse */
-ubyte Reset_1W(void)
-{
-	unsigned short pin;
-
-	/* Set port pin to output */
-	SET_OUTPUT;
-	
-	/* Set pin low */
-	RESET_PIN;
-
-	/* Start the timer */
-	CLEAR_T2;
-	START_T2;
-
-	/* Wait for 500 usec */
-	while (READ_T2 < 78) ;
-
-	/* Set pin to input */
-	SET_INPUT;
-
-	/* Wait up to 60 usecs for line to go high */
-	CLEAR_T2;
-	START_T2;
-
-	while ((READ_T2 < 9) &&
-		   !(pin = READ_PIN)) ;
-
-	if (!pin) /* line never went high, so failure */
-		return 0;
-		
-	/* Test for presence pulse for up to 240 usec */
-	while ((READ_T2 < 46) &&
-		   (pin = READ_PIN)) ;
-
-	/* Wait around to end procedure 500 usec */
-	while (READ_T2 < 78) ;
-
-	/* Return last known pin value (ie if presence was asserted or not) */
-	return !pin;
-}
-
-/* Write a byte on the One Wire bus */
-void Write_1W(ubyte tx_byte)
-{
-	int i;
-
-	/* Make sure pin will be high */
-	SET_PIN;
-
-	/* Set port pin to output */
-	SET_OUTPUT;
-	
-	for (i=0; i<8; i++) {
-		/* Start timer */
-		CLEAR_T2;
-		START_T2;
-
-		/* Set pin low to initiate timeslot */
-		RESET_PIN;
-
-		/* Wait for at least 1 usec (6.4 actually) */
-		while (READ_T2 < 1) ;
-
-		/* Write the bit if necessary */
-		if ((tx_byte >> i) & 0x01)
-			SET_PIN;
-
-		/* Wait out til end of timeslot */
-		while (READ_T2 < 12) ;	
-
-		/* Bring line high */
-		SET_PIN;
-
-		/* Wait another usec before next timeslot */
-		while (READ_T2 < 13) ;
-	}
-}
-
-/* Read a byte from the One Wire bus */
-ubyte Read_1W(void)
-{
-	int i;
-	ubyte rx_byte = 0x0; /* initialise to zero */
-
-	/* Make sure pin will be high */
-	SET_PIN;
-
-	/* Set port pin to output */
-	SET_OUTPUT;
-	
-	for (i=0; i<8; i++) {
-		/* Start timer */
-		CLEAR_T2;
-		START_T2;
-
-		/* Set pin low to initiate timeslot */
-		RESET_PIN;
-
-		/* Wait for at least 1 usec (6.4 actually) */
-		while (READ_T2 < 1) ;
-
-		/* Make pin an input */
-		SET_INPUT;
-
-		/* Wait for slave to write bit */
-		while (READ_T2 < 2) ;
-
-		/* Sample line */
-		if (READ_PIN) 
-			rx_byte |= (0x01 << i);
-
-		/* Wait out til end of timeslot */
-		while (READ_T2 < 11) ;	
-
-		/* Bring line high */
-		SET_PIN;
-
-		/* Set port pin to output */
-		SET_OUTPUT;
-
-		/* Wait another usec before next timeslot */
-		while (READ_T2 < 12) ;
-	}
-	
-	return rx_byte; /* Return the byte read */
-}
-
-/* Convert from first two bytes of temperature data to degrees C */
-/* Gives 1/2 degree C resolution */
-float Do_1W_Temperature(ubyte MSB, ubyte LSB)
-{
-	float amt = 0.0;
-	char temp;
-
-/* Least significant bit signifies half a degree */
-	if (LSB & 0x01)
-		amt = 0.5;
-
-/* shift the byte to remove the least significant bit */
-	temp = LSB>>1;
-	
-/* Most significant byte indicates sign */
-	if (MSB)
-		temp |= 0x80;
-
-/* Convert from two's complement signed 8 bit value to float */
-	amt += (float) temp;
-
-	return amt;
-}
-
-/* Convert temperature with full resolution */
-float Do_1W_Temperature_Full(ubyte MSB, ubyte LSB,
-							 ubyte count_remain, ubyte count_per_C)
-{
-	float amt = 0.0;
-	char temp;
-
-/* shift the byte to remove the least significant bit */
-	temp = LSB>>1;
-	
-/* Most significant byte indicates sign */
-	if (MSB)
-		temp |= 0x80;
-
-/* Convert from two's complement signed 8 bit value to float */
-	amt = (float) temp;
-
-/* Calculation from p4 of the DS1820 Data Sheet */
-	if (fabs((double) count_per_C) > 1e-9) {
-		amt += ((float) count_per_C - (float) count_remain)/((float) count_per_C) - 0.25;
-	}
-
-	return amt;
-}
-
-/*
- * Routine to calculate 8 bit CRC from DalSemi
- * Polynomial is CRC = X^8 + X^5 + X^4 + 1
- * Adapted from assembly language in Dallas Semiconductor
- * Application Note 27
- */
-ubyte Do_1W_CRC(ubyte next_byte, ubyte CRC)
-{
-	int i;
-
-	/* Move the bits in one by one and do some stuff */
-	for (i=0; i<8; i++) {
-		if ((next_byte ^ CRC) & 0x01) {
-			CRC ^= 0x18; /* The generator polynomial */
-			CRC >>= 1;
-			CRC |= 0x80;
-		} else {
-			CRC >>= 1;
-		}
-		next_byte >>= 1;
-	}
-
-	return CRC;
-}
-
-short ds1820_init(void)
-{
-  /* ---------- Timer 2 Control Register ----------
-   *  timer 2 works in timer mode
-   *  prescaler factor is 128 (6.4 usec resolution)
-   *  timer 2 run bit is reset
-   *  up/down control bit is reset 
-   *  external up/down control is disabled
-   */
-  T2CON = 0x0004;
-  T2    = 0x0000;  /* load timer 2 register */
-
-	/* Reset pulse and presence sequence */
-	if (!Reset_1W())
-		return -1;
-	return 0;
-}
-
-short ds1820_get_sn(ubyte sn[8])
-{
-	int i;
-	ubyte CRC;
-
-	/* Start cycle on 1 wire bus by issuing reset and detecting presence */
-	Reset_1W();
-
-	/* Send Read ROM command (only works if ONE DS device on wire) */
-	Write_1W(0x33);
-
-	CRC = 0x0;
-
-	/* Read 8 bytes of serial number etc */
-	for (i=0; i<8; i++) {
-		sn[i] = Read_1W();
-		CRC = Do_1W_CRC(sn[i], CRC);
-	}
-
-	if (CRC != 0x0)
-		return -1;
-	return 0;
-}
-
-short ds1820_get_temp(ubyte *MSB, ubyte *LSB, ubyte *count_remain, ubyte *count_per_C)
-{
-	int i;
-	uword wait_count;
-	ubyte rx_buffer[10];
-	ubyte CRC;
-
-	if(ds1820Running){ // Check if the subrutine is still running
-		return 0;
-	}	
-
-	ds1820Running = 1; // Signal that this is running
-
-	/* Start temperature reading cycle of DS1820 */
-	Reset_1W();
-
-	Write_1W(0xCC); /* Skip ROM */
-	Write_1W(0x44); /* Start conversion command */
-
-	/* Wait for conversion to complete (signalled by all 1s) */
-	wait_count = 0;
-	while ((Read_1W() != 0xff) &&     /* Avoid lockup by quitting after 1000 */
-			 (wait_count++ < 1000)) ;   /* byte reads (~600 ms) */
-
-	if (wait_count > 999){ /* Error: wait for temperature conversion timed out */
-		ds1820Running = 0; // Function is done and can be called again
-		return -1;
-	}
-
-	/* Reset bus */
-	Reset_1W();
-
-	Write_1W(0xCC); /* Skip ROM */
-	Write_1W(0xBE); /* Read scratchpad */
-
-	CRC = 0x0;
-
-	/* read 9 data bytes */
-	for (i=0; i<9; i++) {
-		rx_buffer[i] = Read_1W();
-		CRC = Do_1W_CRC(rx_buffer[i], CRC);
-	}
-
-	if (CRC != 0x0){
-		ds1820Running = 0; // Function is done and can be called again
-		return -2;
-	}
-
-	/* Low accuracy temperature is in first two bytes */
-	*LSB = rx_buffer[0];
- 	*MSB = rx_buffer[1];
-
-	/* Higher resolution data is in bytes 6 and 7 */
-	*count_remain = rx_buffer[6];
-	*count_per_C = rx_buffer[7];
-
-	ds1820Running = 0; // Function is done and can be called again
-
-	return 0;
-}
-
-
+/*
+ ****************************************************************************
+ # $Id: ds1820.c,v 1.9 2006/05/26 18:25:26 avaccari Exp $
+ #
+ # Copyright (C) 1999
+ # Associated Universities, Inc. Washington DC, USA.
+ #
+ # Correspondence concerning ALMA should be addressed as follows:
+ #        Internet email: mmaswgrp@nrao.edu
+ ****************************************************************************
+ */
+/*
+ ****************************************************************************
+ *  DS1820.C 
+ *
+ *  Implementation file for DS1820 library for dealing with Dallas Semiconductor 
+ *	 DS1820 Temperature sensor.  Much of the code in here is general to
+ *  any 1-Wire device.  This code is written for a C167 micro and makes use
+ *  of the Timer 2 in the general purpose timer unit.
+ *
+ ****************************************************************************
+ */
+
+#include <reg167.h>
+#include <intrins.h>
+#include <math.h>
+
+#include "ds1820.h"
+
+/* Global */
+static ubyte ds1820Running=0;
+
+/* States of the split phase temperature reading */
+#define DS_IDLE			0
+#define DS_CONVERT		1
+#define DS_WAIT			2
+#define DS_READ			3
+#define DS_SET_READ		4
+#define DS_SET_WRITE	5
+#define DS_SET_CHECK	6
+#define DS_SET_COPY		7
+#define DS_SET_WAIT		8
+
+static ubyte ds1820State=DS_IDLE;
+static uword ds1820WaitCount;
+static ubyte ds1820Tx[13];
+static ubyte ds1820Rx[9];
+static ubyte ds1820SetBits;
+
+/* Devices found by the ROM search */
+static ubyte ds1820Rom[DS1820_MAX_DEVICES][8];
+static ubyte ds1820Count=0;
+static ubyte ds1820Device;
+
+/* ROM code of the on-board device, the node serial number */
+static ubyte ds1820Sn[8];
+static ubyte ds1820SnValid=0;
+
+/* Resolution of the DS18B20 type devices (0 for the DS1820) */
+static ubyte ds1820Bits[DS1820_MAX_DEVICES];
+static uword ds1820ConvReads=DS1820_CONV_READS+DS1820_CONV_READS/DS1820_CONV_MARGIN;
+
+/* Called on entry and exit of the engine interrupt (0 if not given) */
+static ds1820_profile_func ds1820ProfileHook=0;
+
+/* States of the interrupt driven engine */
+#define OW_IDLE			0
+#define OW_RESET_LOW	1
+#define OW_RESET_SAMPLE	2
+#define OW_RESET_END	3
+#define OW_SLOT			4
+
+/* Time elapsed since Timer 2 was loaded with -period */
+#define ELAPSED_T2(period) ((uword) (READ_T2 + (period)))
+
+/* Interrupt driven engine */
+static struct {
+	ubyte volatile	state;		/* Current step of the transaction */
+	ubyte volatile	status;		/* Result of the last transaction */
+	ubyte			*tx_buffer;	/* Next byte to write */
+	ubyte			tx_len;		/* Bytes left to write */
+	ubyte			*rx_buffer;	/* Next byte to read */
+	ubyte			rx_len;		/* Bytes left to read */
+	ubyte			mask;		/* Mask of the current bit */
+	ubyte			presence;	/* Presence pulse detected */
+} engine_1W = {OW_IDLE, ONEWIRE_DONE};
+
+static void Slot_1W(void);
+static void Next_1W(void);
+static void Finish_1W(ubyte status);
+static ubyte Address_1W(ubyte device, ubyte *tx_buffer);
+static short Scratchpad_1W(ubyte device, ubyte *rx_buffer);
+static void Normalize_1W(ubyte device, ubyte *rx_buffer);
+static void Conv_Reads_1W(void);
+static short Search_1W(void);
+static void Board_1W(void);
+
+/* Reset one wire bus and test for presence pulse.  The blocking primitives
+   hold the interrupts off for the time critical part only: from the release
+   of the reset to the end of the presence pulse, from the start of a slot to
+   the bit.  They can run with the CAN interrupts on */
+ubyte Reset_1W(void)
+{
+	unsigned short pin;
+	bit ien;
+
+	/* Set port pin to output */
+	SET_OUTPUT;
+	
+	/* Set pin low */
+	RESET_PIN;
+
+	/* Start the timer */
+	CLEAR_T2;
+	START_T2;
+
+	/* Wait for 500 usec */
+	while (READ_T2 < 78) ;
+
+	ien = IEN;
+	IEN = 0;
+
+	/* Set pin to input */
+	SET_INPUT;
+
+	/* Wait up to 60 usecs for line to go high */
+	CLEAR_T2;
+	START_T2;
+
+	while ((READ_T2 < 9) &&
+		   !(pin = READ_PIN)) ;
+
+	if (!pin) { /* line never went high, so failure */
+		IEN = ien;
+		return 0;
+	}
+		
+	/* Test for presence pulse for up to 240 usec */
+	while ((READ_T2 < 46) &&
+		   (pin = READ_PIN)) ;
+
+	IEN = ien;
+
+	/* Wait around to end procedure 500 usec */
+	while (READ_T2 < 78) ;
+
+	/* Return last known pin value (ie if presence was asserted or not) */
+	return !pin;
+}
+
+/* Write a bit on the One Wire bus */
+void Write_Bit_1W(ubyte tx_bit)
+{
+	bit ien;
+
+	/* Make sure pin will be high */
+	SET_PIN;
+
+	/* Set port pin to output */
+	SET_OUTPUT;
+
+	ien = IEN;
+	IEN = 0;
+
+	/* Start timer */
+	CLEAR_T2;
+	START_T2;
+
+	/* Set pin low to initiate timeslot */
+	RESET_PIN;
+
+	/* Wait for at least 1 usec (6.4 actually) */
+	while (READ_T2 < 1) ;
+
+	/* Write the bit if necessary */
+	if (tx_bit)
+		SET_PIN;
+
+	IEN = ien;
+
+	/* Wait out til end of timeslot */
+	while (READ_T2 < 12) ;	
+
+	/* Bring line high */
+	SET_PIN;
+
+	/* Wait another usec before next timeslot */
+	while (READ_T2 < 13) ;
+}
+
+/* Read a bit from the One Wire bus */
+ubyte Read_Bit_1W(void)
+{
+	ubyte rx_bit = 0x0;
+	bit ien;
+
+	/* Make sure pin will be high */
+	SET_PIN;
+
+	/* Set port pin to output */
+	SET_OUTPUT;
+
+	ien = IEN;
+	IEN = 0;
+
+	/* Start timer */
+	CLEAR_T2;
+	START_T2;
+
+	/* Set pin low to initiate timeslot */
+	RESET_PIN;
+
+	/* Wait for at least 1 usec (6.4 actually) */
+	while (READ_T2 < 1) ;
+
+	/* Make pin an input */
+	SET_INPUT;
+
+	/* Wait for slave to write bit */
+	while (READ_T2 < 2) ;
+
+	/* Sample line */
+	if (READ_PIN) 
+		rx_bit = 0x01;
+
+	IEN = ien;
+
+	/* Wait out til end of timeslot */
+	while (READ_T2 < 11) ;	
+
+	/* Bring line high */
+	SET_PIN;
+
+	/* Set port pin to output */
+	SET_OUTPUT;
+
+	/* Wait another usec before next timeslot */
+	while (READ_T2 < 12) ;
+
+	return rx_bit;
+}
+
+/* Write a byte on the One Wire bus */
+void Write_1W(ubyte tx_byte)
+{
+	int i;
+
+	for (i=0; i<8; i++)
+		Write_Bit_1W((tx_byte >> i) & 0x01);
+}
+
+/* Read a byte from the One Wire bus */
+ubyte Read_1W(void)
+{
+	int i;
+	ubyte rx_byte = 0x0; /* initialise to zero */
+
+	for (i=0; i<8; i++)
+		rx_byte |= Read_Bit_1W() << i;
+	
+	return rx_byte; /* Return the byte read */
+}
+
+/* Start a background transaction on the One Wire bus */
+short Start_1W(ubyte reset, ubyte *tx_buffer, ubyte tx_len,
+			   ubyte *rx_buffer, ubyte rx_len)
+{
+	if (engine_1W.state != OW_IDLE)
+		return -1;
+
+	engine_1W.tx_buffer = tx_buffer;
+	engine_1W.tx_len = tx_len;
+	engine_1W.rx_buffer = rx_buffer;
+	engine_1W.rx_len = rx_len;
+	engine_1W.mask = 0x01;
+	engine_1W.status = ONEWIRE_BUSY;
+
+	/* Switch Timer 2 to the engine resolution */
+	T2CON = ONEWIRE_T2CON;
+	T2 = 0x0000;
+
+	/* ---------- Timer 2 Interrupt Control Register ----------
+	 *  timer 2 interrupt priority level (ILVL) = 12
+	 *  timer 2 interrupt group level (GLVL) = 2
+	 *  Below CAN: its latency only stretches the non critical part of a slot
+	 */
+	T2IC = 0x0072;
+
+	if (reset) {
+		/* Set pin low for the reset pulse */
+		engine_1W.state = OW_RESET_LOW;
+		SET_OUTPUT;
+		RESET_PIN;
+		T2 = (uword) -ONEWIRE_RESET_LOW;
+		START_T2;
+	} else {
+		START_T2;
+		Next_1W();
+	}
+
+	return 0;
+}
+
+/* Status of the last background transaction */
+ubyte Status_1W(void)
+{
+	return engine_1W.status;
+}
+
+/*
+ * Time critical part of a slot: recovery, start pulse and data bit.
+ * Interrupts are held off until the bit has been written or sampled
+ * (at most ~11 usec), Timer 2 then overflows at the end of the slot.
+ */
+static void Slot_1W(void)
+{
+	bit ien;
+
+	ien = IEN;
+	IEN = 0;
+
+	T2 = (uword) -ONEWIRE_SLOT;
+
+	/* Line high for the recovery time */
+	SET_PIN;
+	SET_OUTPUT;
+	while (ELAPSED_T2(ONEWIRE_SLOT) < ONEWIRE_RECOVERY) ;
+
+	/* Set pin low to initiate timeslot */
+	RESET_PIN;
+	while (ELAPSED_T2(ONEWIRE_SLOT) < ONEWIRE_START_END) ;
+
+	if (engine_1W.tx_len) {
+		/* Write the bit, a 0 keeps the line low until the end of the slot */
+		if (*engine_1W.tx_buffer & engine_1W.mask)
+			SET_PIN;
+	} else {
+		/* Make pin an input and sample the slave bit */
+		SET_INPUT;
+		while (ELAPSED_T2(ONEWIRE_SLOT) < ONEWIRE_SAMPLE) ;
+
+		if (READ_PIN)
+			*engine_1W.rx_buffer |= engine_1W.mask;
+	}
+
+	IEN = ien;
+}
+
+/* Start the next slot or complete the transaction */
+static void Next_1W(void)
+{
+	if (!engine_1W.tx_len && !engine_1W.rx_len) {
+		Finish_1W(ONEWIRE_DONE);
+		return;
+	}
+
+	/* New byte to read */
+	if (!engine_1W.tx_len && (engine_1W.mask == 0x01))
+		*engine_1W.rx_buffer = 0x0;
+
+	engine_1W.state = OW_SLOT;
+	Slot_1W();
+}
+
+/* Release Timer 2 and report the transaction result */
+static void Finish_1W(ubyte status)
+{
+	STOP_T2;
+	T2IE = 0;
+	T2IR = 0;
+	T2CON = ONEWIRE_T2CON_BLOCKING;
+
+	if (status == ONEWIRE_DONE) {
+		/* Bring line high */
+		SET_PIN;
+		SET_OUTPUT;
+	} else {
+		/* Leave the faulty bus alone */
+		SET_INPUT;
+	}
+
+	engine_1W.state = OW_IDLE;
+	engine_1W.status = status;
+}
+
+/* Timer 2 interrupt: end of the current step of the background transaction */
+void Timer2_1W(void) interrupt T2INT = 0x22
+{
+	if (ds1820ProfileHook)
+		ds1820ProfileHook(1);
+
+	switch (engine_1W.state) {
+		case OW_RESET_LOW:
+			/* Set pin to input, presence is sampled 70 usec from now */
+			T2 = (uword) -ONEWIRE_PRESENCE;
+			SET_INPUT;
+
+			/* Wait up to 15 usecs for line to go high */
+			while (!READ_PIN &&
+				   (ELAPSED_T2(ONEWIRE_PRESENCE) < ONEWIRE_RELEASE_WAIT)) ;
+
+			if (!READ_PIN) { /* line never went high, so failure */
+				Finish_1W(ONEWIRE_SHORT);
+				break;
+			}
+
+			engine_1W.state = OW_RESET_SAMPLE;
+			break;
+
+		case OW_RESET_SAMPLE:
+			/* Test for presence pulse and wait around to end procedure */
+			engine_1W.presence = !READ_PIN;
+			T2 = (uword) -ONEWIRE_RESET_END;
+			engine_1W.state = OW_RESET_END;
+			break;
+
+		case OW_RESET_END:
+			if (!engine_1W.presence) {
+				Finish_1W(ONEWIRE_NO_PRESENCE);
+				break;
+			}
+			Next_1W();
+			break;
+
+		case OW_SLOT:
+			/* Bring line high */
+			SET_PIN;
+
+			/* Move to the next bit */
+			engine_1W.mask <<= 1;
+			if (!engine_1W.mask) {
+				engine_1W.mask = 0x01;
+				if (engine_1W.tx_len) {
+					engine_1W.tx_buffer++;
+					engine_1W.tx_len--;
+				} else {
+					engine_1W.rx_buffer++;
+					engine_1W.rx_len--;
+				}
+			}
+			Next_1W();
+			break;
+
+		default:
+			Finish_1W(ONEWIRE_DONE);
+			break;
+	}
+
+	if (ds1820ProfileHook)
+		ds1820ProfileHook(0);
+}
+
+/* Function timing the engine interrupt */
+void ds1820_set_profile_hook(ds1820_profile_func hook)
+{
+	ds1820ProfileHook = hook;
+}
+
+/* Convert from first two bytes of temperature data to degrees C */
+/* Gives 1/2 degree C resolution */
+float Do_1W_Temperature(ubyte MSB, ubyte LSB)
+{
+	float amt = 0.0;
+	char temp;
+
+/* Least significant bit signifies half a degree */
+	if (LSB & 0x01)
+		amt = 0.5;
+
+/* shift the byte to remove the least significant bit */
+	temp = LSB>>1;
+	
+/* Most significant byte indicates sign */
+	if (MSB)
+		temp |= 0x80;
+
+/* Convert from two's complement signed 8 bit value to float */
+	amt += (float) temp;
+
+	return amt;
+}
+
+/* Convert temperature with full resolution */
+float Do_1W_Temperature_Full(ubyte MSB, ubyte LSB,
+							 ubyte count_remain, ubyte count_per_C)
+{
+	float amt = 0.0;
+	char temp;
+
+/* shift the byte to remove the least significant bit */
+	temp = LSB>>1;
+	
+/* Most significant byte indicates sign */
+	if (MSB)
+		temp |= 0x80;
+
+/* Convert from two's complement signed 8 bit value to float */
+	amt = (float) temp;
+
+/* Calculation from p4 of the DS1820 Data Sheet */
+	if (fabs((double) count_per_C) > 1e-9) {
+		amt += ((float) count_per_C - (float) count_remain)/((float) count_per_C) - 0.25;
+	}
+
+	return amt;
+}
+
+/* Convert from first two bytes of temperature data to 1/100 degrees C */
+/* Integer version of Do_1W_Temperature */
+long Do_1W_Temperature_Centi(ubyte MSB, ubyte LSB)
+{
+	char temp;
+	long amt;
+
+/* shift the byte to remove the least significant bit */
+	temp = LSB>>1;
+
+/* Most significant byte indicates sign */
+	if (MSB)
+		temp |= 0x80;
+
+	amt = 100L * temp;
+
+/* Least significant bit signifies half a degree */
+	if (LSB & 0x01)
+		amt += 50;
+
+	return amt;
+}
+
+/* Convert temperature with full resolution to 1/100 degrees C */
+/* Integer version of Do_1W_Temperature_Full, rounded to nearest (halves up) */
+long Do_1W_Temperature_Full_Centi(ubyte MSB, ubyte LSB,
+								  ubyte count_remain, ubyte count_per_C)
+{
+	char temp;
+	long amt, num, den, frac;
+
+/* shift the byte to remove the least significant bit */
+	temp = LSB>>1;
+
+/* Most significant byte indicates sign */
+	if (MSB)
+		temp |= 0x80;
+
+	amt = 100L * temp;
+
+/* Calculation from p4 of the DS1820 Data Sheet: */
+/* 100 * (count_per_C - count_remain) / count_per_C - 25 */
+	if (count_per_C) {
+		/* floor(x + 1/2) with x = num / (2 * count_per_C) */
+		num = 200L * ((long) count_per_C - (long) count_remain) + count_per_C;
+		den = 2L * count_per_C;
+
+		frac = num / den;
+		if ((num % den) < 0)
+			frac--;	/* Division truncates towards zero */
+
+		amt += frac - 25;
+	}
+
+	return amt;
+}
+
+/*
+ * Routine to calculate 8 bit CRC from DalSemi
+ * Polynomial is CRC = X^8 + X^5 + X^4 + 1
+ * Adapted from assembly language in Dallas Semiconductor
+ * Application Note 27
+ * The table driven versions rely on the CRC being linear:
+ * CRC(a ^ b) = CRC(a) ^ CRC(b), with the tables holding the CRC
+ * of every possible byte (or low and high nibble) from a zero CRC.
+ */
+#if ONEWIRE_CRC == ONEWIRE_CRC_BYTE
+
+static const ubyte crc_table_1W[256] = {
+	0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
+	0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41,
+	0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E,
+	0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC,
+	0x23, 0x7D, 0x9F, 0xC1, 0x42, 0x1C, 0xFE, 0xA0,
+	0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
+	0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D,
+	0x7C, 0x22, 0xC0, 0x9E, 0x1D, 0x43, 0xA1, 0xFF,
+	0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5,
+	0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07,
+	0xDB, 0x85, 0x67, 0x39, 0xBA, 0xE4, 0x06, 0x58,
+	0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
+	0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6,
+	0xA7, 0xF9, 0x1B, 0x45, 0xC6, 0x98, 0x7A, 0x24,
+	0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B,
+	0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9,
+	0x8C, 0xD2, 0x30, 0x6E, 0xED, 0xB3, 0x51, 0x0F,
+	0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
+	0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92,
+	0xD3, 0x8D, 0x6F, 0x31, 0xB2, 0xEC, 0x0E, 0x50,
+	0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C,
+	0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE,
+	0x32, 0x6C, 0x8E, 0xD0, 0x53, 0x0D, 0xEF, 0xB1,
+	0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
+	0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49,
+	0x08, 0x56, 0xB4, 0xEA, 0x69, 0x37, 0xD5, 0x8B,
+	0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4,
+	0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16,
+	0xE9, 0xB7, 0x55, 0x0B, 0x88, 0xD6, 0x34, 0x6A,
+	0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
+	0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7,
+	0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
+};
+
+ubyte Do_1W_CRC(ubyte next_byte, ubyte CRC)
+{
+	return crc_table_1W[next_byte ^ CRC];
+}
+
+#elif ONEWIRE_CRC == ONEWIRE_CRC_NIBBLE
+
+static const ubyte crc_low_1W[16] = {
+	0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
+	0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41
+};
+
+static const ubyte crc_high_1W[16] = {
+	0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8,
+	0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+
+ubyte Do_1W_CRC(ubyte next_byte, ubyte CRC)
+{
+	CRC ^= next_byte;
+
+	return crc_low_1W[CRC & 0x0F] ^ crc_high_1W[CRC >> 4];
+}
+
+#else /* ONEWIRE_CRC_BITWISE */
+
+ubyte Do_1W_CRC(ubyte next_byte, ubyte CRC)
+{
+	int i;
+
+	/* Move the bits in one by one and do some stuff */
+	for (i=0; i<8; i++) {
+		if ((next_byte ^ CRC) & 0x01) {
+			CRC ^= 0x18; /* The generator polynomial */
+			CRC >>= 1;
+			CRC |= 0x80;
+		} else {
+			CRC >>= 1;
+		}
+		next_byte >>= 1;
+	}
+
+	return CRC;
+}
+
+#endif /* ONEWIRE_CRC */
+
+short ds1820_init(void)
+{
+	ubyte i;
+	ubyte rx_buffer[9];
+
+  /* ---------- Timer 2 Control Register ----------
+   *  timer 2 works in timer mode
+   *  prescaler factor is 128 (6.4 usec resolution)
+   *  timer 2 run bit is reset
+   *  up/down control bit is reset 
+   *  external up/down control is disabled
+   */
+  T2CON = 0x0004;
+  T2    = 0x0000;  /* load timer 2 register */
+
+	/* Reset pulse and presence sequence */
+	if (!Reset_1W())
+		return -1;
+
+	/* Alone on the bus the on-board device answers Read ROM.  With probes
+	   plugged in the answers collide and the CRC is wrong */
+	ds1820SnValid = (ds1820_read_rom(ds1820Sn) == 0);
+
+	/* Find out who is on the bus.  Errors are left to ds1820_get_sn() */
+	ds1820_search();
+
+	/* Find out the resolution the DS18B20 type devices power up with */
+	for (i=0; i<ds1820Count; i++) {
+		ds1820Bits[i] = 0;
+		if ((ds1820_get_family(i) != DS18B20_FAMILY) &&
+			(ds1820_get_family(i) != DS1822_FAMILY))
+			continue;
+		if (Scratchpad_1W(i, rx_buffer) == 0)
+			ds1820Bits[i] = ((rx_buffer[4] >> 5) & 0x03) + 9;
+		else
+			ds1820Bits[i] = 12;	/* Assume the worst */
+	}
+	Conv_Reads_1W();
+
+	return 0;
+}
+
+/* Keep the devices found by the ROM search for a warm restart */
+void ds1820_save(DS1820_STATE *state)
+{
+	ubyte i, j;
+
+	state->count = ds1820Count;
+	for (i=0; i<DS1820_MAX_DEVICES; i++) {
+		for (j=0; j<8; j++)
+			state->rom[i][j] = ds1820Rom[i][j];
+		state->bits[i] = ds1820Bits[i];
+	}
+}
+
+/* Take back the devices kept by ds1820_save() instead of searching the bus */
+short ds1820_restore(DS1820_STATE *state)
+{
+	ubyte i, j;
+
+	if ((state->count == 0) || (state->count > DS1820_MAX_DEVICES))
+		return -1;
+
+	/* Same Timer 2 setup as ds1820_init() */
+	T2CON = 0x0004;
+	T2    = 0x0000;
+
+	/* Somebody must still be there */
+	if (!Reset_1W())
+		return -1;
+
+	ds1820Count = state->count;
+	for (i=0; i<DS1820_MAX_DEVICES; i++) {
+		for (j=0; j<8; j++)
+			ds1820Rom[i][j] = state->rom[i][j];
+		ds1820Bits[i] = state->bits[i];
+	}
+	Conv_Reads_1W();
+
+	/* ds1820_search() put the on-board device first */
+	for (j=0; j<8; j++)
+		ds1820Sn[j] = ds1820Rom[0][j];
+	ds1820SnValid = 1;
+
+	return 0;
+}
+
+/* Enumerate the devices on the bus, the on-board device first */
+short ds1820_search(void)
+{
+	short status;
+
+	if (ds1820Running)
+		return -1;
+
+	status = Search_1W();
+	Board_1W();
+
+	return status;
+}
+
+/* Read the ROM code of the only device on the bus */
+short ds1820_read_rom(ubyte rom[8])
+{
+	int i;
+	ubyte CRC;
+
+	/* Start cycle on 1 wire bus by issuing reset and detecting presence */
+	Reset_1W();
+
+	/* Send Read ROM command (only works if ONE DS device on wire) */
+	Write_1W(0x33);
+
+	CRC = 0x0;
+
+	/* Read 8 bytes of serial number etc */
+	for (i=0; i<8; i++) {
+		rom[i] = Read_1W();
+		CRC = Do_1W_CRC(rom[i], CRC);
+	}
+
+	if (CRC != 0x0)
+		return -1;
+	return 0;
+}
+
+/* Enumerate the devices on the bus with the Search ROM command (AN187) */
+static short Search_1W(void)
+{
+	ubyte rom[8];
+	ubyte last_discrepancy = 0;
+	ubyte last_zero;
+	ubyte id_bit_number, id_bit, cmp_id_bit, search_direction;
+	ubyte mask;
+	ubyte i, CRC;
+
+	ds1820Count = 0;
+
+	do {
+		/* No presence pulse: nobody is there */
+		if (!Reset_1W())
+			return -1;
+
+		Write_1W(0xF0); /* Search ROM */
+
+		last_zero = 0;
+
+		for (id_bit_number=1; id_bit_number<=64; id_bit_number++) {
+			i = (id_bit_number-1) >> 3;
+			mask = 0x01 << ((id_bit_number-1) & 0x07);
+
+			/* Read the bit and its complement from all the devices */
+			id_bit = Read_Bit_1W();
+			cmp_id_bit = Read_Bit_1W();
+
+			/* Error: nobody answered */
+			if (id_bit && cmp_id_bit)
+				return -1;
+
+			if (id_bit != cmp_id_bit) {
+				/* All the devices left have the same bit here */
+				search_direction = id_bit;
+			} else {
+				/* Discrepancy: repeat the last choice before the last discrepancy,
+				   take the 1 branch on it and the 0 branch past it */
+				if (id_bit_number < last_discrepancy)
+					search_direction = (rom[i] & mask) ? 1 : 0;
+				else
+					search_direction = (id_bit_number == last_discrepancy) ? 1 : 0;
+
+				if (!search_direction)
+					last_zero = id_bit_number;
+			}
+
+			if (search_direction)
+				rom[i] |= mask;
+			else
+				rom[i] &= ~mask;
+
+			/* Devices with a different bit drop out until the next reset */
+			Write_Bit_1W(search_direction);
+		}
+
+		CRC = 0x0;
+		for (i=0; i<8; i++)
+			CRC = Do_1W_CRC(rom[i], CRC);
+
+		if (CRC != 0x0)
+			return -2;
+
+		for (i=0; i<8; i++)
+			ds1820Rom[ds1820Count][i] = rom[i];
+		ds1820Count++;
+
+		last_discrepancy = last_zero;
+
+	} while (last_discrepancy && (ds1820Count < DS1820_MAX_DEVICES));
+
+	return 0;
+}
+
+/* Number of devices found by the last ROM search */
+ubyte ds1820_get_count(void)
+{
+	return ds1820Count;
+}
+
+/* ROM code of a device found by the last ROM search */
+short ds1820_get_rom(ubyte device, ubyte rom[8])
+{
+	ubyte i;
+
+	if (device >= ds1820Count)
+		return -1;
+
+	for (i=0; i<8; i++)
+		rom[i] = ds1820Rom[device][i];
+
+	return 0;
+}
+
+/* Family code of a device found by the last ROM search (0 if unknown) */
+ubyte ds1820_get_family(ubyte device)
+{
+	if (device >= ds1820Count)
+		return 0;
+
+	return ds1820Rom[device][0];
+}
+
+/* Resolution of a device in bits (0 for a DS1820, which is not configurable) */
+ubyte ds1820_get_resolution(ubyte device)
+{
+	if (device >= ds1820Count)
+		return 0;
+
+	return ds1820Bits[device];
+}
+
+/* Set the resolution of a DS18B20 type device to 9 to 12 bits in the
+   background.  ds1820_poll_temp() writes the scratchpad, checks it took and
+   copies it to the EEPROM */
+short ds1820_set_resolution(ubyte device, ubyte bits)
+{
+	ubyte n;
+
+	if ((bits < 9) || (bits > 12))
+		return -1;
+
+	if ((device >= ds1820Count) || (ds1820Bits[device] == 0))
+		return -1;
+
+	if (ds1820Running || (ds1820State != DS_IDLE))
+		return DS1820_BUSY;
+
+	/* Read the scratchpad first to keep the alarm thresholds as they are */
+	n = Address_1W(device, ds1820Tx);
+	ds1820Tx[n++] = 0xBE; /* Read scratchpad */
+
+	if (Start_1W(1, ds1820Tx, n, ds1820Rx, 9))
+		return DS1820_BUSY;
+
+	ds1820Running = 1; // Keep the blocking routines out until done
+	ds1820Device = device;
+	ds1820SetBits = bits;
+	ds1820State = DS_SET_READ;
+
+	return 0;
+}
+
+short ds1820_get_sn(ubyte sn[8])
+{
+	int i;
+
+	/* The on-board device, whatever else is on the bus */
+	if (ds1820SnValid) {
+		for (i=0; i<8; i++)
+			sn[i] = ds1820Sn[i];
+		return 0;
+	}
+
+	return ds1820_read_rom(sn);
+}
+
+short ds1820_get_temp(ubyte *MSB, ubyte *LSB, ubyte *count_remain, ubyte *count_per_C)
+{
+	int i;
+	uword wait_count;
+	ubyte rx_buffer[10];
+	ubyte tx_buffer[9];
+	ubyte CRC;
+	ubyte n;
+
+	if(ds1820Running){ // Check if the subrutine is still running
+		return 0;
+	}	
+
+	ds1820Running = 1; // Signal that this is running
+
+	/* Start temperature reading cycle of DS1820 */
+	Reset_1W();
+
+	Write_1W(0xCC); /* Skip ROM */
+	Write_1W(0x44); /* Start conversion command */
+
+	/* Wait for conversion to complete (signalled by all 1s) */
+	wait_count = 0;
+	while ((Read_1W() != 0xff) &&     /* Avoid lockup by quitting after 1000 */
+			 (wait_count++ < 1000)) ;   /* byte reads (~600 ms) */
+
+	if (wait_count > 999){ /* Error: wait for temperature conversion timed out */
+		ds1820Running = 0; // Function is done and can be called again
+		return -1;
+	}
+
+	/* Reset bus */
+	Reset_1W();
+
+	/* Address the first device */
+	n = Address_1W(0, tx_buffer);
+	for (i=0; i<n; i++)
+		Write_1W(tx_buffer[i]);
+
+	Write_1W(0xBE); /* Read scratchpad */
+
+	CRC = 0x0;
+
+	/* read 9 data bytes */
+	for (i=0; i<9; i++) {
+		rx_buffer[i] = Read_1W();
+		CRC = Do_1W_CRC(rx_buffer[i], CRC);
+	}
+
+	if (CRC != 0x0){
+		ds1820Running = 0; // Function is done and can be called again
+		return -2;
+	}
+
+	Normalize_1W(0, rx_buffer);
+
+	/* Low accuracy temperature is in first two bytes */
+	*LSB = rx_buffer[0];
+ 	*MSB = rx_buffer[1];
+
+	/* Higher resolution data is in bytes 6 and 7 */
+	*count_remain = rx_buffer[6];
+	*count_per_C = rx_buffer[7];
+
+	ds1820Running = 0; // Function is done and can be called again
+
+	return 0;
+}
+
+/* Start a temperature conversion in the background */
+short ds1820_start_temp(void)
+{
+	if (ds1820Running || (ds1820State != DS_IDLE))
+		return -1;
+
+	ds1820Tx[0] = 0xCC; /* Skip ROM */
+	ds1820Tx[1] = 0x44; /* Start conversion command */
+
+	if (Start_1W(1, ds1820Tx, 2, 0, 0))
+		return -1;
+
+	ds1820Running = 1; // Keep the blocking routines out until done
+	ds1820State = DS_CONVERT;
+
+	return 0;
+}
+
+/* Move the background temperature reading along */
+short ds1820_poll_temp(ubyte *device, ubyte *MSB, ubyte *LSB, ubyte *count_remain, ubyte *count_per_C)
+{
+	int i;
+	ubyte CRC;
+	ubyte n;
+
+	if (ds1820State == DS_IDLE)
+		return DS1820_IDLE;
+
+	if (Status_1W() == ONEWIRE_BUSY)
+		return DS1820_BUSY;
+
+	if (Status_1W() != ONEWIRE_DONE) { /* Error: no device or bus fault */
+		ds1820State = DS_IDLE;
+		ds1820Running = 0;
+		return -1;
+	}
+
+	switch (ds1820State) {
+		case DS_CONVERT:
+			/* Conversion started: wait for completion (signalled by all 1s) */
+			ds1820WaitCount = 0;
+			ds1820Rx[0] = 0x0;
+			ds1820State = DS_WAIT;
+			break;
+
+		case DS_WAIT:
+			if (ds1820Rx[0] == 0xff) {
+				/* Reset bus and read the scratchpad of the first device */
+				ds1820Device = 0;
+				n = Address_1W(ds1820Device, ds1820Tx);
+				ds1820Tx[n++] = 0xBE; /* Read scratchpad */
+				Start_1W(1, ds1820Tx, n, ds1820Rx, 9);
+				ds1820State = DS_READ;
+				return DS1820_BUSY;
+			}
+
+			if (ds1820WaitCount++ >= ds1820ConvReads) { /* Error: wait for temperature conversion timed out */
+				ds1820State = DS_IDLE;
+				ds1820Running = 0;
+				return -1;
+			}
+			break;
+
+		case DS_READ:
+			CRC = 0x0;
+			for (i=0; i<9; i++)
+				CRC = Do_1W_CRC(ds1820Rx[i], CRC);
+
+			*device = ds1820Device;
+
+			if (CRC == 0x0) {
+				Normalize_1W(ds1820Device, ds1820Rx);
+
+				/* Low accuracy temperature is in first two bytes */
+				*LSB = ds1820Rx[0];
+				*MSB = ds1820Rx[1];
+
+				/* Higher resolution data is in bytes 6 and 7 */
+				*count_remain = ds1820Rx[6];
+				*count_per_C = ds1820Rx[7];
+			}
+
+			/* Go on with the next device, if any */
+			if (++ds1820Device < ds1820Count) {
+				n = Address_1W(ds1820Device, ds1820Tx);
+				ds1820Tx[n++] = 0xBE; /* Read scratchpad */
+				Start_1W(1, ds1820Tx, n, ds1820Rx, 9);
+			} else {
+				ds1820State = DS_IDLE;
+				ds1820Running = 0;
+			}
+
+			if (CRC != 0x0)
+				return -2;
+
+			return 0;
+
+		case DS_SET_READ:
+			CRC = 0x0;
+			for (i=0; i<9; i++)
+				CRC = Do_1W_CRC(ds1820Rx[i], CRC);
+
+			*device = ds1820Device;
+
+			if (CRC != 0x0) {
+				ds1820State = DS_IDLE;
+				ds1820Running = 0;
+				return -2;
+			}
+
+			n = Address_1W(ds1820Device, ds1820Tx);
+			ds1820Tx[n++] = 0x4E; /* Write scratchpad */
+			ds1820Tx[n++] = ds1820Rx[2]; /* TH */
+			ds1820Tx[n++] = ds1820Rx[3]; /* TL */
+			ds1820Tx[n++] = ((ds1820SetBits-9) << 5) | 0x1F; /* Configuration */
+			Start_1W(1, ds1820Tx, n, 0, 0);
+			ds1820State = DS_SET_WRITE;
+			return DS1820_BUSY;
+
+		case DS_SET_WRITE:
+			/* Read it back to check it took */
+			n = Address_1W(ds1820Device, ds1820Tx);
+			ds1820Tx[n++] = 0xBE; /* Read scratchpad */
+			Start_1W(1, ds1820Tx, n, ds1820Rx, 9);
+			ds1820State = DS_SET_CHECK;
+			return DS1820_BUSY;
+
+		case DS_SET_CHECK:
+			CRC = 0x0;
+			for (i=0; i<9; i++)
+				CRC = Do_1W_CRC(ds1820Rx[i], CRC);
+
+			*device = ds1820Device;
+
+			if ((CRC != 0x0) || (((ds1820Rx[4] >> 5) & 0x03) != (ds1820SetBits-9))) {
+				ds1820State = DS_IDLE;
+				ds1820Running = 0;
+				return (CRC != 0x0) ? -2 : -1;
+			}
+
+			ds1820Bits[ds1820Device] = ds1820SetBits;
+			Conv_Reads_1W();
+
+			/* Keep it across a power cycle */
+			n = Address_1W(ds1820Device, ds1820Tx);
+			ds1820Tx[n++] = 0x48; /* Copy scratchpad */
+			Start_1W(1, ds1820Tx, n, 0, 0);
+			ds1820State = DS_SET_COPY;
+			return DS1820_BUSY;
+
+		case DS_SET_COPY:
+			/* Copy started: wait for completion (signalled by all 1s) */
+			ds1820WaitCount = 0;
+			ds1820Rx[0] = 0x0;
+			ds1820State = DS_SET_WAIT;
+			break;
+
+		case DS_SET_WAIT:
+			*device = ds1820Device;
+
+			if (ds1820Rx[0] == 0xff) {
+				ds1820State = DS_IDLE;
+				ds1820Running = 0;
+				return DS1820_IDLE;
+			}
+
+			if (ds1820WaitCount++ >= DS1820_COPY_READS) { /* Error: EEPROM copy timed out */
+				ds1820State = DS_IDLE;
+				ds1820Running = 0;
+				return -1;
+			}
+			break;
+
+		default:
+			ds1820State = DS_IDLE;
+			ds1820Running = 0;
+			return -1;
+	}
+
+	/* Read the conversion or copy status byte */
+	Start_1W(0, 0, 0, ds1820Rx, 1);
+
+	return DS1820_BUSY;
+}
+
+/* Fill in the ROM command addressing a device: Match ROM with its ROM code,
+   or Skip ROM when there is at most one device on the bus.  Returns the length */
+static ubyte Address_1W(ubyte device, ubyte *tx_buffer)
+{
+	ubyte i;
+
+	if (ds1820Count <= 1) {
+		tx_buffer[0] = 0xCC; /* Skip ROM */
+		return 1;
+	}
+
+	tx_buffer[0] = 0x55; /* Match ROM */
+	for (i=0; i<8; i++)
+		tx_buffer[i+1] = ds1820Rom[device][i];
+
+	return 9;
+}
+
+/* Read the scratchpad of a device.  Returns 0, -1 on bus error or -2 on CRC error */
+static short Scratchpad_1W(ubyte device, ubyte *rx_buffer)
+{
+	ubyte i, n;
+	ubyte CRC;
+	ubyte tx_buffer[9];
+
+	if (!Reset_1W())
+		return -1;
+
+	n = Address_1W(device, tx_buffer);
+	for (i=0; i<n; i++)
+		Write_1W(tx_buffer[i]);
+
+	Write_1W(0xBE); /* Read scratchpad */
+
+	CRC = 0x0;
+	for (i=0; i<9; i++) {
+		rx_buffer[i] = Read_1W();
+		CRC = Do_1W_CRC(rx_buffer[i], CRC);
+	}
+
+	if (CRC != 0x0)
+		return -2;
+	return 0;
+}
+
+/* Rewrite the temperature of a DS18B20 type device in the DS1820 format, so that
+   users and the Do_1W_Temperature routines see the same thing from all devices.
+   The 1/16 C reading t is split into a 0.5 C reading of (t+4)/16 whole degrees
+   and a count_remain of 16-((t+4)%16), with count_per_C = 16 */
+static void Normalize_1W(ubyte device, ubyte *rx_buffer)
+{
+	int raw;
+
+	if ((device >= ds1820Count) || (ds1820Bits[device] == 0))
+		return;
+
+	raw = (short) (((uword) rx_buffer[1] << 8) | rx_buffer[0]);
+
+	/* Bits below the resolution are undefined */
+	raw &= ~((1 << (12-ds1820Bits[device])) - 1);
+
+	rx_buffer[0] = (ubyte) ((raw+4) >> 3);
+	rx_buffer[1] = ((raw+4) < 0) ? 0xFF : 0x00;
+	rx_buffer[6] = 16 - ((raw+4) & 0x0F);
+	rx_buffer[7] = 16;
+}
+
+/* Move the on-board device to the front of the list, keeping the others in
+   search order.  It is the one that answered Read ROM, or without an answer
+   the first DS1820 found, the probes being DS18B20 type */
+static void Board_1W(void)
+{
+	ubyte i, j;
+	ubyte board;
+	ubyte rom[8];
+
+	if (ds1820Count == 0)
+		return;
+
+	board = ds1820Count;
+	if (ds1820SnValid) {
+		for (board=0; board<ds1820Count; board++) {
+			for (j=0; (j<8) && (ds1820Rom[board][j] == ds1820Sn[j]); j++)
+				;
+			if (j == 8)
+				break;
+		}
+	}
+
+	if (board >= ds1820Count)
+		for (board=0; (board<ds1820Count) && (ds1820Rom[board][0] != DS1820_FAMILY); board++)
+			;
+
+	/* Not found: the first one it is */
+	if (board >= ds1820Count)
+		board = 0;
+
+	for (j=0; j<8; j++)
+		rom[j] = ds1820Rom[board][j];
+	for (i=board; i>0; i--)
+		for (j=0; j<8; j++)
+			ds1820Rom[i][j] = ds1820Rom[i-1][j];
+	for (j=0; j<8; j++) {
+		ds1820Rom[0][j] = rom[j];
+		ds1820Sn[j] = rom[j];
+	}
+	ds1820SnValid = 1;
+}
+
+/* Scale the conversion timeout to the slowest device on the bus: a DS18B20
+   type device takes half as long for every bit of resolution below 12. A
+   quarter is added on top, so a status read stretched by the slot timing
+   does not end a conversion that is still in time (93.75 ms at 9 bits) */
+static void Conv_Reads_1W(void)
+{
+	ubyte i;
+	uword reads;
+
+	ds1820ConvReads = 0;
+
+	for (i=0; i<ds1820Count; i++) {
+		if (ds1820Bits[i] == 0)
+			reads = DS1820_CONV_READS;
+		else
+			reads = DS1820_CONV_READS >> (12-ds1820Bits[i]);
+
+		if (reads > ds1820ConvReads)
+			ds1820ConvReads = reads;
+	}
+
+	if (ds1820ConvReads == 0)
+		ds1820ConvReads = DS1820_CONV_READS;
+
+	ds1820ConvReads += ds1820ConvReads/DS1820_CONV_MARGIN;
+}
+
+
@@ -1,117 +1,250 @@
-/*
- ****************************************************************************
- # $Id: ds1820.h,v 1.3 2000/03/18 00:17:44 mbrooks Exp $
- #
- # Copyright (C) 1999
- # Associated Universities, Inc. Washington DC, USA.
- #
- # Correspondence concerning ALMA should be addressed as follows:
- #        Internet email: mmaswgrp@nrao.edu
- ****************************************************************************
- */
-/*****************************************************************************
- *
- *  DS1820.H 
- *
- *  Header file for DS1820 library for dealing with Dallas Semiconductor 
- *	 DS1820 Temperature sensor.  Much of the code in here is general to
- *  any 1-Wire device.  This code is written for a C167 micro and makes use
- *  of the Timer 2 in the general purpose timer unit.
- *
- ****************************************************************************
- */
-
-/*
- ****************************************************************************
- *  Prototypes of global functions
- ****************************************************************************
- */
-
-#define ulong unsigned long
-#define uword unsigned int
-#define ubyte unsigned char
-
-/**
- * Routines for ALMA specific things.  All routines return 0 for success and -1
- * on error.
- */
-short ds1820_init(void);
-short ds1820_get_sn(ubyte sn[8]);
-short ds1820_get_temp(ubyte *MSB, ubyte *LSB, ubyte *count_remain, ubyte *count_per_C);
-
-/**
- * Generic 1 Wire primitive functions 
- */
-ubyte Reset_1W(void);              /* Reset bus and test for presence pulse */
-void  Write_1W(ubyte tx_byte);	  /* Write a byte to the bus */
-ubyte Read_1W(void);				     /* Read a byte from the bus */
-
-ubyte Do_1W_CRC(ubyte next_byte, ubyte CRC);   /* Calculate CRC */
-float Do_1W_Temperature(ubyte MSB, ubyte LSB); /* Calculate temperature from DS1820 data with 0.5C resolution */
-float Do_1W_Temperature_Full(ubyte MSB, ubyte LSB, /* Calculate accurate temperature from DS1820 data */
-							 ubyte count_remain, ubyte count_per_C); 
-
-/*
- ****************************************************************************
- * Macros
- ****************************************************************************
- */
-/**
- * This macro starts the Timer 2. The timer continues
- * to count from where it had stopped
- */
-
-#define START_T2 T2R = 1
-
-/**
- * This macro stops Timer 2. The contents of
- * the timer register remain unchanged.
- */
-
-#define STOP_T2 T2R = 0                     
-
-/**
- * This macro stops Timer 2 and sets the timer
- * register to 0.
- */
-
-#define CLEAR_T2 T2R = 0; T2 = 0x0000 
-
-/**
- * This macro returns the contents of the selected Timer 2.
- * The timer is not stopped. Access of the CPU to the
- * registers of the timer is of higher priority than a timer
- * increment, a reload or a capture event.
- */
-
-#define READ_T2 T2
-
-/**
- * The following macros vary depending on the hardware.  Use different
- * targets to create different libraries
- */
-
-#ifdef SK167
-
-sbit  P7_0 = P7^0;
-
-#define READ_PIN P7_0
-#define SET_PIN P7_0 = 1
-#define RESET_PIN P7_0 = 0
-#define SET_INPUT DP7 &= ~0x01
-#define SET_OUTPUT DP7 |= 0x01
-
-#endif
-
-#ifdef AMBSI
-
-sbit  P3_0 = P3^0;
-
-#define READ_PIN P3_0
-#define SET_PIN P3_0 = 1
-#define RESET_PIN P3_0 = 0
-#define SET_INPUT DP3 &= ~0x01
-#define SET_OUTPUT DP3 |= 0x01
-
-#endif
-
+/*
+ ****************************************************************************
+ # $Id: ds1820.h,v 1.3 2000/03/18 00:17:44 mbrooks Exp $
+ #
+ # Copyright (C) 1999
+ # Associated Universities, Inc. Washington DC, USA.
+ #
+ # Correspondence concerning ALMA should be addressed as follows:
+ #        Internet email: mmaswgrp@nrao.edu
+ ****************************************************************************
+ */
+/*****************************************************************************
+ *
+ *  DS1820.H 
+ *
+ *  Header file for DS1820 library for dealing with Dallas Semiconductor 
+ *	 DS1820 Temperature sensor.  Much of the code in here is general to
+ *  any 1-Wire device.  This code is written for a C167 micro and makes use
+ *  of the Timer 2 in the general purpose timer unit.
+ *
+ ****************************************************************************
+ */
+
+/*
+ ****************************************************************************
+ *  Prototypes of global functions
+ ****************************************************************************
+ */
+
+#define ulong unsigned long
+#define uword unsigned int
+#define ubyte unsigned char
+
+/**
+ * Routines for ALMA specific things.  All routines return 0 for success and -1
+ * on error.
+ */
+short ds1820_init(void);
+short ds1820_get_sn(ubyte sn[8]);
+short ds1820_get_temp(ubyte *MSB, ubyte *LSB, ubyte *count_remain, ubyte *count_per_C);
+
+/**
+ * Multi-drop support.  ds1820_init() runs a Search ROM and keeps the ROM codes
+ * of up to DS1820_MAX_DEVICES devices.  With more than one device on the bus
+ * each one is addressed with Match ROM.  The on-board device is always device
+ * 0 and its ROM code is what ds1820_get_sn() returns as the node serial number,
+ * so that plugging in a probe changes neither.  ds1820_init() recognizes it by
+ * the Read ROM answer it gets when it is alone on the bus; with probes already
+ * plugged in at power up, it is the first DS1820 found (probes are expected
+ * to be DS18B20 type).  The other devices follow in search order.
+ */
+short ds1820_search(void);
+short ds1820_read_rom(ubyte rom[8]);
+ubyte ds1820_get_count(void);
+short ds1820_get_rom(ubyte device, ubyte rom[8]);
+
+#define DS1820_MAX_DEVICES	4	/* Devices remembered by the ROM search */
+
+/**
+ * Warm restart support.  ds1820_save() copies the devices found by the ROM
+ * search and their resolution to a DS1820_STATE the application keeps across
+ * a software reset.  After the reset ds1820_restore() takes them back in place
+ * of ds1820_init(): the devices were not powered down and keep their
+ * configuration, so only a presence check is done on the bus.
+ */
+typedef struct {
+	ubyte	count;
+	ubyte	rom[DS1820_MAX_DEVICES][8];
+	ubyte	bits[DS1820_MAX_DEVICES];
+} DS1820_STATE;
+
+void  ds1820_save(DS1820_STATE *state);
+short ds1820_restore(DS1820_STATE *state);
+
+/**
+ * DS18B20 support.  The family code (first ROM byte) tells the parts apart.
+ * The DS18B20 and DS1822 resolution can be set from 9 bits (~94 ms conversion)
+ * to 12 bits (~750 ms), and the conversion timeout follows the slowest device.
+ * Their readings are returned in the DS1820 format (count_per_C = 16) so the
+ * Do_1W_Temperature routines and the data sent on the bus do not change.
+ * ds1820_get_resolution() returns 0 for a DS1820.  ds1820_set_resolution()
+ * does not block: it returns 0 once the change is queued, DS1820_BUSY while
+ * the bus is taken and -1 for a bad device or resolution.  ds1820_poll_temp()
+ * then writes the scratchpad, reads it back and copies it to the EEPROM, and
+ * returns DS1820_IDLE when done or -1/-2 on error, like for a reading.
+ */
+ubyte ds1820_get_family(ubyte device);
+ubyte ds1820_get_resolution(ubyte device);
+short ds1820_set_resolution(ubyte device, ubyte bits);
+
+#define DS1820_FAMILY		0x10	/* DS1820 and DS18S20 */
+#define DS18B20_FAMILY		0x28
+#define DS1822_FAMILY		0x22
+
+/**
+ * Split phase temperature reading.  ds1820_start_temp() broadcasts the Convert T
+ * command in the background and returns at once.  ds1820_poll_temp() never
+ * blocks: it moves the reading along and returns DS1820_BUSY until the
+ * scratchpad of a device has been read, then 0 with the data, -1 on timeout
+ * or bus error and -2 on CRC error.  device tells which one was read: keep
+ * polling until DS1820_IDLE is returned to get all of them.
+ */
+short ds1820_start_temp(void);
+short ds1820_poll_temp(ubyte *device, ubyte *MSB, ubyte *LSB, ubyte *count_remain, ubyte *count_per_C);
+
+#define DS1820_BUSY			1	/* Reading in progress */
+#define DS1820_IDLE			2	/* No reading in progress */
+#define DS1820_CONV_READS	1400	/* Status reads in a 12 bit conversion (~780 ms) */
+#define DS1820_CONV_MARGIN	4		/* Timeout margin: 1/4 of the conversion reads on top */
+#define DS1820_COPY_READS	36		/* Status reads before EEPROM copy timeout (~20 ms) */
+
+/**
+ * Generic 1 Wire primitive functions 
+ */
+ubyte Reset_1W(void);              /* Reset bus and test for presence pulse */
+void  Write_1W(ubyte tx_byte);	  /* Write a byte to the bus */
+ubyte Read_1W(void);				     /* Read a byte from the bus */
+void  Write_Bit_1W(ubyte tx_bit);	  /* Write a single bit to the bus */
+ubyte Read_Bit_1W(void);			     /* Read a single bit from the bus */
+
+/**
+ * Interrupt driven 1 Wire engine.  A transaction is an optional reset and
+ * presence detect followed by tx_len byte writes and rx_len byte reads.  It
+ * runs in the background on the Timer 2 interrupt and Status_1W() reports
+ * ONEWIRE_BUSY until it completes.  The buffers must remain valid until then.
+ * Only one transaction can be in progress, and the blocking primitives above
+ * must not be used while it runs.  Start_1W returns -1 if the engine is busy.
+ */
+short Start_1W(ubyte reset, ubyte *tx_buffer, ubyte tx_len,  /* Start a background transaction */
+			   ubyte *rx_buffer, ubyte rx_len);
+ubyte Status_1W(void);							/* Status of the last transaction */
+
+/**
+ * Time the engine: a function given with ds1820_set_profile_hook is called
+ * on entry (begin = 1) and on exit (begin = 0) of the Timer 2 interrupt.
+ */
+typedef void (*ds1820_profile_func)(ubyte begin);
+void ds1820_set_profile_hook(ds1820_profile_func hook);
+
+#define ONEWIRE_DONE		0	/* Transaction completed */
+#define ONEWIRE_BUSY		1	/* Transaction in progress */
+#define ONEWIRE_NO_PRESENCE	2	/* No presence pulse after reset */
+#define ONEWIRE_SHORT		3	/* Bus did not return high after reset */
+
+ubyte Do_1W_CRC(ubyte next_byte, ubyte CRC);   /* Calculate CRC */
+float Do_1W_Temperature(ubyte MSB, ubyte LSB); /* Calculate temperature from DS1820 data with 0.5C resolution */
+float Do_1W_Temperature_Full(ubyte MSB, ubyte LSB, /* Calculate accurate temperature from DS1820 data */
+							 ubyte count_remain, ubyte count_per_C); 
+long  Do_1W_Temperature_Centi(ubyte MSB, ubyte LSB); /* Same as Do_1W_Temperature in 1/100 C, no floating point */
+long  Do_1W_Temperature_Full_Centi(ubyte MSB, ubyte LSB, /* Same as Do_1W_Temperature_Full in 1/100 C, */
+								   ubyte count_remain, ubyte count_per_C); /* rounded to nearest */
+
+/**
+ * Implementation of Do_1W_CRC, chosen at build time.  ONEWIRE_CRC can be set
+ * from the project defines to trade code size against speed:
+ *  ONEWIRE_CRC_BITWISE - one polynomial step per bit, no table
+ *  ONEWIRE_CRC_NIBBLE  - two lookups per byte in 16 entry tables (32 bytes)
+ *  ONEWIRE_CRC_BYTE    - one lookup per byte in a 256 entry table
+ */
+
+#define ONEWIRE_CRC_BITWISE	0
+#define ONEWIRE_CRC_NIBBLE	1
+#define ONEWIRE_CRC_BYTE	2
+
+#ifndef ONEWIRE_CRC
+#define ONEWIRE_CRC ONEWIRE_CRC_NIBBLE
+#endif
+
+/*
+ ****************************************************************************
+ * Macros
+ ****************************************************************************
+ */
+/**
+ * This macro starts the Timer 2. The timer continues
+ * to count from where it had stopped
+ */
+
+#define START_T2 T2R = 1
+
+/**
+ * This macro stops Timer 2. The contents of
+ * the timer register remain unchanged.
+ */
+
+#define STOP_T2 T2R = 0                     
+
+/**
+ * This macro stops Timer 2 and sets the timer
+ * register to 0.
+ */
+
+#define CLEAR_T2 T2R = 0; T2 = 0x0000 
+
+/**
+ * This macro returns the contents of the selected Timer 2.
+ * The timer is not stopped. Access of the CPU to the
+ * registers of the timer is of higher priority than a timer
+ * increment, a reload or a capture event.
+ */
+
+#define READ_T2 T2
+
+/**
+ * Timing of the interrupt driven engine.  Timer 2 runs with prescaler 8
+ * (0.4 usec resolution) while a background transaction is in progress and
+ * is set back to prescaler 128 for the blocking primitives when done.
+ */
+
+#define ONEWIRE_T2CON			0x0000	/* Timer mode, prescaler 8, stopped */
+#define ONEWIRE_T2CON_BLOCKING	0x0004	/* Timer mode, prescaler 128, stopped */
+
+#define ONEWIRE_RESET_LOW		1250	/* 500 usec reset pulse */
+#define ONEWIRE_RELEASE_WAIT	37		/* 15 usec for the line to go high */
+#define ONEWIRE_PRESENCE		175		/* Sample presence 70 usec after release */
+#define ONEWIRE_RESET_END		1075	/* Complete 500 usec of presence window */
+#define ONEWIRE_RECOVERY		3		/* 1.2 usec high before each slot */
+#define ONEWIRE_START_END		6		/* 1.2 usec low to start each slot */
+#define ONEWIRE_SAMPLE			28		/* Sample read data 11 usec into the slot */
+#define ONEWIRE_SLOT			168		/* 67 usec from slot start to release */
+
+/**
+ * The following macros vary depending on the hardware.  Use different
+ * targets to create different libraries
+ */
+
+#ifdef SK167
+
+sbit  P7_0 = P7^0;
+
+#define READ_PIN P7_0
+#define SET_PIN P7_0 = 1
+#define RESET_PIN P7_0 = 0
+#define SET_INPUT DP7 &= ~0x01
+#define SET_OUTPUT DP7 |= 0x01
+
+#endif
+
+#ifdef AMBSI
+
+sbit  P3_0 = P3^0;
+
+#define READ_PIN P3_0
+#define SET_PIN P3_0 = 1
+#define RESET_PIN P3_0 = 0
+#define SET_INPUT DP3 &= ~0x01
+#define SET_OUTPUT DP3 |= 0x01
+
+#endif
+
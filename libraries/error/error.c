@@ -1,152 +1,315 @@
-/****************************************************************************
- # $Id: error.c,v 1.8 2003/08/01 22:19:35 tucelec Exp $
- #
- # Copyright (C) 1999
- # Associated Universities, Inc. Washington DC, USA.
- #
- # Correspondence concerning ALMA should be addressed as follows:
- #        Internet email: mmaswgrp@nrao.edu
- ****************************************************************************
- *
- *  MAIN.C 
- *
- *  Slave node implementation for AMBSI board.  This implementation
- *  of an M&C slave node provides access to the analog and digital
- *  I/O on the C167, and the ambient temperature in the DS1820.  Note that it 
- *  is specific to the hardware setup of the board.
- *
- ****************************************************************************
- */
-
-/* Include general libraries */
-#include <stdlib.h>
-#include <string.h>
-
-/* include library interface */
-#include "error.h"
-
-/* Typedefs */
-typedef struct{
-	unsigned char			*facility_descr;
-	FACILITY_ERROR_ARRAY	*facility_error_array;
-} MAIN_ERROR_ARRAY;
-
-/* Globals */
-static MAIN_ERROR_ARRAY		main_array[8];
-unsigned char				error_status[8];
-static unsigned char		already_initialized=0;
-static unsigned char		devices=0;
-
-/* Error array for Error library */
-static FACILITY_ERROR_ARRAY	facility_error_array[6]={{0, "NoEr"},	// 0x00 -> No Error
-													 {1, "NMem"},	// 0x01 -> Not Enough Memory
-													 {2, "AIni"},	// 0x02 -> Library Already Initialized
-													 {3, "NIni"},	// 0x03 -> Library not Initialized
-													 {4, "DMax"},	// 0x04 -> Exceeded Max Number Devices
-													 {5, "DNRg"}};	// 0x05 -> Device not Accounted for in the Initialization (Not Registered)
-static unsigned char		facility_descr[3]="ERR";
-
-/* Prototypes */
-int				init_error_handler(unsigned char devices_no);
-unsigned char	reg_facility(unsigned char *facility_descr, FACILITY_ERROR_ARRAY *facility_error_array);
-unsigned char	report_error(unsigned char facility_no, unsigned char error_no);
-void			write_error_CAN(CAN_MSG_TYPE *can_msg);
-void			clear_error(void);
-
-/* Initialize main error array */
-int init_error_handler(unsigned char devices_no){
-
-	clear_error();
-
-	if(already_initialized){
-		report_error(0,2); // ERROR - Library Already Initialized
-		return -1;
-	}
-
-	if(devices_no>8){
-		report_error(0,4); // ERROR - Exceeded Max Number Devices
-		return -1;
-	}
-
-	/* Registring error array for error facility (facility# = 0) */
-	main_array[0].facility_descr=facility_descr;
-	main_array[0].facility_error_array=facility_error_array;
-	devices=devices_no;
-
-	already_initialized=1;
-
-	return 0;
-}
-
-/* Register facilities into the main array */
-unsigned char reg_facility(unsigned char *facility_descr, FACILITY_ERROR_ARRAY *facility_error_array){
-
-	unsigned char static facility_index=1;
-	unsigned char i;
-
-	if(already_initialized){
-		if(facility_index>devices){
-			/* Check if the device has already been registered */
-			for(i=1;i<devices;i++){
-				if(!strcmp(main_array[i].facility_descr,facility_descr)){
-					return i; // Device already initialize: return the device number
-				}
-			}
-			report_error(0,5); // ERROR - Device not Accounted for in the Initialization
-			return -1;
-		}
-		/* Check if the device has already been registered */
-		for(i=1;i<facility_index;i++){
-			if(!strcmp(main_array[i].facility_descr,facility_descr)){
-				return i; // Device already initialize: return the device number
-			}
-		}
-		main_array[facility_index].facility_descr=facility_descr;
-		main_array[facility_index].facility_error_array=facility_error_array;
-
-		return facility_index++;
-	}
-
-	report_error(0,3); // ERROR - Library not Initialized
-	return -1;
-}
-
-/* Fill in error status */
-unsigned char report_error(unsigned char facility_no, unsigned char error_no){
-	
-	if(facility_no==0){
-	 	memcpy(&error_status[0],facility_descr,3);
-		memcpy(&error_status[3],&facility_error_array[error_no].description,4);
-		error_status[7]=(facility_no<<5)|(error_no&0x1F);
-	} else {
-		if(already_initialized){
-			if(facility_no>devices){
-				return report_error(0,5); // ERROR - Device not Accounted for in the Initialization
-			}
- 			memcpy(&error_status[0],main_array[facility_no].facility_descr,3);
-			memcpy(&error_status[3],main_array[facility_no].facility_error_array[error_no].description,4);
-			error_status[7]=(facility_no<<5)|(error_no&0x1F);
-
-			return error_status[7];
-		}
-		
-		return report_error(0,3); // ERROR - Library not Initialized
-	}
-
-	return error_status[7];
-}
-
-/* Write error to CAN message */
-void write_error_CAN(CAN_MSG_TYPE *can_msg){
-
-	can_msg->len = 8;	
-
-	memcpy(can_msg->data,&error_status,7);
-	can_msg->data[7]=error_status[7];
-
-}
-
-/* Clear error status */
-void clear_error(void){
-	memcpy(error_status,"\0\0\0\0\0\0\0\0",8);
-}
+/****************************************************************************
+ # $Id: error.c,v 1.8 2003/08/01 22:19:35 tucelec Exp $
+ #
+ # Copyright (C) 1999
+ # Associated Universities, Inc. Washington DC, USA.
+ #
+ # Correspondence concerning ALMA should be addressed as follows:
+ #        Internet email: mmaswgrp@nrao.edu
+ ****************************************************************************
+ *
+ *  MAIN.C 
+ *
+ *  Slave node implementation for AMBSI board.  This implementation
+ *  of an M&C slave node provides access to the analog and digital
+ *  I/O on the C167, and the ambient temperature in the DS1820.  Note that it 
+ *  is specific to the hardware setup of the board.
+ *
+ ****************************************************************************
+ */
+
+/* Include C167 register definitions */
+#include <reg167.h>
+
+/* Include general libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* include library interface */
+#include "error.h"
+
+/* Defines */
+#define ERROR_RING_MASK		(ERROR_RING_SIZE-1)
+
+/* Typedefs */
+typedef struct{
+	unsigned char			*facility_descr;
+	FACILITY_ERROR_ARRAY	*facility_error_array;
+} MAIN_ERROR_ARRAY;
+
+/* Globals */
+static MAIN_ERROR_ARRAY		main_array[8];
+unsigned char				error_status[8];
+static unsigned char		already_initialized=0;
+static unsigned char		devices=0;
+
+/* Event history: error_seq counts the events ever logged, the last
+   ERROR_RING_SIZE of them are kept. Readers walk it with error_cursor */
+static ERROR_EVENT			error_ring[ERROR_RING_SIZE];
+static unsigned int			error_seq=0;
+static unsigned int			error_cursor=0;
+static unsigned int			error_kept=0;		// Events in the ring (ERROR_RING_SIZE once it wrapped)
+static volatile unsigned long	*error_clock=0;
+
+/* Error array for Error library */
+static FACILITY_ERROR_ARRAY	facility_error_array[6]={{0, "NoEr"},	// 0x00 -> No Error
+													 {1, "NMem"},	// 0x01 -> Not Enough Memory
+													 {2, "AIni"},	// 0x02 -> Library Already Initialized
+													 {3, "NIni"},	// 0x03 -> Library not Initialized
+													 {4, "DMax"},	// 0x04 -> Exceeded Max Number Devices
+													 {5, "DNRg"}};	// 0x05 -> Device not Accounted for in the Initialization (Not Registered)
+static unsigned char		facility_descr[3]="ERR";
+
+/* Prototypes */
+int				init_error_handler(unsigned char devices_no);
+unsigned char	reg_facility(unsigned char *facility_descr, FACILITY_ERROR_ARRAY *facility_error_array);
+unsigned char	report_error(unsigned char facility_no, unsigned char error_no);
+void			write_error_CAN(CAN_MSG_TYPE *can_msg);
+void			clear_error(void);
+void			set_error_clock(volatile unsigned long *clock);
+void			read_error_CAN(CAN_MSG_TYPE *can_msg);
+void			cursor_error_CAN(CAN_MSG_TYPE *can_msg);
+int				read_error_block(unsigned long offset, unsigned char *data, unsigned char len);
+static void		log_error(unsigned char code);
+static void		put_error_event(unsigned char *data, unsigned int seq, ERROR_EVENT *event);
+
+/* Initialize main error array */
+int init_error_handler(unsigned char devices_no){
+
+	clear_error();
+
+	if(already_initialized){
+		report_error(0,2); // ERROR - Library Already Initialized
+		return -1;
+	}
+
+	if(devices_no>8){
+		report_error(0,4); // ERROR - Exceeded Max Number Devices
+		return -1;
+	}
+
+	/* Registring error array for error facility (facility# = 0) */
+	main_array[0].facility_descr=facility_descr;
+	main_array[0].facility_error_array=facility_error_array;
+	devices=devices_no;
+
+	already_initialized=1;
+
+	return 0;
+}
+
+/* Register facilities into the main array */
+unsigned char reg_facility(unsigned char *facility_descr, FACILITY_ERROR_ARRAY *facility_error_array){
+
+	unsigned char static facility_index=1;
+	unsigned char i;
+
+	if(already_initialized){
+		if(facility_index>devices){
+			/* Check if the device has already been registered */
+			for(i=1;i<devices;i++){
+				if(!strcmp(main_array[i].facility_descr,facility_descr)){
+					return i; // Device already initialize: return the device number
+				}
+			}
+			report_error(0,5); // ERROR - Device not Accounted for in the Initialization
+			return -1;
+		}
+		/* Check if the device has already been registered */
+		for(i=1;i<facility_index;i++){
+			if(!strcmp(main_array[i].facility_descr,facility_descr)){
+				return i; // Device already initialize: return the device number
+			}
+		}
+		main_array[facility_index].facility_descr=facility_descr;
+		main_array[facility_index].facility_error_array=facility_error_array;
+
+		return facility_index++;
+	}
+
+	report_error(0,3); // ERROR - Library not Initialized
+	return -1;
+}
+
+/* Fill in error status */
+unsigned char report_error(unsigned char facility_no, unsigned char error_no){
+	
+	if(facility_no==0){
+	 	memcpy(&error_status[0],facility_descr,3);
+		memcpy(&error_status[3],&facility_error_array[error_no].description,4);
+		error_status[7]=(facility_no<<5)|(error_no&0x1F);
+	} else {
+		if(already_initialized){
+			if(facility_no>devices){
+				return report_error(0,5); // ERROR - Device not Accounted for in the Initialization
+			}
+ 			memcpy(&error_status[0],main_array[facility_no].facility_descr,3);
+			memcpy(&error_status[3],main_array[facility_no].facility_error_array[error_no].description,4);
+			error_status[7]=(facility_no<<5)|(error_no&0x1F);
+		} else {
+			return report_error(0,3); // ERROR - Library not Initialized
+		}
+	}
+
+	log_error(error_status[7]);
+
+	return error_status[7];
+}
+
+/* Append an error to the event history. Constant time, safe from interrupts */
+static void log_error(unsigned char code){
+
+	unsigned char ien;
+	ERROR_EVENT *event;
+
+	ien=IEN;
+	IEN=0;
+
+	/* The same error again: just count it */
+	event=&error_ring[(error_seq-1)&ERROR_RING_MASK];
+	if(error_seq&&(event->code==code)){
+		if(event->repeat<0xFF){
+			event->repeat++;
+		}
+	} else {
+		event=&error_ring[error_seq&ERROR_RING_MASK];
+		event->code=code;
+		event->repeat=1;
+		event->stamp=error_clock ? *error_clock : 0;
+		error_seq++;
+		if(error_kept<ERROR_RING_SIZE){
+			error_kept++;
+		}
+	}
+
+	IEN=ien;
+}
+
+/* Write error to CAN message */
+void write_error_CAN(CAN_MSG_TYPE *can_msg){
+
+	can_msg->len = 8;	
+
+	memcpy(can_msg->data,&error_status,7);
+	can_msg->data[7]=error_status[7];
+
+}
+
+/* Clear error status (the event history is kept) */
+void clear_error(void){
+	memcpy(error_status,"\0\0\0\0\0\0\0\0",8);
+}
+
+/* Use a counter of the application to timestamp the events */
+void set_error_clock(volatile unsigned long *clock){
+	error_clock=clock;
+}
+
+/* Write the event at the cursor to CAN message and move the cursor on.
+   Payload: sequence number (2 bytes), code, repeat count and timestamp (4 bytes),
+   MSB first. Gaps in the sequence numbers are events overwritten before they
+   were read. With no new event the code and repeat count are 0 */
+void read_error_CAN(CAN_MSG_TYPE *can_msg){
+
+	unsigned char ien;
+	unsigned int seq;
+	ERROR_EVENT event;
+
+	ien=IEN;
+	IEN=0;
+
+	/* Skip what was already overwritten */
+	if((unsigned int)(error_seq-error_cursor)>error_kept){
+		error_cursor=error_seq-error_kept;
+	}
+
+	seq=error_cursor;
+	if(seq!=error_seq){
+		event=error_ring[seq&ERROR_RING_MASK];
+		error_cursor++;
+	} else {
+		event.code=0;
+		event.repeat=0;
+		event.stamp=0;
+	}
+
+	IEN=ien;
+
+	can_msg->len = ERROR_EVENT_LEN;
+
+	put_error_event(can_msg->data,seq,&event);
+}
+
+/* Write an event as read_error_CAN sends it */
+static void put_error_event(unsigned char *data, unsigned int seq, ERROR_EVENT *event){
+	data[0]=(unsigned char)(seq>>8);
+	data[1]=(unsigned char)seq;
+	data[2]=event->code;
+	data[3]=event->repeat;
+	data[4]=(unsigned char)(event->stamp>>24);
+	data[5]=(unsigned char)(event->stamp>>16);
+	data[6]=(unsigned char)(event->stamp>>8);
+	data[7]=(unsigned char)event->stamp;
+}
+
+/* Copy len bytes from offset of the whole event history, oldest event first,
+   ERROR_EVENT_LEN bytes per event as read_error_CAN sends them. The cursor is
+   left alone. Returns the bytes copied: fewer than len past the newest event.
+   Events logged between two calls shift the history, the sequence numbers
+   show it */
+int read_error_block(unsigned long offset, unsigned char *data, unsigned char len){
+
+	unsigned char ien;
+	unsigned char cnt, pos;
+	unsigned int index;
+	unsigned char bytes[ERROR_EVENT_LEN];
+
+	ien=IEN;
+	IEN=0;
+
+	for(cnt=0;cnt<len;cnt++,offset++){
+		if(offset/ERROR_EVENT_LEN>=error_kept){
+			break;
+		}
+		index=(unsigned int)(offset/ERROR_EVENT_LEN);
+		pos=(unsigned char)(offset%ERROR_EVENT_LEN);
+		if((cnt==0)||(pos==0)){
+			put_error_event(bytes,error_seq-error_kept+index,&error_ring[(error_seq-error_kept+index)&ERROR_RING_MASK]);
+		}
+		data[cnt]=bytes[pos];
+	}
+
+	IEN=ien;
+
+	return cnt;
+}
+
+/* Control: move the cursor to the given sequence number (2 bytes, MSB first).
+   Anything older than the history goes to the oldest event kept, so 0 rewinds.
+   Monitor: the cursor and the sequence number of the next event to be logged */
+void cursor_error_CAN(CAN_MSG_TYPE *can_msg){
+
+	unsigned char ien;
+	unsigned int seq;
+
+	if(can_msg->dirn==CAN_CONTROL){
+		if(can_msg->len>=2){
+			seq=((unsigned int)can_msg->data[0]<<8)|can_msg->data[1];
+			ien=IEN;
+			IEN=0;
+			if((unsigned int)(error_seq-seq)>error_kept){
+				seq=error_seq-error_kept;
+			}
+			error_cursor=seq;
+			IEN=ien;
+		}
+		return;
+	}
+
+	can_msg->len = ERROR_CURSOR_LEN;
+
+	can_msg->data[0]=(unsigned char)(error_cursor>>8);
+	can_msg->data[1]=(unsigned char)error_cursor;
+	can_msg->data[2]=(unsigned char)(error_seq>>8);
+	can_msg->data[3]=(unsigned char)error_seq;
+}
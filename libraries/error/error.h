@@ -1,37 +1,53 @@
-#ifndef ERROR_H
-
-	#define ERROR_H
-
-	#ifndef AMB_H
-
-		/* An enum for CAN message direction */
-		typedef enum {	CAN_MONITOR,
-						CAN_CONTROL
-		} CAN_DIRN_TYPE;
-
-		/* Configuration and current data structure for CAN messages */
-		typedef struct {
-			unsigned long			relative_address;	/* CAN ID - Slave base address */
-			unsigned char			data[8];			/* Current value */
-			unsigned char			len;				/* Amount of data */
-			CAN_DIRN_TYPE	dirn;						/* Direction of message */
-		} CAN_MSG_TYPE;
-
-	#endif
-	/* Externs */
-	extern unsigned char	error_status[8];
-	
-	/* Typedefs */
-	typedef struct{
-		unsigned char		error_no;
-		unsigned char		description[4];
-	} FACILITY_ERROR_ARRAY;
-
-	/* Prototypes */
-	extern int				init_error_handler(unsigned char devices_no);
-	extern unsigned char	reg_facility(unsigned char *facility_descr, FACILITY_ERROR_ARRAY *facility_error_array);
-	extern unsigned char 	report_error(unsigned char facility_no, unsigned char error_no);
-	extern void				write_error_CAN(CAN_MSG_TYPE *can_msg);
-	extern void				clear_error(void);
-
-#endif
+#ifndef ERROR_H
+
+	#define ERROR_H
+
+	#ifndef AMB_H
+
+		/* An enum for CAN message direction */
+		typedef enum {	CAN_MONITOR,
+						CAN_CONTROL
+		} CAN_DIRN_TYPE;
+
+		/* Configuration and current data structure for CAN messages */
+		typedef struct {
+			unsigned long			relative_address;	/* CAN ID - Slave base address */
+			unsigned char			data[8];			/* Current value */
+			unsigned char			len;				/* Amount of data */
+			CAN_DIRN_TYPE	dirn;						/* Direction of message */
+		} CAN_MSG_TYPE;
+
+	#endif
+	/* Defines */
+	#define ERROR_RING_SIZE		16		/* Number of events kept (power of 2) */
+	#define ERROR_EVENT_LEN		8		/* Payload of read_error_CAN */
+	#define ERROR_CURSOR_LEN	4		/* Payload of cursor_error_CAN */
+
+	/* Externs */
+	extern unsigned char	error_status[8];
+	
+	/* Typedefs */
+	typedef struct{
+		unsigned char		error_no;
+		unsigned char		description[4];
+	} FACILITY_ERROR_ARRAY;
+
+	/* A reported error. Identical errors in a row only bump the repeat count */
+	typedef struct{
+		unsigned char		code;		/* (facility_no<<5)|(error_no&0x1F), as error_status[7] */
+		unsigned char		repeat;		/* Times it was reported in a row (stops at 255) */
+		unsigned long		stamp;		/* Clock value at the first report */
+	} ERROR_EVENT;
+
+	/* Prototypes */
+	extern int				init_error_handler(unsigned char devices_no);
+	extern unsigned char	reg_facility(unsigned char *facility_descr, FACILITY_ERROR_ARRAY *facility_error_array);
+	extern unsigned char 	report_error(unsigned char facility_no, unsigned char error_no);
+	extern void				write_error_CAN(CAN_MSG_TYPE *can_msg);
+	extern void				clear_error(void);
+	extern void				set_error_clock(volatile unsigned long *clock);
+	extern void				read_error_CAN(CAN_MSG_TYPE *can_msg);
+	extern void				cursor_error_CAN(CAN_MSG_TYPE *can_msg);
+	extern int				read_error_block(unsigned long offset, unsigned char *data, unsigned char len);
+
+#endif
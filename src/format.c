@@ -0,0 +1,384 @@
+#include <string.h>
+
+#include "format.h"
+
+/* Defines */
+#define INT_WORDS		8		// 128 bit integer part: holds every float
+#define FRAC_WORDS		10		// 160 bit fraction: holds every float down to 2^-149
+#define ALL_WORDS		(INT_WORDS+FRAC_WORDS)
+
+#define FORMAT_OK		0
+#define FORMAT_NAN		1
+#define FORMAT_INF		2
+
+/* Typedefs */
+/* A float as an exact fixed point number: integer words first, most
+   significant word first. Every float fits, so no digit is ever guessed
+   and the rounding is exact (ties to even, as the C library does) */
+typedef struct {
+	unsigned char	negative;
+	unsigned int	word[ALL_WORDS];
+} FORMAT_NUMBER;
+
+/* Prototypes */
+static unsigned char formatSplit(FORMAT_NUMBER *number, float value);
+static unsigned char formatIntDigits(FORMAT_NUMBER *number, char *digits);
+static unsigned char formatFracDigit(FORMAT_NUMBER *number);
+static unsigned char formatFracZero(FORMAT_NUMBER *number);
+static unsigned char formatRoundUp(char *digits, unsigned char count);
+static unsigned char formatSpecial(char *dest, unsigned char special, unsigned char negative, char *nan, char *inf);
+
+
+
+/* Copy a string */
+unsigned char formatString(char *dest, char *src){
+
+	/* Some locals */
+	unsigned char len = 0;
+
+	while(*src){
+		dest[len++] = *src++;
+	}
+	dest[len] = '\0';
+
+	return len;
+}
+
+
+
+/* Write an unsigned number, as "%lu" */
+unsigned char formatUnsigned(char *dest, unsigned long value){
+
+	/* Some locals */
+	char digits[10];
+	unsigned char cnt = 0;
+	unsigned char len = 0;
+
+	do {
+		digits[cnt++] = (char)(value%10);
+		value /= 10;
+	} while(value);
+
+	while(cnt){
+		dest[len++] = '0'+digits[--cnt];
+	}
+	dest[len] = '\0';
+
+	return len;
+}
+
+
+
+/* Write a float with a fixed number of decimals, right aligned in width
+   characters, as "%<width>.<decimals>f" */
+unsigned char formatFixed(char *dest, float value, unsigned char width, unsigned char decimals){
+
+	/* Some locals */
+	FORMAT_NUMBER number;
+	char digits[1+FORMAT_INT_DIGITS+FORMAT_MAX_DECIMALS];	// Room for a carry in front
+	unsigned char special, nInt, next, first, cnt, len;
+
+	if(decimals>FORMAT_MAX_DECIMALS){
+		decimals = FORMAT_MAX_DECIMALS;
+	}
+
+	special = formatSplit(&number, value);
+	if(special!=FORMAT_OK){
+		/* Right aligned as well */
+		len = (special==FORMAT_NAN) ? 3 : number.negative+3;
+		for(cnt=0;cnt+len<width;cnt++){
+			*dest++ = ' ';
+		}
+		return cnt+formatSpecial(dest, special, number.negative, "nan", "inf");
+	}
+
+	/* Integer digits ("0" if none) and decimals */
+	nInt = formatIntDigits(&number, &digits[1]);
+	if(nInt==0){
+		digits[1] = 0;
+		nInt = 1;
+	}
+	for(cnt=0;cnt<decimals;cnt++){
+		digits[1+nInt+cnt] = formatFracDigit(&number);
+	}
+
+	/* Round on the rest */
+	first = 1;
+	next = formatFracDigit(&number);
+	if((next>5)||((next==5)&&(!formatFracZero(&number)||(digits[nInt+decimals]&1)))){
+		if(formatRoundUp(&digits[1], nInt+decimals)){
+			digits[0] = 1;
+			first = 0;
+			nInt++;
+		}
+	}
+
+	/* Right align */
+	len = number.negative+nInt+(decimals ? decimals+1 : 0);
+	for(cnt=0;cnt+len<width;cnt++){
+		*dest++ = ' ';
+	}
+	len = cnt;
+
+	if(number.negative){
+		dest[0] = '-';
+	}
+	cnt = number.negative;
+
+	while(nInt--){
+		dest[cnt++] = '0'+digits[first++];
+	}
+	if(decimals){
+		dest[cnt++] = '.';
+		while(decimals--){
+			dest[cnt++] = '0'+digits[first++];
+		}
+	}
+	dest[cnt] = '\0';
+
+	return len+cnt;
+}
+
+
+
+/* Write a float in exponent notation, as "%.<decimals>E" */
+unsigned char formatExp(char *dest, float value, unsigned char decimals){
+
+	/* Some locals */
+	FORMAT_NUMBER number;
+	char digits[FORMAT_INT_DIGITS];
+	char mantissa[1+FORMAT_MAX_DECIMALS];
+	unsigned char special, nInt, next, sticky, cnt, len;
+	int exponent;
+
+	if(decimals>FORMAT_MAX_DECIMALS){
+		decimals = FORMAT_MAX_DECIMALS;
+	}
+
+	special = formatSplit(&number, value);
+	if(special!=FORMAT_OK){
+		return formatSpecial(dest, special, number.negative, "NAN", "INF");
+	}
+
+	/* Pick decimals+1 significant digits, the next one and whether any other follows */
+	nInt = formatIntDigits(&number, digits);
+	if(nInt){
+		exponent = nInt-1;
+		for(cnt=0;cnt<=decimals;cnt++){
+			mantissa[cnt] = (cnt<nInt) ? digits[cnt] : formatFracDigit(&number);
+		}
+		next = (cnt<nInt) ? digits[cnt++] : formatFracDigit(&number);
+		sticky = !formatFracZero(&number);
+		while(cnt<nInt){
+			sticky |= digits[cnt++];
+		}
+	} else if(formatFracZero(&number)){
+		exponent = 0;
+		for(cnt=0;cnt<=decimals;cnt++){
+			mantissa[cnt] = 0;
+		}
+		next = 0;
+		sticky = 0;
+	} else {
+		exponent = -1;
+		while((mantissa[0] = formatFracDigit(&number))==0){
+			exponent--;
+		}
+		for(cnt=1;cnt<=decimals;cnt++){
+			mantissa[cnt] = formatFracDigit(&number);
+		}
+		next = formatFracDigit(&number);
+		sticky = !formatFracZero(&number);
+	}
+
+	/* Round, 9.99 going to 1.00 with the next exponent */
+	if((next>5)||((next==5)&&(sticky||(mantissa[decimals]&1)))){
+		if(formatRoundUp(mantissa, decimals+1)){
+			mantissa[0] = 1;
+			exponent++;
+		}
+	}
+
+	len = 0;
+	if(number.negative){
+		dest[len++] = '-';
+	}
+	dest[len++] = '0'+mantissa[0];
+	if(decimals){
+		dest[len++] = '.';
+		for(cnt=1;cnt<=decimals;cnt++){
+			dest[len++] = '0'+mantissa[cnt];
+		}
+	}
+
+	/* At least two exponent digits */
+	dest[len++] = 'E';
+	if(exponent<0){
+		dest[len++] = '-';
+		exponent = -exponent;
+	} else {
+		dest[len++] = '+';
+	}
+	if(exponent<10){
+		dest[len++] = '0';
+	}
+	len += formatUnsigned(&dest[len], (unsigned long)exponent);
+
+	return len;
+}
+
+
+
+/* Turn an IEEE single precision float into an exact fixed point number */
+static unsigned char formatSplit(FORMAT_NUMBER *number, float value){
+
+	/* Some locals */
+	union {
+		float			flt_val;
+		unsigned long	ulng_val;
+	} bits;
+	unsigned long mantissa;
+	int exponent, pos;
+	unsigned char cnt;
+
+	bits.flt_val = value;
+	number->negative = (bits.ulng_val&0x80000000L) ? 1 : 0;
+	exponent = (int)((bits.ulng_val>>23)&0xFF);
+	mantissa = bits.ulng_val&0x007FFFFFL;
+
+	if(exponent==0xFF){
+		return mantissa ? FORMAT_NAN : FORMAT_INF;
+	}
+
+	/* Denormals have no hidden bit */
+	if(exponent==0){
+		exponent = 1;
+	} else {
+		mantissa |= 0x00800000L;
+	}
+
+	/* value = mantissa * 2^(exponent-150): bit 0 of the mantissa lands
+	   FRAC_WORDS*16+exponent-150 bits above the least significant bit */
+	memset(number->word, 0, sizeof(number->word));
+	pos = FRAC_WORDS*16+exponent-150;
+	for(cnt=0;cnt<24;cnt++,pos++){
+		if(mantissa&(1L<<cnt)){
+			number->word[ALL_WORDS-1-(pos>>4)] |= (unsigned int)1<<(pos&0x0F);
+		}
+	}
+
+	return FORMAT_OK;
+}
+
+
+
+/* Get the digits of the integer part, most significant first. Returns
+   their number (0 if the integer part is 0). The integer part is consumed */
+static unsigned char formatIntDigits(FORMAT_NUMBER *number, char *digits){
+
+	/* Some locals */
+	unsigned long part;
+	unsigned char top, cnt, len;
+	char tmp;
+
+	/* Skip the leading zero words */
+	for(top=0;(top<INT_WORDS)&&(number->word[top]==0);top++);
+
+	len = 0;
+	while(top<INT_WORDS){
+
+		/* Divide by 10, the remainder is the next digit */
+		part = 0;
+		for(cnt=top;cnt<INT_WORDS;cnt++){
+			part = (part<<16)|number->word[cnt];
+			number->word[cnt] = (unsigned int)(part/10);
+			part %= 10;
+		}
+		digits[len++] = (char)part;
+
+		if(number->word[top]==0){
+			top++;
+		}
+	}
+
+	/* They came least significant first */
+	for(cnt=0;cnt<len/2;cnt++){
+		tmp = digits[cnt];
+		digits[cnt] = digits[len-1-cnt];
+		digits[len-1-cnt] = tmp;
+	}
+
+	return len;
+}
+
+
+
+/* Get the next decimal of the fraction */
+static unsigned char formatFracDigit(FORMAT_NUMBER *number){
+
+	/* Some locals */
+	unsigned long part;
+	unsigned char cnt;
+
+	/* Multiply by 10, what goes over the point is the digit */
+	part = 0;
+	for(cnt=ALL_WORDS;cnt>INT_WORDS;cnt--){
+		part += 10L*number->word[cnt-1];
+		number->word[cnt-1] = (unsigned int)(part&0xFFFF);
+		part >>= 16;
+	}
+
+	return (unsigned char)part;
+}
+
+
+
+/* Check if nothing is left of the fraction */
+static unsigned char formatFracZero(FORMAT_NUMBER *number){
+
+	/* Some locals */
+	unsigned char cnt;
+
+	for(cnt=INT_WORDS;cnt<ALL_WORDS;cnt++){
+		if(number->word[cnt]){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+
+/* Add one to the last digit. Returns 1 if it carried out of the first one */
+static unsigned char formatRoundUp(char *digits, unsigned char count){
+
+	while(count--){
+		if(digits[count]<9){
+			digits[count]++;
+			return 0;
+		}
+		digits[count] = 0;
+	}
+
+	return 1;
+}
+
+
+
+/* Write not-a-number and infinity */
+static unsigned char formatSpecial(char *dest, unsigned char special, unsigned char negative, char *nan, char *inf){
+
+	/* Some locals */
+	unsigned char len = 0;
+
+	if(special==FORMAT_NAN){
+		return formatString(dest, nan);
+	}
+
+	if(negative){
+		dest[len++] = '-';
+	}
+
+	return len+formatString(&dest[len], inf);
+}
@@ -0,0 +1,18 @@
+#ifndef _FORMAT_H
+
+	#define _FORMAT_H
+
+	/* Defines */
+	#define FORMAT_MAX_DECIMALS		6		// Most decimals formatFixed and formatExp will print
+	#define FORMAT_INT_DIGITS		39		// Digits in the integer part of the largest float
+
+	/* Prototypes */
+	/* Externs */
+	/* All the functions write straight into dest, add a NUL and return the
+	   number of characters written (NUL excluded) */
+	extern unsigned char formatString(char *dest, char *src);
+	extern unsigned char formatUnsigned(char *dest, unsigned long value);
+	extern unsigned char formatFixed(char *dest, float value, unsigned char width, unsigned char decimals);	// As "%<width>.<decimals>f"
+	extern unsigned char formatExp(char *dest, float value, unsigned char decimals);	// As "%.<decimals>E"
+
+#endif /* _FORMAT_H */
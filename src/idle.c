@@ -0,0 +1,189 @@
+#include <reg167.h>
+#include <intrins.h>
+
+#include "..\..\libraries\amb\amb.h"
+#include "idle.h"
+#include "timebase.h"
+#include "profile.h"
+
+/* Defines */
+#define IDLE_US_PER_SECOND		1000000L	// Sleep is timed with the timebase clock
+
+/* Static */
+static unsigned char volatile idleEvents;		// IDLE_WAKE_xxx set since the last idleAwake
+static unsigned long idleCanSeen;				// CAN transactions at the last idleAwake
+static unsigned char idleSlept;					// The last idleWait put the CPU to sleep (1:yes)
+
+static unsigned long volatile idleSleep;		// Microseconds asleep in the current second
+static unsigned int volatile idleCount[IDLE_SOURCES];		// Wakeups in the current second
+static unsigned int volatile idleLastCount[IDLE_SOURCES];	// Wakeups in the last second
+static unsigned int volatile idleFraction;		// Time asleep in the last second
+static unsigned long volatile idleTotal;		// Wakeups since startup
+
+
+
+/* Clear the statistics */
+void idleInit(void){
+
+	/* Some locals */
+	unsigned char source;
+
+	idleEvents = 0;
+	amb_get_num_transactions(&idleCanSeen);
+	idleSlept = 0;
+
+	idleSleep = 0;
+	for(source=0;source<IDLE_SOURCES;source++){
+		idleCount[source] = 0;
+		idleLastCount[source] = 0;
+	}
+	idleFraction = 0;
+	idleTotal = 0;
+
+}
+
+
+
+/* Note an event for the main loop. The interrupt itself wakes the CPU up:
+   the event keeps the main loop from going back to sleep before serving it */
+void idleWake(unsigned char event){
+
+	idleEvents |= event;
+
+}
+
+
+
+/* Take the events that woke the CPU up and count the wakeup by source. The
+   second counter must not clear the counts halfway through */
+void idleAwake(void){
+
+	/* Some locals */
+	unsigned char events, ien;
+	unsigned long transactions;
+
+	ien = IEN;
+	IEN = 0;
+
+	events = idleEvents;
+	idleEvents = 0;
+
+	amb_get_num_transactions(&transactions);
+	if(transactions!=idleCanSeen){
+		events |= IDLE_WAKE_CAN;
+		idleCanSeen = transactions;
+	}
+
+	/* A wakeup may have more than one source */
+	if(idleSlept){
+		idleSlept = 0;
+		if(events&IDLE_WAKE_TIMER){
+			idleCount[IDLE_SOURCE_TIMER]++;
+		}
+		if(events&IDLE_WAKE_SERIAL){
+			idleCount[IDLE_SOURCE_SERIAL]++;
+		}
+		if(events&IDLE_WAKE_CAN){
+			idleCount[IDLE_SOURCE_CAN]++;
+		}
+		if(!events){
+			idleCount[IDLE_SOURCE_OTHER]++;
+		}
+		idleTotal++;
+	}
+
+	IEN = ien;
+
+}
+
+
+
+/* Sleep until the next interrupt, unless an event arrived since idleAwake */
+void idleWait(void){
+
+	/* Some locals */
+	unsigned char ien;
+	unsigned long transactions, start, sleep;
+
+	/* With interrupts disabled a request still ends the idle mode, but it
+	   is only served once they are enabled again: one that comes between
+	   the check and the IDLE instruction cannot be missed */
+	ien = IEN;
+	IEN = 0;
+
+	amb_get_num_transactions(&transactions);
+	if(idleEvents||(transactions!=idleCanSeen)){
+		IEN = ien;
+		return;
+	}
+
+	start = timebaseMicros();
+	_idle_();
+	sleep = timebaseMicros()-start;
+
+	/* Accounted before the waking interrupt runs: a wakeup by the second
+	   counter still counts in the second that just ended */
+	idleSleep += sleep;
+	profileIdleAdd(sleep*1000/PROFILE_TICK_NS);
+	idleSlept = 1;
+
+	IEN = ien;
+
+}
+
+
+
+/* Close the statistics of the last second */
+void idleSecond(void){
+
+	/* Some locals */
+	unsigned char source;
+	unsigned long fraction;
+
+	fraction = idleSleep/(IDLE_US_PER_SECOND/IDLE_FRACTION_FULL);
+	idleSleep = 0;
+	idleFraction = (fraction<IDLE_FRACTION_FULL) ? (unsigned int)fraction : IDLE_FRACTION_FULL;
+
+	for(source=0;source<IDLE_SOURCES;source++){
+		idleLastCount[source] = idleCount[source];
+		idleCount[source] = 0;
+	}
+
+}
+
+
+
+/* Time asleep in the last second in hundredths of percent */
+unsigned int idleGetFraction(void){
+
+	return idleFraction;
+}
+
+
+
+/* Wakeups from a source in the last second */
+unsigned int idleGetWakeups(unsigned char source){
+
+	if(source>=IDLE_SOURCES){
+		return 0;
+	}
+
+	return idleLastCount[source];
+}
+
+
+
+/* Wakeups since startup */
+unsigned long idleGetTotalWakeups(void){
+
+	/* Some locals */
+	unsigned long total;
+	unsigned char ien;
+
+	ien = IEN;
+	IEN = 0;
+	total = idleTotal;
+	IEN = ien;
+
+	return total;
+}
@@ -0,0 +1,35 @@
+#ifndef _IDLE_H
+
+	#define _IDLE_H
+
+	/* Defines */
+	#define IDLE_FRACTION_FULL	10000	// Idle fraction of a second fully spent asleep (hundredths of percent)
+
+	/* Wake events, set by the interrupts that bring work to the main loop */
+	#define IDLE_WAKE_TIMER		0x01	// Second counter or point sampling (timebase, T4)
+	#define IDLE_WAKE_SERIAL	0x02	// RS232 character received or transmit queue drained
+	#define IDLE_WAKE_CAN		0x04	// CAN transaction completed (found from the slave library)
+
+	/* Wakeup sources, as counted */
+	#define IDLE_SOURCE_TIMER	0
+	#define IDLE_SOURCE_SERIAL	1
+	#define IDLE_SOURCE_CAN		2
+	#define IDLE_SOURCE_OTHER	3		// Any other interrupt (1-Wire, journal, identify)
+	#define IDLE_SOURCES		4
+
+	/* Prototypes */
+	/* Externs */
+	/* The main loop calls idleAwake before its tasks and idleWait after
+	   them. idleWait puts the CPU in idle mode unless an event arrived
+	   while the tasks were running. Peripherals and PEC transfers go on
+	   in idle mode; any interrupt wakes the CPU up */
+	extern void idleInit(void);
+	extern void idleWake(unsigned char event);	// Call from the interrupts (IDLE_WAKE_xxx)
+	extern void idleAwake(void);
+	extern void idleWait(void);
+	extern void idleSecond(void);				// Call once per second (timer interrupt)
+	extern unsigned int idleGetFraction(void);	// Last second asleep, hundredths of percent
+	extern unsigned int idleGetWakeups(unsigned char source);	// Last second
+	extern unsigned long idleGetTotalWakeups(void);
+
+#endif /* _IDLE_H */
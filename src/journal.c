@@ -0,0 +1,212 @@
+#include <reg167.h>
+#include <intrins.h>
+
+#include "journal.h"
+#include "timebase.h"
+
+/* Defines */
+#define JOURNAL_MASK		(JOURNAL_SIZE-1)
+
+/* Port 2 bit masks of the journaled lines */
+#define PRES_ALARM_MASK		0x0001	// Pressure alarm (0:error) => Invert in firmware
+#define TEMP_ALARM_MASK		0x0004	// Temperature alarm (0:error) => Invert in firmware
+#define DRIVE_IND_MASK		0x0010	// Drive indicator (1:on)
+#define FAULT_STAT_MASK		0x0800	// Fault status (1:error)
+
+/* Static */
+static JOURNAL_EVENT journal[JOURNAL_SIZE];
+
+static unsigned char volatile journalHead;		// Written only by the capture interrupts
+static unsigned char volatile journalTail;		// Written only by the reader (CAN interrupt)
+static unsigned int volatile journalSeq;
+static unsigned int volatile journalLost;
+static unsigned int volatile journalCount[JOURNAL_LINES];
+
+/* Prototypes */
+static void journalStore(unsigned char line, unsigned int capture, unsigned char level);
+
+
+
+/* Initialize the edge capture journal. The timebase must be running */
+void journalInit(void){
+
+	journalClear();
+
+	/* Capture on both edges, timestamp taken from the timebase timer T1 */
+	CCM0 = (CCM0 & 0xF0F0) | 0x0B0B;	/* CC0 (P2.0) and CC2 (P2.2) */
+	CCM1 = (CCM1 & 0xFFF0) | 0x000B;	/* CC4 (P2.4) */
+	CCM2 = (CCM2 & 0x0FFF) | 0xB000;	/* CC11 (P2.11) */
+
+	/* Set interrupts */
+	CC0IC = 0x0068;		/* SET CAPTURE INTERRUPTS:
+							- ILVL = 10
+							- GLVL = 0 to 3 */
+	CC2IC = 0x0069;
+	CC4IC = 0x006A;
+	CC11IC = 0x006B;
+
+}
+
+
+
+/* Get the oldest event from the journal. Returns 0 if the journal is empty */
+unsigned char journalRead(JOURNAL_EVENT *event){
+
+	if(journalTail == journalHead){
+		return 0;
+	}
+
+	*event = journal[journalTail & JOURNAL_MASK];
+	journalTail++;
+
+	return 1;
+}
+
+
+
+/* Copy bytes of the pending events, oldest first, as journalPut writes them.
+   The events stay in the journal. Returns the bytes copied: fewer than len
+   past the last event */
+unsigned char journalReadBlock(unsigned long offset, unsigned char *data, unsigned char len){
+
+	unsigned char ien;
+	unsigned char cnt, pos;
+	unsigned long index;
+	unsigned char bytes[JOURNAL_EVENT_LEN];
+
+	/* The capture interrupts must not move the head meanwhile */
+	ien = IEN;
+	IEN = 0;
+
+	for(cnt=0;cnt<len;cnt++,offset++){
+		index = offset/JOURNAL_EVENT_LEN;
+		if(index >= (unsigned char)(journalHead - journalTail)){
+			break;
+		}
+		pos = (unsigned char)(offset%JOURNAL_EVENT_LEN);
+		if((cnt==0)||(pos==0)){
+			journalPut(bytes, &journal[(journalTail + (unsigned char)index) & JOURNAL_MASK]);
+		}
+		data[cnt] = bytes[pos];
+	}
+
+	IEN = ien;
+
+	return cnt;
+}
+
+
+
+/* Write an event in JOURNAL_EVENT_LEN bytes, MSB first: line, level,
+   sequence number (2) and capture time (4) */
+void journalPut(unsigned char *dest, JOURNAL_EVENT *event){
+
+	dest[0] = event->line;
+	dest[1] = event->level;
+	dest[2] = (unsigned char)(event->seq>>8);
+	dest[3] = (unsigned char)(event->seq);
+	dest[4] = (unsigned char)(event->stamp>>24);
+	dest[5] = (unsigned char)(event->stamp>>16);
+	dest[6] = (unsigned char)(event->stamp>>8);
+	dest[7] = (unsigned char)(event->stamp);
+}
+
+
+
+/* Get the number of edges seen on a line */
+unsigned int journalGetCount(unsigned char line){
+
+	if(line >= JOURNAL_LINES){
+		return 0;
+	}
+
+	return journalCount[line];
+}
+
+
+
+/* Get the number of events waiting to be read */
+unsigned char journalGetPending(void){
+	return (unsigned char)(journalHead - journalTail);
+}
+
+
+
+/* Get the number of events dropped because the journal was full */
+unsigned int journalGetLost(void){
+	return journalLost;
+}
+
+
+
+/* Discard all the events and clear the counters */
+void journalClear(void){
+
+	unsigned char cnt;
+
+	journalTail = journalHead;
+	journalSeq = 0;
+	journalLost = 0;
+
+	for(cnt=0;cnt<JOURNAL_LINES;cnt++){
+		journalCount[cnt] = 0;
+	}
+}
+
+
+
+/* Store one captured edge */
+static void journalStore(unsigned char line, unsigned int capture, unsigned char level){
+
+	unsigned long now;
+	JOURNAL_EVENT *event;
+
+	journalCount[line]++;
+
+	/* Rebuild the capture time from the current time */
+	now = timebaseCapture(capture);
+
+	/* Journal full: drop the event */
+	if((unsigned char)(journalHead - journalTail) >= JOURNAL_SIZE){
+		journalSeq++;
+		journalLost++;
+		return;
+	}
+
+	event = &journal[journalHead & JOURNAL_MASK];
+	event->line = line;
+	event->level = level;
+	event->seq = journalSeq++;
+	event->stamp = now;
+
+	/* Publish the event */
+	journalHead++;
+}
+
+
+
+/* Pressure alarm edge */
+void journalCC0Irq(void) interrupt CC0INT = 0x10 {
+	journalStore(JOURNAL_PRES_ALARM, CC0, (P2 & PRES_ALARM_MASK) ? 0 : 1);
+}
+
+
+
+/* Temperature alarm edge */
+void journalCC2Irq(void) interrupt CC2INT = 0x12 {
+	journalStore(JOURNAL_TEMP_ALARM, CC2, (P2 & TEMP_ALARM_MASK) ? 0 : 1);
+}
+
+
+
+/* Drive indicator edge */
+void journalCC4Irq(void) interrupt CC4INT = 0x14 {
+	journalStore(JOURNAL_DRIVE_IND, CC4, (P2 & DRIVE_IND_MASK) ? 1 : 0);
+}
+
+
+
+/* Fault status edge */
+void journalCC11Irq(void) interrupt CC11INT = 0x1B {
+	journalStore(JOURNAL_FAULT_STAT, CC11, (P2 & FAULT_STAT_MASK) ? 1 : 0);
+}
@@ -0,0 +1,41 @@
+#ifndef _JOURNAL_H
+
+	#define _JOURNAL_H
+
+	/* Defines */
+	#define JOURNAL_SIZE		32		// Number of events in the ring buffer (power of 2, max 128)
+
+	/* Journaled lines */
+	#define JOURNAL_PRES_ALARM	0		// P2.0  (CC0IO)  - Pressure alarm
+	#define JOURNAL_TEMP_ALARM	1		// P2.2  (CC2IO)  - Temperature alarm
+	#define JOURNAL_DRIVE_IND	2		// P2.4  (CC4IO)  - Drive indicator
+	#define JOURNAL_FAULT_STAT	3		// P2.11 (CC11IO) - Fault status
+	#define JOURNAL_LINES		4		// Number of journaled lines
+
+	#define JOURNAL_NO_EVENT	0xFF	// Line number returned when the journal is empty
+	#define JOURNAL_EVENT_LEN	8		// Bytes of an event written by journalPut
+
+	/* Timestamp resolution */
+	#define JOURNAL_TICK_NS		1000	// Lower 32 bits of the timebase clock (microseconds)
+
+	/* Typedefs */
+	/* A single captured edge */
+	typedef struct {
+		unsigned char	line;		// Line that changed (JOURNAL_xxx)
+		unsigned char	level;		// Logic level after the edge (1:alarm/on/error)
+		unsigned int	seq;		// Running event number (gaps show lost events)
+		unsigned long	stamp;		// Capture time in JOURNAL_TICK_NS units
+	} JOURNAL_EVENT;
+
+	/* Prototypes */
+	/* Externs */
+	extern void journalInit(void);
+	extern unsigned char journalRead(JOURNAL_EVENT *event);
+	extern unsigned char journalReadBlock(unsigned long offset, unsigned char *data, unsigned char len);	// Pending events, not removed
+	extern void journalPut(unsigned char *dest, JOURNAL_EVENT *event);
+	extern unsigned int journalGetCount(unsigned char line);
+	extern unsigned char journalGetPending(void);
+	extern unsigned int journalGetLost(void);
+	extern void journalClear(void);
+
+#endif /* _JOURNAL_H */
@@ -1,1255 +1,3044 @@
-/****************************************************************************
- # $Id: main.c,v 1.7 2011/03/02 19:35:09 avaccari Exp $
- #
- # Copyright (C) 1999
- # Associated Universities, Inc. Washington DC, USA.
- #
- # Correspondence concerning ALMA should be addressed as follows:
- #        Internet email: mmaswgrp@nrao.edu
- ****************************************************************************
- *
- *  MAIN.C 
- *
- *  Slave node implementation for ALMA compressor monitor and control.
- *
- *	Revision history
- *
- *	2011-02-28
- *	Rev. 2.0.1
- *	- Lowered interrupt priority for the second counter and the internal 
- *	  monitoring. They are now placed lower than CAN not just in GLVL but
- *	  also in ILVL. This will assure CAN can interrupt them both in case
- *    of arbitration.
- *
- *	2011-02-21c
- *  Rev. 2.0.0
- *  - Updated to comply with CMC module rev.B mounting rev.C PCB
- *  - Implemented Sumitomo timing requirements for hardware operation
- *	- Modified for continuous hardware monitoring
- *	- Modified to allow data on FE cryogenics to be pushed
- *
- *  2008-03-05
- *  Rev. 1.0.1
- *  - Fixed mapping of analog channels 
- *  - Changed scaling for pressure
- *  - Inverted logic for drive readout
- * 
- *  2007-09-19
- *  Rev. 1.0.0
- *  First version ready for debugging.
- *
- ****************************************************************************
- */
-
-/* Uses serial port */
-#include <reg167.h>
-#include <stdio.h>
-#include <string.h>
-
-/* include library interface */
-#include "..\..\libraries\amb\amb.h"
-#include "..\..\libraries\ds1820\ds1820.h"
-#include "..\..\libraries\onboard_adc\onboard_adc.h"
-#include "serial.h"
-
-/*** Defines ****/
-#define USE_48MS	0	// Defines if the 48ms pulse is used to trigger the correponding interrupt
-						// If yes then P8.0 will not be available for use as a normal I/O pin since
- 					    // it will receive the 48ms pulse.
-
-/* General defines */
-#define HIGH	1
-#define LOW		0
-
-/* Serial message defines */
-#define SIZE_OF_SERIAL_MESSAGE	80
-
-/* Revision Level Defines */
-#define	MAJOR	2
-#define MINOR	0
-#define PATCH	1
-
-/** RCAs **/
-/* Monitor */
-#define FIRST_MONITOR_RCA				0x00001
-#define GET_TEMP_1						0x00001
-#define GET_TEMP_2						0x00002
-#define GET_TEMP_3						0x00003
-#define GET_TEMP_4						0x00004
-#define GET_RET_PRESSURE				0x00005
-#define GET_AUX_2						0x00006
-#define GET_PRESSURE					0x00007
-#define GET_PRESSURE_ALARM				0x00008
-#define GET_TEMP_ALARM					0x00009
-#define GET_DRIVE_INDICATION			0x0000A
-#define GET_ICCU_STATUS					0x0000B
-#define GET_ICCU_CABLE_DETECT			0x0000C
-#define GET_FETIM_STATUS				0x0000D
-#define GET_FETIM_CABLE					0x0000E
-#define GET_INTERLOCK_OVERRIDE			0x0000F
-#define GET_ECU_TYPE					0x00010
-#define GET_FAULT_STATUS				0x00011
-#define GET_SW_REVISION_LEVEL			0x00012
-#define GET_TIME_SINCE_LAST_POWER_ON	0x00013
-#define GET_TIME_SINCE_LAST_POWER_OFF	0x00014
-#define LAST_MONITOR_RCA				0x00014
-/* Control */
-#define FIRST_CONTROL_RCA					0x01001
-#define SET_REMOTE_DRIVE					0x01001
-#define SET_REMOTE_RESET					0x01002
-#define SET_FAULT_LATCH_RESET				0x01003
-#define SET_PUSH_4K_CRYOCOOLER_TEMP			0x01004
-#define SET_PUSH_15K_CRYOCOOLER_TEMP		0x01005
-#define SET_PUSH_110K_CRYOCOOLER_TEMP		0x01006
-#define SET_PUSH_PORT_PRESSURE				0x01007
-#define SET_PUSH_DEWAR_PRESSURE				0x01008
-#define SET_PUSH_GATE_VALVE_STATE			0x01009
-#define SET_PUSH_SOLENOID_VALVE_STATE		0x0100A
-#define SET_PUSH_BACKING_PUMP_ENABLE		0x0100B
-#define SET_PUSH_TURBO_PUMP_ENABLE			0x0100C
-#define SET_PUSH_TURBO_PUMP_STATE			0x0100D
-#define SET_PUSH_TURBO_PUMP_SPEED			0x0100E
-#define SET_PUSH_CRYO_SUPPLY_CURRENT_230V	0x0100F
-#define SET_BYPASS_TIMERS					0x02000
-#define LAST_CONTROL_RCA					0x02000
-
-/* General */
-#define BYTE_LEN				1
-#define REVISION_LEN			3
-#define FLOAT_LEN				4
-#define ULONG_LEN				4
-
-/* Analog monitor channels defines */
-#define CH_T1		8	// 0->5V => -30->60C
-#define CH_T2		9	// 0->5V => -30->60C
-#define CH_T3		10	// 0->5V => -30->60C
-#define	CH_T4		11	// 0->5V => -30->60C
-#define CH_RET_PRES	12	// 0->5V => 0->300psi
-#define CH_AUX2		13	// 0->5V
-#define CH_PRESS	14	// 0->5V => 0->300psi
-
-
-
-
-/* Analog conversion factors defines */
-#define TEMP(V)		((18.0*(V))-30.0)
-#define AUX(V)		(V)
-#define PRESSURE(V)	((V<1.0)?(-1.0):(V-1.0))
-
-/* Timer values */
-#define REMOTE_DRIVE_ON_TIME	180L	// Seconds the compressor has to stay ON
-#define REMOTE_DRIVE_OFF_TIME	420L	// Seconds the compressor has to stay OFF
-
-
-/* Macros */
-
-#define REMOTE_ON_SEC(time)			(time-lastOnSec)
-#define REMOTE_OFF_SEC(time)		(time-lastOffSec)
-#define REMOTE_ON_MIN(time)			((ubyte)((time-lastOnSec)/60))
-#define REMOTE_OFF_MIN(time)		((ubyte)((time-lastOffSec)/60))
-#define REMOTE_ON_OK(time)			(((time-lastOffSec)>REMOTE_DRIVE_OFF_TIME)?HIGH:LOW)
-#define REMOTE_OFF_OK(time)			(((time-lastOnSec)>REMOTE_DRIVE_ON_TIME)?HIGH:LOW)
-
-#define INVERT(IO)					((IO == LOW) ? HIGH : LOW)	// Invert I/O signals
-
-#define VALVE_STATE(state)			((state==0)?"Closed":((state==1)?"Opened":((state==2)?"Unknown":"Error")))
-
-/* Special register defines */
-/* Port 2 */
-/* P2.0 */
-#define PRES_ALARM			P2^0	// Pressure alarm (0:error) => Invert in fimrware
-#define PRES_ALARM_DP		DP2		// Port for pressure alarm
-#define	PRES_ALARM_MASK 	0x0001	// Bit mask for pressure alarm
-/* P2.2 */
-#define TEMP_ALARM			P2^2	// Temperature alarm (0:error) => Invert in firmware
-#define TEMP_ALARM_DP		DP2		// Port for temperature alarm
-#define	TEMP_ALARM_MASK 	0x0004	// Bit mask for temperature alarm
-/* P2.4 */
-#define DRIVE_IND			P2^4	// Drive indicator (1:on)
-#define DRIVE_IND_DP		DP2		// Port for drive indicator
-#define	DRIVE_IND_MASK 		0x0010	// Bit mask for drive indicator
-/* P2.5 */ 
-#define ICCU_STATUS			P2^5	// ICCU status (0:error) => Invert in firmware
-#define ICCU_STATUS_DP		DP2		// Port for ICCU status
-#define ICCU_STATUS_MASK	0x0020	// Bit mask for ICCU status
-/* P2.6 */
-#define ICCU_CABLE			P2^6	// ICCU cable detect (1:error)
-#define ICCU_CABLE_DP		DP2		// Port for ICCU cable detect
-#define ICCU_CABLE_MASK		0x0040	// Bit mask for ICCU cable detect
-/* P2.7 */
-#define FETIM_STATUS		P2^7	// FETIM status (0:error) => Invert in firmware
-#define FETIM_STATUS_DP		DP2		// Port for FETIM status
-#define FETIM_STATUS_MASK	0x0080	// Bit mask for FETIM status
-/* P2.8 */
-#define FETIM_CABLE			P2^8	// FETIM cable detect (0:error) => Invert in fimrware
-#define FETIM_CABLE_DP		DP2		// Port for FETIM cable detect
-#define FETIM_CABLE_MASK	0x0100	// Bit mask for FETIM cable detect
-/* P2.9 */
-#define INTRLK_OVRD			P2^9	// Interlock override (1:enabled)
-#define INTRLK_OVRD_DP		DP2		// Port for interlock override
-#define INTRLK_OVRD_MASK	0x0200	// Bit mask for interlock override
-/* P2.10 */
-#define ECU_TYPE			P2^10	// ECU type (0:EU, 1:Jap)
-#define ECU_TYPE_DP			DP2		// Port for ECU type
-#define ECU_TYPE_MASK		0x0400	// Bit mask for ECU type
-/* P2.11 */
-#define FAULT_STAT			P2^11	// Fault status (1:error)
-#define FAULT_STAT_DP		DP2		// Port for fault status
-#define FAULT_STAT_MASK		0x0800	// Bit mask for fault status
-
-/* Port 7 */
-/* P7.0 */
-#define REMOTE_DRV			P7^0	// Remote drive (1:on)
-#define REMOTE_DRV_DP		DP7		// Port for remote drive
-#define	REMOTE_DRV_MASK 	0x01	// Bit mask for remote drive
-/* P7.1 */
-#define FAULT_RST			P7^1	// Fault latch reset (Pulse high)
-#define FAULT_RST_DP		DP7		// Port for fault latch reset
-#define FAULT_RST_MASK		0x02	// Bit mask for fault latch reset
-
-/* Port 8 */
-/* P8.0 */
-#define REMOTE_RST			P8^0	// Remote reset (Pulse high)
-#define REMOTE_RST_DP		DP8		// Port for remote reset
-#define	REMOTE_RST_MASK 	0x01	// Bit mask for remote reset
-
-
-
-
-
-
-/* Special function registers */
-/* Read */
-sbit pAlarm = PRES_ALARM;	// Pressure alarm
-sbit tAlarm = TEMP_ALARM;	// Temperature alarm
-sbit drvInd = DRIVE_IND;	// Drive indicator
-sbit iccuSt = ICCU_STATUS;	// ICCU status
-sbit iccuCb = ICCU_CABLE;	// ICCU cable
-sbit fetimS = FETIM_STATUS;	// FETIM status
-sbit fetimC = FETIM_CABLE;	// FETIM cable
-sbit intOvr = INTRLK_OVRD;	// Interlock override
-sbit ecuTyp = ECU_TYPE;		// ECU type
-sbit faultS = FAULT_STAT;	// Fault status
-/* Write */
-sbit rmtDrv	= REMOTE_DRV;	// Remote drive
-sbit fltRst = FAULT_RST;	// Fault latch reset
-sbit rmtRst	= REMOTE_RST;	// Remote reset
-/* External bus control signal buffer chip enable is on P4.7 */
-sbit DISABLE_EX_BUF	= P4^7;
-
-
-
-/* Set aside memory for the callbacks in the AMB library */
-static CALLBACK_STRUCT cb_memory[3];
-
-
-
-
-/* Typedefs */
-/* A union for conversion float <-> 4 bytes */
-typedef union {
-	float flt_val;
-	ubyte chr_val[4];
-	ulong ulng_val;
-} CONVERSION;
-
-/* A structure to hold single elements of data */
-typedef struct {
-	CONVERSION	data;
-	ulong		time;
-} DATA;
-
-/* enum to address compressor data */
-typedef enum {
-	comp_temp1,
-	comp_temp2,
-	comp_temp3,
-	comp_temp4,
-	comp_ret_pres,
-	comp_aux2,
-	comp_sup_pres,
-	comp_pres_alarm,
-	comp_temp_alarm,
-	comp_drive_ind,
-	comp_iccu_stat,
-	comp_iccu_cable,
-	comp_fetim_stat,
-	comp_fetim_cable,
-	comp_intrlk_ovrd,
-	comp_ecu_type,
-	comp_fault_stat,
-	comp_sw_rev,
-	comp_time_on,
-	comp_time_off,
-
-	comp_min_item=comp_temp1,
-	comp_max_item=comp_time_off
-} COMP_ITEMS;
-
-/* enum to address cryostat data */
-typedef enum {
-	cryo_temp_4k,
-	cryo_temp_15k,
-	cryo_temp_110k,
-	cryo_pres_port,
-	cryo_pres_dewar,
-	cryo_gate_state,
-	cryo_sole_state,
-	cryo_back_ena,
-	cryo_turb_ena,
-	cryo_turb_sta,
-	cryo_turb_spe,
-	cryo_sup_curr,
-	
-	cryo_min_item=cryo_temp_4k,
-	cryo_max_item=cryo_sup_curr
-} CRYO_ITEMS;
-
-/* A structure to hold the available data */
-typedef struct {
-	DATA	comp_data[comp_max_item+1];
-	DATA	cryo_data[cryo_max_item+1];
-} STATUS;	
-
-/* An enum to define the possible data types */
-typedef enum {
-	chr_val,
-	flt_val,
-	rev_val,
-	tim_val,
-	exp_val
-} DATA_TYPE;
-
-
-
-/* Prototypes */
-void GPT1_vInit(void);
-void GPT1_viTmr3(void);
-void GPT1_viTmr4(void);
-ubyte *buildMessage(ubyte *text, DATA *data, ubyte *units, DATA_TYPE type);
-
-
-/* CAN message callbacks */
-int ambient_msg(CAN_MSG_TYPE *message);  /* Called to get DS1820 temperature */
-int monitor_msg(CAN_MSG_TYPE *message);  /* Called to get monitor messages */
-int control_msg(CAN_MSG_TYPE *message);  /* Called to set control messages */
-
-
-
-
-
-
-
-
-
-
-/*** Globals ***/
-/* A global containing the current status info */
-volatile STATUS idata status;
-
-/* A global for conversion of float */
-CONVERSION idata conv;
-
-/* A global for the last read temperature */
-ubyte ambient_temp_data[4];
-
-/* A couple of globals to keep track of last sent messages */
-ubyte lastRemoteDrive = LOW;
-ubyte lastRemoteReset = LOW;
-ubyte lastFaultLatchReset = LOW;
-ubyte lastBypassTimers = LOW;
-
-/* Second counters (look at defined macros before changing the names) */
-volatile ulong idata lastOnSec = 0x00000000;
-volatile ulong idata lastOffSec = 0x00000000;
-volatile ulong idata timerSec = 0x00000000;
-
-ubyte bypassTimers = 0; // Used for troubleshooting the unit when not connected to compressor
-
-
-
-
-
-
-/* Main */
-void main(void) {
-
-	/* A counter */
-	ubyte cnt;
-
-	/* A variable to keep track of time betwen RS232 messages */
-	ulong lastMessageTime = timerSec;
-
-	if(USE_48MS){
-		// Setup the CAPCOM2 unit to receive the 48ms pulse from the Xilinx
-		P8&=0xFE; // Set value of P8.0 to 0
-		DP8&=0xFE; // Set INPUT direction for P8.0
-		CCM4&=0xFFF0; // Clear setup for CCMOD16
-		CCM4|=0x0001; // Set CCMOD16 to trigger on rising edge
-		CC16IC=0x0078; // Interrupt: ILVL=14, GLVL=0;
-	}
-
-
-
-
-	/* Make sure that external bus control signal buffer is disabled */
-	DP4 |= 0x01;
-	DISABLE_EX_BUF = HIGH;
-
-
-
-
-	/* Initialize the slave library */
-	if (amb_init_slave((void *) cb_memory) != 0) 
-		return;
-
-	/* Register callbacks for CAN events */
-	if (amb_register_function(0x30003, 0x30003, ambient_msg) != 0)
-		return;
-	
-	/* Register monitor callbacks */
-	if (amb_register_function(FIRST_MONITOR_RCA, LAST_MONITOR_RCA, monitor_msg) !=0)
-		return;
-
-	/* Register control callbacks */
-	if (amb_register_function(FIRST_CONTROL_RCA, LAST_CONTROL_RCA, control_msg) !=0)
-		return;
-
-
-
-	/* Initialize control lines */
-	rmtDrv = LOW; 	// Compressor off
-	rmtRst = LOW;	// Reset line default to low. It needs an high pulse to reset the compressor.
-
-	/* Fault latch reset is idle low. It needs an high pulse to reset the compressor. */
-	fltRst = HIGH;	
-	fltRst = LOW;
-
-
-
-
-	/* Port direction initialization */
-	/* Write (set corresponding port direction bits to 1) */
-	REMOTE_RST_DP |= REMOTE_RST_MASK;
-	REMOTE_DRV_DP |= REMOTE_DRV_MASK;
-	FAULT_RST_DP |= FAULT_RST_MASK;
-	
-	/* Read (set corresponding port direction bits to 0) */
-	PRES_ALARM_DP &= ~PRES_ALARM_MASK;
-	TEMP_ALARM_DP &= ~TEMP_ALARM_MASK;
-	DRIVE_IND_DP &= ~DRIVE_IND_MASK;
-	ICCU_STATUS_DP &= ~ICCU_STATUS_MASK;
-	ICCU_CABLE_DP &= ~ICCU_CABLE_MASK;
-	FETIM_STATUS_DP &= ~FETIM_STATUS_MASK;
-	FETIM_CABLE_DP &= ~FETIM_CABLE_MASK;
-	INTRLK_OVRD_DP &= ~INTRLK_OVRD_MASK;
-	ECU_TYPE_DP	&= ~ECU_TYPE_MASK;
-	FAULT_STAT_DP &= ~FAULT_STAT_MASK;
-
-
-
-
-	/* Initialize modules */
-	adc_init(0,0,0,0); // ADC initialization
-	GPT1_vInit(); // Timer initialization (GPT1, Core T3 and aux T2)
-	serialInit('\0'); // Serial interface (termination is only required when receiving)
-	
-
-
-
-	/* globally enable interrupts */
-  	amb_start();
-
-
-
-	/* Start timers */
-	T3R = 1; // timer 3 run bit is set
-	T4R = 1; // timer 4 run bit is set
-
-
-	/* Never return */
-	while (1){
-		/* Read the DS1820 when nothing else occurs */
-		ds1820_get_temp(&ambient_temp_data[1], &ambient_temp_data[0], &ambient_temp_data[2], &ambient_temp_data[3]);
-
-		/* Write compressor data to RS232 */
-		for(cnt=comp_min_item;cnt<comp_max_item+1;cnt++){
-
-			/* Wait 3 second before sending next message */
-			while((timerSec-lastMessageTime)<3){};
-
-			/* Wait for serial port to be done transmitting */
-			while((*serialGetStatus())&SER_TX_BUSY){};
-
-			switch(cnt){
-				case comp_temp1:
-					serialWrite(buildMessage("Temperature 1",&status.comp_data[cnt],"C",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_temp2:
-					serialWrite(buildMessage("Temperature 2",&status.comp_data[cnt],"C",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_temp3:
-					serialWrite(buildMessage("Temperature 3",&status.comp_data[cnt],"C",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_temp4:
-					serialWrite(buildMessage("Temperature 4",&status.comp_data[cnt],"C",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_ret_pres:
-					serialWrite(buildMessage("Return Pressure",&status.comp_data[cnt],"MPa",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_aux2:
-					serialWrite(buildMessage("Aux Input 2",&status.comp_data[cnt],"V",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_sup_pres:
-					serialWrite(buildMessage("Supply Pressure",&status.comp_data[cnt],"MPa",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_pres_alarm:
-					serialWrite(buildMessage("Pressure Alarm",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Alarm":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_temp_alarm:
-					serialWrite(buildMessage("Temperature Alarm",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Alarm":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_drive_ind:
-					serialWrite(buildMessage("Drive Indicator",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"On":"Off",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_iccu_stat:
-					serialWrite(buildMessage("ICCU Status",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Error":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_iccu_cable:
-					serialWrite(buildMessage("ICCU Cable",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Error":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_fetim_stat:
-					serialWrite(buildMessage("FETIM Status",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Error":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_fetim_cable:
-					serialWrite(buildMessage("FETIM Cable",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Error":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_intrlk_ovrd:
-					serialWrite(buildMessage("Interlock Override",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Engaged":"Off",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_ecu_type:
-					serialWrite(buildMessage("ECU Type",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Japanese":"European",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_fault_stat:
-					serialWrite(buildMessage("Compressor Fault",&status.comp_data[cnt],status.comp_data[cnt].data.chr_val[0]?"Error":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_sw_rev:
-					serialWrite(buildMessage("Software Revision",&status.comp_data[cnt],"",rev_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_time_on:
-					serialWrite(buildMessage("Time since last ON",&status.comp_data[cnt],"min",tim_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case comp_time_off:
-					serialWrite(buildMessage("Time since last OFF",&status.comp_data[cnt],"min",tim_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				default:
-					break;
-			}
-
-		lastMessageTime=timerSec;
-	
-		}
-
-					
-		/* Write cryostat (from FEMC) data to RS232 */
-		for(cnt=cryo_min_item;cnt<cryo_max_item+1;cnt++){
-
-			/* Wait 3 second before sending next message */
-			while((timerSec-lastMessageTime)<3){};
-
-			/* Wait for serial port to be done transmitting */
-			while((*serialGetStatus())&SER_TX_BUSY){};
-
-			switch(cnt){
-				case cryo_temp_4k:
-					serialWrite(buildMessage("4K stage",&status.cryo_data[cnt],"K",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_temp_15k:
-					serialWrite(buildMessage("15K stage",&status.cryo_data[cnt],"K",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_temp_110k:
-					serialWrite(buildMessage("110K stage",&status.cryo_data[cnt],"K",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_pres_port:
-					serialWrite(buildMessage("Port Pressure",&status.cryo_data[cnt],"mbar",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_pres_dewar:
-					serialWrite(buildMessage("Dewar Pressure",&status.cryo_data[cnt],"mbar",exp_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_gate_state:
-					serialWrite(buildMessage("Gate Valve",&status.cryo_data[cnt],VALVE_STATE(status.cryo_data[cnt].data.chr_val[0]),chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_sole_state:
-					serialWrite(buildMessage("Solenoid Valve",&status.cryo_data[cnt],VALVE_STATE(status.cryo_data[cnt].data.chr_val[0]),chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_back_ena:
-					serialWrite(buildMessage("Backing Pump",&status.cryo_data[cnt],status.cryo_data[cnt].data.chr_val[0]?"On":"Off",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_turb_ena:
-					serialWrite(buildMessage("Turbo Pump",&status.cryo_data[cnt],status.cryo_data[cnt].data.chr_val[0]?"On":"Off",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_turb_sta:
-					serialWrite(buildMessage("Turbo Pump Status",&status.cryo_data[cnt],status.cryo_data[cnt].data.chr_val[0]?"Error":"Ok",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_turb_spe:
-					serialWrite(buildMessage("Turbo Pump Speed",&status.cryo_data[cnt],status.cryo_data[cnt].data.chr_val[0]?"Up to speed":"Low",chr_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-				case cryo_sup_curr:
-					serialWrite(buildMessage("FE 230V Current",&status.cryo_data[cnt],"A",flt_val),SIZE_OF_SERIAL_MESSAGE);
-					break;
-
-				default:
-					break;
-			}
-
-		lastMessageTime=timerSec;
-	
-		}
-
-
-	}
-}
-
-
-
-/* Buil the serial message and returns a pointer to it */
-ubyte *buildMessage(ubyte *text, DATA *data, ubyte *units, DATA_TYPE type){
-
-	/* A static buffer */
-	static ubyte idata message[SIZE_OF_SERIAL_MESSAGE];
-
-	/* Some locals */
-	ubyte	ageOfData;
-
-	/* Clear message */
-	memset(message,'\0',SIZE_OF_SERIAL_MESSAGE);
-	
-	ageOfData = (timerSec - data->time)/60;
-	
-	if(ageOfData>=255){
-		ageOfData=255;
-	}
-
-	switch(type){
-		case chr_val:
-			sprintf(message,"%s\r\nValue: %u %s\r\nAge: %u min\r\n\r\n",text,data->data.chr_val[0],units,ageOfData);
-			break;
-		case flt_val:
-			sprintf(message,"%s\r\nValue: %5.2f %s\r\nAge: %u min\r\n\r\n",text,data->data.flt_val,units,ageOfData);
-			break;
-		case exp_val:
-			sprintf(message,"%s\r\nValue: %5.2E %s\r\nAge: %u min\r\n\r\n",text,data->data.flt_val,units,ageOfData);
-			break;
-		case rev_val:
-			sprintf(message,"%s\r\nValue: %u.%u.%u %s\r\nAge: %u min\r\n\r\n",text,data->data.chr_val[0],data->data.chr_val[1],data->data.chr_val[2],units,ageOfData);
-			break;
-		case tim_val:
-			sprintf(message,"%s\r\nValue: %lu %s\r\nAge: %u min\r\n\r\n",text,(data->data.ulng_val/60),units,ageOfData);
-			break;
-		default:
-			break;
-	}	
-
-	return message;
-
-}
-
-
-
-/* Temperature request messages */
-int ambient_msg(CAN_MSG_TYPE *message) {
-
-	if (message->dirn == CAN_MONITOR) {  /* Should only be a monitor requests */
-		message->len = 4;
-		message->data[0] = ambient_temp_data[0];
-		message->data[1] = ambient_temp_data[1];
-		message->data[2] = ambient_temp_data[2];
-		message->data[3] = ambient_temp_data[3];
-	} 
-
-	return 0;
-}
-
-
-
-
-
-
-
-/* Monitor requests */
-int monitor_msg(CAN_MSG_TYPE *message) {
-
-	/* If it is a control message on monitor RCA, do nothing. */
-	if(message->dirn==CAN_CONTROL){
-		return 0;
-	}
-
-	/* Perform the monitor operation */
-	switch(message->relative_address){
-		case GET_TEMP_1:
-			message->data[0] = status.comp_data[comp_temp1].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_temp1].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_temp1].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_temp1].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_TEMP_2:
-			message->data[0] = status.comp_data[comp_temp2].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_temp2].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_temp2].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_temp2].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_TEMP_3:
-			message->data[0] = status.comp_data[comp_temp3].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_temp3].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_temp3].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_temp3].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_TEMP_4:
-			message->data[0] = status.comp_data[comp_temp4].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_temp4].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_temp4].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_temp4].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_RET_PRESSURE:
-			message->data[0] = status.comp_data[comp_ret_pres].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_ret_pres].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_ret_pres].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_ret_pres].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_AUX_2:
-			message->data[0] = status.comp_data[comp_aux2].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_aux2].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_aux2].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_aux2].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_PRESSURE:
-			message->data[0] = status.comp_data[comp_sup_pres].data.chr_val[3];
-			message->data[1] = status.comp_data[comp_sup_pres].data.chr_val[2];
-			message->data[2] = status.comp_data[comp_sup_pres].data.chr_val[1];
-			message->data[3] = status.comp_data[comp_sup_pres].data.chr_val[0];
-			message->len = FLOAT_LEN;
-			break;
-
-		case GET_PRESSURE_ALARM:
-			message->data[0] = status.comp_data[comp_pres_alarm].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break; 
-
-		case GET_TEMP_ALARM:
-			message->data[0] = status.comp_data[comp_temp_alarm].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break; 
-
-		case GET_DRIVE_INDICATION:
-			message->data[0] = status.comp_data[comp_drive_ind].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_ICCU_STATUS:
-			message->data[0] = status.comp_data[comp_iccu_stat].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_ICCU_CABLE_DETECT:
-			message->data[0] = status.comp_data[comp_iccu_cable].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_FETIM_STATUS:
-			message->data[0] = status.comp_data[comp_fetim_stat].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_FETIM_CABLE:
-			message->data[0] = status.comp_data[comp_fetim_cable].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_INTERLOCK_OVERRIDE:
-			message->data[0] = status.comp_data[comp_intrlk_ovrd].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_ECU_TYPE:
-			message->data[0] = status.comp_data[comp_ecu_type].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_FAULT_STATUS:
-			message->data[0] = status.comp_data[comp_fault_stat].data.chr_val[0];
-			message->len = BYTE_LEN;
-			break;
-
-		case GET_SW_REVISION_LEVEL:
-			message->data[0] = status.comp_data[comp_sw_rev].data.chr_val[0];
-			message->data[1] = status.comp_data[comp_sw_rev].data.chr_val[1];
-			message->data[2] = status.comp_data[comp_sw_rev].data.chr_val[2];
-			message->len = REVISION_LEN;
-			break;
-
-		case GET_TIME_SINCE_LAST_POWER_ON:
-			if(REMOTE_OFF_OK(timerSec)){
-				message->data[0] = 0xFF;
-				message->data[1] = 0xFF;
-				message->data[2] = 0xFF;
-				message->data[3] = 0xFF;
-			} else {
-				message->data[0] = status.comp_data[comp_time_on].data.chr_val[3];
-				message->data[1] = status.comp_data[comp_time_on].data.chr_val[2];
-				message->data[2] = status.comp_data[comp_time_on].data.chr_val[1];
-				message->data[3] = status.comp_data[comp_time_on].data.chr_val[0];
-			}
-			message->len = ULONG_LEN;
-			break;
-
-		case GET_TIME_SINCE_LAST_POWER_OFF:
-			if(REMOTE_ON_OK(timerSec)){
-				message->data[0] = 0xFF;
-				message->data[1] = 0xFF;
-				message->data[2] = 0xFF;
-				message->data[3] = 0xFF;
-			} else {
-				message->data[0] = status.comp_data[comp_time_off].data.chr_val[3];
-				message->data[1] = status.comp_data[comp_time_off].data.chr_val[2];
-				message->data[2] = status.comp_data[comp_time_off].data.chr_val[1];
-				message->data[3] = status.comp_data[comp_time_off].data.chr_val[0];
-			}
-			message->len = ULONG_LEN;
-			break;
-
-		default:
-			break;
-	}
-
-	return 0;
-}
-
-
-
-
-
-
-
-
-
-/* Control requests */
-int control_msg(CAN_MSG_TYPE *message) {
-
-	if(message->dirn==CAN_CONTROL){ // If control on control RCA
-		switch(message->relative_address){
-			case SET_REMOTE_DRIVE:
-				switch(message->data[0]){
-					case LOW:
-						if(bypassTimers||((rmtDrv==HIGH)&&REMOTE_OFF_OK(timerSec))){
-							rmtDrv = LOW;
-							lastOffSec=timerSec;
-						}
-						break;
-					case HIGH:
-						if(bypassTimers||((rmtDrv==LOW)&&REMOTE_ON_OK(timerSec))){
-							rmtDrv = HIGH;
-							lastOnSec=timerSec;
-						}
-						break;
-					default:
-						break;
-				}
-				lastRemoteDrive = message->data[0];
-				break;
-
-			case SET_REMOTE_RESET:
-				/* Generate a high pulse */
-				rmtRst = HIGH;
-				rmtRst = LOW;
-				lastRemoteReset = message->data[0];
-				break;
-
-			case SET_FAULT_LATCH_RESET:
-				/* Generate a high pulse */
-				fltRst = HIGH;
-				fltRst = LOW;
-				lastFaultLatchReset = message->data[0];
-				break;
-
-			case SET_PUSH_4K_CRYOCOOLER_TEMP:
-				status.cryo_data[cryo_temp_4k].data.chr_val[0]=message->data[3];
-				status.cryo_data[cryo_temp_4k].data.chr_val[1]=message->data[2];
-				status.cryo_data[cryo_temp_4k].data.chr_val[2]=message->data[1];
-				status.cryo_data[cryo_temp_4k].data.chr_val[3]=message->data[0];
-				status.cryo_data[cryo_temp_4k].time=timerSec;
-				break;
-
-			case SET_PUSH_15K_CRYOCOOLER_TEMP:
-				status.cryo_data[cryo_temp_15k].data.chr_val[0]=message->data[3];
-				status.cryo_data[cryo_temp_15k].data.chr_val[1]=message->data[2];
-				status.cryo_data[cryo_temp_15k].data.chr_val[2]=message->data[1];
-				status.cryo_data[cryo_temp_15k].data.chr_val[3]=message->data[0];
-				status.cryo_data[cryo_temp_15k].time=timerSec;
-				break;
-
-			case SET_PUSH_110K_CRYOCOOLER_TEMP:
-				status.cryo_data[cryo_temp_110k].data.chr_val[0]=message->data[3];
-				status.cryo_data[cryo_temp_110k].data.chr_val[1]=message->data[2];
-				status.cryo_data[cryo_temp_110k].data.chr_val[2]=message->data[1];
-				status.cryo_data[cryo_temp_110k].data.chr_val[3]=message->data[0];
-				status.cryo_data[cryo_temp_110k].time=timerSec;
-				break;
-
-			case SET_PUSH_PORT_PRESSURE:
-				status.cryo_data[cryo_pres_port].data.chr_val[0]=message->data[3];
-				status.cryo_data[cryo_pres_port].data.chr_val[1]=message->data[2];
-				status.cryo_data[cryo_pres_port].data.chr_val[2]=message->data[1];
-				status.cryo_data[cryo_pres_port].data.chr_val[3]=message->data[0];
-				status.cryo_data[cryo_pres_port].time=timerSec;
-				break;
-
-			case SET_PUSH_DEWAR_PRESSURE:
-				status.cryo_data[cryo_pres_dewar].data.chr_val[0]=message->data[3];
-				status.cryo_data[cryo_pres_dewar].data.chr_val[1]=message->data[2];
-				status.cryo_data[cryo_pres_dewar].data.chr_val[2]=message->data[1];
-				status.cryo_data[cryo_pres_dewar].data.chr_val[3]=message->data[0];
-				status.cryo_data[cryo_pres_dewar].time=timerSec;
-				break;
-
-			case SET_PUSH_GATE_VALVE_STATE:
-				status.cryo_data[cryo_gate_state].data.chr_val[0]=message->data[0];
-				status.cryo_data[cryo_gate_state].time=timerSec;
-				break;
-
-			case SET_PUSH_SOLENOID_VALVE_STATE:
-				status.cryo_data[cryo_sole_state].data.chr_val[0]=message->data[0];
-				status.cryo_data[cryo_sole_state].time=timerSec;
-				break;
-
-			case SET_PUSH_BACKING_PUMP_ENABLE:
-				status.cryo_data[cryo_back_ena].data.chr_val[0]=message->data[0];
-				status.cryo_data[cryo_back_ena].time=timerSec;
-				break;
-
-			case SET_PUSH_TURBO_PUMP_ENABLE:
-				status.cryo_data[cryo_turb_ena].data.chr_val[0]=message->data[0];
-				status.cryo_data[cryo_turb_ena].time=timerSec;
-				break;
-
-			case SET_PUSH_TURBO_PUMP_STATE:
-				status.cryo_data[cryo_turb_sta].data.chr_val[0]=message->data[0];
-				status.cryo_data[cryo_turb_sta].time=timerSec;
-				break;
-
-			case SET_PUSH_TURBO_PUMP_SPEED:
-				status.cryo_data[cryo_turb_spe].data.chr_val[0]=message->data[0];
-				status.cryo_data[cryo_turb_spe].time=timerSec;
-				break;
-
-			case SET_PUSH_CRYO_SUPPLY_CURRENT_230V:
-				status.cryo_data[cryo_sup_curr].data.chr_val[0]=message->data[3];
-				status.cryo_data[cryo_sup_curr].data.chr_val[1]=message->data[2];
-				status.cryo_data[cryo_sup_curr].data.chr_val[2]=message->data[1];
-				status.cryo_data[cryo_sup_curr].data.chr_val[3]=message->data[0];
-				status.cryo_data[cryo_sup_curr].time=timerSec;
-				break;
-
-			/* For troubleshooting use only RCA 0x2000 */
-			case SET_BYPASS_TIMERS:
-				bypassTimers = message->data[0];
-				lastBypassTimers = message->data[0];
-				break;
-
-
-			default:
-				break;
-		}
-	} else { // If monitor on control RCA
-		switch(message->relative_address){
-			case SET_REMOTE_DRIVE:
-				message->data[0] = lastRemoteDrive;
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_REMOTE_RESET:
-				message->data[0] = lastRemoteReset;
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_FAULT_LATCH_RESET:
-				message->data[0] = lastFaultLatchReset;
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_4K_CRYOCOOLER_TEMP:
-				message->data[3]=status.cryo_data[cryo_temp_4k].data.chr_val[0];
-				message->data[2]=status.cryo_data[cryo_temp_4k].data.chr_val[1];
-				message->data[1]=status.cryo_data[cryo_temp_4k].data.chr_val[2];
-				message->data[0]=status.cryo_data[cryo_temp_4k].data.chr_val[3];
-				message->len = FLOAT_LEN;
-				break;
-
-			case SET_PUSH_15K_CRYOCOOLER_TEMP:
-				message->data[3]=status.cryo_data[cryo_temp_15k].data.chr_val[0];
-				message->data[2]=status.cryo_data[cryo_temp_15k].data.chr_val[1];
-				message->data[1]=status.cryo_data[cryo_temp_15k].data.chr_val[2];
-				message->data[0]=status.cryo_data[cryo_temp_15k].data.chr_val[3];
-				message->len = FLOAT_LEN;
-				break;
-
-			case SET_PUSH_110K_CRYOCOOLER_TEMP:
-				message->data[3]=status.cryo_data[cryo_temp_110k].data.chr_val[0];
-				message->data[2]=status.cryo_data[cryo_temp_110k].data.chr_val[1];
-				message->data[1]=status.cryo_data[cryo_temp_110k].data.chr_val[2];
-				message->data[0]=status.cryo_data[cryo_temp_110k].data.chr_val[3];
-				message->len = FLOAT_LEN;
-				break;
-
-			case SET_PUSH_PORT_PRESSURE:
-				message->data[3]=status.cryo_data[cryo_pres_port].data.chr_val[0];
-				message->data[2]=status.cryo_data[cryo_pres_port].data.chr_val[1];
-				message->data[1]=status.cryo_data[cryo_pres_port].data.chr_val[2];
-				message->data[0]=status.cryo_data[cryo_pres_port].data.chr_val[3];
-				message->len = FLOAT_LEN;
-				break;
-
-			case SET_PUSH_DEWAR_PRESSURE:
-				message->data[3]=status.cryo_data[cryo_pres_dewar].data.chr_val[0];
-				message->data[2]=status.cryo_data[cryo_pres_dewar].data.chr_val[1];
-				message->data[1]=status.cryo_data[cryo_pres_dewar].data.chr_val[2];
-				message->data[0]=status.cryo_data[cryo_pres_dewar].data.chr_val[3];
-				message->len = FLOAT_LEN;
-				break;
-
-			case SET_PUSH_GATE_VALVE_STATE:
-				message->data[0]=status.cryo_data[cryo_gate_state].data.chr_val[0];
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_SOLENOID_VALVE_STATE:
-				message->data[0]=status.cryo_data[cryo_sole_state].data.chr_val[0];
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_BACKING_PUMP_ENABLE:
-				message->data[0]=status.cryo_data[cryo_back_ena].data.chr_val[0];
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_TURBO_PUMP_ENABLE:
-				message->data[0]=status.cryo_data[cryo_turb_ena].data.chr_val[0];
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_TURBO_PUMP_STATE:
-				message->data[0]=status.cryo_data[cryo_turb_sta].data.chr_val[0];
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_TURBO_PUMP_SPEED:
-				message->data[0]=status.cryo_data[cryo_turb_spe].data.chr_val[0];
-				message->len = BYTE_LEN;
-				break;
-
-			case SET_PUSH_CRYO_SUPPLY_CURRENT_230V:
-				message->data[3]=status.cryo_data[cryo_sup_curr].data.chr_val[0];
-				message->data[2]=status.cryo_data[cryo_sup_curr].data.chr_val[1];
-				message->data[1]=status.cryo_data[cryo_sup_curr].data.chr_val[2];
-				message->data[0]=status.cryo_data[cryo_sup_curr].data.chr_val[3];
-				message->len = FLOAT_LEN;
-				break;
-
-			/* For troubleshooting use only RCA 0x2000 */
-			case SET_BYPASS_TIMERS:
-				message->data[0] = lastBypassTimers;
-				break;
-
-			default: 
-				break;
-		}
-	}
-
-	return 0;
-}
-
-
-
-
-
-
-
-
-
-/* Triggers every 48ms pulse */
-void received_48ms(void) interrupt 0x30 {
-	// Put whatever you want to be execute at the 48ms clock.
-	// Remember that right now this interrupt has higher priority than the CAN.
-	// Also to be able to use the 48ms, the Xilinx has to be programmed to connect the
-	// incoming pulse on (pin31) to the cpu (pin28).
-}
-
-
-
-
-
-
-
-/* Configures Timer 3 to overflow every 1 sec */
-void GPT1_vInit(void)
-{
-  ///  -----------------------------------------------------------------------
-  ///  Configuration of the GPT1 Core Timer 3:
-  ///  -----------------------------------------------------------------------
-  ///  - timer 3 works in timer mode
-  ///  - maximum input frequency for timer 3 is 2.5 MHz
-  ///  - prescaler factor is 512
-  ///  - up/down control bit is reset
-  ///  - external up/down control is disabled
-  ///  - alternate output function T3OUT (P3.3) is disabled
-  ///  - timer 3 output toggle latch (T3OTL) is set to 0
-  ///  - timer 3 run bit is reset
-
-  T3CON          =  0x0006;      // load timer 3 control register
-  T3             =  0x676A;      // load timer 3 register
-
-  ///  -----------------------------------------------------------------------
-  ///  Configuration of the GPT1 Core Timer 4:
-  ///  -----------------------------------------------------------------------
-  ///  - timer 4 works in timer mode
-  ///  - maximum input frequency for timer 4 is 2.5 MHz
-  ///  - prescaler factor is 32
-  ///  - up/down control bit is reset
-  ///  - external up/down control is disabled
-  ///  - timer 4 run bit is reset
-
-  T4CON          =  0x0002;      // load timer 4 control register
-  T4             =  0x0000;      // load timer 4 register
-
-  ///  -----------------------------------------------------------------------
-  ///  Configuration of the used GPT1 Port Pins:
-  ///  -----------------------------------------------------------------------
-
-
-  ///  -----------------------------------------------------------------------
-  ///  Configuration of the used GPT1 Interrupts:
-  ///  -----------------------------------------------------------------------
-  ///  - timer 3 service request node configuration:
-  ///  - timer 3 interrupt priority level (ILVL) = 12
-  ///  - timer 3 interrupt group level (GLVL) = 3
-
-  T3IC           =  0x0073;     
-
-  ///  - timer 4 service request node configuration:
-  ///  - timer 4 interrupt priority level (ILVL) = 11
-  ///  - timer 4 interrupt group level (GLVL) = 3
-
-  T4IC           =  0x006F;     
-
-
-} //  End of function GPT1_vInit
-
-
-
-
-
-
-
-
-/* Triggered every time Timer 3 overflows (~1 sec) */
-void GPT1_viTmr3(void) interrupt 0x23 {
-	
-	T3 =  0x676A;      // reload timer 3 register
-	
-	/* Increase seconds timer */
-	timerSec++;
-
-} 
-
-
-
-/* Triggered every time Timer 4 overflows (~105 msec) */
-void GPT1_viTmr4(void) interrupt 0x24 {
-
-	/* A local counter for loops */
-	ubyte cnt;
-
-	/* Loop over the compressor monitor points and store the values */
-	for(cnt=comp_min_item;cnt<comp_max_item+1;cnt++){
-		switch(cnt){
-			case comp_temp1:
-				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T1));
-				break;
-			case comp_temp2:
-				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T2));
-				break;
-			case comp_temp3:
-				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T3));
-				break;
-			case comp_temp4:
-				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T4));
-				break;
-			case comp_ret_pres:
-				status.comp_data[cnt].data.flt_val = PRESSURE(get_adc_single(CH_RET_PRES));
-				break;
-			case comp_aux2:
-				status.comp_data[cnt].data.flt_val = AUX(get_adc_single(CH_AUX2));
-				break;
-			case comp_sup_pres:
-				status.comp_data[cnt].data.flt_val = PRESSURE(get_adc_single(CH_PRESS));
-				break;
-			case comp_pres_alarm:
-				status.comp_data[cnt].data.chr_val[0] = INVERT(pAlarm);
-				break;
-			case comp_temp_alarm:
-				status.comp_data[cnt].data.chr_val[0] = INVERT(tAlarm);
-				break;
-			case comp_drive_ind:
-				status.comp_data[cnt].data.chr_val[0] = drvInd;
-				break;
-			case comp_iccu_stat:
-				status.comp_data[cnt].data.chr_val[0] = INVERT(iccuSt);
-				break;
-			case comp_iccu_cable:
-				status.comp_data[cnt].data.chr_val[0] = iccuCb;
-				break;
-			case comp_fetim_stat:
-				status.comp_data[cnt].data.chr_val[0] = INVERT(fetimS);
-				break;
-			case comp_fetim_cable:
-				status.comp_data[cnt].data.chr_val[0] = INVERT(fetimC);
-				break;
-			case comp_intrlk_ovrd:
-				status.comp_data[cnt].data.chr_val[0] = intOvr;
-				break;
-			case comp_ecu_type:
-				status.comp_data[cnt].data.chr_val[0] = ecuTyp;
-				break;
-			case comp_fault_stat:
-				status.comp_data[cnt].data.chr_val[0] = faultS;
-				break;
-			case comp_sw_rev:
-				status.comp_data[cnt].data.chr_val[0] = MAJOR;
-				status.comp_data[cnt].data.chr_val[1] = MINOR;
-				status.comp_data[cnt].data.chr_val[2] = PATCH;
-				break;
-			case comp_time_on:
-				status.comp_data[cnt].data.ulng_val = REMOTE_ON_SEC(timerSec);
-				break;
-			case comp_time_off:
-				status.comp_data[cnt].data.ulng_val = REMOTE_OFF_SEC(timerSec);
-				break;
-			default:
-				break;
-		}
-
-		status.comp_data[cnt].time = timerSec; // store time info
-	}
-}
-
+/****************************************************************************
+ # $Id: main.c,v 1.7 2011/03/02 19:35:09 avaccari Exp $
+ #
+ # Copyright (C) 1999
+ # Associated Universities, Inc. Washington DC, USA.
+ #
+ # Correspondence concerning ALMA should be addressed as follows:
+ #        Internet email: mmaswgrp@nrao.edu
+ ****************************************************************************
+ *
+ *  MAIN.C 
+ *
+ *  Slave node implementation for ALMA compressor monitor and control.
+ *
+ *	Revision history
+ *
+ *	2026-10-18
+ *	Rev. 2.1.0
+ *	- Edge capture journal for the alarm and fault inputs
+ *	- 1-Wire bit engine on timer 2 interrupts, conversions scheduled in the
+ *	  background with cached and timestamped readings, table driven CRC8,
+ *	  fixed point temperatures, Search ROM for several sensors and DS18B20
+ *	  resolution setting
+ *	- RS232 binary telemetry mode, queued transmit with PEC transfers, query
+ *	  commands on receive, alarm preemption and delta only reporting, sprintf
+ *	  replaced by a fixed point formatter
+ *	- Timestamped error event history in the error library
+ *	- CAN health counters and rates, busoff recovery, identify answers in the
+ *	  slot of the node address
+ *	- Warm restart keeping timers and counters, boot phase timing and fast boot
+ *	  with the 1-Wire bus probed after CAN is up
+ *	- Stack high water marks, region profiler and CPU load
+ *	- Idle mode main loop and a monotonic timebase
+ *	- Sampling paced by the 48 ms timing event, for builds with USE_48MS=1
+ *	- Segmented transfers of the journal, error history and point directory
+ *	- Point directory describing every monitor and control point
+ *	- Monitor and control points for the above, about 40 new RCAs
+ *	- Built with AMB library 1.3.0
+ *
+ *	2011-02-28
+ *	Rev. 2.0.1
+ *	- Lowered interrupt priority for the second counter and the internal 
+ *	  monitoring. They are now placed lower than CAN not just in GLVL but
+ *	  also in ILVL. This will assure CAN can interrupt them both in case
+ *    of arbitration.
+ *
+ *	2011-02-21c
+ *  Rev. 2.0.0
+ *  - Updated to comply with CMC module rev.B mounting rev.C PCB
+ *  - Implemented Sumitomo timing requirements for hardware operation
+ *	- Modified for continuous hardware monitoring
+ *	- Modified to allow data on FE cryogenics to be pushed
+ *
+ *  2008-03-05
+ *  Rev. 1.0.1
+ *  - Fixed mapping of analog channels 
+ *  - Changed scaling for pressure
+ *  - Inverted logic for drive readout
+ * 
+ *  2007-09-19
+ *  Rev. 1.0.0
+ *  First version ready for debugging.
+ *
+ ****************************************************************************
+ */
+
+/* Uses serial port */
+#include <reg167.h>
+#include <string.h>
+
+/* include library interface */
+#include "..\..\libraries\amb\amb.h"
+#include "..\..\libraries\ds1820\ds1820.h"
+#include "..\..\libraries\onboard_adc\onboard_adc.h"
+#include "..\..\libraries\error\error.h"
+#include "serial.h"
+#include "journal.h"
+#include "format.h"
+#include "warm.h"
+#include "stack.h"
+#include "profile.h"
+#include "idle.h"
+#include "timebase.h"
+#include "te.h"
+
+/*** Defines ****/
+/* Defines if the 48ms pulse is used to trigger the correponding interrupt. The
+   pulse can only reach the cpu on P8.0 (pin28), the remote reset output, when
+   the Xilinx connects it there (from pin31). Boards programmed that way are
+   built with USE_48MS=1 in the target defines (C166, Define): P8.0 is then
+   left as an input, the remote reset (0x01002) is refused and the pulse paces
+   the sampling and trims the timebase. Otherwise P8.0 stays the remote reset
+   output and the timing event points are neither registered nor published */
+#ifndef USE_48MS
+#define USE_48MS	0
+#endif
+
+/* General defines */
+#define HIGH	1
+#define LOW		0
+
+/* Serial message defines */
+#define SIZE_OF_SERIAL_MESSAGE	80
+
+/* Serial modes */
+#define SERIAL_MODE_ASCII		0	// One text record every 3 seconds
+#define SERIAL_MODE_BINARY		1	// All the points in one framed record every serialPeriod seconds
+
+/* Binary telemetry frame: type, sequence number and time followed by the
+   value and age of every compressor and cryostat point and the ambient temperature */
+#define TELEMETRY_FRAME_TYPE	0x01
+#define TELEMETRY_POINT_SIZE	5	// Value (4 bytes MSB first) and age (minutes)
+#define TELEMETRY_FRAME_SIZE	(7+(comp_max_item+cryo_max_item+2)*TELEMETRY_POINT_SIZE+4)
+
+/* Points as numbered by the RS232 console: compressor points first, then cryostat ones */
+#define COMP_POINTS				(comp_max_item+1)
+#define ALL_POINTS				(COMP_POINTS+cryo_max_item+1)
+#define CONSOLE_REPLY_SIZE		128
+
+/* Points printed as soon as they change, ahead of the 3 seconds text cycle */
+#define ALARM_POINTS			8
+
+/* How the node last started */
+#define RESTART_POWER_ON		0	// Power on or hardware reset
+#define RESTART_COLD			1	// Device reset (0x31000): everything starts from scratch
+#define RESTART_WARM			2	// Software reset (0x31001): timers, counters and settings kept
+
+/* Boot phases, timed from the reset request (from main after a power on) */
+#define BOOT_MAIN				0	// Startup code done
+#define BOOT_PORTS				1	// Control lines and port directions set
+#define BOOT_CAN				2	// Slave library ready: CAN set up (serial number kept from before a software reset)
+#define BOOT_SERVING			3	// Callbacks registered and interrupts enabled: answering CAN
+#define BOOT_ADC				4	// Error library and ADC ready
+#define BOOT_READY				5	// Timers, RS232 and journal started: every point served but the 1-Wire ones
+#define BOOT_ONEWIRE			6	// 1-Wire bus probed: serial number and ambient points
+#define BOOT_PHASES				7
+#define BOOT_NOT_REACHED		0xFFFFFFFFL
+
+/* Revision Level Defines */
+#define	MAJOR	2
+#define MINOR	1
+#define PATCH	0
+
+/** RCAs **/
+/* Monitor */
+#define FIRST_MONITOR_RCA				0x00001
+#define GET_TEMP_1						0x00001
+#define GET_TEMP_2						0x00002
+#define GET_TEMP_3						0x00003
+#define GET_TEMP_4						0x00004
+#define GET_RET_PRESSURE				0x00005
+#define GET_AUX_2						0x00006
+#define GET_PRESSURE					0x00007
+#define GET_PRESSURE_ALARM				0x00008
+#define GET_TEMP_ALARM					0x00009
+#define GET_DRIVE_INDICATION			0x0000A
+#define GET_ICCU_STATUS					0x0000B
+#define GET_ICCU_CABLE_DETECT			0x0000C
+#define GET_FETIM_STATUS				0x0000D
+#define GET_FETIM_CABLE					0x0000E
+#define GET_INTERLOCK_OVERRIDE			0x0000F
+#define GET_ECU_TYPE					0x00010
+#define GET_FAULT_STATUS				0x00011
+#define GET_SW_REVISION_LEVEL			0x00012
+#define GET_TIME_SINCE_LAST_POWER_ON	0x00013
+#define GET_TIME_SINCE_LAST_POWER_OFF	0x00014
+#define LAST_MONITOR_RCA				0x00014
+/* Control */
+#define FIRST_CONTROL_RCA					0x01001
+#define SET_REMOTE_DRIVE					0x01001
+#define SET_REMOTE_RESET					0x01002
+#define SET_FAULT_LATCH_RESET				0x01003
+#define SET_PUSH_4K_CRYOCOOLER_TEMP			0x01004
+#define SET_PUSH_15K_CRYOCOOLER_TEMP		0x01005
+#define SET_PUSH_110K_CRYOCOOLER_TEMP		0x01006
+#define SET_PUSH_PORT_PRESSURE				0x01007
+#define SET_PUSH_DEWAR_PRESSURE				0x01008
+#define SET_PUSH_GATE_VALVE_STATE			0x01009
+#define SET_PUSH_SOLENOID_VALVE_STATE		0x0100A
+#define SET_PUSH_BACKING_PUMP_ENABLE		0x0100B
+#define SET_PUSH_TURBO_PUMP_ENABLE			0x0100C
+#define SET_PUSH_TURBO_PUMP_STATE			0x0100D
+#define SET_PUSH_TURBO_PUMP_SPEED			0x0100E
+#define SET_PUSH_CRYO_SUPPLY_CURRENT_230V	0x0100F
+#define LAST_CONTROL_RCA					0x0100F
+#define SET_BYPASS_TIMERS					0x02000	// Registered on its own: the range between holds other control RCAs
+/* Edge capture journal */
+#define FIRST_JOURNAL_MONITOR_RCA			0x00100
+#define GET_EDGE_JOURNAL					0x00100
+#define GET_EDGE_COUNTS						0x00101
+#define GET_EDGE_JOURNAL_STATUS				0x00102
+#define LAST_JOURNAL_MONITOR_RCA			0x00102
+#define SET_EDGE_JOURNAL_CLEAR				0x01100
+/* Ambient temperature (DS1820) */
+#define GET_AMBIENT_TEMP					0x30003
+#define FIRST_AMBIENT_MONITOR_RCA			0x00110
+#define GET_AMBIENT_AGE						0x00110
+#define GET_AMBIENT_ERRORS					0x00111
+#define GET_AMBIENT_SENSORS					0x00112
+#define GET_AMBIENT_RESOLUTION				0x00113
+#define FIRST_PROBE_TEMP					0x00120	// One per DS1820 device, on-board first
+#define LAST_PROBE_TEMP						0x00127
+#define FIRST_PROBE_ROM						0x00128	// One per DS1820 device, on-board first
+#define LAST_PROBE_ROM						0x0012F
+#define LAST_AMBIENT_MONITOR_RCA			0x0012F
+#define SET_AMBIENT_RESOLUTION				0x01110
+/* RS232 port */
+#define FIRST_SERIAL_CONTROL_RCA			0x01120
+#define SET_SERIAL_MODE						0x01120
+#define SET_SERIAL_BAUD						0x01121
+#define SET_SERIAL_PERIOD					0x01122
+#define SET_SERIAL_DELTA					0x01123
+#define LAST_SERIAL_CONTROL_RCA				0x01123
+/* Error library */
+#define FIRST_ERROR_MONITOR_RCA				0x00130
+#define GET_ERROR_STATUS					0x00130
+#define GET_ERROR_EVENT						0x00131
+#define LAST_ERROR_MONITOR_RCA				0x00131
+#define SET_ERROR_CURSOR					0x01130
+/* Restart and boot */
+#define FIRST_RESTART_MONITOR_RCA			0x00140
+#define GET_RESTART_STATUS					0x00140
+#define FIRST_BOOT_PHASE					0x00141	// One per boot phase: microseconds to reach it
+#define LAST_BOOT_PHASE						0x00147
+#define LAST_RESTART_MONITOR_RCA			0x00147
+/* Stacks */
+#define GET_STACK_USAGE						0x00150
+/* Profiler */
+#define FIRST_PROFILE_MONITOR_RCA			0x00160
+#define FIRST_PROFILE_REGION				0x00160	// One per profiled region (PROFILE_xxx)
+#define LAST_PROFILE_REGION					0x0016B
+#define GET_CPU_LOAD						0x0016F	// After the regions, with room for more
+#define LAST_PROFILE_MONITOR_RCA			0x0016F
+#define SET_PROFILE_CLEAR					0x01160
+/* Idle mode */
+#define FIRST_IDLE_MONITOR_RCA				0x00170
+#define GET_IDLE_STATUS						0x00170
+#define GET_IDLE_WAKEUPS					0x00171
+#define LAST_IDLE_MONITOR_RCA				0x00171
+/* Timing event (48ms pulse) */
+#define FIRST_TE_MONITOR_RCA				0x00180
+#define GET_TE_STATUS						0x00180
+#define GET_TE_CLOCK						0x00181
+#define GET_SAMPLE_TE						0x00182
+#define LAST_TE_MONITOR_RCA					0x00182
+#define SET_TE_PHASE						0x01180
+/* Point directory */
+#define FIRST_DIRECTORY_MONITOR_RCA			0x00190
+#define GET_DIRECTORY_STATUS				0x00190
+#define GET_DIRECTORY_ENTRY					0x00191
+#define LAST_DIRECTORY_MONITOR_RCA			0x00191
+#define SET_DIRECTORY_CURSOR				0x01190
+
+/* General */
+#define BYTE_LEN				1
+#define REVISION_LEN			3
+#define FLOAT_LEN				4
+#define ULONG_LEN				4
+#define JOURNAL_LEN				8
+#define COUNTS_LEN				8
+#define JOURNAL_STATUS_LEN		3
+#define AMBIENT_LEN				4
+#define AMBIENT_ERRORS_LEN		4
+#define PROBE_ROM_LEN			8
+#define SERIAL_BAUD_LEN			4
+#define RESTART_STATUS_LEN		7
+#define STACK_USAGE_LEN			8
+#define PROFILE_LEN				8
+#define CPU_LOAD_LEN			4
+#define IDLE_STATUS_LEN			8
+#define IDLE_WAKEUPS_LEN		8
+#define TE_STATUS_LEN			7
+#define TE_CLOCK_LEN			4
+#define SAMPLE_TE_LEN			6
+#define TE_PHASE_LEN			2
+#define ERROR_STATUS_LEN		8
+#define DIRECTORY_STATUS_LEN	7
+#define DIRECTORY_ENTRY_LEN		8
+
+/* Point directory: data types, DIR_CONTROL added for the points set by the master */
+#define DIR_MONITOR				0x00	// Read only
+#define DIR_CONTROL				0x80	// Set by the master, read back with a monitor request
+#define DIR_BYTE				0x01	// Unsigned byte (flags, states and settings)
+#define DIR_UWORD				0x02	// Unsigned 16 bit, MSB first
+#define DIR_ULONG				0x03	// Unsigned 32 bit, MSB first
+#define DIR_FLOAT				0x04	// IEEE 754 single, MSB first
+#define DIR_REVISION			0x05	// Major, minor and patch
+#define DIR_RECORD				0x06	// Several fields, described with the RCA
+
+/* Point directory: units */
+#define DIR_NO_UNIT				0
+#define DIR_CELSIUS				1
+#define DIR_KELVIN				2
+#define DIR_MPA					3
+#define DIR_MBAR				4
+#define DIR_VOLT				5
+#define DIR_AMPERE				6
+#define DIR_SECOND				7
+#define DIR_MICROSECOND			8
+
+/* Point directory: tenths of a second between updates */
+#define DIR_ON_READ				0		// Computed when read, or set by the master
+#define DIR_SAMPLED				((ubyte)(SAMPLE_TICKS*TIMEBASE_TICK_US/100000L))	// Compressor points (T4 interrupt)
+#define DIR_EVERY_SECOND		10
+#define DIR_AMBIENT				((ubyte)(10*AMBIENT_PERIOD))	// DS1820 conversions (1 second in fast mode)
+
+#define DIR_ENTRIES				47		// Entries in pointDirectory
+
+/* Analog monitor channels defines */
+#define CH_T1		8	// 0->5V => -30->60C
+#define CH_T2		9	// 0->5V => -30->60C
+#define CH_T3		10	// 0->5V => -30->60C
+#define	CH_T4		11	// 0->5V => -30->60C
+#define CH_RET_PRES	12	// 0->5V => 0->300psi
+#define CH_AUX2		13	// 0->5V
+#define CH_PRESS	14	// 0->5V => 0->300psi
+
+
+
+
+/* Analog conversion factors defines */
+#define TEMP(V)		((18.0*(V))-30.0)
+#define AUX(V)		(V)
+#define PRESSURE(V)	((V<1.0)?(-1.0):(V-1.0))
+
+/* Timer values */
+#define REMOTE_DRIVE_ON_TIME	180L	// Seconds the compressor has to stay ON
+#define REMOTE_DRIVE_OFF_TIME	420L	// Seconds the compressor has to stay OFF
+#define AMBIENT_PERIOD			5L		// Seconds between DS1820 conversions
+#define AMBIENT_PERIOD_FAST		1L		// Seconds between conversions with all the DS18B20s at 9 or 10 bits
+#define SERIAL_PERIOD			1		// Default seconds between binary telemetry frames
+#define SAMPLE_TICKS			2		// Timebase ticks between samplings of the compressor points (100 msec)
+
+
+/* Macros */
+
+#define REMOTE_ON_SEC(time)			(time-lastOnSec)
+#define REMOTE_OFF_SEC(time)		(time-lastOffSec)
+#define REMOTE_ON_MIN(time)			((ubyte)((time-lastOnSec)/60))
+#define REMOTE_OFF_MIN(time)		((ubyte)((time-lastOffSec)/60))
+#define REMOTE_ON_OK(time)			(((time-lastOffSec)>REMOTE_DRIVE_OFF_TIME)?HIGH:LOW)
+#define REMOTE_OFF_OK(time)			(((time-lastOnSec)>REMOTE_DRIVE_ON_TIME)?HIGH:LOW)
+
+#define INVERT(IO)					((IO == LOW) ? HIGH : LOW)	// Invert I/O signals
+
+#define VALVE_STATE(state)			((state==0)?"Closed":((state==1)?"Opened":((state==2)?"Unknown":"Error")))
+
+/* Special register defines */
+/* Port 2 */
+/* P2.0 */
+#define PRES_ALARM			P2^0	// Pressure alarm (0:error) => Invert in fimrware
+#define PRES_ALARM_DP		DP2		// Port for pressure alarm
+#define	PRES_ALARM_MASK 	0x0001	// Bit mask for pressure alarm
+/* P2.2 */
+#define TEMP_ALARM			P2^2	// Temperature alarm (0:error) => Invert in firmware
+#define TEMP_ALARM_DP		DP2		// Port for temperature alarm
+#define	TEMP_ALARM_MASK 	0x0004	// Bit mask for temperature alarm
+/* P2.4 */
+#define DRIVE_IND			P2^4	// Drive indicator (1:on)
+#define DRIVE_IND_DP		DP2		// Port for drive indicator
+#define	DRIVE_IND_MASK 		0x0010	// Bit mask for drive indicator
+/* P2.5 */ 
+#define ICCU_STATUS			P2^5	// ICCU status (0:error) => Invert in firmware
+#define ICCU_STATUS_DP		DP2		// Port for ICCU status
+#define ICCU_STATUS_MASK	0x0020	// Bit mask for ICCU status
+/* P2.6 */
+#define ICCU_CABLE			P2^6	// ICCU cable detect (1:error)
+#define ICCU_CABLE_DP		DP2		// Port for ICCU cable detect
+#define ICCU_CABLE_MASK		0x0040	// Bit mask for ICCU cable detect
+/* P2.7 */
+#define FETIM_STATUS		P2^7	// FETIM status (0:error) => Invert in firmware
+#define FETIM_STATUS_DP		DP2		// Port for FETIM status
+#define FETIM_STATUS_MASK	0x0080	// Bit mask for FETIM status
+/* P2.8 */
+#define FETIM_CABLE			P2^8	// FETIM cable detect (0:error) => Invert in fimrware
+#define FETIM_CABLE_DP		DP2		// Port for FETIM cable detect
+#define FETIM_CABLE_MASK	0x0100	// Bit mask for FETIM cable detect
+/* P2.9 */
+#define INTRLK_OVRD			P2^9	// Interlock override (1:enabled)
+#define INTRLK_OVRD_DP		DP2		// Port for interlock override
+#define INTRLK_OVRD_MASK	0x0200	// Bit mask for interlock override
+/* P2.10 */
+#define ECU_TYPE			P2^10	// ECU type (0:EU, 1:Jap)
+#define ECU_TYPE_DP			DP2		// Port for ECU type
+#define ECU_TYPE_MASK		0x0400	// Bit mask for ECU type
+/* P2.11 */
+#define FAULT_STAT			P2^11	// Fault status (1:error)
+#define FAULT_STAT_DP		DP2		// Port for fault status
+#define FAULT_STAT_MASK		0x0800	// Bit mask for fault status
+
+/* Port 7 */
+/* P7.0 */
+#define REMOTE_DRV			P7^0	// Remote drive (1:on)
+#define REMOTE_DRV_DP		DP7		// Port for remote drive
+#define	REMOTE_DRV_MASK 	0x01	// Bit mask for remote drive
+/* P7.1 */
+#define FAULT_RST			P7^1	// Fault latch reset (Pulse high)
+#define FAULT_RST_DP		DP7		// Port for fault latch reset
+#define FAULT_RST_MASK		0x02	// Bit mask for fault latch reset
+
+/* Port 8 */
+/* P8.0 */
+#define REMOTE_RST			P8^0	// Remote reset (Pulse high)
+#define REMOTE_RST_DP		DP8		// Port for remote reset
+#define	REMOTE_RST_MASK 	0x01	// Bit mask for remote reset
+
+
+
+
+
+
+/* Special function registers */
+/* Read */
+sbit pAlarm = PRES_ALARM;	// Pressure alarm
+sbit tAlarm = TEMP_ALARM;	// Temperature alarm
+sbit drvInd = DRIVE_IND;	// Drive indicator
+sbit iccuSt = ICCU_STATUS;	// ICCU status
+sbit iccuCb = ICCU_CABLE;	// ICCU cable
+sbit fetimS = FETIM_STATUS;	// FETIM status
+sbit fetimC = FETIM_CABLE;	// FETIM cable
+sbit intOvr = INTRLK_OVRD;	// Interlock override
+sbit ecuTyp = ECU_TYPE;		// ECU type
+sbit faultS = FAULT_STAT;	// Fault status
+/* Write */
+sbit rmtDrv	= REMOTE_DRV;	// Remote drive
+sbit fltRst = FAULT_RST;	// Fault latch reset
+sbit rmtRst	= REMOTE_RST;	// Remote reset
+/* External bus control signal buffer chip enable is on P4.7 */
+sbit DISABLE_EX_BUF	= P4^7;
+
+
+
+/* Set aside memory for the callbacks in the AMB library */
+static CALLBACK_STRUCT cb_memory[20];
+
+
+
+
+/* Typedefs */
+/* A union for conversion float <-> 4 bytes */
+typedef union {
+	float flt_val;
+	ubyte chr_val[4];
+	ulong ulng_val;
+} CONVERSION;
+
+/* A structure to hold single elements of data */
+typedef struct {
+	CONVERSION	data;
+	ulong		time;
+} DATA;
+
+/* enum to address compressor data */
+typedef enum {
+	comp_temp1,
+	comp_temp2,
+	comp_temp3,
+	comp_temp4,
+	comp_ret_pres,
+	comp_aux2,
+	comp_sup_pres,
+	comp_pres_alarm,
+	comp_temp_alarm,
+	comp_drive_ind,
+	comp_iccu_stat,
+	comp_iccu_cable,
+	comp_fetim_stat,
+	comp_fetim_cable,
+	comp_intrlk_ovrd,
+	comp_ecu_type,
+	comp_fault_stat,
+	comp_sw_rev,
+	comp_time_on,
+	comp_time_off,
+
+	comp_min_item=comp_temp1,
+	comp_max_item=comp_time_off
+} COMP_ITEMS;
+
+/* enum to address cryostat data */
+typedef enum {
+	cryo_temp_4k,
+	cryo_temp_15k,
+	cryo_temp_110k,
+	cryo_pres_port,
+	cryo_pres_dewar,
+	cryo_gate_state,
+	cryo_sole_state,
+	cryo_back_ena,
+	cryo_turb_ena,
+	cryo_turb_sta,
+	cryo_turb_spe,
+	cryo_sup_curr,
+	
+	cryo_min_item=cryo_temp_4k,
+	cryo_max_item=cryo_sup_curr
+} CRYO_ITEMS;
+
+/* A structure to hold the available data */
+typedef struct {
+	DATA	comp_data[comp_max_item+1];
+	DATA	cryo_data[cryo_max_item+1];
+} STATUS;	
+
+/* What is kept across a software reset (at most WARM_SIZE bytes) */
+typedef struct {
+	ulong			timerSec;
+	ulong			lastOnSec;
+	ulong			lastOffSec;
+	ubyte			remoteDrive;
+	ubyte			lastRemoteDrive;
+	ubyte			bypassTimers;
+	uword			ambientCrcErrors;
+	uword			ambientTimeouts;
+	ubyte			serialMode;
+	ubyte			serialPeriod;
+	ubyte			serialDelta;
+	ulong			serialBaud;
+	uword			telemetrySeq;
+	uword			warmRestarts;
+	DS1820_STATE	ds1820;
+} WARM_STATE;
+
+/* An enum to define the possible data types */
+typedef enum {
+	chr_val,
+	flt_val,
+	rev_val,
+	tim_val,
+	exp_val
+} DATA_TYPE;
+
+/* An entry of the point directory: consecutive RCAs served alike */
+typedef struct {
+	ulong	rca;		// First RCA
+	ubyte	count;		// Number of RCAs
+	ubyte	type;		// DIR_MONITOR or DIR_CONTROL, plus the data type (DIR_xxx)
+	ubyte	len;		// Bytes of a monitor reply (0: variable)
+	ubyte	units;		// Units code (DIR_xxx)
+	ubyte	period;		// Tenths of a second between updates (DIR_ON_READ: none)
+	read_or_write_func	func;	// Callback serving the RCAs
+} DIR_ENTRY;
+
+
+
+/* Prototypes */
+void GPT1_vInit(void);
+void GPT1_viTmr4(void);
+void timerTick(void);
+ulong timerSecNow(void);
+void triggerSampling(void);
+ubyte *buildMessage(ubyte *text, DATA *data, ubyte *units, DATA_TYPE type);
+ubyte *buildFrame(void);
+ubyte *pointMessage(ubyte point);
+ubyte consoleTask(void);
+ubyte alarmTask(void);
+void reportPoint(ubyte point);
+uword messageDigest(ubyte *message);
+ubyte consolePoint(char *name);
+void putPoint(ubyte *dest, DATA *data);
+ubyte ambientTask(void);
+void ambientSetPeriod(void);
+void backgroundTasks(void);
+ubyte loadWarmState(void);
+void saveWarmState(ubyte warm);
+void bootMark(ubyte phase);
+ubyte bootBusy(CAN_MSG_TYPE *message);
+void directoryInit(void);
+void directoryPut(ubyte *dest, ubyte entry);
+
+
+/* CAN message callbacks */
+int ambient_msg(CAN_MSG_TYPE *message);  /* Called to get DS1820 temperature and status */
+int monitor_msg(CAN_MSG_TYPE *message);  /* Called to get monitor messages */
+int control_msg(CAN_MSG_TYPE *message);  /* Called to set control messages */
+int journal_msg(CAN_MSG_TYPE *message);  /* Called to access the edge capture journal */
+int journal_block(ulong relative_address, ulong offset, ubyte *data, ubyte len);  /* Called to stream the edge capture journal */
+int serial_msg(CAN_MSG_TYPE *message);  /* Called to configure the RS232 port */
+int error_msg(CAN_MSG_TYPE *message);  /* Called to read the error library history */
+int error_block(ulong relative_address, ulong offset, ubyte *data, ubyte len);  /* Called to stream the error library history */
+int restart_msg(CAN_MSG_TYPE *message);  /* Called to get how the node last started */
+int stack_msg(CAN_MSG_TYPE *message);  /* Called to get the stack high-water marks */
+int profile_msg(CAN_MSG_TYPE *message);  /* Called to read and clear the profiler */
+int idle_msg(CAN_MSG_TYPE *message);  /* Called to get the idle time and the wakeups */
+int te_msg(CAN_MSG_TYPE *message);  /* Called to get and set the timing event synchronization */
+int directory_msg(CAN_MSG_TYPE *message);  /* Called to read the point directory */
+int directory_block(ulong relative_address, ulong offset, ubyte *data, ubyte len);  /* Called to stream the point directory */
+
+
+
+
+
+
+
+
+
+
+/*** Globals ***/
+/* A global containing the current status info */
+volatile STATUS idata status;
+
+/* A global for conversion of float */
+CONVERSION idata conv;
+
+/* A global for the last read temperature of each DS1820 device */
+ubyte ambient_temp_data[DS1820_MAX_DEVICES][4];
+
+/* Globals to keep track of the background DS1820 readings */
+ubyte ambientValid = 0;		// One bit per device, set after its first good reading
+ulong ambientTime;			// Time of the last good reading of the on-board device
+ulong ambientStart;			// Time the last conversion was started
+ulong ambientPeriod = AMBIENT_PERIOD;	// Time between conversions
+ubyte ambientResolution = 0;	// DS18B20 resolution to apply when the bus is free (0:none)
+ubyte ambientSetDevice;		// Next device to get ambientResolution
+ubyte lastAmbientResolution = 0;
+uword ambientCrcErrors = 0;	// Readings discarded because of CRC errors
+uword ambientTimeouts = 0;	// Readings lost because of timeouts or bus errors
+
+/* A couple of globals to keep track of last sent messages */
+ubyte lastRemoteDrive = LOW;
+ubyte lastRemoteReset = LOW;
+ubyte lastFaultLatchReset = LOW;
+ubyte lastBypassTimers = LOW;
+ubyte lastEdgeJournalClear = LOW;
+ubyte lastProfileClear = LOW;
+
+/* Globals to configure the RS232 port */
+ubyte serialMode = SERIAL_MODE_ASCII;
+ubyte serialPeriod = SERIAL_PERIOD;	// Seconds between binary frames
+uword telemetrySeq = 0;				// Sequence number of the binary frames
+ubyte serialDelta = 0;				// Text mode only prints the points that changed (1:on)
+
+/* Globals to keep track of what was last printed for each point */
+ulong reportedMask = 0;				// One bit per point (ALL_POINTS must not exceed 32)
+uword reportedDigest[ALL_POINTS];	// Digest of the value and units last printed
+
+/* Points printed as soon as they change */
+const ubyte alarmPoints[ALARM_POINTS] = {
+	comp_pres_alarm, comp_temp_alarm, comp_iccu_stat, comp_iccu_cable,
+	comp_fetim_stat, comp_fetim_cable, comp_fault_stat, COMP_POINTS+cryo_turb_sta
+};
+
+/* Point names known to the RS232 console "get" command */
+const char *pointNames[ALL_POINTS] = {
+	"temp1", "temp2", "temp3", "temp4", "retpres", "aux2", "suppres",
+	"presalarm", "tempalarm", "drive", "iccu", "iccucable", "fetim", "fetimcable",
+	"interlock", "ecutype", "fault", "swrev", "timeon", "timeoff",
+	"4k", "15k", "110k", "portpres", "dewarpres", "gatevalve", "solenoid",
+	"backing", "turbo", "turbostatus", "turbospeed", "current"
+};
+
+/* Monitor and control points, published when their RCAs reach the callback given */
+const DIR_ENTRY pointDirectory[DIR_ENTRIES] = {
+	{GET_TEMP_1, 4, DIR_MONITOR|DIR_FLOAT, FLOAT_LEN, DIR_CELSIUS, DIR_SAMPLED, monitor_msg},
+	{GET_RET_PRESSURE, 1, DIR_MONITOR|DIR_FLOAT, FLOAT_LEN, DIR_MPA, DIR_SAMPLED, monitor_msg},
+	{GET_AUX_2, 1, DIR_MONITOR|DIR_FLOAT, FLOAT_LEN, DIR_VOLT, DIR_SAMPLED, monitor_msg},
+	{GET_PRESSURE, 1, DIR_MONITOR|DIR_FLOAT, FLOAT_LEN, DIR_MPA, DIR_SAMPLED, monitor_msg},
+	{GET_PRESSURE_ALARM, 10, DIR_MONITOR|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_SAMPLED, monitor_msg},
+	{GET_SW_REVISION_LEVEL, 1, DIR_MONITOR|DIR_REVISION, REVISION_LEN, DIR_NO_UNIT, DIR_ON_READ, monitor_msg},
+	{GET_TIME_SINCE_LAST_POWER_ON, 2, DIR_MONITOR|DIR_ULONG, ULONG_LEN, DIR_SECOND, DIR_SAMPLED, monitor_msg},
+	{SET_REMOTE_DRIVE, 3, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, control_msg},
+	{SET_PUSH_4K_CRYOCOOLER_TEMP, 3, DIR_CONTROL|DIR_FLOAT, FLOAT_LEN, DIR_KELVIN, DIR_ON_READ, control_msg},
+	{SET_PUSH_PORT_PRESSURE, 2, DIR_CONTROL|DIR_FLOAT, FLOAT_LEN, DIR_MBAR, DIR_ON_READ, control_msg},
+	{SET_PUSH_GATE_VALVE_STATE, 6, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, control_msg},
+	{SET_PUSH_CRYO_SUPPLY_CURRENT_230V, 1, DIR_CONTROL|DIR_FLOAT, FLOAT_LEN, DIR_AMPERE, DIR_ON_READ, control_msg},
+	{SET_BYPASS_TIMERS, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, control_msg},
+	{GET_EDGE_JOURNAL, 1, DIR_MONITOR|DIR_RECORD, JOURNAL_LEN, DIR_MICROSECOND, DIR_ON_READ, journal_msg},
+	{GET_EDGE_COUNTS, 1, DIR_MONITOR|DIR_RECORD, COUNTS_LEN, DIR_NO_UNIT, DIR_ON_READ, journal_msg},
+	{GET_EDGE_JOURNAL_STATUS, 1, DIR_MONITOR|DIR_RECORD, JOURNAL_STATUS_LEN, DIR_NO_UNIT, DIR_ON_READ, journal_msg},
+	{SET_EDGE_JOURNAL_CLEAR, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, journal_msg},
+	{GET_AMBIENT_TEMP, 1, DIR_MONITOR|DIR_RECORD, AMBIENT_LEN, DIR_CELSIUS, DIR_AMBIENT, ambient_msg},
+	{GET_AMBIENT_AGE, 1, DIR_MONITOR|DIR_ULONG, ULONG_LEN, DIR_SECOND, DIR_ON_READ, ambient_msg},
+	{GET_AMBIENT_ERRORS, 1, DIR_MONITOR|DIR_RECORD, AMBIENT_ERRORS_LEN, DIR_NO_UNIT, DIR_ON_READ, ambient_msg},
+	{GET_AMBIENT_SENSORS, 1, DIR_MONITOR|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, ambient_msg},
+	{GET_AMBIENT_RESOLUTION, 1, DIR_MONITOR|DIR_RECORD, 0, DIR_NO_UNIT, DIR_ON_READ, ambient_msg},
+	{FIRST_PROBE_TEMP, LAST_PROBE_TEMP-FIRST_PROBE_TEMP+1, DIR_MONITOR|DIR_RECORD, AMBIENT_LEN, DIR_CELSIUS, DIR_AMBIENT, ambient_msg},
+	{FIRST_PROBE_ROM, LAST_PROBE_ROM-FIRST_PROBE_ROM+1, DIR_MONITOR|DIR_RECORD, PROBE_ROM_LEN, DIR_NO_UNIT, DIR_ON_READ, ambient_msg},
+	{SET_AMBIENT_RESOLUTION, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, ambient_msg},
+	{SET_SERIAL_MODE, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, serial_msg},
+	{SET_SERIAL_BAUD, 1, DIR_CONTROL|DIR_ULONG, SERIAL_BAUD_LEN, DIR_NO_UNIT, DIR_ON_READ, serial_msg},
+	{SET_SERIAL_PERIOD, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_SECOND, DIR_ON_READ, serial_msg},
+	{SET_SERIAL_DELTA, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, serial_msg},
+	{GET_ERROR_STATUS, 1, DIR_MONITOR|DIR_RECORD, ERROR_STATUS_LEN, DIR_NO_UNIT, DIR_ON_READ, error_msg},
+	{GET_ERROR_EVENT, 1, DIR_MONITOR|DIR_RECORD, ERROR_EVENT_LEN, DIR_SECOND, DIR_ON_READ, error_msg},
+	{SET_ERROR_CURSOR, 1, DIR_CONTROL|DIR_RECORD, ERROR_CURSOR_LEN, DIR_NO_UNIT, DIR_ON_READ, error_msg},
+	{GET_RESTART_STATUS, 1, DIR_MONITOR|DIR_RECORD, RESTART_STATUS_LEN, DIR_MICROSECOND, DIR_ON_READ, restart_msg},
+	{FIRST_BOOT_PHASE, LAST_BOOT_PHASE-FIRST_BOOT_PHASE+1, DIR_MONITOR|DIR_ULONG, ULONG_LEN, DIR_MICROSECOND, DIR_ON_READ, restart_msg},
+	{GET_STACK_USAGE, 1, DIR_MONITOR|DIR_RECORD, STACK_USAGE_LEN, DIR_NO_UNIT, DIR_ON_READ, stack_msg},
+	{FIRST_PROFILE_REGION, LAST_PROFILE_REGION-FIRST_PROFILE_REGION+1, DIR_MONITOR|DIR_RECORD, PROFILE_LEN, DIR_NO_UNIT, DIR_ON_READ, profile_msg},
+	{GET_CPU_LOAD, 1, DIR_MONITOR|DIR_RECORD, CPU_LOAD_LEN, DIR_NO_UNIT, DIR_EVERY_SECOND, profile_msg},
+	{SET_PROFILE_CLEAR, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, profile_msg},
+	{GET_IDLE_STATUS, 1, DIR_MONITOR|DIR_RECORD, IDLE_STATUS_LEN, DIR_NO_UNIT, DIR_EVERY_SECOND, idle_msg},
+	{GET_IDLE_WAKEUPS, 1, DIR_MONITOR|DIR_RECORD, IDLE_WAKEUPS_LEN, DIR_NO_UNIT, DIR_EVERY_SECOND, idle_msg},
+	{GET_TE_STATUS, 1, DIR_MONITOR|DIR_RECORD, TE_STATUS_LEN, DIR_NO_UNIT, DIR_ON_READ, te_msg},
+	{GET_TE_CLOCK, 1, DIR_MONITOR|DIR_RECORD, TE_CLOCK_LEN, DIR_NO_UNIT, DIR_ON_READ, te_msg},
+	{GET_SAMPLE_TE, 1, DIR_MONITOR|DIR_RECORD, SAMPLE_TE_LEN, DIR_NO_UNIT, DIR_SAMPLED, te_msg},
+	{SET_TE_PHASE, 1, DIR_CONTROL|DIR_UWORD, TE_PHASE_LEN, DIR_MICROSECOND, DIR_ON_READ, te_msg},
+	{GET_DIRECTORY_STATUS, 1, DIR_MONITOR|DIR_RECORD, DIRECTORY_STATUS_LEN, DIR_NO_UNIT, DIR_ON_READ, directory_msg},
+	{GET_DIRECTORY_ENTRY, 1, DIR_MONITOR|DIR_RECORD, DIRECTORY_ENTRY_LEN, DIR_NO_UNIT, DIR_ON_READ, directory_msg},
+	{SET_DIRECTORY_CURSOR, 1, DIR_CONTROL|DIR_BYTE, BYTE_LEN, DIR_NO_UNIT, DIR_ON_READ, directory_msg}
+};
+
+/* Globals for the point directory */
+ubyte directoryIndex[DIR_ENTRIES];	// Published entries of pointDirectory, in order
+ubyte directoryCount = 0;			// Number of published entries
+ubyte directoryCursor = 0;			// Next entry read on GET_DIRECTORY_ENTRY
+
+/* Second counters (look at defined macros before changing the names) */
+volatile ulong idata lastOnSec = 0x00000000;
+volatile ulong idata lastOffSec = 0x00000000;
+volatile ulong idata timerSec = 0x00000000;
+ubyte timerTicks = 0;		// Timebase ticks into the current second
+ulong sampleTe = TE_NO_COUNT;	// Timing event of the last sampling (TE_NO_COUNT if not on one)
+
+ubyte bypassTimers = 0; // Used for troubleshooting the unit when not connected to compressor
+
+/* Globals to keep track of the restarts */
+WARM_STATE warmState;				// Saved before a software reset, taken back after it
+ubyte restartKind = RESTART_POWER_ON;
+uword warmRestarts = 0;				// Software resets that kept the state
+ulong restartTime = 0;				// Microseconds from the reset request to serving CAN again
+
+/* Globals to keep track of the boot */
+ulong bootStamp[BOOT_PHASES];		// Microseconds to reach each phase (BOOT_NOT_REACHED if not yet)
+volatile ubyte bootReady = 0;		// Every module started (1:ready)
+volatile ubyte onewireReady = 0;	// 1-Wire devices known (1:ready)
+
+
+
+
+
+
+/* Main */
+void main(void) {
+
+	/* A counter */
+	ubyte cnt;
+
+	/* A variable to keep track of time betwen RS232 messages */
+	ulong lastMessageTime = timerSec;
+
+	/* Boot clock: already running after a reset request (it times the
+	   startup code too), started here after a power on */
+	for(cnt=0;cnt<BOOT_PHASES;cnt++){
+		bootStamp[cnt] = BOOT_NOT_REACHED;
+	}
+	if(warmStopwatchRunning()){
+		restartKind = RESTART_COLD;
+	} else {
+		warmStopwatchStart();
+	}
+	bootMark(BOOT_MAIN);
+
+	/* Stack high-water marks (painted by the startup code) */
+	stackInit();
+
+	/* Profiler, before any profiled code can run (GPT2, T6) */
+	profileInit();
+
+	/* Make sure that external bus control signal buffer is disabled */
+	DP4 |= 0x01;
+	DISABLE_EX_BUF = HIGH;
+
+	/* A software reset (_trap_) leaves the interrupt control registers as
+	   they were: no interrupt of the last run may come in once amb_start
+	   enables them, before its module has set it up again */
+	T1IC = 0x0000;		// Timebase
+	T2IC = 0x0000;		// 1-Wire engine
+	T4IC = 0x0000;		// Sampling
+	T5IC = 0x0000;		// Identify slot
+	CC0IC = 0x0000;		// Edge capture journal
+	CC2IC = 0x0000;
+	CC4IC = 0x0000;
+	CC11IC = 0x0000;
+	CC16IC = 0x0000;	// Timing event
+	CC17IC = 0x0000;
+	S0TIC = 0x0000;		// RS232
+	S0RIC = 0x0000;
+	XP0IC = 0x0000;		// CAN
+
+
+
+
+	/* After a software reset take back the saved state, sparing the 1-Wire probing */
+	if(loadWarmState()){
+		restartKind = RESTART_WARM;
+	}
+
+	/* Initialize control lines */
+	rmtDrv = (restartKind==RESTART_WARM) ? warmState.remoteDrive : LOW; 	// Compressor off (left alone by a software reset)
+	rmtRst = LOW;	// Reset line default to low. It needs an high pulse to reset the compressor.
+
+	/* Fault latch reset is idle low. It needs an high pulse to reset the compressor. */
+	fltRst = HIGH;	
+	fltRst = LOW;
+
+
+
+
+	/* Port direction initialization */
+	/* Write (set corresponding port direction bits to 1) */
+	if(!USE_48MS){
+		REMOTE_RST_DP |= REMOTE_RST_MASK; // Otherwise P8.0 receives the 48ms pulse
+	}
+	REMOTE_DRV_DP |= REMOTE_DRV_MASK;
+	FAULT_RST_DP |= FAULT_RST_MASK;
+	
+	/* Read (set corresponding port direction bits to 0) */
+	PRES_ALARM_DP &= ~PRES_ALARM_MASK;
+	TEMP_ALARM_DP &= ~TEMP_ALARM_MASK;
+	DRIVE_IND_DP &= ~DRIVE_IND_MASK;
+	ICCU_STATUS_DP &= ~ICCU_STATUS_MASK;
+	ICCU_CABLE_DP &= ~ICCU_CABLE_MASK;
+	FETIM_STATUS_DP &= ~FETIM_STATUS_MASK;
+	FETIM_CABLE_DP &= ~FETIM_CABLE_MASK;
+	INTRLK_OVRD_DP &= ~INTRLK_OVRD_MASK;
+	ECU_TYPE_DP	&= ~ECU_TYPE_MASK;
+	FAULT_STAT_DP &= ~FAULT_STAT_MASK;
+
+	bootMark(BOOT_PORTS);
+
+
+
+
+	/* Fast boot: CAN comes up first. Until the slower modules below are
+	   started the points that need them answer "initializing" (bootBusy).
+	   The 1-Wire probing comes last, the library answers the identify
+	   requests "initializing" until it has the serial number */
+	if(restartKind!=RESTART_WARM){
+		amb_defer_serial_number();
+	}
+
+	/* Initialize the slave library */
+	if (amb_init_slave((void *) cb_memory) != 0) 
+		return;
+
+	bootMark(BOOT_CAN);
+
+	/* Save the state before a software reset */
+	amb_set_reset_hook(saveWarmState);
+
+	/* Time the CAN interrupt and the 1-Wire engine */
+	amb_set_profile_hook(profileCanHook);
+	ds1820_set_profile_hook(profileOnewireHook);
+
+	/* Register callbacks for CAN events */
+	if (amb_register_function(GET_AMBIENT_TEMP, GET_AMBIENT_TEMP, ambient_msg) != 0)
+		return;
+
+	if (amb_register_function(FIRST_AMBIENT_MONITOR_RCA, LAST_AMBIENT_MONITOR_RCA, ambient_msg) != 0)
+		return;
+
+	if (amb_register_function(SET_AMBIENT_RESOLUTION, SET_AMBIENT_RESOLUTION, ambient_msg) != 0)
+		return;
+	
+	/* Register monitor callbacks */
+	if (amb_register_function(FIRST_MONITOR_RCA, LAST_MONITOR_RCA, monitor_msg) !=0)
+		return;
+
+	/* Register control callbacks */
+	if (amb_register_function(FIRST_CONTROL_RCA, LAST_CONTROL_RCA, control_msg) !=0)
+		return;
+
+	if (amb_register_function(SET_BYPASS_TIMERS, SET_BYPASS_TIMERS, control_msg) !=0)
+		return;
+
+	/* Register edge capture journal callbacks */
+	if (amb_register_function(FIRST_JOURNAL_MONITOR_RCA, LAST_JOURNAL_MONITOR_RCA, journal_msg) !=0)
+		return;
+
+	if (amb_set_block_function(FIRST_JOURNAL_MONITOR_RCA, journal_block) !=0)
+		return;
+
+	if (amb_register_function(SET_EDGE_JOURNAL_CLEAR, SET_EDGE_JOURNAL_CLEAR, journal_msg) !=0)
+		return;
+
+	/* Register RS232 port callbacks */
+	if (amb_register_function(FIRST_SERIAL_CONTROL_RCA, LAST_SERIAL_CONTROL_RCA, serial_msg) !=0)
+		return;
+
+	/* Register error library callbacks */
+	if (amb_register_function(FIRST_ERROR_MONITOR_RCA, LAST_ERROR_MONITOR_RCA, error_msg) !=0)
+		return;
+
+	if (amb_set_block_function(FIRST_ERROR_MONITOR_RCA, error_block) !=0)
+		return;
+
+	if (amb_register_function(SET_ERROR_CURSOR, SET_ERROR_CURSOR, error_msg) !=0)
+		return;
+
+	/* Register restart and boot callbacks */
+	if (amb_register_function(FIRST_RESTART_MONITOR_RCA, LAST_RESTART_MONITOR_RCA, restart_msg) !=0)
+		return;
+
+	/* Register stack callbacks */
+	if (amb_register_function(GET_STACK_USAGE, GET_STACK_USAGE, stack_msg) !=0)
+		return;
+
+	/* Register profiler callbacks */
+	if (amb_register_function(FIRST_PROFILE_MONITOR_RCA, LAST_PROFILE_MONITOR_RCA, profile_msg) !=0)
+		return;
+
+	if (amb_register_function(SET_PROFILE_CLEAR, SET_PROFILE_CLEAR, profile_msg) !=0)
+		return;
+
+	/* Register idle mode callbacks */
+	if (amb_register_function(FIRST_IDLE_MONITOR_RCA, LAST_IDLE_MONITOR_RCA, idle_msg) !=0)
+		return;
+
+	/* Register timing event callbacks, only with the 48ms pulse on P8.0 */
+	if(USE_48MS){
+		if (amb_register_function(FIRST_TE_MONITOR_RCA, LAST_TE_MONITOR_RCA, te_msg) !=0)
+			return;
+
+		if (amb_register_function(SET_TE_PHASE, SET_TE_PHASE, te_msg) !=0)
+			return;
+	}
+
+	/* Register point directory callbacks */
+	if (amb_register_function(FIRST_DIRECTORY_MONITOR_RCA, LAST_DIRECTORY_MONITOR_RCA, directory_msg) !=0)
+		return;
+
+	if (amb_set_block_function(FIRST_DIRECTORY_MONITOR_RCA, directory_block) !=0)
+		return;
+
+	if (amb_register_function(SET_DIRECTORY_CURSOR, SET_DIRECTORY_CURSOR, directory_msg) !=0)
+		return;
+
+	/* Publish the points that have a callback */
+	directoryInit();
+
+	/* globally enable interrupts */
+  	amb_start();
+
+	/* Serving again: time since the reset request (0 after power on) */
+	bootMark(BOOT_SERVING);
+	if(restartKind!=RESTART_POWER_ON){
+		restartTime = bootStamp[BOOT_SERVING];
+	}
+
+
+
+
+	/* Initialize modules */
+	init_error_handler(1); // Error library, before the modules that register with it (ADC)
+	set_error_clock(&timerSec); // Error events are stamped in seconds since power on
+	adc_init(0,0,0,0); // ADC initialization
+
+	bootMark(BOOT_ADC);
+
+	GPT1_vInit(); // Sampling interrupt (GPT1, T4)
+	timebaseInit(timerTick); // Seconds counter and microseconds clock (CAPCOM1, T1): starts the sampling
+	if(USE_48MS){
+		teInit(triggerSampling); // 48ms pulse capture (CAPCOM2, CC16 and T7): trims the timebase, paces the sampling
+	}
+	serialInit(CR); // Serial interface (console commands end with CR)
+	if(restartKind==RESTART_WARM){
+		serialSetBaud(warmState.serialBaud); // Baud rate kept across a software reset
+	}
+	journalInit(); // Edge capture journal on the alarm and fault inputs (CAPCOM1, timestamps from T1)
+	amb_set_clock(timebaseMicros,1000); // Busoff recoveries are timed with the timebase clock
+
+
+
+	/* Every point is served from now on, the 1-Wire ones once probed */
+	bootMark(BOOT_READY);
+	bootReady = 1;
+
+	/* Serial number and device list, the slowest step. Without them the
+	   node keeps serving, the identify requests stay "initializing" */
+	if(restartKind!=RESTART_WARM){
+		amb_read_serial_number();
+	}
+	onewireReady = 1;
+	bootMark(BOOT_ONEWIRE);
+	warmStopwatchStop();
+
+	/* First DS1820 conversion is due right away */
+	ambientSetPeriod();
+	ambientStart = timerSecNow() - ambientPeriod;
+
+	/* The main loop sleeps between the events from now on */
+	idleInit();
+
+	/* Never return */
+	while (1){
+		/* Write all the data to RS232 in one binary frame */
+		if(serialMode==SERIAL_MODE_BINARY){
+
+			/* Wait for the next period, reading the DS1820 meanwhile */
+			while((timerSecNow()-lastMessageTime)<serialPeriod){
+				backgroundTasks();
+			}
+			profileEnd(PROFILE_IDLE);
+
+			lastMessageTime=timerSecNow();
+			serialWriteFrame(buildFrame(),TELEMETRY_FRAME_SIZE);
+
+			continue;
+		}
+
+		/* Write compressor and then cryostat (from FEMC) data to RS232 */
+		for(cnt=0;cnt<ALL_POINTS;cnt++){
+
+			/* Wait 3 second before sending next message, reading the DS1820 and
+			   printing the alarm changes meanwhile. The tasks run at least once
+			   per point, even when unchanged points are skipped */
+			do {
+				backgroundTasks();
+			} while((timerSecNow()-lastMessageTime)<3);
+			profileEnd(PROFILE_IDLE);
+
+			/* Binary mode was selected: start over */
+			if(serialMode!=SERIAL_MODE_ASCII){
+				break;
+			}
+
+			/* In delta mode skip the points printed before and unchanged since */
+			if(serialDelta&&(reportedMask&(1L<<cnt))&&(reportedDigest[cnt]==messageDigest(pointMessage(cnt)))){
+				continue;
+			}
+
+			reportPoint(cnt);
+
+			lastMessageTime=timerSecNow();
+	
+		}
+
+
+	}
+}
+
+
+
+/* Build the serial message of a point (compressor points first, then the
+   cryostat ones) and returns a pointer to it. Returns 0 for an unknown point */
+ubyte *pointMessage(ubyte point){
+
+	/* Compressor data */
+	if(point<COMP_POINTS){
+		switch(point){
+			case comp_temp1:
+				return buildMessage("Temperature 1",&status.comp_data[point],"C",flt_val);
+			case comp_temp2:
+				return buildMessage("Temperature 2",&status.comp_data[point],"C",flt_val);
+			case comp_temp3:
+				return buildMessage("Temperature 3",&status.comp_data[point],"C",flt_val);
+			case comp_temp4:
+				return buildMessage("Temperature 4",&status.comp_data[point],"C",flt_val);
+			case comp_ret_pres:
+				return buildMessage("Return Pressure",&status.comp_data[point],"MPa",flt_val);
+			case comp_aux2:
+				return buildMessage("Aux Input 2",&status.comp_data[point],"V",flt_val);
+			case comp_sup_pres:
+				return buildMessage("Supply Pressure",&status.comp_data[point],"MPa",flt_val);
+			case comp_pres_alarm:
+				return buildMessage("Pressure Alarm",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Alarm":"Ok",chr_val);
+			case comp_temp_alarm:
+				return buildMessage("Temperature Alarm",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Alarm":"Ok",chr_val);
+			case comp_drive_ind:
+				return buildMessage("Drive Indicator",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"On":"Off",chr_val);
+			case comp_iccu_stat:
+				return buildMessage("ICCU Status",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Error":"Ok",chr_val);
+			case comp_iccu_cable:
+				return buildMessage("ICCU Cable",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Error":"Ok",chr_val);
+			case comp_fetim_stat:
+				return buildMessage("FETIM Status",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Error":"Ok",chr_val);
+			case comp_fetim_cable:
+				return buildMessage("FETIM Cable",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Error":"Ok",chr_val);
+			case comp_intrlk_ovrd:
+				return buildMessage("Interlock Override",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Engaged":"Off",chr_val);
+			case comp_ecu_type:
+				return buildMessage("ECU Type",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Japanese":"European",chr_val);
+			case comp_fault_stat:
+				return buildMessage("Compressor Fault",&status.comp_data[point],status.comp_data[point].data.chr_val[0]?"Error":"Ok",chr_val);
+			case comp_sw_rev:
+				return buildMessage("Software Revision",&status.comp_data[point],"",rev_val);
+			case comp_time_on:
+				return buildMessage("Time since last ON",&status.comp_data[point],"min",tim_val);
+			case comp_time_off:
+				return buildMessage("Time since last OFF",&status.comp_data[point],"min",tim_val);
+			default:
+				break;
+		}
+		return 0;
+	}
+
+	/* Cryostat (from FEMC) data */
+	point -= COMP_POINTS;
+	switch(point){
+		case cryo_temp_4k:
+			return buildMessage("4K stage",&status.cryo_data[point],"K",flt_val);
+		case cryo_temp_15k:
+			return buildMessage("15K stage",&status.cryo_data[point],"K",flt_val);
+		case cryo_temp_110k:
+			return buildMessage("110K stage",&status.cryo_data[point],"K",flt_val);
+		case cryo_pres_port:
+			return buildMessage("Port Pressure",&status.cryo_data[point],"mbar",flt_val);
+		case cryo_pres_dewar:
+			return buildMessage("Dewar Pressure",&status.cryo_data[point],"mbar",exp_val);
+		case cryo_gate_state:
+			return buildMessage("Gate Valve",&status.cryo_data[point],VALVE_STATE(status.cryo_data[point].data.chr_val[0]),chr_val);
+		case cryo_sole_state:
+			return buildMessage("Solenoid Valve",&status.cryo_data[point],VALVE_STATE(status.cryo_data[point].data.chr_val[0]),chr_val);
+		case cryo_back_ena:
+			return buildMessage("Backing Pump",&status.cryo_data[point],status.cryo_data[point].data.chr_val[0]?"On":"Off",chr_val);
+		case cryo_turb_ena:
+			return buildMessage("Turbo Pump",&status.cryo_data[point],status.cryo_data[point].data.chr_val[0]?"On":"Off",chr_val);
+		case cryo_turb_sta:
+			return buildMessage("Turbo Pump Status",&status.cryo_data[point],status.cryo_data[point].data.chr_val[0]?"Error":"Ok",chr_val);
+		case cryo_turb_spe:
+			return buildMessage("Turbo Pump Speed",&status.cryo_data[point],status.cryo_data[point].data.chr_val[0]?"Up to speed":"Low",chr_val);
+		case cryo_sup_curr:
+			return buildMessage("FE 230V Current",&status.cryo_data[point],"A",flt_val);
+		default:
+			break;
+	}
+
+	return 0;
+
+}
+
+
+
+/* Serve the commands received on the RS232 port. The replies are queued
+   between the periodic messages (or frames in binary mode):
+	get <point>		- one point, by name or number
+	dump			- all the points
+	stream <period>	- binary frames every period seconds (0: back to text)
+	delta <on|off>	- text mode only prints the points that changed
+	stats			- driver and background task counters */
+ubyte consoleTask(void){
+
+	/* Some statics */
+	static char line[SER_RX_BUF_SIZE+1];
+	static ubyte reply[CONSOLE_REPLY_SIZE];
+	static ubyte dumpPoint = ALL_POINTS;	// Next point to send for "dump"
+
+	/* Some locals */
+	ubyte *message;
+	char *arg;
+	ubyte cnt;
+	ubyte len;
+	uword value;
+	ubyte work = 0;
+
+	/* Go on with a dump while there is room in the transmit queue */
+	while((dumpPoint<ALL_POINTS)&&(serialGetTxFree()>=SIZE_OF_SERIAL_MESSAGE)){
+		message = pointMessage(dumpPoint++);
+		serialWrite(message,(ubyte)strlen(message));
+		work = 1;
+	}
+
+	if(!serialRead(line,sizeof(line))){
+		return work;
+	}
+
+	/* Commands and point names are not case sensitive */
+	for(cnt=0;line[cnt];cnt++){
+		if((line[cnt]>='A')&&(line[cnt]<='Z')){
+			line[cnt] += 'a'-'A';
+		}
+	}
+
+	/* Split the command from its argument */
+	arg = strchr(line,' ');
+	if(arg){
+		*arg++ = '\0';
+		while(*arg==' '){
+			arg++;
+		}
+	} else {
+		arg = &line[cnt];
+	}
+
+	message = reply;
+
+	if(!strcmp(line,"get")){
+		cnt = consolePoint(arg);
+		if(cnt<ALL_POINTS){
+			message = pointMessage(cnt);
+		} else {
+			strcpy(reply,"Unknown point\r\n\r\n");
+		}
+	} else if(!strcmp(line,"dump")){
+		dumpPoint = 0;
+		return 1;
+	} else if(!strcmp(line,"stream")){
+		for(value=0;(*arg>='0')&&(*arg<='9')&&(value<256);arg++){
+			value = 10*value+(*arg-'0');
+		}
+		if(*arg||(value>255)){
+			strcpy(reply,"Period must be 0 to 255 s\r\n\r\n");
+		} else if(value==0){
+			serialMode = SERIAL_MODE_ASCII;
+			strcpy(reply,"Streaming off\r\n\r\n");
+		} else {
+			serialPeriod = (ubyte)value;
+			serialMode = SERIAL_MODE_BINARY;
+			len = formatString(reply,"Streaming every ");
+			len += formatUnsigned(&reply[len],value);
+			formatString(&reply[len]," s\r\n\r\n");
+		}
+	} else if(!strcmp(line,"delta")){
+		if(!strcmp(arg,"on")){
+			serialDelta = 1;
+			strcpy(reply,"Delta on\r\n\r\n");
+		} else if(!strcmp(arg,"off")){
+			serialDelta = 0;
+			strcpy(reply,"Delta off\r\n\r\n");
+		} else {
+			strcpy(reply,"Delta must be on or off\r\n\r\n");
+		}
+	} else if(!strcmp(line,"stats")){
+		len = formatString(reply,"Uptime: ");
+		len += formatUnsigned(&reply[len],timerSecNow());
+		len += formatString(&reply[len]," s\r\nSerial: ");
+		len += formatUnsigned(&reply[len],serialGetTxDropped());
+		len += formatString(&reply[len]," dropped, ");
+		len += formatUnsigned(&reply[len],serialGetRxOverruns());
+		len += formatString(&reply[len]," overruns\r\nAmbient: ");
+		len += formatUnsigned(&reply[len],ambientCrcErrors);
+		len += formatString(&reply[len]," CRC, ");
+		len += formatUnsigned(&reply[len],ambientTimeouts);
+		len += formatString(&reply[len]," timeouts\r\nJournal: ");
+		len += formatUnsigned(&reply[len],journalGetLost());
+		formatString(&reply[len]," lost\r\n\r\n");
+	} else {
+		strcpy(reply,"Commands: get <point>, dump, stream <period>, delta <on|off>, stats\r\n\r\n");
+	}
+
+	serialWrite(message,(ubyte)strlen(message));
+
+	return 1;
+}
+
+
+
+/* Print the alarm and fault points as soon as they change, without waiting
+   for their turn in the text cycle. An alarm already active when the text
+   mode starts is printed right away as well. Returns 0 if nothing changed */
+ubyte alarmTask(void){
+
+	/* Some locals */
+	ubyte cnt;
+	ubyte point;
+	ubyte level;
+	ubyte work = 0;
+
+	if(serialMode!=SERIAL_MODE_ASCII){
+		return 0;
+	}
+
+	for(cnt=0;cnt<ALARM_POINTS;cnt++){
+
+		/* Keep it for later if the message would be dropped */
+		if(serialGetTxFree()<SIZE_OF_SERIAL_MESSAGE){
+			return work;
+		}
+
+		point = alarmPoints[cnt];
+
+		if(reportedMask&(1L<<point)){
+			if(reportedDigest[point]!=messageDigest(pointMessage(point))){
+				reportPoint(point);
+				work = 1;
+			}
+		} else {
+			level = (point<COMP_POINTS) ? status.comp_data[point].data.chr_val[0] : status.cryo_data[point-COMP_POINTS].data.chr_val[0];
+			if(level){
+				reportPoint(point);
+				work = 1;
+			}
+		}
+	}
+
+	return work;
+}
+
+
+
+/* Queue the message of a point and remember what it printed */
+void reportPoint(ubyte point){
+
+	/* Some locals */
+	ubyte *message;
+
+	message = pointMessage(point);
+
+	/* Queue the message, without the trailing NULs */
+	if(message){
+		serialWrite(message,(ubyte)strlen(message));
+		reportedDigest[point] = messageDigest(message);
+		reportedMask |= 1L<<point;
+	}
+}
+
+
+
+/* Fletcher-16 digest of a point message up to the age line, which changes
+   every minute even when the value does not */
+uword messageDigest(ubyte *message){
+
+	/* Some locals */
+	uword sum1 = 0;
+	uword sum2 = 0;
+	ubyte *end;
+
+	if(!message){
+		return 0;
+	}
+
+	end = strstr(message,"\r\nAge:");
+
+	while(*message&&(message!=end)){
+		sum1 = (sum1+*message++)%255;
+		sum2 = (sum2+sum1)%255;
+	}
+
+	return (sum2<<8)|sum1;
+}
+
+
+
+/* Look up a point by name or number. Returns ALL_POINTS if not found */
+ubyte consolePoint(char *name){
+
+	/* Some locals */
+	ubyte cnt;
+	uword value;
+
+	/* A number */
+	if((*name>='0')&&(*name<='9')){
+		for(value=0;(*name>='0')&&(*name<='9')&&(value<ALL_POINTS);name++){
+			value = 10*value+(*name-'0');
+		}
+		return (*name||(value>=ALL_POINTS)) ? ALL_POINTS : (ubyte)value;
+	}
+
+	/* A name */
+	for(cnt=0;cnt<ALL_POINTS;cnt++){
+		if(!strcmp(name,pointNames[cnt])){
+			return cnt;
+		}
+	}
+
+	return ALL_POINTS;
+}
+
+
+
+/* Buil the serial message and returns a pointer to it */
+ubyte *buildMessage(ubyte *text, DATA *data, ubyte *units, DATA_TYPE type){
+
+	/* A static buffer */
+	static ubyte idata message[SIZE_OF_SERIAL_MESSAGE];
+
+	/* Some locals */
+	ulong	ageOfData;
+	ubyte	len;
+
+	profileBegin(PROFILE_MESSAGE);
+
+	ageOfData = (timerSecNow() - data->time)/60;
+	
+	if(ageOfData>=255){
+		ageOfData=255;
+	}
+
+	/* Same layout as "%s\r\nValue: <value> %s\r\nAge: %u min\r\n\r\n", without printf */
+	len = formatString(message,text);
+	len += formatString(&message[len],"\r\nValue: ");
+
+	switch(type){
+		case chr_val:
+			len += formatUnsigned(&message[len],data->data.chr_val[0]);
+			break;
+		case flt_val:
+			len += formatFixed(&message[len],data->data.flt_val,5,2);
+			break;
+		case exp_val:
+			len += formatExp(&message[len],data->data.flt_val,2);
+			break;
+		case rev_val:
+			len += formatUnsigned(&message[len],data->data.chr_val[0]);
+			message[len++] = '.';
+			len += formatUnsigned(&message[len],data->data.chr_val[1]);
+			message[len++] = '.';
+			len += formatUnsigned(&message[len],data->data.chr_val[2]);
+			break;
+		case tim_val:
+			len += formatUnsigned(&message[len],data->data.ulng_val/60);
+			break;
+		default:
+			message[0] = '\0';
+			profileEnd(PROFILE_MESSAGE);
+			return message;
+	}	
+
+	message[len++] = ' ';
+	len += formatString(&message[len],units);
+	len += formatString(&message[len],"\r\nAge: ");
+	len += formatUnsigned(&message[len],ageOfData);
+	formatString(&message[len]," min\r\n\r\n");
+
+	profileEnd(PROFILE_MESSAGE);
+
+	return message;
+
+}
+
+
+
+/* Build the binary telemetry frame and returns a pointer to it */
+ubyte *buildFrame(void){
+
+	/* A static buffer */
+	static ubyte frame[TELEMETRY_FRAME_SIZE];
+
+	/* Some locals */
+	ubyte cnt;
+	ubyte *dest;
+	ulong now = timerSecNow();
+
+	profileBegin(PROFILE_FRAME);
+
+	/* Header */
+	frame[0] = TELEMETRY_FRAME_TYPE;
+	frame[1] = (ubyte)(telemetrySeq>>8);
+	frame[2] = (ubyte)(telemetrySeq);
+	frame[3] = (ubyte)(now>>24);
+	frame[4] = (ubyte)(now>>16);
+	frame[5] = (ubyte)(now>>8);
+	frame[6] = (ubyte)(now);
+	telemetrySeq++;
+
+	dest = &frame[7];
+
+	/* Compressor data */
+	for(cnt=comp_min_item;cnt<comp_max_item+1;cnt++){
+		putPoint(dest,&status.comp_data[cnt]);
+		dest += TELEMETRY_POINT_SIZE;
+	}
+
+	/* Cryostat data */
+	for(cnt=cryo_min_item;cnt<cryo_max_item+1;cnt++){
+		putPoint(dest,&status.cryo_data[cnt]);
+		dest += TELEMETRY_POINT_SIZE;
+	}
+
+	/* Ambient temperature, as on the CAN bus */
+	IEN = 0;
+	memcpy(dest,ambient_temp_data[0],4);
+	IEN = 1;
+
+	profileEnd(PROFILE_FRAME);
+
+	return frame;
+
+}
+
+
+
+/* Store the value of a point (MSB first, as on the CAN bus) and its age in minutes */
+void putPoint(ubyte *dest, DATA *data){
+
+	/* Some locals */
+	ulong ageOfData;
+	CONVERSION value;
+
+	/* The timer interrupt must not see a partial update */
+	IEN = 0;
+	value = data->data;
+	ageOfData = (timerSecNow() - data->time)/60;
+	IEN = 1;
+
+	dest[0] = value.chr_val[3];
+	dest[1] = value.chr_val[2];
+	dest[2] = value.chr_val[1];
+	dest[3] = value.chr_val[0];
+	dest[4] = (ageOfData>=255) ? 255 : (ubyte)ageOfData;
+
+}
+
+
+
+/* Keep the DS1820 reading going in the background and cache the last good
+   value. Returns 0 if it only found the 1-Wire bus still busy */
+ubyte ambientTask(void){
+
+	/* Some locals */
+	ubyte device;
+	ubyte data[4];
+
+	switch(ds1820_poll_temp(&device, &data[1], &data[0], &data[2], &data[3])){
+		case DS1820_BUSY:
+			return 0;
+		case 0:
+			/* The CAN interrupt must not see a partial update */
+			IEN = 0;
+			memcpy(ambient_temp_data[device], data, 4);
+			if(device==0){
+				ambientTime = timerSecNow();
+			}
+			ambientValid |= 1<<device;
+			IEN = 1;
+			return 1;	// More devices may follow
+		case -1:
+			ambientTimeouts++;
+			break;
+		case -2:
+			ambientCrcErrors++;
+			break;
+		default: // Nothing in progress, or a resolution change done
+			break;
+	}
+
+	/* Apply a new resolution one device at a time, while the bus is free */
+	if(ambientResolution){
+		switch(ds1820_set_resolution(ambientSetDevice, ambientResolution)){
+			case DS1820_BUSY:
+				return 0;
+			case 0:	// Done in the background by ds1820_poll_temp()
+				ambientSetDevice++;
+				return 1;
+			default: // Not a DS18B20, or past the last device
+				ambientSetDevice++;
+				break;
+		}
+		if(ambientSetDevice>=ds1820_get_count()){
+			ambientResolution = 0;
+			ambientSetPeriod();
+		}
+		return 1;
+	}
+
+	/* Start the next conversion when due */
+	if((timerSecNow()-ambientStart)>=ambientPeriod){
+		if(ds1820_start_temp()==0){
+			ambientStart = timerSecNow();
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+
+/* Convert faster when every device on the bus is a DS18B20 at low resolution */
+void ambientSetPeriod(void){
+
+	/* Some locals */
+	ubyte device;
+	ubyte bits;
+
+	ambientPeriod = AMBIENT_PERIOD_FAST;
+
+	if(ds1820_get_count()==0){
+		ambientPeriod = AMBIENT_PERIOD;
+	}
+
+	for(device=0;device<ds1820_get_count();device++){
+		bits = ds1820_get_resolution(device);
+		if((bits==0)||(bits>10)){	// DS1820 or slow DS18B20
+			ambientPeriod = AMBIENT_PERIOD;
+		}
+	}
+}
+
+
+
+/* Run the background tasks once, then sleep until an interrupt brings
+   new work. The time the main loop spends between two runs, waiting for
+   the next message, is the idle time, and so is a task run that only
+   polled and found nothing to do */
+void backgroundTasks(void){
+
+	profileEnd(PROFILE_IDLE);
+
+	/* The tasks below serve whatever woke the CPU up */
+	idleAwake();
+
+	profileBegin(PROFILE_AMBIENT);
+	if(ambientTask()){
+		profileEnd(PROFILE_AMBIENT);
+	} else {
+		profileEndIdle(PROFILE_AMBIENT);
+	}
+
+	profileBegin(PROFILE_CONSOLE);
+	if(consoleTask()){
+		profileEnd(PROFILE_CONSOLE);
+	} else {
+		profileEndIdle(PROFILE_CONSOLE);
+	}
+
+	profileBegin(PROFILE_ALARM);
+	if(alarmTask()){
+		profileEnd(PROFILE_ALARM);
+	} else {
+		profileEndIdle(PROFILE_ALARM);
+	}
+
+	stackTask();
+
+	/* Sleep: too long for a region, it is added to the idle time by itself */
+	idleWait();
+
+	profileBegin(PROFILE_IDLE);
+
+}
+
+
+
+/* Take back the state saved before a software reset. Returns 1 if it was
+   valid and the DS1820 devices are still there, 0 for a cold start */
+ubyte loadWarmState(void){
+
+	/* Some locals */
+	ubyte sn[8];
+
+	if(!warmLoad(&warmState,sizeof(warmState))){
+		return 0;
+	}
+
+	/* The devices found before the reset, the on-board one gives the serial number */
+	if((ds1820_restore(&warmState.ds1820)!=0)||(ds1820_get_sn(sn)!=0)){
+		return 0;
+	}
+	amb_set_serial_number(sn);
+
+	timerSec = warmState.timerSec;
+	lastOnSec = warmState.lastOnSec;
+	lastOffSec = warmState.lastOffSec;
+	lastRemoteDrive = warmState.lastRemoteDrive;
+	bypassTimers = warmState.bypassTimers;
+	lastBypassTimers = warmState.bypassTimers;
+	ambientCrcErrors = warmState.ambientCrcErrors;
+	ambientTimeouts = warmState.ambientTimeouts;
+	serialMode = warmState.serialMode;
+	serialPeriod = warmState.serialPeriod;
+	serialDelta = warmState.serialDelta;
+	telemetrySeq = warmState.telemetrySeq;
+	warmRestarts = warmState.warmRestarts+1;
+
+	return 1;
+}
+
+
+
+/* Called by the AMB library (CAN interrupt) right before a reset. Times the
+   restart and, for a software reset, saves what has to survive it */
+void saveWarmState(ubyte warm){
+
+	warmStopwatchStart();
+
+	if(!warm){
+		warmClear();
+		return;
+	}
+
+	warmState.timerSec = timerSec;
+	warmState.lastOnSec = lastOnSec;
+	warmState.lastOffSec = lastOffSec;
+	warmState.remoteDrive = rmtDrv;
+	warmState.lastRemoteDrive = lastRemoteDrive;
+	warmState.bypassTimers = bypassTimers;
+	warmState.ambientCrcErrors = ambientCrcErrors;
+	warmState.ambientTimeouts = ambientTimeouts;
+	warmState.serialMode = serialMode;
+	warmState.serialPeriod = serialPeriod;
+	warmState.serialDelta = serialDelta;
+	warmState.serialBaud = serialGetBaud();
+	warmState.telemetrySeq = telemetrySeq;
+	warmState.warmRestarts = warmRestarts;
+	ds1820_save(&warmState.ds1820);
+
+	warmSave(&warmState,sizeof(warmState));
+}
+
+
+
+/* Stamp a boot phase with the boot clock */
+void bootMark(ubyte phase){
+
+	bootStamp[phase] = warmStopwatchRead();
+
+}
+
+
+
+/* Answer for the points that need modules still starting up: monitor
+   requests get an empty reply ("initializing") and control requests are
+   dropped. Returns 1 if the request was answered so */
+ubyte bootBusy(CAN_MSG_TYPE *message){
+
+	if(bootReady){
+		return 0;
+	}
+
+	message->len = 0;
+
+	return 1;
+}
+
+
+
+/* Build the published point directory: the entries of pointDirectory whose
+   first and last RCAs both reach their own callback (a wider range registered
+   by another module does not count). Called once the callbacks are registered,
+   before the interrupts are enabled */
+void directoryInit(void){
+
+	/* Some locals */
+	ubyte cnt;
+	const DIR_ENTRY *entry;
+
+	directoryCount = 0;
+	for(cnt=0;cnt<DIR_ENTRIES;cnt++){
+		entry = &pointDirectory[cnt];
+		if((amb_get_function(entry->rca)==entry->func)&&(amb_get_function(entry->rca+entry->count-1)==entry->func)){
+			directoryIndex[directoryCount++] = cnt;
+		}
+	}
+	directoryCursor = 0;
+}
+
+
+
+/* Write a published directory entry (DIRECTORY_ENTRY_LEN bytes): first RCA
+   (3 bytes, MSB first), number of RCAs, type, length, units and period */
+void directoryPut(ubyte *dest, ubyte entry){
+
+	/* Some locals */
+	const DIR_ENTRY *dir;
+
+	dir = &pointDirectory[directoryIndex[entry]];
+	dest[0] = (ubyte)(dir->rca>>16);
+	dest[1] = (ubyte)(dir->rca>>8);
+	dest[2] = (ubyte)(dir->rca);
+	dest[3] = dir->count;
+	dest[4] = dir->type;
+	dest[5] = dir->len;
+	dest[6] = dir->units;
+	dest[7] = dir->period;
+}
+
+
+
+/* Temperature request messages */
+int ambient_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	ulong age;
+	ubyte device;
+
+	if (message->dirn == CAN_CONTROL) {  /* Only the resolution can be set */
+		if(message->relative_address==SET_AMBIENT_RESOLUTION){
+			/* Applied by ambientTask when the bus is free */
+			if((message->data[0]>=9)&&(message->data[0]<=12)){
+				ambientResolution = message->data[0];
+				ambientSetDevice = 0;
+			}
+			lastAmbientResolution = message->data[0];
+		}
+		return 0;
+	}
+
+	/* Not before the 1-Wire bus is probed */
+	if(!onewireReady){
+		message->len = 0;
+		return 0;
+	}
+
+	/* Per device readings and ROM codes */
+	if((message->relative_address>=FIRST_PROBE_TEMP)&&(message->relative_address<=LAST_PROBE_TEMP)){
+		device = (ubyte)(message->relative_address-FIRST_PROBE_TEMP);
+		if((device>=DS1820_MAX_DEVICES)||!(ambientValid&(1<<device))){
+			return 0;	// No such device or no reading yet
+		}
+		message->len = AMBIENT_LEN;
+		memcpy(message->data, ambient_temp_data[device], AMBIENT_LEN);
+		return 0;
+	}
+
+	if((message->relative_address>=FIRST_PROBE_ROM)&&(message->relative_address<=LAST_PROBE_ROM)){
+		device = (ubyte)(message->relative_address-FIRST_PROBE_ROM);
+		if(ds1820_get_rom(device, message->data)==0){
+			message->len = PROBE_ROM_LEN;
+		}
+		return 0;
+	}
+
+	switch(message->relative_address){
+		case GET_AMBIENT_TEMP:
+			/* Last good reading of the on-board device, served from the cache */
+			message->len = AMBIENT_LEN;
+			message->data[0] = ambient_temp_data[0][0];
+			message->data[1] = ambient_temp_data[0][1];
+			message->data[2] = ambient_temp_data[0][2];
+			message->data[3] = ambient_temp_data[0][3];
+			break;
+
+		case GET_AMBIENT_AGE:
+			/* Seconds since the last good reading (0xFFFFFFFF if none yet) */
+			age = (ambientValid&0x01) ? (timerSec-ambientTime) : 0xFFFFFFFF;
+			message->data[0] = (ubyte)(age>>24);
+			message->data[1] = (ubyte)(age>>16);
+			message->data[2] = (ubyte)(age>>8);
+			message->data[3] = (ubyte)(age);
+			message->len = ULONG_LEN;
+			break;
+
+		case GET_AMBIENT_ERRORS:
+			message->data[0] = (ubyte)(ambientCrcErrors>>8);
+			message->data[1] = (ubyte)(ambientCrcErrors);
+			message->data[2] = (ubyte)(ambientTimeouts>>8);
+			message->data[3] = (ubyte)(ambientTimeouts);
+			message->len = AMBIENT_ERRORS_LEN;
+			break;
+
+		case GET_AMBIENT_SENSORS:
+			/* Number of DS1820 devices found on the bus */
+			message->data[0] = ds1820_get_count();
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_AMBIENT_RESOLUTION:
+			/* Resolution in bits of each device (0 for a DS1820) */
+			for(device=0;device<ds1820_get_count();device++){
+				message->data[device] = ds1820_get_resolution(device);
+			}
+			message->len = device;
+			break;
+
+		case SET_AMBIENT_RESOLUTION:
+			message->data[0] = lastAmbientResolution;
+			message->len = BYTE_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+
+
+
+
+/* Monitor requests */
+int monitor_msg(CAN_MSG_TYPE *message) {
+
+	/* If it is a control message on monitor RCA, do nothing. */
+	if(message->dirn==CAN_CONTROL){
+		return 0;
+	}
+
+	/* Not before the ADC and the timers are started */
+	if(bootBusy(message)){
+		return 0;
+	}
+
+	profileBegin(PROFILE_CAN_MONITOR);
+
+	/* Perform the monitor operation */
+	switch(message->relative_address){
+		case GET_TEMP_1:
+			message->data[0] = status.comp_data[comp_temp1].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_temp1].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_temp1].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_temp1].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_TEMP_2:
+			message->data[0] = status.comp_data[comp_temp2].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_temp2].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_temp2].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_temp2].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_TEMP_3:
+			message->data[0] = status.comp_data[comp_temp3].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_temp3].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_temp3].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_temp3].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_TEMP_4:
+			message->data[0] = status.comp_data[comp_temp4].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_temp4].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_temp4].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_temp4].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_RET_PRESSURE:
+			message->data[0] = status.comp_data[comp_ret_pres].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_ret_pres].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_ret_pres].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_ret_pres].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_AUX_2:
+			message->data[0] = status.comp_data[comp_aux2].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_aux2].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_aux2].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_aux2].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_PRESSURE:
+			message->data[0] = status.comp_data[comp_sup_pres].data.chr_val[3];
+			message->data[1] = status.comp_data[comp_sup_pres].data.chr_val[2];
+			message->data[2] = status.comp_data[comp_sup_pres].data.chr_val[1];
+			message->data[3] = status.comp_data[comp_sup_pres].data.chr_val[0];
+			message->len = FLOAT_LEN;
+			break;
+
+		case GET_PRESSURE_ALARM:
+			message->data[0] = status.comp_data[comp_pres_alarm].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break; 
+
+		case GET_TEMP_ALARM:
+			message->data[0] = status.comp_data[comp_temp_alarm].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break; 
+
+		case GET_DRIVE_INDICATION:
+			message->data[0] = status.comp_data[comp_drive_ind].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_ICCU_STATUS:
+			message->data[0] = status.comp_data[comp_iccu_stat].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_ICCU_CABLE_DETECT:
+			message->data[0] = status.comp_data[comp_iccu_cable].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_FETIM_STATUS:
+			message->data[0] = status.comp_data[comp_fetim_stat].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_FETIM_CABLE:
+			message->data[0] = status.comp_data[comp_fetim_cable].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_INTERLOCK_OVERRIDE:
+			message->data[0] = status.comp_data[comp_intrlk_ovrd].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_ECU_TYPE:
+			message->data[0] = status.comp_data[comp_ecu_type].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_FAULT_STATUS:
+			message->data[0] = status.comp_data[comp_fault_stat].data.chr_val[0];
+			message->len = BYTE_LEN;
+			break;
+
+		case GET_SW_REVISION_LEVEL:
+			message->data[0] = status.comp_data[comp_sw_rev].data.chr_val[0];
+			message->data[1] = status.comp_data[comp_sw_rev].data.chr_val[1];
+			message->data[2] = status.comp_data[comp_sw_rev].data.chr_val[2];
+			message->len = REVISION_LEN;
+			break;
+
+		case GET_TIME_SINCE_LAST_POWER_ON:
+			if(REMOTE_OFF_OK(timerSec)){
+				message->data[0] = 0xFF;
+				message->data[1] = 0xFF;
+				message->data[2] = 0xFF;
+				message->data[3] = 0xFF;
+			} else {
+				message->data[0] = status.comp_data[comp_time_on].data.chr_val[3];
+				message->data[1] = status.comp_data[comp_time_on].data.chr_val[2];
+				message->data[2] = status.comp_data[comp_time_on].data.chr_val[1];
+				message->data[3] = status.comp_data[comp_time_on].data.chr_val[0];
+			}
+			message->len = ULONG_LEN;
+			break;
+
+		case GET_TIME_SINCE_LAST_POWER_OFF:
+			if(REMOTE_ON_OK(timerSec)){
+				message->data[0] = 0xFF;
+				message->data[1] = 0xFF;
+				message->data[2] = 0xFF;
+				message->data[3] = 0xFF;
+			} else {
+				message->data[0] = status.comp_data[comp_time_off].data.chr_val[3];
+				message->data[1] = status.comp_data[comp_time_off].data.chr_val[2];
+				message->data[2] = status.comp_data[comp_time_off].data.chr_val[1];
+				message->data[3] = status.comp_data[comp_time_off].data.chr_val[0];
+			}
+			message->len = ULONG_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	profileEnd(PROFILE_CAN_MONITOR);
+
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+/* Control requests */
+int control_msg(CAN_MSG_TYPE *message) {
+
+	profileBegin(PROFILE_CAN_CONTROL);
+
+	if(message->dirn==CAN_CONTROL){ // If control on control RCA
+		switch(message->relative_address){
+			case SET_REMOTE_DRIVE:
+				switch(message->data[0]){
+					case LOW:
+						if(bypassTimers||((rmtDrv==HIGH)&&REMOTE_OFF_OK(timerSec))){
+							rmtDrv = LOW;
+							lastOffSec=timerSec;
+						}
+						break;
+					case HIGH:
+						if(bypassTimers||((rmtDrv==LOW)&&REMOTE_ON_OK(timerSec))){
+							rmtDrv = HIGH;
+							lastOnSec=timerSec;
+						}
+						break;
+					default:
+						break;
+				}
+				lastRemoteDrive = message->data[0];
+				break;
+
+			case SET_REMOTE_RESET:
+				/* Generate a high pulse, not while P8.0 is an input for the 48ms pulse */
+				if(REMOTE_RST_DP&REMOTE_RST_MASK){
+					rmtRst = HIGH;
+					rmtRst = LOW;
+				}
+				lastRemoteReset = message->data[0];
+				break;
+
+			case SET_FAULT_LATCH_RESET:
+				/* Generate a high pulse */
+				fltRst = HIGH;
+				fltRst = LOW;
+				lastFaultLatchReset = message->data[0];
+				break;
+
+			case SET_PUSH_4K_CRYOCOOLER_TEMP:
+				status.cryo_data[cryo_temp_4k].data.chr_val[0]=message->data[3];
+				status.cryo_data[cryo_temp_4k].data.chr_val[1]=message->data[2];
+				status.cryo_data[cryo_temp_4k].data.chr_val[2]=message->data[1];
+				status.cryo_data[cryo_temp_4k].data.chr_val[3]=message->data[0];
+				status.cryo_data[cryo_temp_4k].time=timerSec;
+				break;
+
+			case SET_PUSH_15K_CRYOCOOLER_TEMP:
+				status.cryo_data[cryo_temp_15k].data.chr_val[0]=message->data[3];
+				status.cryo_data[cryo_temp_15k].data.chr_val[1]=message->data[2];
+				status.cryo_data[cryo_temp_15k].data.chr_val[2]=message->data[1];
+				status.cryo_data[cryo_temp_15k].data.chr_val[3]=message->data[0];
+				status.cryo_data[cryo_temp_15k].time=timerSec;
+				break;
+
+			case SET_PUSH_110K_CRYOCOOLER_TEMP:
+				status.cryo_data[cryo_temp_110k].data.chr_val[0]=message->data[3];
+				status.cryo_data[cryo_temp_110k].data.chr_val[1]=message->data[2];
+				status.cryo_data[cryo_temp_110k].data.chr_val[2]=message->data[1];
+				status.cryo_data[cryo_temp_110k].data.chr_val[3]=message->data[0];
+				status.cryo_data[cryo_temp_110k].time=timerSec;
+				break;
+
+			case SET_PUSH_PORT_PRESSURE:
+				status.cryo_data[cryo_pres_port].data.chr_val[0]=message->data[3];
+				status.cryo_data[cryo_pres_port].data.chr_val[1]=message->data[2];
+				status.cryo_data[cryo_pres_port].data.chr_val[2]=message->data[1];
+				status.cryo_data[cryo_pres_port].data.chr_val[3]=message->data[0];
+				status.cryo_data[cryo_pres_port].time=timerSec;
+				break;
+
+			case SET_PUSH_DEWAR_PRESSURE:
+				status.cryo_data[cryo_pres_dewar].data.chr_val[0]=message->data[3];
+				status.cryo_data[cryo_pres_dewar].data.chr_val[1]=message->data[2];
+				status.cryo_data[cryo_pres_dewar].data.chr_val[2]=message->data[1];
+				status.cryo_data[cryo_pres_dewar].data.chr_val[3]=message->data[0];
+				status.cryo_data[cryo_pres_dewar].time=timerSec;
+				break;
+
+			case SET_PUSH_GATE_VALVE_STATE:
+				status.cryo_data[cryo_gate_state].data.chr_val[0]=message->data[0];
+				status.cryo_data[cryo_gate_state].time=timerSec;
+				break;
+
+			case SET_PUSH_SOLENOID_VALVE_STATE:
+				status.cryo_data[cryo_sole_state].data.chr_val[0]=message->data[0];
+				status.cryo_data[cryo_sole_state].time=timerSec;
+				break;
+
+			case SET_PUSH_BACKING_PUMP_ENABLE:
+				status.cryo_data[cryo_back_ena].data.chr_val[0]=message->data[0];
+				status.cryo_data[cryo_back_ena].time=timerSec;
+				break;
+
+			case SET_PUSH_TURBO_PUMP_ENABLE:
+				status.cryo_data[cryo_turb_ena].data.chr_val[0]=message->data[0];
+				status.cryo_data[cryo_turb_ena].time=timerSec;
+				break;
+
+			case SET_PUSH_TURBO_PUMP_STATE:
+				status.cryo_data[cryo_turb_sta].data.chr_val[0]=message->data[0];
+				status.cryo_data[cryo_turb_sta].time=timerSec;
+				break;
+
+			case SET_PUSH_TURBO_PUMP_SPEED:
+				status.cryo_data[cryo_turb_spe].data.chr_val[0]=message->data[0];
+				status.cryo_data[cryo_turb_spe].time=timerSec;
+				break;
+
+			case SET_PUSH_CRYO_SUPPLY_CURRENT_230V:
+				status.cryo_data[cryo_sup_curr].data.chr_val[0]=message->data[3];
+				status.cryo_data[cryo_sup_curr].data.chr_val[1]=message->data[2];
+				status.cryo_data[cryo_sup_curr].data.chr_val[2]=message->data[1];
+				status.cryo_data[cryo_sup_curr].data.chr_val[3]=message->data[0];
+				status.cryo_data[cryo_sup_curr].time=timerSec;
+				break;
+
+			/* For troubleshooting use only RCA 0x2000 */
+			case SET_BYPASS_TIMERS:
+				bypassTimers = message->data[0];
+				lastBypassTimers = message->data[0];
+				break;
+
+
+			default:
+				break;
+		}
+	} else { // If monitor on control RCA
+		switch(message->relative_address){
+			case SET_REMOTE_DRIVE:
+				message->data[0] = lastRemoteDrive;
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_REMOTE_RESET:
+				message->data[0] = lastRemoteReset;
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_FAULT_LATCH_RESET:
+				message->data[0] = lastFaultLatchReset;
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_4K_CRYOCOOLER_TEMP:
+				message->data[3]=status.cryo_data[cryo_temp_4k].data.chr_val[0];
+				message->data[2]=status.cryo_data[cryo_temp_4k].data.chr_val[1];
+				message->data[1]=status.cryo_data[cryo_temp_4k].data.chr_val[2];
+				message->data[0]=status.cryo_data[cryo_temp_4k].data.chr_val[3];
+				message->len = FLOAT_LEN;
+				break;
+
+			case SET_PUSH_15K_CRYOCOOLER_TEMP:
+				message->data[3]=status.cryo_data[cryo_temp_15k].data.chr_val[0];
+				message->data[2]=status.cryo_data[cryo_temp_15k].data.chr_val[1];
+				message->data[1]=status.cryo_data[cryo_temp_15k].data.chr_val[2];
+				message->data[0]=status.cryo_data[cryo_temp_15k].data.chr_val[3];
+				message->len = FLOAT_LEN;
+				break;
+
+			case SET_PUSH_110K_CRYOCOOLER_TEMP:
+				message->data[3]=status.cryo_data[cryo_temp_110k].data.chr_val[0];
+				message->data[2]=status.cryo_data[cryo_temp_110k].data.chr_val[1];
+				message->data[1]=status.cryo_data[cryo_temp_110k].data.chr_val[2];
+				message->data[0]=status.cryo_data[cryo_temp_110k].data.chr_val[3];
+				message->len = FLOAT_LEN;
+				break;
+
+			case SET_PUSH_PORT_PRESSURE:
+				message->data[3]=status.cryo_data[cryo_pres_port].data.chr_val[0];
+				message->data[2]=status.cryo_data[cryo_pres_port].data.chr_val[1];
+				message->data[1]=status.cryo_data[cryo_pres_port].data.chr_val[2];
+				message->data[0]=status.cryo_data[cryo_pres_port].data.chr_val[3];
+				message->len = FLOAT_LEN;
+				break;
+
+			case SET_PUSH_DEWAR_PRESSURE:
+				message->data[3]=status.cryo_data[cryo_pres_dewar].data.chr_val[0];
+				message->data[2]=status.cryo_data[cryo_pres_dewar].data.chr_val[1];
+				message->data[1]=status.cryo_data[cryo_pres_dewar].data.chr_val[2];
+				message->data[0]=status.cryo_data[cryo_pres_dewar].data.chr_val[3];
+				message->len = FLOAT_LEN;
+				break;
+
+			case SET_PUSH_GATE_VALVE_STATE:
+				message->data[0]=status.cryo_data[cryo_gate_state].data.chr_val[0];
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_SOLENOID_VALVE_STATE:
+				message->data[0]=status.cryo_data[cryo_sole_state].data.chr_val[0];
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_BACKING_PUMP_ENABLE:
+				message->data[0]=status.cryo_data[cryo_back_ena].data.chr_val[0];
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_TURBO_PUMP_ENABLE:
+				message->data[0]=status.cryo_data[cryo_turb_ena].data.chr_val[0];
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_TURBO_PUMP_STATE:
+				message->data[0]=status.cryo_data[cryo_turb_sta].data.chr_val[0];
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_TURBO_PUMP_SPEED:
+				message->data[0]=status.cryo_data[cryo_turb_spe].data.chr_val[0];
+				message->len = BYTE_LEN;
+				break;
+
+			case SET_PUSH_CRYO_SUPPLY_CURRENT_230V:
+				message->data[3]=status.cryo_data[cryo_sup_curr].data.chr_val[0];
+				message->data[2]=status.cryo_data[cryo_sup_curr].data.chr_val[1];
+				message->data[1]=status.cryo_data[cryo_sup_curr].data.chr_val[2];
+				message->data[0]=status.cryo_data[cryo_sup_curr].data.chr_val[3];
+				message->len = FLOAT_LEN;
+				break;
+
+			/* For troubleshooting use only RCA 0x2000 */
+			case SET_BYPASS_TIMERS:
+				message->data[0] = lastBypassTimers;
+				break;
+
+			default: 
+				break;
+		}
+	}
+
+	profileEnd(PROFILE_CAN_CONTROL);
+
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+/* Edge capture journal requests */
+int journal_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	JOURNAL_EVENT event;
+	ubyte cnt;
+	uword value;
+
+	/* Not before the journal is started */
+	if(bootBusy(message)){
+		return 0;
+	}
+
+	if(message->dirn==CAN_CONTROL){ // If control on control RCA
+		if(message->relative_address==SET_EDGE_JOURNAL_CLEAR){
+			journalClear();
+			lastEdgeJournalClear = message->data[0];
+		}
+		return 0;
+	}
+
+	/* Perform the monitor operation */
+	switch(message->relative_address){
+		case GET_EDGE_JOURNAL:
+			/* Return and remove the oldest event */
+			if(journalRead(&event)){
+				journalPut(message->data,&event);
+			} else {
+				message->data[0] = JOURNAL_NO_EVENT;
+				for(cnt=1;cnt<JOURNAL_LEN;cnt++){
+					message->data[cnt] = 0;
+				}
+			}
+			message->len = JOURNAL_LEN;
+			break;
+
+		case GET_EDGE_COUNTS:
+			/* Pressure alarm, temperature alarm, drive indicator and fault status */
+			for(cnt=0;cnt<JOURNAL_LINES;cnt++){
+				value = journalGetCount(cnt);
+				message->data[2*cnt] = (ubyte)(value>>8);
+				message->data[2*cnt+1] = (ubyte)(value);
+			}
+			message->len = COUNTS_LEN;
+			break;
+
+		case GET_EDGE_JOURNAL_STATUS:
+			value = journalGetLost();
+			message->data[0] = journalGetPending();
+			message->data[1] = (ubyte)(value>>8);
+			message->data[2] = (ubyte)(value);
+			message->len = JOURNAL_STATUS_LEN;
+			break;
+
+		case SET_EDGE_JOURNAL_CLEAR:
+			message->data[0] = lastEdgeJournalClear;
+			message->len = BYTE_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+/* Edge capture journal as a segmented transfer (library RCA 0x31002): the
+   pending events, oldest first, in the GET_EDGE_JOURNAL format. Reading
+   does not remove them */
+int journal_block(ulong relative_address, ulong offset, ubyte *data, ubyte len) {
+
+	/* Not before the journal is started */
+	if(!bootReady){
+		return -1;
+	}
+
+	if(relative_address!=GET_EDGE_JOURNAL){
+		return -1;
+	}
+
+	return journalReadBlock(offset,data,len);
+}
+
+
+
+
+
+
+
+/* RS232 port configuration requests */
+int serial_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	ulong baud;
+
+	/* Not before the serial driver is started */
+	if(bootBusy(message)){
+		return 0;
+	}
+
+	if(message->dirn==CAN_CONTROL){ // If control on control RCA
+		switch(message->relative_address){
+			case SET_SERIAL_MODE:
+				if(message->data[0]<=SERIAL_MODE_BINARY){
+					serialMode = message->data[0];
+				}
+				break;
+
+			case SET_SERIAL_BAUD:
+				/* Applied by the serial driver once the queued messages are sent */
+				baud = ((ulong)message->data[0]<<24)|((ulong)message->data[1]<<16)|((ulong)message->data[2]<<8)|message->data[3];
+				serialSetBaud(baud);
+				break;
+
+			case SET_SERIAL_PERIOD:
+				if(message->data[0]){
+					serialPeriod = message->data[0];
+				}
+				break;
+
+			case SET_SERIAL_DELTA:
+				serialDelta = message->data[0] ? 1 : 0;
+				break;
+
+			default:
+				break;
+		}
+		return 0;
+	}
+
+	/* Perform the monitor operation */
+	switch(message->relative_address){
+		case SET_SERIAL_MODE:
+			message->data[0] = serialMode;
+			message->len = BYTE_LEN;
+			break;
+
+		case SET_SERIAL_BAUD:
+			baud = serialGetBaud();
+			message->data[0] = (ubyte)(baud>>24);
+			message->data[1] = (ubyte)(baud>>16);
+			message->data[2] = (ubyte)(baud>>8);
+			message->data[3] = (ubyte)(baud);
+			message->len = SERIAL_BAUD_LEN;
+			break;
+
+		case SET_SERIAL_PERIOD:
+			message->data[0] = serialPeriod;
+			message->len = BYTE_LEN;
+			break;
+
+		case SET_SERIAL_DELTA:
+			message->data[0] = serialDelta;
+			message->len = BYTE_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+/* Error library requests */
+int error_msg(CAN_MSG_TYPE *message) {
+
+	/* Not before the error library is started */
+	if(bootBusy(message)){
+		return 0;
+	}
+
+	switch(message->relative_address){
+		case GET_ERROR_STATUS:
+			if(message->dirn==CAN_MONITOR){
+				write_error_CAN(message);
+			}
+			break;
+
+		case GET_ERROR_EVENT:
+			if(message->dirn==CAN_MONITOR){
+				read_error_CAN(message);
+			}
+			break;
+
+		case SET_ERROR_CURSOR:
+			cursor_error_CAN(message);
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+/* Error library history as a segmented transfer (library RCA 0x31002):
+   the events kept, oldest first, in the GET_ERROR_EVENT format */
+int error_block(ulong relative_address, ulong offset, ubyte *data, ubyte len) {
+
+	/* Not before the error library is started */
+	if(!bootReady){
+		return -1;
+	}
+
+	if(relative_address!=GET_ERROR_EVENT){
+		return -1;
+	}
+
+	return read_error_block(offset,data,len);
+}
+
+
+
+/* Restart and boot requests */
+int restart_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	ulong time;
+
+	if(message->dirn==CAN_CONTROL){ // Monitor only
+		return 0;
+	}
+
+	/* Microseconds to reach a boot phase (BOOT_NOT_REACHED if not yet) */
+	if((message->relative_address>=FIRST_BOOT_PHASE)&&(message->relative_address<=LAST_BOOT_PHASE)){
+		time = bootStamp[message->relative_address-FIRST_BOOT_PHASE];
+		message->data[0] = (ubyte)(time>>24);
+		message->data[1] = (ubyte)(time>>16);
+		message->data[2] = (ubyte)(time>>8);
+		message->data[3] = (ubyte)(time);
+		message->len = ULONG_LEN;
+		return 0;
+	}
+
+	/* How the node last started, the number of warm restarts and the time
+	   from the reset request to serving CAN again in us */
+	message->data[0] = restartKind;
+	message->data[1] = (ubyte)(warmRestarts>>8);
+	message->data[2] = (ubyte)(warmRestarts);
+	message->data[3] = (ubyte)(restartTime>>24);
+	message->data[4] = (ubyte)(restartTime>>16);
+	message->data[5] = (ubyte)(restartTime>>8);
+	message->data[6] = (ubyte)(restartTime);
+	message->len = RESTART_STATUS_LEN;
+
+	return 0;
+}
+
+
+
+/* Stack requests */
+int stack_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	ubyte stack;
+	uword value;
+
+	if(message->dirn==CAN_CONTROL){ // Monitor only
+		return 0;
+	}
+
+	/* Size and bytes ever used of the system stack, then the user stack */
+	for(stack=0;stack<STACK_NUMBER;stack++){
+		value = stackGetSize(stack);
+		message->data[4*stack] = (ubyte)(value>>8);
+		message->data[4*stack+1] = (ubyte)(value);
+		value = stackGetMaxUsed(stack);
+		message->data[4*stack+2] = (ubyte)(value>>8);
+		message->data[4*stack+3] = (ubyte)(value);
+	}
+	message->len = STACK_USAGE_LEN;
+
+	return 0;
+}
+
+
+
+/* Profiler requests */
+int profile_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	PROFILE_REGION stats;
+	uword value;
+
+	if(message->dirn==CAN_CONTROL){ // If control on control RCA
+		if(message->relative_address==SET_PROFILE_CLEAR){
+			profileClear();
+			lastProfileClear = message->data[0];
+		}
+		return 0;
+	}
+
+	/* Perform the monitor operation */
+	if((message->relative_address>=FIRST_PROFILE_REGION)&&(message->relative_address<=LAST_PROFILE_REGION)){
+		/* Count, total and longest time of a region in PROFILE_TICK_NS units (the
+		   longest saturates at PROFILE_MAX_SAT, 26 ms) */
+		profileRead(message->relative_address-FIRST_PROFILE_REGION,&stats);
+		message->data[0] = (ubyte)(stats.count>>8);
+		message->data[1] = (ubyte)(stats.count);
+		message->data[2] = (ubyte)(stats.total>>24);
+		message->data[3] = (ubyte)(stats.total>>16);
+		message->data[4] = (ubyte)(stats.total>>8);
+		message->data[5] = (ubyte)(stats.total);
+		message->data[6] = (ubyte)(stats.max>>8);
+		message->data[7] = (ubyte)(stats.max);
+		message->len = PROFILE_LEN;
+		return 0;
+	}
+
+	switch(message->relative_address){
+		case GET_CPU_LOAD:
+			/* Last second and peak, in hundredths of percent */
+			value = profileGetLoad();
+			message->data[0] = (ubyte)(value>>8);
+			message->data[1] = (ubyte)(value);
+			value = profileGetPeakLoad();
+			message->data[2] = (ubyte)(value>>8);
+			message->data[3] = (ubyte)(value);
+			message->len = CPU_LOAD_LEN;
+			break;
+
+		case SET_PROFILE_CLEAR:
+			message->data[0] = lastProfileClear;
+			message->len = BYTE_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+/* Idle mode requests */
+int idle_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	ubyte source;
+	uword value;
+	ulong total;
+
+	if(message->dirn==CAN_CONTROL){ // Monitor only
+		return 0;
+	}
+
+	switch(message->relative_address){
+		case GET_IDLE_STATUS:
+			/* Time asleep and CPU load of the last second, in hundredths of
+			   percent, and the wakeups since startup */
+			value = idleGetFraction();
+			message->data[0] = (ubyte)(value>>8);
+			message->data[1] = (ubyte)(value);
+			value = profileGetLoad();
+			message->data[2] = (ubyte)(value>>8);
+			message->data[3] = (ubyte)(value);
+			total = idleGetTotalWakeups();
+			message->data[4] = (ubyte)(total>>24);
+			message->data[5] = (ubyte)(total>>16);
+			message->data[6] = (ubyte)(total>>8);
+			message->data[7] = (ubyte)(total);
+			message->len = IDLE_STATUS_LEN;
+			break;
+
+		case GET_IDLE_WAKEUPS:
+			/* Wakeups of the last second: timer, serial, CAN and other interrupts */
+			for(source=0;source<IDLE_SOURCES;source++){
+				value = idleGetWakeups(source);
+				message->data[2*source] = (ubyte)(value>>8);
+				message->data[2*source+1] = (ubyte)(value);
+			}
+			message->len = IDLE_WAKEUPS_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+/* Timing event requests */
+int te_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	ulong count;
+	uword value;
+
+	if(message->dirn==CAN_CONTROL){ // If control on control RCA
+		if(message->relative_address==SET_TE_PHASE){
+			teSetPhase(((uword)message->data[0]<<8)|message->data[1]);
+		}
+		return 0;
+	}
+
+	/* Perform the monitor operation */
+	switch(message->relative_address){
+		case GET_TE_STATUS:
+			/* Lock state, timing events since the first one and missing ones */
+			message->data[0] = teGetState();
+			count = teGetCount();
+			message->data[1] = (ubyte)(count>>24);
+			message->data[2] = (ubyte)(count>>16);
+			message->data[3] = (ubyte)(count>>8);
+			message->data[4] = (ubyte)(count);
+			value = teGetMissed();
+			message->data[5] = (ubyte)(value>>8);
+			message->data[6] = (ubyte)(value);
+			message->len = TE_STATUS_LEN;
+			break;
+
+		case GET_TE_CLOCK:
+			/* Timebase correction in hundredths of ppm and offset of the last
+			   timing event from the 48 ms grid in microseconds (both signed) */
+			value = (uword)(((long)timebaseGetTrim()*100)/16);
+			message->data[0] = (ubyte)(value>>8);
+			message->data[1] = (ubyte)(value);
+			value = (uword)teGetOffset();
+			message->data[2] = (ubyte)(value>>8);
+			message->data[3] = (ubyte)(value);
+			message->len = TE_CLOCK_LEN;
+			break;
+
+		case GET_SAMPLE_TE:
+			/* Timing event the last sampling of the compressor points was
+			   timed from (0xFFFFFFFF if not on a timing event) and phase */
+			count = sampleTe;
+			message->data[0] = (ubyte)(count>>24);
+			message->data[1] = (ubyte)(count>>16);
+			message->data[2] = (ubyte)(count>>8);
+			message->data[3] = (ubyte)(count);
+			value = teGetPhase();
+			message->data[4] = (ubyte)(value>>8);
+			message->data[5] = (ubyte)(value);
+			message->len = SAMPLE_TE_LEN;
+			break;
+
+		case SET_TE_PHASE:
+			value = teGetPhase();
+			message->data[0] = (ubyte)(value>>8);
+			message->data[1] = (ubyte)(value);
+			message->len = TE_PHASE_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+
+/* Point directory requests. Served from the start: the master can read it
+   before the slower modules are up */
+int directory_msg(CAN_MSG_TYPE *message) {
+
+	/* Some locals */
+	uword bytes;
+	ubyte cnt;
+
+	if(message->dirn==CAN_CONTROL){ // If control on control RCA
+		if(message->relative_address==SET_DIRECTORY_CURSOR){
+			directoryCursor = message->data[0];
+		}
+		return 0;
+	}
+
+	/* Perform the monitor operation */
+	switch(message->relative_address){
+		case GET_DIRECTORY_STATUS:
+			/* Entries, entry length, directory length in bytes and software
+			   revision: the master can keep the directory of a revision */
+			bytes = (uword)directoryCount*DIRECTORY_ENTRY_LEN;
+			message->data[0] = directoryCount;
+			message->data[1] = DIRECTORY_ENTRY_LEN;
+			message->data[2] = (ubyte)(bytes>>8);
+			message->data[3] = (ubyte)(bytes);
+			message->data[4] = MAJOR;
+			message->data[5] = MINOR;
+			message->data[6] = PATCH;
+			message->len = DIRECTORY_STATUS_LEN;
+			break;
+
+		case GET_DIRECTORY_ENTRY:
+			/* Entry at the cursor, which moves on. Past the last one the
+			   entry is all 0 (no RCAs) and the cursor stays */
+			if(directoryCursor<directoryCount){
+				directoryPut(message->data,directoryCursor++);
+			} else {
+				for(cnt=0;cnt<DIRECTORY_ENTRY_LEN;cnt++){
+					message->data[cnt] = 0;
+				}
+			}
+			message->len = DIRECTORY_ENTRY_LEN;
+			break;
+
+		case SET_DIRECTORY_CURSOR:
+			message->data[0] = directoryCursor;
+			message->len = BYTE_LEN;
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+
+/* Point directory as a segmented transfer (library RCA 0x31002): the
+   published entries, GET_DIRECTORY_ENTRY format, one after the other */
+int directory_block(ulong relative_address, ulong offset, ubyte *data, ubyte len) {
+
+	/* Some locals */
+	ubyte entry[DIRECTORY_ENTRY_LEN];
+	ubyte cnt, pos;
+
+	if(relative_address!=GET_DIRECTORY_ENTRY){
+		return -1;
+	}
+
+	for(cnt=0;cnt<len;cnt++,offset++){
+		if(offset>=(ulong)directoryCount*DIRECTORY_ENTRY_LEN){
+			break;
+		}
+		pos = (ubyte)(offset%DIRECTORY_ENTRY_LEN);
+		if((cnt==0)||(pos==0)){
+			directoryPut(entry,(ubyte)(offset/DIRECTORY_ENTRY_LEN));
+		}
+		data[cnt] = entry[pos];
+	}
+
+	return cnt;
+}
+
+
+
+/* Configures the Timer 4 interrupt. Timer 4 itself is not run: the
+   interrupt is requested by the timebase or by the timing events */
+void GPT1_vInit(void)
+{
+  ///  -----------------------------------------------------------------------
+  ///  Configuration of the GPT1 Core Timer 4:
+  ///  -----------------------------------------------------------------------
+  ///  - timer 4 works in timer mode
+  ///  - maximum input frequency for timer 4 is 2.5 MHz
+  ///  - prescaler factor is 32
+  ///  - up/down control bit is reset
+  ///  - external up/down control is disabled
+  ///  - timer 4 run bit is reset
+
+  T4CON          =  0x0002;      // load timer 4 control register
+  T4             =  0x0000;      // load timer 4 register
+
+  ///  -----------------------------------------------------------------------
+  ///  Configuration of the used GPT1 Interrupts:
+  ///  -----------------------------------------------------------------------
+  ///  - timer 4 service request node configuration:
+  ///  - timer 4 interrupt priority level (ILVL) = 11
+  ///  - timer 4 interrupt group level (GLVL) = 3
+
+  T4IC           =  0x006F;     
+
+
+} //  End of function GPT1_vInit
+
+
+
+
+
+
+
+
+/* Called by the timebase every tick (50 msec, timebase interrupt). Counts
+   the seconds and paces the sampling */
+void timerTick(void){
+
+	timerTicks++;
+
+	/* Timing events still coming */
+	if(USE_48MS){
+		teTick();
+	}
+
+	/* Sample the compressor points, unless the timing events do */
+	if(((timerTicks%SAMPLE_TICKS)==0)&&(teGetState()!=TE_LOCKED)){
+		triggerSampling();
+	}
+
+	if(timerTicks<TIMEBASE_TICKS_PER_SEC){
+		return;
+	}
+	timerTicks = 0;
+
+	profileBegin(PROFILE_SECOND);
+	
+	/* Increase seconds timer */
+	timerSec++;
+
+	/* Time base for the CAN error rates */
+	amb_second_tick();
+
+	/* CPU load of the last second */
+	profileSecond();
+	idleSecond();
+
+	/* The main loop paces the RS232 messages on the seconds */
+	idleWake(IDLE_WAKE_TIMER);
+
+	profileEnd(PROFILE_SECOND);
+
+} 
+
+
+
+/* Sample the compressor points at the lower priority of the T4 interrupt */
+void triggerSampling(void){
+
+	T4IR = 1;
+
+}
+
+
+
+/* Seconds since power on, for the code running below the timebase
+   interrupt: the two words of timerSec can change between their reads */
+ulong timerSecNow(void){
+
+	/* Some locals */
+	ulong now;
+
+	do {
+		now = timerSec;
+	} while(now!=timerSec);
+
+	return now;
+}
+
+
+
+/* Triggered every SAMPLE_TICKS timebase ticks (100 msec), or at the set
+   phase of every other timing event (96 msec) while they are locked */
+void GPT1_viTmr4(void) interrupt 0x24 {
+
+	/* A local counter for loops */
+	ubyte cnt;
+
+	/* Some locals */
+	ulong now;
+	ubyte ien;
+
+	profileBegin(PROFILE_T4);
+
+	/* One time for all the points */
+	now = timerSecNow();
+
+	/* The timing event interrupt may change it, the CAN one may read it */
+	ien = IEN;
+	IEN = 0;
+	sampleTe = teGetSampleCount();
+	IEN = ien;
+
+	/* Loop over the compressor monitor points and store the values */
+	for(cnt=comp_min_item;cnt<comp_max_item+1;cnt++){
+		switch(cnt){
+			case comp_temp1:
+				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T1));
+				break;
+			case comp_temp2:
+				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T2));
+				break;
+			case comp_temp3:
+				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T3));
+				break;
+			case comp_temp4:
+				status.comp_data[cnt].data.flt_val = TEMP(get_adc_single(CH_T4));
+				break;
+			case comp_ret_pres:
+				status.comp_data[cnt].data.flt_val = PRESSURE(get_adc_single(CH_RET_PRES));
+				break;
+			case comp_aux2:
+				status.comp_data[cnt].data.flt_val = AUX(get_adc_single(CH_AUX2));
+				break;
+			case comp_sup_pres:
+				status.comp_data[cnt].data.flt_val = PRESSURE(get_adc_single(CH_PRESS));
+				break;
+			case comp_pres_alarm:
+				status.comp_data[cnt].data.chr_val[0] = INVERT(pAlarm);
+				break;
+			case comp_temp_alarm:
+				status.comp_data[cnt].data.chr_val[0] = INVERT(tAlarm);
+				break;
+			case comp_drive_ind:
+				status.comp_data[cnt].data.chr_val[0] = drvInd;
+				break;
+			case comp_iccu_stat:
+				status.comp_data[cnt].data.chr_val[0] = INVERT(iccuSt);
+				break;
+			case comp_iccu_cable:
+				status.comp_data[cnt].data.chr_val[0] = iccuCb;
+				break;
+			case comp_fetim_stat:
+				status.comp_data[cnt].data.chr_val[0] = INVERT(fetimS);
+				break;
+			case comp_fetim_cable:
+				status.comp_data[cnt].data.chr_val[0] = INVERT(fetimC);
+				break;
+			case comp_intrlk_ovrd:
+				status.comp_data[cnt].data.chr_val[0] = intOvr;
+				break;
+			case comp_ecu_type:
+				status.comp_data[cnt].data.chr_val[0] = ecuTyp;
+				break;
+			case comp_fault_stat:
+				status.comp_data[cnt].data.chr_val[0] = faultS;
+				break;
+			case comp_sw_rev:
+				status.comp_data[cnt].data.chr_val[0] = MAJOR;
+				status.comp_data[cnt].data.chr_val[1] = MINOR;
+				status.comp_data[cnt].data.chr_val[2] = PATCH;
+				break;
+			case comp_time_on:
+				status.comp_data[cnt].data.ulng_val = REMOTE_ON_SEC(now);
+				break;
+			case comp_time_off:
+				status.comp_data[cnt].data.ulng_val = REMOTE_OFF_SEC(now);
+				break;
+			default:
+				break;
+		}
+
+		status.comp_data[cnt].time = now; // store time info
+	}
+
+	/* New samples for the alarm changes */
+	idleWake(IDLE_WAKE_TIMER);
+
+	profileEnd(PROFILE_T4);
+}
+
@@ -0,0 +1,252 @@
+#include <reg167.h>
+
+#include "profile.h"
+
+/* Defines */
+#define PROFILE_TICKS_PER_LOAD	(1000000000L/PROFILE_TICK_NS/PROFILE_LOAD_FULL)	// Idle ticks in 0.01% of a second
+
+/* Static */
+static PROFILE_REGION profile[PROFILE_REGIONS];
+
+static unsigned long volatile profileIdle;		// Idle ticks in the current second
+static unsigned int volatile profileLoad;		// CPU load of the last second
+static unsigned int volatile profilePeak;		// Highest CPU load
+static unsigned int volatile profileWraps;		// T6 overflows: upper half of the profiling clock
+
+/* Prototypes */
+static unsigned long profileClock(void);
+
+
+
+/* Start the free running profiling timer and clear the statistics */
+void profileInit(void){
+
+	profileClear();
+
+	profileWraps = 0;
+	T6 = 0x0000;
+	T6CON = 0x0041;		/* SET TIMER 6:
+							- timer mode
+							- prescaler 8 (0.4 usec resolution)
+							- count up
+							- run bit is set */
+	T6IC = 0x006C;		/* SET TIMER 6 INTERRUPT:
+							- overflows counted in profileWraps
+							- interrupt priority level (ILVL) = 11
+							- interrupt group level (GLVL) = 0 */
+
+}
+
+
+
+/* Count the T6 overflows */
+void profileT6Irq(void) interrupt T6INT = 0x26 {
+
+	profileWraps++;
+
+}
+
+
+
+/* The profiling clock: T6 and its overflows. An overflow whose interrupt
+   is still pending (higher level code running) is counted here */
+static unsigned long profileClock(void){
+
+	/* Some locals */
+	unsigned int high, low;
+	unsigned char ien;
+
+	ien = IEN;
+	IEN = 0;
+
+	high = profileWraps;
+	low = T6;
+	if(T6IR&&(low<0x8000)){
+		high++;
+	}
+
+	IEN = ien;
+
+	return ((unsigned long)high<<16)|low;
+}
+
+
+
+/* Mark the start of a region */
+void profileBegin(unsigned char region){
+
+	profile[region].start = profileClock();
+	profile[region].running = 1;
+
+}
+
+
+
+/* Mark the end of a region and add its time to the statistics */
+void profileEnd(unsigned char region){
+
+	/* Some locals */
+	unsigned long ticks;
+	unsigned char ien;
+	PROFILE_REGION *stats = &profile[region];
+
+	ticks = profileClock()-stats->start;
+	if(!stats->running){
+		return;
+	}
+
+	/* The CAN interrupt must not read a partial update */
+	ien = IEN;
+	IEN = 0;
+
+	stats->running = 0;
+	if((stats->count<0xFFFF)&&(stats->total<=0xFFFFFFFFL-ticks)){
+		stats->count++;
+		stats->total += ticks;
+		if(ticks>stats->max){
+			stats->max = (ticks<PROFILE_MAX_SAT) ? (unsigned int)ticks : PROFILE_MAX_SAT;
+		}
+	}
+
+	if(region==PROFILE_IDLE){
+		profileIdle += ticks;
+	}
+
+	IEN = ien;
+
+}
+
+
+
+/* Mark the end of a region that found nothing to do. A task that polls
+   is idle then: its time goes to the idle time, not to its statistics */
+void profileEndIdle(unsigned char region){
+
+	/* Some locals */
+	unsigned long ticks;
+	unsigned char ien;
+	PROFILE_REGION *stats = &profile[region];
+
+	ticks = profileClock()-stats->start;
+	if(!stats->running){
+		return;
+	}
+
+	ien = IEN;
+	IEN = 0;
+
+	stats->running = 0;
+	profileIdle += ticks;
+
+	IEN = ien;
+
+}
+
+
+
+/* Add idle time measured outside the regions, as the time asleep in idle
+   mode (timed by the idle module with the timebase clock) */
+void profileIdleAdd(unsigned long ticks){
+
+	profileIdle += ticks;
+
+}
+
+
+
+/* Turn the idle time of the last second into the CPU load */
+void profileSecond(void){
+
+	/* Some locals */
+	unsigned long idle;
+
+	idle = profileIdle/PROFILE_TICKS_PER_LOAD;
+	profileIdle = 0;
+
+	profileLoad = (idle<PROFILE_LOAD_FULL) ? (unsigned int)(PROFILE_LOAD_FULL-idle) : 0;
+	if(profileLoad>profilePeak){
+		profilePeak = profileLoad;
+	}
+
+}
+
+
+
+/* Copy the statistics of a region */
+void profileRead(unsigned char region, PROFILE_REGION *stats){
+
+	/* Some locals */
+	unsigned char ien;
+
+	ien = IEN;
+	IEN = 0;
+	*stats = profile[region];
+	IEN = ien;
+
+}
+
+
+
+/* CPU load of the last second in hundredths of percent */
+unsigned int profileGetLoad(void){
+
+	return profileLoad;
+}
+
+
+
+/* Highest CPU load since the statistics were cleared */
+unsigned int profileGetPeakLoad(void){
+
+	return profilePeak;
+}
+
+
+
+/* Clear the statistics. Regions in progress are still timed when they end */
+void profileClear(void){
+
+	/* Some locals */
+	unsigned char region;
+	unsigned char ien;
+
+	ien = IEN;
+	IEN = 0;
+
+	for(region=0;region<PROFILE_REGIONS;region++){
+		profile[region].count = 0;
+		profile[region].total = 0;
+		profile[region].max = 0;
+	}
+	profilePeak = 0;
+
+	IEN = ien;
+
+}
+
+
+
+/* Time the CAN interrupt, called by the slave library on entry and exit */
+void profileCanHook(unsigned char begin){
+
+	if(begin){
+		profileBegin(PROFILE_CAN);
+	} else {
+		profileEnd(PROFILE_CAN);
+	}
+
+}
+
+
+
+/* Time the 1-Wire engine, called by the ds1820 library on entry and exit
+   of the Timer 2 interrupt */
+void profileOnewireHook(unsigned char begin){
+
+	if(begin){
+		profileBegin(PROFILE_ONEWIRE);
+	} else {
+		profileEnd(PROFILE_ONEWIRE);
+	}
+
+}
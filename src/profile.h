@@ -0,0 +1,52 @@
+#ifndef _PROFILE_H
+
+	#define _PROFILE_H
+
+	/* Defines */
+	#define PROFILE_TICK_NS		400		// T6 runs at fCPU/8, its overflows extend it to 32 bits
+	#define PROFILE_MAX_SAT		0xFFFF	// Longest run shown: 26 ms or longer
+	#define PROFILE_LOAD_FULL	10000	// CPU load of a fully busy second (hundredths of percent)
+
+	/* Profiled regions. Each one is entered from a single context, and the
+	   time of the interrupts taken inside a region is counted in it */
+	#define PROFILE_SECOND		0		// Second counter (timebase interrupt)
+	#define PROFILE_T4			1		// Timer 4 interrupt: ADC and digital input sampling
+	#define PROFILE_CAN_MONITOR	2		// Compressor monitor requests (CAN interrupt)
+	#define PROFILE_CAN_CONTROL	3		// Compressor control requests (CAN interrupt)
+	#define PROFILE_AMBIENT		4		// DS1820 background reading
+	#define PROFILE_CONSOLE		5		// RS232 console commands
+	#define PROFILE_ALARM		6		// Alarm change printing
+	#define PROFILE_MESSAGE		7		// Text message formatting (buildMessage)
+	#define PROFILE_FRAME		8		// Binary telemetry frame (buildFrame)
+	#define PROFILE_IDLE		9		// Main loop awake and waiting (time asleep and task runs with no work are only added to the load)
+	#define PROFILE_CAN			10		// CAN interrupt as a whole, the callbacks included
+	#define PROFILE_ONEWIRE		11		// 1-Wire engine (Timer 2 interrupt)
+	#define PROFILE_REGIONS		12
+
+	/* Typedefs */
+	/* Statistics of a region. The count and the total stop together when
+	   either would overflow, so total/count stays the mean */
+	typedef struct {
+		unsigned int	count;		// Times the region was run
+		unsigned long	total;		// Time spent in it in PROFILE_TICK_NS units
+		unsigned int	max;		// Longest run in PROFILE_TICK_NS units (PROFILE_MAX_SAT at most)
+		unsigned long	start;		// Profiling clock at profileBegin
+		unsigned char	running;	// Between profileBegin and profileEnd (1:yes)
+	} PROFILE_REGION;
+
+	/* Prototypes */
+	/* Externs */
+	extern void profileInit(void);
+	extern void profileBegin(unsigned char region);
+	extern void profileEnd(unsigned char region);	// Ignored if the region was not begun
+	extern void profileEndIdle(unsigned char region);	// Same, for a run that found no work: its time is idle
+	extern void profileIdleAdd(unsigned long ticks);	// Idle time timed elsewhere (call with interrupts disabled)
+	extern void profileSecond(void);				// Call once per second (timer interrupt)
+	extern void profileRead(unsigned char region, PROFILE_REGION *stats);
+	extern unsigned int profileGetLoad(void);		// Last second, hundredths of percent
+	extern unsigned int profileGetPeakLoad(void);	// Highest since cleared
+	extern void profileClear(void);
+	extern void profileCanHook(unsigned char begin);		// Given to the slave library (amb_set_profile_hook)
+	extern void profileOnewireHook(unsigned char begin);	// Given to the ds1820 library (ds1820_set_profile_hook)
+
+#endif /* _PROFILE_H */
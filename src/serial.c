@@ -1,95 +1,397 @@
-#include <reg167.h>
-#include <intrins.h>
-#include <string.h>
-
-#include "serial.h"
-
-/* Static */
-static char idata serialTxBuffer[SER_TX_BUF_SIZE];
-
-static char msgTerm;
-
-static char volatile bdata serialStatus;
-sbit serialTxBusy = serialStatus^0;
-sbit serialTxBufOvr	= serialStatus^2;
-
-
-
-/* Initialize serial port */
-void serialInit(char termination){
-
-	/* Set port 3 to handle serial communication */
-	P3  |= 0x0400;        /* SET PORT 3.10 OUTPUT LATCH (TXD)              */
-	DP3 |= 0x0400;        /* SET PORT 3.10 DIRECTION CONTROL (TXD OUTPUT)  */
-	DP3 &= 0xF7FF;        /* RESET PORT 3.11 DIRECTION CONTROL (RXD INPUT) */
-
-	/* Set serial mode */	
-	S0BG  = 0x20;         /* SET BAUDRATE TO 19200 BAUD                    */
-	S0CON = 0x8011;       /* SET SERIAL MODE:
-								- asynchronous
-								- 8-N-1
-								- rx enabled
-								- baud generator enabled */
-	
-	/* Set interrupts */
-	S0TIC = 0x0078;       /* SET TRANSMIT INTERRUPT:
-								- Tx Irq flag cleared
-								- Tx Irq enable
-								- PEC service channel 0:
-									- ILVL = 14
-									- GLVL = 0 */
-
-	/* Setup termination character */
-	msgTerm = termination;
-
-	/* Set up PEC channels */
-	/* Tx: PEC channel 0 */
-	DSTP0 = (unsigned int)&S0TBUF;		/* DSTP0 points to the hardware tx buffer */
-
-}
-
-
-
-
-
-/* Writes the message to the serial port */
-void serialWrite(void *message, unsigned char size){
-
-	/* Clear the Tx buffer overrun if any */
-	serialTxBufOvr=0;
-
-	/* If the size of the message is bigger than the buffer, return */
-	if(size>SER_TX_BUF_SIZE){
-		serialTxBufOvr=1;
-		return;
-	}
-
-	/* Copy message to the serial Tx buffer */
-	memcpy(serialTxBuffer, message, (unsigned int)size);
-
-	/* Setup PEC channel 0 */
-	PECC0 = 0x0500 | size; 		/* Transfer 1 byte, increment SRCP0 and send a total of *size bytes */	
-	SRCP0 = _sof_ (serialTxBuffer);	/* SRCP0 points to the transmit buffer */
-	
-	/* Notify the status that the serial Tx is busy */
-	serialTxBusy=1;
-
-	/* Trigger the PEC transfer by raising the Tx Irq Flag */
-	S0TIR=1;
-}
-
-
-
-/* Serial Tx interrupt service routine */
-void serialTxIrq(void) interrupt S0TINT = 42 {
-
-	/* Notify the status that the serial Tx is done */
-	serialTxBusy=0;
-	
-}
-
-
-/* Get serial interface status */
-char volatile *serialGetStatus(void){
-	return &serialStatus;
-}
+#include <reg167.h>
+#include <intrins.h>
+#include <string.h>
+
+#include "serial.h"
+#include "idle.h"
+
+/* Defines */
+#define SER_TX_MASK		(SER_TX_BUF_SIZE-1)
+
+/* Static */
+static unsigned char idata serialTxBuffer[SER_TX_BUF_SIZE];	// Transmit queue (PEC needs it in segment 0)
+
+static unsigned char volatile serialTxHead;		// Written only by the main loop
+static unsigned char volatile serialTxTail;		// Written only by the Tx interrupt
+static unsigned char volatile serialTxChunk;	// Bytes handed to the PEC channel
+static unsigned int volatile serialTxDropped;	// Messages dropped because the queue was full
+
+static char idata serialRxBuffer[SER_RX_BUF_SIZE];	// Line being received
+static unsigned char volatile serialRxCount;	// Characters in the line so far
+static unsigned int volatile serialRxOverruns;	// Characters lost while a line was waiting
+
+static char msgTerm;
+
+static unsigned long serialBaud;
+static unsigned long volatile serialBaudPending;	// Applied when the queue drains (0:none)
+
+/* Prototypes */
+static void serialTxKick(unsigned char head);
+static void serialTxStart(void);
+static void serialApplyBaud(unsigned long baud);
+
+static char volatile bdata serialStatus;
+sbit serialTxBusy = serialStatus^0;
+sbit serialRxReady = serialStatus^1;
+sbit serialTxBufOvr	= serialStatus^2;
+sbit serialRxBufOvr	= serialStatus^3;
+
+
+
+/* Initialize serial port */
+void serialInit(char termination){
+
+	/* Set port 3 to handle serial communication */
+	P3  |= 0x0400;        /* SET PORT 3.10 OUTPUT LATCH (TXD)              */
+	DP3 |= 0x0400;        /* SET PORT 3.10 DIRECTION CONTROL (TXD OUTPUT)  */
+	DP3 &= 0xF7FF;        /* RESET PORT 3.11 DIRECTION CONTROL (RXD INPUT) */
+
+	/* Set serial mode */	
+	serialApplyBaud(SER_BAUD_DEFAULT);	/* SET BAUDRATE TO 19200 BAUD        */
+	S0CON = 0x8011;       /* SET SERIAL MODE:
+								- asynchronous
+								- 8-N-1
+								- rx enabled
+								- baud generator enabled */
+	
+	/* Set interrupts */
+	S0TIC = 0x0078;       /* SET TRANSMIT INTERRUPT:
+								- Tx Irq flag cleared
+								- Tx Irq enable
+								- PEC service channel 0:
+									- ILVL = 14
+									- GLVL = 0 */
+
+	S0RIC = 0x0071;       /* SET RECEIVE INTERRUPT:
+								- Rx Irq flag cleared
+								- Rx Irq enable
+								- ILVL = 12
+								- GLVL = 1 */
+
+	/* Setup termination character */
+	msgTerm = termination;
+
+	/* Empty the receive buffer */
+	serialRxCount = 0;
+	serialRxOverruns = 0;
+	serialRxReady = 0;
+	serialRxBufOvr = 0;
+
+	/* Empty the transmit queue */
+	serialTxHead = 0;
+	serialTxTail = 0;
+	serialTxDropped = 0;
+	serialBaudPending = 0;
+
+	/* Set up PEC channels */
+	/* Tx: PEC channel 0 */
+	DSTP0 = (unsigned int)&S0TBUF;		/* DSTP0 points to the hardware tx buffer */
+
+}
+
+
+
+
+
+/* Queues the message for the serial port. Returns at once: the message is
+   dropped and SER_TX_BUF_OVR set if there is not enough room in the queue */
+void serialWrite(void *message, unsigned char size){
+
+	/* Some locals */
+	unsigned char *src = message;
+	unsigned char head;
+
+	/* Clear the Tx buffer overrun if any */
+	serialTxBufOvr=0;
+
+	/* If there is no room for the message, drop it */
+	if(size>(unsigned char)(SER_TX_MASK-(unsigned char)(serialTxHead-serialTxTail))){
+		serialTxBufOvr=1;
+		serialTxDropped++;
+		return;
+	}
+
+	/* Copy message to the serial Tx queue */
+	head = serialTxHead;
+	while(size--){
+		serialTxBuffer[head++ & SER_TX_MASK] = *src++;
+	}
+
+	/* Publish the message and start sending it if the port is idle */
+	serialTxKick(head);
+}
+
+
+
+/* Queues the payload for the serial port as a COBS frame followed by its CRC.
+   The frame never contains SER_FRAME_DELIMITER except at its end, so a receiver
+   can always resynchronize on it. The CRC is CRC-16/CCITT (0x1021, preset 0xFFFF)
+   over the payload, sent MSB first. */
+void serialWriteFrame(void *payload, unsigned char size){
+
+	/* Some locals */
+	unsigned char *src = payload;
+	unsigned char code, byte;
+	unsigned char codePos, out;
+	unsigned int cnt, crc;
+
+	/* Clear the Tx buffer overrun if any */
+	serialTxBufOvr=0;
+
+	/* If there is no room for the frame, drop it */
+	if((unsigned int)size+SER_FRAME_OVERHEAD(size)>(unsigned char)(SER_TX_MASK-(unsigned char)(serialTxHead-serialTxTail))){
+		serialTxBufOvr=1;
+		serialTxDropped++;
+		return;
+	}
+
+	/* CRC of the payload */
+	crc = 0xFFFF;
+	for(cnt=0;cnt<size;cnt++){
+		byte = (unsigned char)(crc>>8)^src[cnt];
+		byte ^= byte>>4;
+		crc = (crc<<8)^((unsigned int)byte<<12)^((unsigned int)byte<<5)^byte;
+	}
+
+	/* COBS encode payload and CRC straight into the Tx queue */
+	codePos = serialTxHead;
+	out = codePos+1;
+	code = 1;
+	for(cnt=0;cnt<(unsigned int)size+2;cnt++){
+		if(cnt<size){
+			byte = src[cnt];
+		} else {
+			byte = (cnt==size) ? (unsigned char)(crc>>8) : (unsigned char)crc;
+		}
+
+		if(byte==0){
+			serialTxBuffer[codePos & SER_TX_MASK] = code;
+			codePos = out++;
+			code = 1;
+		} else {
+			serialTxBuffer[out++ & SER_TX_MASK] = byte;
+			if(++code==0xFF){
+				serialTxBuffer[codePos & SER_TX_MASK] = code;
+				codePos = out++;
+				code = 1;
+			}
+		}
+	}
+	serialTxBuffer[codePos & SER_TX_MASK] = code;
+	serialTxBuffer[out++ & SER_TX_MASK] = SER_FRAME_DELIMITER;
+
+	/* Publish the frame and start sending it if the port is idle */
+	serialTxKick(out);
+}
+
+
+
+/* Publish the queued bytes up to head and start the transfer if the port is idle */
+static void serialTxKick(unsigned char head){
+
+	serialTxHead = head;
+
+	/* If busy, the Tx interrupt picks the new bytes up when done with the current ones */
+	if(serialTxBusy){
+		return;
+	}
+
+	serialTxStart();
+
+	/* Trigger the PEC transfer by raising the Tx Irq Flag */
+	S0TIR=1;
+}
+
+
+
+/* Hand the next contiguous run of queued bytes to PEC channel 0 */
+static void serialTxStart(void){
+
+	/* Some locals */
+	unsigned int chunk;
+
+	/* Stop at the end of the buffer: the PEC source pointer does not wrap */
+	chunk = (unsigned char)(serialTxHead-serialTxTail);
+	if(chunk>SER_TX_BUF_SIZE-(serialTxTail & SER_TX_MASK)){
+		chunk = SER_TX_BUF_SIZE-(serialTxTail & SER_TX_MASK);
+	}
+	serialTxChunk = (unsigned char)chunk;
+
+	/* Setup PEC channel 0 */
+	SRCP0 = _sof_ (&serialTxBuffer[serialTxTail & SER_TX_MASK]);	/* SRCP0 points to the next byte to send */
+	PECC0 = 0x0500 | chunk; 		/* Transfer 1 byte, increment SRCP0 and send a total of chunk bytes */	
+
+	/* Notify the status that the serial Tx is busy */
+	serialTxBusy=1;
+}
+
+
+
+/* Set the baud rate. Returns -1 if it can not be generated accurately enough.
+   If a message is being sent the change waits until the queue is empty: the
+   stop bit of the last byte may be cut short, so the receiver has to resynchronize. */
+char serialSetBaud(unsigned long baud){
+
+	if((baud<SER_BAUD_MIN)||(baud>SER_BAUD_MAX)){
+		return -1;
+	}
+
+	serialBaudPending = baud;
+
+	/* Port idle: change now (unless the Tx interrupt already did) */
+	if(!serialTxBusy && serialBaudPending){
+		serialApplyBaud(serialBaudPending);
+	}
+
+	return 0;
+}
+
+
+
+/* Get the current baud rate */
+unsigned long serialGetBaud(void){
+	return serialBaud;
+}
+
+
+
+/* Get the number of messages dropped because the transmit queue was full */
+unsigned int serialGetTxDropped(void){
+	return serialTxDropped;
+}
+
+
+
+/* Program the baud rate generator */
+static void serialApplyBaud(unsigned long baud){
+
+	/* Baud = fCPU/(32*(S0BG+1)) with fCPU = 20 MHz, rounded to nearest */
+	S0BG = (unsigned int)((625000L+baud/2)/baud)-1;
+	serialBaud = baud;
+	serialBaudPending = 0;
+}
+
+
+
+/* Get a received line. Returns its length (0 if no line is complete yet) and
+   copies it to line, NUL terminated and without the termination character */
+unsigned char serialRead(char *line, unsigned char size){
+
+	/* Some locals */
+	unsigned char cnt;
+
+	if(!serialRxReady){
+		return 0;
+	}
+
+	/* Leave room for the NUL */
+	cnt = serialRxCount;
+	if(cnt>size-1){
+		cnt = size-1;
+	}
+	memcpy(line, serialRxBuffer, (unsigned int)cnt);
+	line[cnt] = '\0';
+
+	/* Let the receive interrupt start the next line */
+	serialRxCount = 0;
+	serialRxReady = 0;
+
+	return cnt;
+}
+
+
+
+/* Get the number of characters lost because a line was not read in time */
+unsigned int serialGetRxOverruns(void){
+	return serialRxOverruns;
+}
+
+
+
+/* Get the free room in the transmit queue */
+unsigned char serialGetTxFree(void){
+	return (unsigned char)(SER_TX_MASK-(unsigned char)(serialTxHead-serialTxTail));
+}
+
+
+
+/* Serial Rx interrupt service routine: collect characters up to the termination */
+void serialRxIrq(void) interrupt S0RINT = 43 {
+
+	/* Some locals */
+	char rxChar = (char)S0RBUF;
+
+	/* The console may have a line to read */
+	idleWake(IDLE_WAKE_SERIAL);
+
+	/* Previous line not read yet: drop the character */
+	if(serialRxReady){
+		serialRxBufOvr = 1;
+		serialRxOverruns++;
+		return;
+	}
+
+	/* End of line. Empty lines (as the LF of a CR LF pair) are ignored */
+	if((rxChar==msgTerm)||(rxChar==LF)||(rxChar==CR)){
+		if(serialRxCount){
+			serialRxReady = 1;
+		}
+		return;
+	}
+
+	/* Backspace or delete: remove the last character */
+	if((rxChar==BS)||(rxChar==DEL)){
+		if(serialRxCount){
+			serialRxCount--;
+		}
+		return;
+	}
+
+	/* Line too long: drop the character */
+	if(serialRxCount>=SER_RX_BUF_SIZE){
+		serialRxBufOvr = 1;
+		serialRxOverruns++;
+		return;
+	}
+
+	serialRxBuffer[serialRxCount++] = rxChar;
+}
+
+
+
+/* Serial Tx interrupt service routine: the PEC channel has sent its last byte */
+void serialTxIrq(void) interrupt S0TINT = 42 {
+
+	/* The interrupt comes twice at the end of a transfer: once when the PEC
+	   count reaches 0 and again when the last byte has been sent. Only the
+	   first one releases the bytes */
+	if(!serialTxBusy){
+		return;
+	}
+
+	/* Release the bytes just sent: room for a console dump to go on */
+	serialTxTail += serialTxChunk;
+	serialTxChunk = 0;
+	idleWake(IDLE_WAKE_SERIAL);
+
+	/* Chain the next transfer, triggered by the end of the byte being sent */
+	if(serialTxHead!=serialTxTail){
+		serialTxStart();
+		return;
+	}
+
+	/* Notify the status that the serial Tx is done */
+	serialTxBusy=0;
+
+	/* Change the baud rate now that the queue is empty */
+	if(serialBaudPending){
+		serialApplyBaud(serialBaudPending);
+	}
+	
+}
+
+
+/* Get serial interface status */
+char volatile *serialGetStatus(void){
+	return &serialStatus;
+}
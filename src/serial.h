@@ -1,23 +1,44 @@
-#ifndef _SERIAL_H
-	
-	#define _SERIAL_H
-
-	/* Defines */
-	#define SER_TX_BUF_SIZE		80
-
-	/* Defines to help with driver status */
-	#define SER_TX_BUSY		0x01
-	#define SER_TX_BUF_OVR	0x04
-
-
-	/* Defines to help with bytes */
-	#define LF		0x0A	// Line Feed
-	#define CR		0x0D	// Carriage Return
-	
-	/* Prototypes */
-	/* Externs */
-	extern void serialInit(char termination);	
-	extern void serialWrite(void *message, unsigned char size);
-	extern char volatile *serialGetStatus(void);
-
-#endif /* _SERIAL_H */
+#ifndef _SERIAL_H
+	
+	#define _SERIAL_H
+
+	/* Defines */
+	#define SER_TX_BUF_SIZE		256		// Transmit queue size (must be 256: the indexes wrap as bytes)
+	#define SER_RX_BUF_SIZE		32		// Longest line received
+
+	/* Baud rates */
+	#define SER_BAUD_DEFAULT	19200
+	#define SER_BAUD_MIN		9600	// Slowest rate accepted by serialSetBaud
+	#define SER_BAUD_MAX		57600	// Fastest rate within 2% of the requested one at 20 MHz
+
+	/* Framing */
+	#define SER_FRAME_DELIMITER	0x00	// Ends every COBS frame
+	#define SER_FRAME_OVERHEAD(size)	(4+((size)+2)/254)	// CRC, COBS codes and delimiter
+
+	/* Defines to help with driver status */
+	#define SER_TX_BUSY		0x01	// Transmit queue not empty
+	#define SER_RX_READY	0x02	// A received line is waiting to be read
+	#define SER_TX_BUF_OVR	0x04	// Last message dropped: no room in the transmit queue
+	#define SER_RX_BUF_OVR	0x08	// Received characters were dropped
+
+
+	/* Defines to help with bytes */
+	#define LF		0x0A	// Line Feed
+	#define CR		0x0D	// Carriage Return
+	#define BS		0x08	// Backspace
+	#define DEL		0x7F	// Delete
+	
+	/* Prototypes */
+	/* Externs */
+	extern void serialInit(char termination);	
+	extern void serialWrite(void *message, unsigned char size);
+	extern void serialWriteFrame(void *payload, unsigned char size);
+	extern char serialSetBaud(unsigned long baud);
+	extern unsigned long serialGetBaud(void);
+	extern unsigned int serialGetTxDropped(void);
+	extern unsigned char serialGetTxFree(void);
+	extern unsigned char serialRead(char *line, unsigned char size);
+	extern unsigned int serialGetRxOverruns(void);
+	extern char volatile *serialGetStatus(void);
+
+#endif /* _SERIAL_H */
@@ -0,0 +1,102 @@
+#include <reg167.h>
+
+#include "stack.h"
+
+/* Defines */
+#define STACK_SYS_RESERVE	(6*2)	// Bytes below STKOV kept for the stack overflow trap
+
+/* Externs */
+/* User stack bounds, from Start167.a66 */
+extern unsigned int near stack_user_bottom[];
+extern unsigned int near stack_user_top[];
+
+/* Static */
+/* Both stacks are scanned from the bottom up: the painted words left at
+   the bottom were never used. The lowest word found changed is the mark */
+static unsigned int stackBottom[STACK_NUMBER];	// Addresses
+static unsigned int stackTop[STACK_NUMBER];
+static unsigned int volatile stackMark[STACK_NUMBER];	// Lowest word ever used
+static unsigned int stackScan[STACK_NUMBER];	// Next word to check
+
+static unsigned char stackNext;		// Stack to scan next
+
+
+
+/* Find the stack bounds. Must be called from main, before any interrupt is enabled */
+void stackInit(void){
+
+	/* Some locals */
+	unsigned char stack;
+
+	stackBottom[STACK_SYSTEM] = STKOV-STACK_SYS_RESERVE;
+	stackTop[STACK_SYSTEM] = STKUN;
+	stackBottom[STACK_USER] = (unsigned int)stack_user_bottom;
+	stackTop[STACK_USER] = (unsigned int)stack_user_top;
+
+	for(stack=0;stack<STACK_NUMBER;stack++){
+		stackMark[stack] = stackTop[stack];
+		stackScan[stack] = stackBottom[stack];
+	}
+
+	stackNext = STACK_SYSTEM;
+
+}
+
+
+
+/* Check a few more painted words of one stack. The two stacks take turns
+   and each scan starts over from the bottom once it meets a used word */
+void stackTask(void){
+
+	/* Some locals */
+	unsigned char stack, cnt;
+	unsigned int address;
+
+	stack = stackNext;
+	stackNext = (stackNext+1)%STACK_NUMBER;
+
+	address = stackScan[stack];
+	for(cnt=0;cnt<STACK_SCAN_WORDS;cnt++){
+
+		/* Nothing below the mark was touched since the last pass */
+		if(address>=stackMark[stack]){
+			address = stackBottom[stack];
+			break;
+		}
+
+		if(((stack==STACK_SYSTEM) ? *(unsigned int idata *)address : *(unsigned int near *)address)!=STACK_PATTERN){
+			stackMark[stack] = address;
+			address = stackBottom[stack];
+			break;
+		}
+
+		address += 2;
+	}
+	stackScan[stack] = address;
+
+}
+
+
+
+/* Size of a stack in bytes */
+unsigned int stackGetSize(unsigned char stack){
+
+	if(stack>=STACK_NUMBER){
+		return 0;
+	}
+
+	return stackTop[stack]-stackBottom[stack];
+}
+
+
+
+/* Bytes of a stack ever used. A used word that happens to hold the painted
+   value is taken as unused, so this can read short by a few bytes */
+unsigned int stackGetMaxUsed(unsigned char stack){
+
+	if(stack>=STACK_NUMBER){
+		return 0;
+	}
+
+	return stackTop[stack]-stackMark[stack];
+}
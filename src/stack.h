@@ -0,0 +1,21 @@
+#ifndef _STACK_H
+
+	#define _STACK_H
+
+	/* Defines */
+	#define STACK_PATTERN		0xAA55	// Painted by the startup code (STK_PATTERN in Start167.a66)
+	#define STACK_SCAN_WORDS	32		// Words checked by each call of stackTask
+
+	/* Stacks */
+	#define STACK_SYSTEM		0		// System stack (SP): return addresses and interrupt frames
+	#define STACK_USER			1		// User stack (R0): automatics
+	#define STACK_NUMBER		2
+
+	/* Prototypes */
+	/* Externs */
+	extern void stackInit(void);
+	extern void stackTask(void);
+	extern unsigned int stackGetSize(unsigned char stack);		// Bytes
+	extern unsigned int stackGetMaxUsed(unsigned char stack);	// Bytes ever used (high-water mark)
+
+#endif /* _STACK_H */
@@ -0,0 +1,275 @@
+#include <reg167.h>
+
+#include "te.h"
+#include "timebase.h"
+
+/* Defines */
+#define TE_TOLERANCE_US		200		// Farthest a timing event may be from the 48 ms grid
+#define TE_LOCK_COUNT		21		// Regular timing events in a row before locking (about 1 second)
+#define TE_LOST_US			(3*TE_PERIOD_US)	// No timing event for this long: lock lost
+#define TE_WINDOW			125		// Timing events between two trims (6 seconds: 120 timebase ticks)
+#define TE_SAMPLE_EVERY		2		// Timing events between two samplings (96 msec)
+
+/* Trim change, in 1/256 T1 counts per tick, for a drift of the timebase
+   over a window: drift/(120 ticks)/(0.8 us per count)*256 */
+#define TE_TRIM(drift)		((drift)*8/3)
+
+/* Static */
+static unsigned char volatile teState;
+static unsigned long volatile teCount;			// Timing events since the first one
+static unsigned int volatile teMissed;
+static int volatile teOffset;					// Last timing event from the grid (us)
+static unsigned long teLast;					// Timebase time of the last timing event (us)
+static unsigned char teGood;					// Regular timing events in a row
+static unsigned char teSeen;					// A timing event came since teInit (1:yes)
+
+static unsigned long teRef;						// Timebase time at the start of the trim window
+static unsigned char teWindow;					// Timing events in the trim window
+
+static unsigned int volatile tePhase;			// Microseconds from the timing event to the sampling
+static unsigned long tePending;					// Timing event of the sampling being timed
+static unsigned long volatile teSampleCount = TE_NO_COUNT;	// Timing event of the last sampling
+static te_func teSample;						// Application sampling function
+
+/* Prototypes */
+static void teStartSample(void);
+static void teUnlock(unsigned char state);
+
+
+
+/* Start capturing the timing event. The timebase must be running */
+void teInit(te_func sample){
+
+	teState = TE_NONE;
+	teCount = 0;
+	teMissed = 0;
+	teOffset = 0;
+	teGood = 0;
+	teSeen = 0;
+	teWindow = 0;
+	tePhase = 0;
+	teSampleCount = TE_NO_COUNT;
+	teSample = sample;
+
+	/* Setup CAPCOM2 timer T7 as free running capture counter */
+	T7REL = 0x0000;			/* Reload with 0: full 16 bit period */
+	T7 = 0x0000;
+	T78CON = (T78CON & 0xFF00) | 0x0001;	/* SET TIMER 7:
+												- timer mode
+												- prescaler 16 (0.8 usec resolution)
+												- run bit is reset */
+
+	/* The 48ms pulse comes from the Xilinx on P8.0 (input) */
+	P8 &= 0xFE;
+	DP8 &= 0xFE;
+
+	/* CC16 captures the rising edge with T7. CC17 is set to compare mode
+	   0 (interrupt only, P8.1 left alone) for each sampling */
+	CCM4 = (CCM4 & 0xFF00) | 0x0001;
+
+	/* Set interrupts */
+	CC16IC = 0x0070;	/* SET TIMING EVENT INTERRUPT:
+							- ILVL = 12
+							- GLVL = 0 */
+	CC17IC = 0x006D;	/* SET SAMPLING PHASE INTERRUPT:
+							- ILVL = 11
+							- GLVL = 1 */
+
+	/* Start the capture counter */
+	T78CON |= 0x0040;
+
+}
+
+
+
+/* Check that the timing events keep coming */
+void teTick(void){
+
+	if(teState==TE_NONE){
+		return;
+	}
+
+	/* Lost: the timebase keeps the last trim */
+	if((timebaseMicros()-teLast)>TE_LOST_US){
+		teUnlock(TE_NONE);
+	}
+
+}
+
+
+
+/* Leave the locked state: the timebase paces the sampling again */
+static void teUnlock(unsigned char state){
+
+	teState = state;
+	teGood = 0;
+	teWindow = 0;
+
+	CCM4 &= 0xFF0F;
+	CC17IR = 0;
+	teSampleCount = TE_NO_COUNT;
+
+}
+
+
+
+/* Sample now */
+static void teStartSample(void){
+
+	teSampleCount = tePending;
+	if(teSample){
+		teSample();
+	}
+
+}
+
+
+
+/* Get the lock state (TE_xxx) */
+unsigned char teGetState(void){
+	return teState;
+}
+
+
+
+/* Get the number of timing events since the first one, missing ones included */
+unsigned long teGetCount(void){
+	return teCount;
+}
+
+
+
+/* Get the number of timing events found missing */
+unsigned int teGetMissed(void){
+	return teMissed;
+}
+
+
+
+/* Get how far the last timing event was from the 48 ms grid in microseconds */
+int teGetOffset(void){
+	return teOffset;
+}
+
+
+
+/* Get the timing event the last sampling was timed from */
+unsigned long teGetSampleCount(void){
+	return teSampleCount;
+}
+
+
+
+/* Set the sampling phase. Values beyond the period are ignored */
+void teSetPhase(unsigned int phase){
+
+	if(phase<TE_PERIOD_US){
+		tePhase = phase;
+	}
+
+}
+
+
+
+/* Get the sampling phase in microseconds */
+unsigned int teGetPhase(void){
+	return tePhase;
+}
+
+
+
+/* Timing event interrupt service routine (every 48 msec) */
+void teCC16Irq(void) interrupt CC16INT = 0x30 {
+
+	/* Some locals */
+	unsigned long now, interval, periods;
+	unsigned int capture, delay;
+	long error, trim;
+
+	/* Timebase time of the edge: the capture was taken a few T7 counts ago */
+	capture = CC16;
+	now = timebaseMicros()-((unsigned long)(unsigned int)(T7-capture)*TE_COUNT_NS)/1000;
+
+	/* First one: nothing to compare it with */
+	if(!teSeen){
+		teSeen = 1;
+		teState = TE_LOCKING;
+		teLast = now;
+		teRef = now;
+		return;
+	}
+
+	/* Nearest point of the 48 ms grid after the last one, so the count
+	   goes on across a loss. Pulses closer than half a period are glitches */
+	interval = now-teLast;
+	periods = (interval+TE_PERIOD_US/2)/TE_PERIOD_US;
+	if(!periods){
+		return;
+	}
+	error = (long)(interval-periods*TE_PERIOD_US);
+
+	teLast = now;
+	teCount += periods;
+	teMissed += (unsigned int)(periods-1);
+	teOffset = (int)error;
+
+	/* Not regular: start locking over */
+	if((periods>1)||(error>TE_TOLERANCE_US)||(error<-TE_TOLERANCE_US)){
+		teUnlock(TE_LOCKING);
+		teRef = now;
+		return;
+	}
+
+	/* Trim the timebase to the drift over the window */
+	if(++teWindow>=TE_WINDOW){
+		error = (long)(now-teRef)-TE_WINDOW*TE_PERIOD_US;
+		trim = timebaseGetTrim()+TE_TRIM(error);
+		if(trim>TIMEBASE_TRIM_MAX){
+			trim = TIMEBASE_TRIM_MAX;
+		}
+		if(trim<-TIMEBASE_TRIM_MAX){
+			trim = -TIMEBASE_TRIM_MAX;
+		}
+		timebaseSetTrim((int)trim);
+		teRef = now;
+		teWindow = 0;
+	}
+
+	if(teState==TE_LOCKING){
+		if(++teGood<TE_LOCK_COUNT){
+			return;
+		}
+		teState = TE_LOCKED;
+	}
+
+	/* Time the sampling from the captured edge */
+	if(teCount%TE_SAMPLE_EVERY){
+		return;
+	}
+	tePending = teCount;
+	delay = (unsigned int)(((unsigned long)tePhase*1000)/TE_COUNT_NS);
+
+	CC17 = capture+delay;
+	CC17IR = 0;
+	CCM4 = (CCM4 & 0xFF0F) | 0x0040;
+
+	/* The phase is already past: the compare would only match after T7 wraps */
+	if((unsigned int)(T7-capture)>=delay){
+		CCM4 &= 0xFF0F;
+		CC17IR = 0;
+		teStartSample();
+	}
+
+}
+
+
+
+/* Sampling phase compare interrupt service routine */
+void teCC17Irq(void) interrupt CC17INT = 0x31 {
+
+	/* Once per timing event */
+	CCM4 &= 0xFF0F;
+
+	teStartSample();
+
+}
@@ -0,0 +1,37 @@
+#ifndef _TE_H
+
+	#define _TE_H
+
+	/* Defines */
+	#define TE_PERIOD_US		48000L	// ALMA timing event period
+	#define TE_COUNT_NS			800		// T7 runs at fCPU/16 (52 ms before it wraps)
+	#define TE_NO_COUNT			0xFFFFFFFFL	// Sample not taken on a timing event
+
+	/* Lock states */
+	#define TE_NONE				0		// No timing event seen for the last 3 periods
+	#define TE_LOCKING			1		// Timing events seen, not yet regular
+	#define TE_LOCKED			2		// Regular timing events: they pace the sampling
+
+	/* Typedefs */
+	/* Function called at the sampling phase, from the compare interrupt */
+	typedef void(*te_func)(void);
+
+	/* Prototypes */
+	/* Externs */
+	/* The 48 ms pulse comes in on P8.0 (CC16) and is captured with T7. The
+	   Xilinx has to be programmed to connect the incoming pulse (pin31) to
+	   the cpu (pin28). While the pulses are regular they trim the timebase
+	   to their frequency and the sampling is triggered at a set phase after
+	   every other pulse. P8.0 is the remote reset output on the other boards:
+	   only builds with USE_48MS=1 (main.c) start this module */
+	extern void teInit(te_func sample);
+	extern void teTick(void);						// Call every timebase tick (timebase interrupt)
+	extern unsigned char teGetState(void);
+	extern unsigned long teGetCount(void);			// Timing events since the first one
+	extern unsigned int teGetMissed(void);			// Timing events found missing
+	extern int teGetOffset(void);					// Last timing event from the 48 ms grid (us)
+	extern unsigned long teGetSampleCount(void);	// Timing event of the last sampling (TE_NO_COUNT if none)
+	extern void teSetPhase(unsigned int phase);		// Microseconds from the timing event to the sampling
+	extern unsigned int teGetPhase(void);
+
+#endif /* _TE_H */
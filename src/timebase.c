@@ -0,0 +1,213 @@
+#include <reg167.h>
+
+#include "timebase.h"
+
+/* Defines */
+#define TIMEBASE_COUNTS		((unsigned int)(TIMEBASE_TICK_US*1000/TIMEBASE_COUNT_NS))	// T1 counts per tick
+#define TIMEBASE_RELOAD		((unsigned int)(0x10000L-TIMEBASE_COUNTS))
+
+/* Static */
+static unsigned long volatile timebaseTicks;	// Ticks since timebaseInit
+static timebase_func timebaseTick;				// Application tick function (0 if none)
+
+static unsigned int volatile timebaseStart;		// T1 at the start of the current tick
+static unsigned int volatile timebasePrevStart;	// T1 at the start of the previous tick
+static int volatile timebaseTrim;				// Tick length correction (1/256 T1 counts)
+static int timebaseTrimAcc;						// Fraction of a count not applied yet
+
+/* Prototypes */
+static void timebaseSnapshot(unsigned long *ticks, unsigned int *count, unsigned int *start, unsigned int *prevStart);
+
+
+
+/* Start the timebase. Timer 1 of CAPCOM1 counts up to the overflow and is
+   reloaded from T1REL by the hardware: the interrupt latency does not
+   move the ticks */
+void timebaseInit(timebase_func tick){
+
+	timebaseTicks = 0;
+	timebaseTick = tick;
+	timebaseStart = TIMEBASE_RELOAD;
+	timebasePrevStart = TIMEBASE_RELOAD;
+	timebaseTrim = 0;
+	timebaseTrimAcc = 0;
+
+	T1REL = TIMEBASE_RELOAD;
+	T1 = TIMEBASE_RELOAD;
+	T01CON = (T01CON & 0x00FF) | 0x0100;	/* SET TIMER 1:
+												- timer mode
+												- prescaler 16 (0.8 usec resolution)
+												- run bit is reset */
+
+	/* Set interrupts */
+	T1IC = 0x0073;		/* SET TIMER 1 INTERRUPT:
+							- ILVL = 12
+							- GLVL = 3 */
+
+	/* Start the timebase */
+	T01CON |= 0x4000;
+
+}
+
+
+
+/* Read the tick count and T1 together, with the T1 values the current and
+   the previous tick started from */
+static void timebaseSnapshot(unsigned long *ticks, unsigned int *count, unsigned int *start, unsigned int *prevStart){
+
+	/* Some locals */
+	unsigned long high;
+	unsigned int low, first, prev;
+
+	/* Read until the tick count is stable across the read of T1 */
+	do {
+		high = timebaseTicks;
+		first = timebaseStart;
+		prev = timebasePrevStart;
+		low = T1;
+	} while(high != timebaseTicks);
+
+	/* Reload occurred but has not been serviced yet */
+	if(T1IR && (low < T1REL+TIMEBASE_COUNTS/2)){
+		high++;
+		prev = first;
+		first = T1REL;
+	}
+
+	*ticks = high;
+	*count = low-first;
+	*start = first;
+	*prevStart = prev;
+}
+
+
+
+/* Microseconds into a tick. A trimmed tick may be a few counts longer than
+   TIMEBASE_TICK_US: the clock waits for the next one instead of going back */
+static unsigned long timebaseFraction(unsigned int count){
+
+	/* Some locals */
+	unsigned long us;
+
+	us = ((unsigned long)count*TIMEBASE_COUNT_NS)/1000;
+
+	return (us<TIMEBASE_TICK_US) ? us : TIMEBASE_TICK_US-1;
+}
+
+
+
+/* Get the 48 bit time in microseconds. Safe from any priority level */
+void timebaseRead(TIMEBASE_STAMP *stamp){
+
+	/* Some locals */
+	unsigned long ticks, low, high;
+	unsigned int count, start, prevStart;
+
+	timebaseSnapshot(&ticks, &count, &start, &prevStart);
+
+	/* ticks*TIMEBASE_TICK_US does not fit in 32 bits: multiply each half */
+	low = (ticks & 0xFFFF)*TIMEBASE_TICK_US + timebaseFraction(count);
+	high = (ticks >> 16)*TIMEBASE_TICK_US;
+
+	stamp->low = low + (high << 16);
+	stamp->high = (unsigned int)(high >> 16) + ((stamp->low < low) ? 1 : 0);
+}
+
+
+
+/* Get the lower 32 bits of the time in microseconds, for intervals */
+unsigned long timebaseMicros(void){
+
+	/* Some locals */
+	unsigned long ticks;
+	unsigned int count, start, prevStart;
+
+	timebaseSnapshot(&ticks, &count, &start, &prevStart);
+
+	return ticks*TIMEBASE_TICK_US + timebaseFraction(count);
+}
+
+
+
+/* Turn a T1 capture into the lower 32 bits of the time in microseconds.
+   The capture must be less than a tick old */
+unsigned long timebaseCapture(unsigned int capture){
+
+	/* Some locals */
+	unsigned long ticks;
+	unsigned int count, start, prevStart;
+
+	timebaseSnapshot(&ticks, &count, &start, &prevStart);
+
+	/* Taken before the last reload */
+	if((unsigned int)(capture-start) > count){
+		ticks--;
+		start = prevStart;
+	}
+
+	return ticks*TIMEBASE_TICK_US + timebaseFraction(capture-start);
+}
+
+
+
+/* Get the number of ticks since timebaseInit */
+unsigned long timebaseGetTicks(void){
+
+	/* Some locals */
+	unsigned long ticks;
+	unsigned int count, start, prevStart;
+
+	timebaseSnapshot(&ticks, &count, &start, &prevStart);
+
+	return ticks;
+}
+
+
+
+/* Make the ticks longer (positive) or shorter than TIMEBASE_TICK_US by a
+   number of T1 counts in 1/256 units, to follow an external reference */
+void timebaseSetTrim(int trim){
+
+	if(trim>TIMEBASE_TRIM_MAX){
+		trim = TIMEBASE_TRIM_MAX;
+	}
+	if(trim<-TIMEBASE_TRIM_MAX){
+		trim = -TIMEBASE_TRIM_MAX;
+	}
+
+	timebaseTrim = trim;
+}
+
+
+
+/* Get the tick length correction in 1/256 T1 counts */
+int timebaseGetTrim(void){
+
+	return timebaseTrim;
+}
+
+
+
+/* Timer 1 reload interrupt service routine (every 50 msec) */
+void timebaseT1Irq(void) interrupt T1INT = 0x21 {
+
+	/* Some locals */
+	int counts;
+
+	timebaseTicks++;
+
+	/* The hardware started this tick from T1REL */
+	timebasePrevStart = timebaseStart;
+	timebaseStart = T1REL;
+
+	/* Length of the next tick: the fractions of a count add up over the ticks */
+	timebaseTrimAcc += timebaseTrim;
+	counts = timebaseTrimAcc/256;
+	timebaseTrimAcc -= counts*256;
+	T1REL = TIMEBASE_RELOAD-counts;
+
+	if(timebaseTick){
+		timebaseTick();
+	}
+
+}
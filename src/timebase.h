@@ -0,0 +1,31 @@
+#ifndef _TIMEBASE_H
+
+	#define _TIMEBASE_H
+
+	/* Defines */
+	#define TIMEBASE_COUNT_NS		800		// T1 runs at fCPU/16
+	#define TIMEBASE_TICK_US		50000L	// T1 period, reloaded by the hardware from T1REL
+	#define TIMEBASE_TICKS_PER_SEC	20
+	#define TIMEBASE_TRIM_MAX		(16*256)	// Largest tick correction: 16 counts (256 ppm)
+
+	/* Typedefs */
+	/* A 48 bit time in microseconds since timebaseInit (8.9 years before it wraps) */
+	typedef struct {
+		unsigned int	high;		// Upper 16 bits
+		unsigned long	low;		// Lower 32 bits
+	} TIMEBASE_STAMP;
+
+	/* Function called on every tick, from the timebase interrupt */
+	typedef void(*timebase_func)(void);
+
+	/* Prototypes */
+	/* Externs */
+	extern void timebaseInit(timebase_func tick);
+	extern void timebaseRead(TIMEBASE_STAMP *stamp);
+	extern unsigned long timebaseMicros(void);		// Lower 32 bits of the clock (71 minutes before it wraps)
+	extern unsigned long timebaseCapture(unsigned int capture);	// Microseconds of a T1 capture less than a tick old
+	extern unsigned long timebaseGetTicks(void);
+	extern void timebaseSetTrim(int trim);			// 1/256 T1 counts per tick: 1/16 ppm
+	extern int timebaseGetTrim(void);
+
+#endif /* _TIMEBASE_H */
@@ -0,0 +1,132 @@
+/* The variables of this module must survive a software reset: keep them
+   out of the zero initialization done by the startup code */
+#pragma NOINIT
+
+#include <reg167.h>
+#include <string.h>
+
+#include "warm.h"
+
+/* Defines */
+#define WARM_MAGIC			0x5741524DL		// "WARM"
+
+/* Static (not initialized: random after power on) */
+static unsigned long warmMagic;
+static unsigned int warmSize;
+static unsigned int warmCheck;
+static unsigned char warmData[WARM_SIZE];
+
+/* Prototypes */
+static unsigned int warmChecksum(void);
+
+
+
+/* Save the state to take back after the reset. Called right before it */
+void warmSave(void *state, unsigned int size){
+
+	if(size>WARM_SIZE){
+		warmClear();
+		return;
+	}
+
+	memcpy(warmData, state, size);
+	warmSize = size;
+	warmCheck = warmChecksum();
+	warmMagic = WARM_MAGIC;
+
+}
+
+
+
+/* Take back the state saved before the reset. Returns 1 if it was valid,
+   0 if a cold start is needed. Either way it cannot be taken back again */
+unsigned char warmLoad(void *state, unsigned int size){
+
+	/* Some locals */
+	unsigned char valid;
+
+	valid = (warmMagic==WARM_MAGIC)&&(warmSize==size)&&(warmCheck==warmChecksum());
+	if(valid){
+		memcpy(state, warmData, size);
+	}
+	warmClear();
+
+	return valid;
+}
+
+
+
+/* Forget the saved state: the next start is a cold one */
+void warmClear(void){
+
+	warmMagic = 0;
+
+}
+
+
+
+/* Start timing the restart. CAPCOM2 timer T8 is left alone by the startup
+   code and keeps counting across the reset */
+void warmStopwatchStart(void){
+
+	T8REL = 0x0000;
+	T8 = 0x0000;
+	T78CON = (T78CON & 0x00FF) | 0x4700;	/* SET TIMER 8:
+												- timer mode
+												- prescaler 1024 (51.2 usec resolution)
+												- run bit is set */
+
+}
+
+
+
+/* Check if the restart is being timed. After a power on T8 is not running */
+unsigned char warmStopwatchRunning(void){
+
+	return (T78CON&0x4000) ? 1 : 0;
+}
+
+
+
+/* Return the time since warmStopwatchStart in microseconds, 0 if not running */
+unsigned long warmStopwatchRead(void){
+
+	if(!warmStopwatchRunning()){
+		return 0;
+	}
+
+	return ((unsigned long)T8*WARM_TICK_NS)/1000;
+}
+
+
+
+/* Stop timing the restart and return the time since warmStopwatchStart in
+   microseconds, 0 if not running */
+unsigned long warmStopwatchStop(void){
+
+	/* Some locals */
+	unsigned long time;
+
+	time = warmStopwatchRead();
+	T78CON &= 0x00FF;
+
+	return time;
+}
+
+
+
+/* Fletcher-16 of the saved state and its size */
+static unsigned int warmChecksum(void){
+
+	/* Some locals */
+	unsigned int sum1, sum2, cnt;
+
+	sum1 = warmSize&0xFF;
+	sum2 = sum1;
+	for(cnt=0;(cnt<warmSize)&&(cnt<WARM_SIZE);cnt++){
+		sum1 = (sum1+warmData[cnt])%255;
+		sum2 = (sum2+sum1)%255;
+	}
+
+	return (sum2<<8)|sum1;
+}
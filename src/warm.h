@@ -0,0 +1,28 @@
+#ifndef _WARM_H
+
+	#define _WARM_H
+
+	/* Defines */
+	#define WARM_SIZE			96		// Bytes of application state kept across a software reset
+
+	/* Restart stopwatch resolution */
+	#define WARM_TICK_NS		51200	// T8 runs at fCPU/1024 (3.3 seconds before it wraps)
+
+	/* Prototypes */
+	/* Externs */
+	/* The state survives the reset in a region the startup code does not
+	   clear. It is checksummed and taken back only once: after a power on,
+	   a device reset or a corrupted save warmLoad returns 0 and the caller
+	   goes through the full (cold) start */
+	extern void warmSave(void *state, unsigned int size);
+	extern unsigned char warmLoad(void *state, unsigned int size);
+	extern void warmClear(void);
+
+	/* Time from the reset request to the node serving again. After a power
+	   on it is not running until started */
+	extern void warmStopwatchStart(void);
+	extern unsigned char warmStopwatchRunning(void);
+	extern unsigned long warmStopwatchRead(void);	// Microseconds, 0 if not running
+	extern unsigned long warmStopwatchStop(void);	// Microseconds, 0 if not running
+
+#endif /* _WARM_H */
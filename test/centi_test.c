@@ -0,0 +1,100 @@
+/* Checks the fixed point temperature conversions for every input: the
+   result must be the exact value rounded to the nearest centi-degree
+   (halves up) and agree with the float conversions */
+
+#include <stdio.h>
+#include <math.h>
+
+#include <reg167.h>
+
+#include "ds1820.h"
+
+/* Defines */
+#define FLOAT_SLACK		0.001		// Float rounding allowed on top of the half centi-degree
+
+/* Prototypes */
+static long floorDiv(long num, long den);
+
+
+
+/* Division rounded towards minus infinity (den > 0) */
+static long floorDiv(long num, long den){
+
+	/* Some locals */
+	long quot = num/den;
+
+	if((num%den)<0){
+		quot--;
+	}
+
+	return quot;
+}
+
+
+
+int main(void){
+
+	/* Some locals */
+	unsigned int msb, lsb, count_remain, count_per_C;
+	unsigned long checked = 0;
+	unsigned long mismatches = 0;
+	unsigned long floatOff = 0;
+	long temp, centi, exact;
+	double reference;
+
+	/* Half degree conversion: every reading */
+	for(msb=0;msb<256;msb++){
+		for(lsb=0;lsb<256;lsb++){
+			centi = Do_1W_Temperature_Centi(msb, lsb);
+			reference = 100.0*Do_1W_Temperature(msb, lsb);
+			checked++;
+			if(centi!=(long)reference){
+				if(mismatches++<10){
+					printf("centi_test: Centi(%02X,%02X) = %ld instead of %.2f\n", msb, lsb, centi, reference);
+				}
+			}
+		}
+	}
+
+	/* Full resolution: every reading, count remaining and count per degree.
+	   Any MSB other than 0 means negative, 0xFF stands for all of them */
+	for(msb=0;msb<256;msb+=255){
+		for(lsb=0;lsb<256;lsb++){
+			temp = (signed char)((lsb>>1)|(msb ? 0x80 : 0x00));
+			for(count_per_C=0;count_per_C<256;count_per_C++){
+				for(count_remain=0;count_remain<256;count_remain++){
+					centi = Do_1W_Temperature_Full_Centi(msb, lsb, count_remain, count_per_C);
+
+					/* 100*T = 100*temp - 25 + 100*(count_per_C-count_remain)/count_per_C, plus 1/2 */
+					if(count_per_C){
+						exact = floorDiv(400L*temp*count_per_C-100L*count_per_C
+							+400L*((long)count_per_C-(long)count_remain)+2L*count_per_C,
+							4L*count_per_C);
+					}else{
+						exact = 100L*temp;
+					}
+
+					checked++;
+					if(centi!=exact){
+						if(mismatches++<10){
+							printf("centi_test: Full_Centi(%02X,%02X,%u,%u) = %ld instead of %ld\n",
+								msb, lsb, count_remain, count_per_C, centi, exact);
+						}
+					}
+
+					reference = 100.0*Do_1W_Temperature_Full(msb, lsb, count_remain, count_per_C);
+					if(fabs(reference-centi)>0.5+FLOAT_SLACK){
+						if(floatOff++<10){
+							printf("centi_test: Full_Centi(%02X,%02X,%u,%u) = %ld, float gives %.4f\n",
+								msb, lsb, count_remain, count_per_C, centi, reference);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	printf("centi_test: %lu inputs, %lu mismatches, %lu off the float result\n", checked, mismatches, floatOff);
+
+	return (mismatches||floatOff) ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+/* Checks the Do_1W_CRC variant selected with ONEWIRE_CRC against the
+   bitwise definition for every CRC and byte, then times it */
+
+#include <stdio.h>
+#include <time.h>
+
+#include <reg167.h>
+
+#include "ds1820.h"
+
+/* Defines */
+#define BENCH_BYTES		(64UL*1024*1024)	// Bytes run through the CRC for the timing
+
+#if ONEWIRE_CRC == ONEWIRE_CRC_BYTE
+	#define VARIANT		"byte table"
+#elif ONEWIRE_CRC == ONEWIRE_CRC_NIBBLE
+	#define VARIANT		"nibble tables"
+#else
+	#define VARIANT		"bitwise"
+#endif
+
+/* Prototypes */
+static unsigned char crcStep(unsigned char next_byte, unsigned char crc);
+
+
+
+/* Dallas CRC8 (x^8 + x^5 + x^4 + 1), one polynomial step per bit */
+static unsigned char crcStep(unsigned char next_byte, unsigned char crc){
+
+	/* Some locals */
+	unsigned char i;
+
+	for(i=0;i<8;i++){
+		if((crc^next_byte)&0x01){
+			crc = (crc>>1)^0x8C;
+		}else{
+			crc >>= 1;
+		}
+		next_byte >>= 1;
+	}
+
+	return crc;
+}
+
+
+
+int main(void){
+
+	/* Some locals */
+	unsigned int crc, next_byte;
+	unsigned long mismatches = 0;
+	unsigned long i;
+	unsigned char rom[8] = {0x10, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00};
+	unsigned char result;
+	struct timespec start, end;
+	double ns;
+
+	/* Every (CRC, byte) pair */
+	for(crc=0;crc<256;crc++){
+		for(next_byte=0;next_byte<256;next_byte++){
+			if(Do_1W_CRC(next_byte, crc)!=crcStep(next_byte, crc)){
+				if(mismatches++<10){
+					printf("crc_test: CRC %02X byte %02X: %02X instead of %02X\n", crc, next_byte,
+						Do_1W_CRC(next_byte, crc), crcStep(next_byte, crc));
+				}
+			}
+		}
+	}
+
+	/* A ROM code followed by its CRC checks to 0 */
+	result = 0;
+	for(i=0;i<7;i++){
+		result = Do_1W_CRC(rom[i], result);
+	}
+	rom[7] = result;
+	result = 0;
+	for(i=0;i<8;i++){
+		result = Do_1W_CRC(rom[i], result);
+	}
+	if(result!=0){
+		mismatches++;
+		printf("crc_test: ROM code CRC does not check\n");
+	}
+
+	/* Timing, each step depending on the last one as on the bus */
+	result = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i=0;i<BENCH_BYTES;i++){
+		result = Do_1W_CRC((unsigned char)i, result);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ns = (end.tv_sec-start.tv_sec)*1e9+(end.tv_nsec-start.tv_nsec);
+
+	printf("crc_test (%s): 65536 pairs, %lu mismatches, %.2f ns/byte on the host (CRC %02X)\n",
+		VARIANT, mismatches, ns/BENCH_BYTES, result);
+
+	return mismatches ? 1 : 0;
+}
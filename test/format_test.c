@@ -0,0 +1,116 @@
+/* Compares the formatter with the host sprintf: formatFixed as "%5.<d>f",
+   formatExp as "%.<d>E" and formatUnsigned as "%u", digit for digit */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "format.h"
+
+/* Defines */
+#define ROUNDS			3000000UL	// Floats drawn, each printed both ways
+#define FIXED_MAX		1e30f		// Largest value compared in fixed point
+
+/* Globals */
+static unsigned int seed = 1;
+static unsigned long checked;
+static unsigned long mismatches;
+
+/* Prototypes */
+static unsigned int randomNext(void);
+static void compare(char *what, float value, int decimals, char *got, char *expected);
+
+
+
+/* Xorshift, the same sequence every run */
+static unsigned int randomNext(void){
+
+	seed ^= seed<<13;
+	seed ^= seed>>17;
+	seed ^= seed<<5;
+
+	return seed;
+}
+
+
+
+/* Both strings must be the same */
+static void compare(char *what, float value, int decimals, char *got, char *expected){
+
+	checked++;
+	if(strcmp(got, expected)){
+		if(mismatches++<10){
+			printf("format_test: %s %.9g, %d decimals: [%s] instead of [%s]\n", what, value, decimals, got, expected);
+		}
+	}
+}
+
+
+
+int main(void){
+
+	/* Some locals */
+	char got[64];
+	char expected[64];
+	unsigned long i;
+	unsigned int bits;
+	unsigned int numbers[] = {0, 1, 9, 10, 123456789, 4294967295U};
+	float value;
+	int decimals;
+
+	for(i=0;i<ROUNDS;i++){
+		switch(i%4){
+			case 0:	// Any bit pattern
+				bits = randomNext();
+				memcpy(&value, &bits, sizeof(value));
+				if(isnan(value)||isinf(value)){
+					continue;
+				}
+				break;
+			case 1:	// Centi values, as the temperatures
+				value = (float)((int)(randomNext()%200001)-100000)/100.0f;
+				break;
+			case 2:	// Close to the rounding halfway points
+				value = (float)((int)(randomNext()%20001)-10000)/1000.0f+0.005f;
+				break;
+			default:	// Powers of two, exact ties
+				value = ldexpf((float)(randomNext()%1000), -(int)(randomNext()%40));
+				break;
+		}
+
+		decimals = (i%3==0) ? 2 : (int)(randomNext()%(FORMAT_MAX_DECIMALS+1));
+
+		if(fabsf(value)<FIXED_MAX){
+			formatFixed(got, value, 5, decimals);
+			sprintf(expected, "%5.*f", decimals, value);
+			compare("fixed", value, decimals, got, expected);
+		}
+
+		formatExp(got, value, decimals);
+		sprintf(expected, "%.*E", decimals, value);
+		compare("exp", value, decimals, got, expected);
+	}
+
+	/* nan and inf */
+	value = NAN;
+	formatFixed(got, value, 5, 2);
+	sprintf(expected, "%5.2f", value);
+	compare("fixed", value, 2, got, expected);
+	value = -INFINITY;
+	formatFixed(got, value, 5, 2);
+	sprintf(expected, "%5.2f", value);
+	compare("fixed", value, 2, got, expected);
+	formatExp(got, value, 2);
+	sprintf(expected, "%.2E", value);
+	compare("exp", value, 2, got, expected);
+
+	for(i=0;i<sizeof(numbers)/sizeof(numbers[0]);i++){
+		formatUnsigned(got, numbers[i]);
+		sprintf(expected, "%u", numbers[i]);
+		compare("unsigned", (float)numbers[i], 0, got, expected);
+	}
+
+	printf("format_test: %lu values, %lu mismatches\n", checked, mismatches);
+
+	return mismatches ? 1 : 0;
+}
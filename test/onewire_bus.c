@@ -0,0 +1,610 @@
+/* Host model of the 1-Wire bus for the ds1820 library tests.
+
+   The library runs unchanged on the host: its Timer 2, interrupt and port
+   pin accesses land here (see stub/reg167.h and stub/onewire_pins.h).
+   Every access moves the simulated time by HOST_STEP_NS, Timer 2 counts
+   with the prescaler set in T2CON and its overflow calls Timer2_1W() when
+   enabled, just like the C167 would.
+
+   The devices only see the edges the master drives on the line:
+     - a low of 480 usec or more is a reset, answered by a presence pulse
+       from 30 to 150 usec after the release;
+     - a low shorter than 15 usec writes a 1, longer writes a 0;
+     - a device sending a 0 holds the line low for 30 usec from the edge.
+   The line is the wired AND of the master and all the devices */
+
+#include <string.h>
+
+#include <reg167.h>
+
+#include "onewire_bus.h"
+
+/* Defines */
+#define US					1000ULL		// ns
+
+#define RESET_MIN			(480*US)	// Shortest low taken as a reset
+#define WRITE_ONE_MAX		(15*US)		// Longest low taken as a 1
+#define PRESENCE_START		(30*US)		// Presence pulse after the reset
+#define PRESENCE_END		(150*US)
+#define SEND_ZERO			(30*US)		// A 0 sent by a device
+#define DS1820_CONV			(750000*US)	// Temperature conversion
+#define DS18B20_CONV_9		(93750*US)	// Temperature conversion at 9 bits
+#define COPY_TIME			(10000*US)	// Copy scratchpad to EEPROM
+
+#define FAMILY_DS1820		0x10
+
+/* Steps of the device protocol */
+#define DEV_IDLE			0			// Deselected, waiting for a reset
+#define DEV_ROM_CMD			1			// Receiving the ROM command
+#define DEV_MATCH			2			// Receiving the ROM code of Match ROM
+#define DEV_SEARCH			3			// Taking part in a Search ROM
+#define DEV_FUNC_CMD		4			// Receiving the function command
+#define DEV_SEND			5			// Sending bytes, then 1s
+#define DEV_WRITE			6			// Receiving the Write Scratchpad bytes
+#define DEV_STATUS			7			// Sending 0s until the conversion or copy is done
+
+/* Typedefs */
+typedef struct {
+	unsigned char rom[8];
+	unsigned char scratch[9];
+	unsigned char eeprom[3];		// TH, TL, configuration
+	int temp16;						// Temperature (1/16 C)
+	unsigned char step;				// Step of the protocol
+	unsigned char next;				// Step after the bytes sent
+	unsigned char byte;				// Byte being received
+	unsigned char bits;				// Bits of the byte done
+	unsigned char count;			// Bytes done
+	unsigned char rx[8];			// Bytes received
+	unsigned char *tx;				// Bytes to send
+	unsigned char tx_len;
+	unsigned char search_slot;		// Search ROM slots started: bit, complement, direction
+	unsigned long long low_from;	// Line held low by the device
+	unsigned long long low_until;
+	unsigned long long busy_until;	// End of the conversion or copy
+} HOST_DEVICE;
+
+/* Registers seen by the library */
+HOST_T2CON host_t2con;
+HOST_IC host_t2ic;
+unsigned char host_ien;
+
+/* Statics */
+static HOST_DEVICE devices[HOST_MAX_DEVICES];
+static int deviceCount;
+
+static unsigned long long now;			// Simulated time
+static unsigned short t2;				// Timer 2 count
+static unsigned long t2Prescale;		// Time since the last count
+static unsigned char inIsr;
+
+static unsigned char pinLatch = 1;		// Port latch of the master
+static unsigned char pinOutput;			// Port direction of the master
+static unsigned char masterLow;			// Master driving the line low
+static unsigned long long masterFall;	// Start of the master low
+static unsigned char shorted;
+
+static unsigned long long ienOffStart;	// Interrupts held off since
+static unsigned long ienOffMax;
+
+/* Prototypes */
+extern void Timer2_1W(void);
+static void hostAdvance(void);
+static void hostDrive(void);
+static unsigned char hostLine(void);
+static void deviceFall(HOST_DEVICE *device);
+static void deviceRise(HOST_DEVICE *device, unsigned long long low);
+static void deviceByte(HOST_DEVICE *device);
+static void deviceSend(HOST_DEVICE *device, unsigned char *tx, unsigned char len, unsigned char next);
+static void deviceConvert(HOST_DEVICE *device);
+static unsigned char deviceBits(HOST_DEVICE *device);
+
+
+
+/* Remove all the devices and start again at time 0 */
+void host_bus_clear(void){
+
+	memset(devices, 0, sizeof(devices));
+	deviceCount = 0;
+	now = 0;
+	t2 = 0;
+	t2Prescale = 0;
+	host_t2con.w = 0;
+	host_t2ic.w = 0;
+	host_ien = 1;
+	pinLatch = 1;
+	pinOutput = 0;
+	masterLow = 0;
+	shorted = 0;
+	ienOffStart = 0;
+	ienOffMax = 0;
+}
+
+
+
+/* Plug in a device.  The serial number goes in the 48 bits after the family code */
+int host_bus_add(unsigned char family, unsigned long serial, int temp16){
+
+	/* Some locals */
+	HOST_DEVICE *device;
+	int i;
+
+	if(deviceCount>=HOST_MAX_DEVICES){
+		return -1;
+	}
+
+	device = &devices[deviceCount];
+	memset(device, 0, sizeof(*device));
+
+	device->rom[0] = family;
+	for(i=0;i<4;i++){
+		device->rom[i+1] = (unsigned char)(serial>>(8*i));
+	}
+	device->rom[7] = host_bus_crc(device->rom, 7);
+
+	/* Power up state: alarms at 75 and 70 C, 12 bits */
+	device->eeprom[0] = 75;
+	device->eeprom[1] = 70;
+	device->eeprom[2] = 0x7F;
+	device->scratch[2] = device->eeprom[0];
+	device->scratch[3] = device->eeprom[1];
+	device->scratch[4] = (family==FAMILY_DS1820) ? 0xFF : device->eeprom[2];
+	device->temp16 = temp16;
+	deviceConvert(device);
+
+	return deviceCount++;
+}
+
+
+
+/* Hold the line low as a short would */
+void host_bus_short(unsigned char state){
+
+	shorted = state;
+}
+
+
+
+/* ROM code of a device */
+void host_bus_rom(int device, unsigned char rom[8]){
+
+	memcpy(rom, devices[device].rom, 8);
+}
+
+
+
+/* Temperature measured by the next conversion */
+void host_bus_temp(int device, int temp16){
+
+	devices[device].temp16 = temp16;
+}
+
+
+
+/* DS18B20 configuration register */
+unsigned char host_bus_config(int device){
+
+	return devices[device].scratch[4];
+}
+
+
+
+/* DS18B20 configuration register in the EEPROM */
+unsigned char host_bus_eeprom(int device){
+
+	return devices[device].eeprom[2];
+}
+
+
+
+/* Dallas CRC8, one polynomial step per bit */
+unsigned char host_bus_crc(unsigned char *data, unsigned char len){
+
+	/* Some locals */
+	unsigned char crc = 0;
+	unsigned char i, j;
+
+	for(i=0;i<len;i++){
+		crc ^= data[i];
+		for(j=0;j<8;j++){
+			crc = (crc&0x01) ? (crc>>1)^0x8C : (crc>>1);
+		}
+	}
+
+	return crc;
+}
+
+
+
+/* One pass of the main loop with nothing to do */
+void host_idle(void){
+
+	hostAdvance();
+}
+
+
+
+/* Simulated time */
+unsigned long long host_time(void){
+
+	return now;
+}
+
+
+
+/* Longest time the engine held the interrupts off */
+unsigned long host_ien_off_max(void){
+
+	return ienOffMax;
+}
+
+
+
+void host_ien_off_clear(void){
+
+	ienOffMax = 0;
+	ienOffStart = now;
+}
+
+
+
+/* Timer 2 register: every access takes some time */
+unsigned short *host_t2(void){
+
+	hostAdvance();
+
+	return &t2;
+}
+
+
+
+/* Port pin of the master */
+unsigned char host_read_pin(void){
+
+	hostAdvance();
+
+	return hostLine();
+}
+
+
+
+void host_set_pin(unsigned char level){
+
+	pinLatch = level;
+	hostDrive();
+}
+
+
+
+void host_set_output(unsigned char output){
+
+	pinOutput = output;
+	hostDrive();
+}
+
+
+
+/* Move the time along by one step: Timer 2, its interrupt and the time
+   the interrupts are held off while the engine runs */
+static void hostAdvance(void){
+
+	/* Some locals */
+	unsigned long period;
+
+	now += HOST_STEP_NS;
+
+	if(host_t2con.b.t2r){
+		/* The prescaler divides the 20 MHz clock by 8<<T2I */
+		period = 400UL<<host_t2con.b.t2i;
+		t2Prescale += HOST_STEP_NS;
+		while(t2Prescale>=period){
+			t2Prescale -= period;
+			if(++t2==0){
+				host_t2ic.b.ir = 1;
+			}
+		}
+	}
+
+	if(host_ien||!host_t2ic.b.ie){
+		ienOffStart = now;
+	}else if((now-ienOffStart)>ienOffMax){
+		ienOffMax = (unsigned long)(now-ienOffStart);
+	}
+
+	if(host_t2ic.b.ir&&host_t2ic.b.ie&&host_ien&&!inIsr){
+		host_t2ic.b.ir = 0;
+		inIsr = 1;
+		Timer2_1W();
+		inIsr = 0;
+	}
+}
+
+
+
+/* Pass the master edges to the devices */
+static void hostDrive(void){
+
+	/* Some locals */
+	unsigned char low;
+	int i;
+
+	low = pinOutput&&!pinLatch;
+	if(low==masterLow){
+		return;
+	}
+	masterLow = low;
+
+	if(low){
+		masterFall = now;
+		for(i=0;i<deviceCount;i++){
+			deviceFall(&devices[i]);
+		}
+	}else{
+		for(i=0;i<deviceCount;i++){
+			deviceRise(&devices[i], now-masterFall);
+		}
+	}
+}
+
+
+
+/* Wired AND of the master and the devices */
+static unsigned char hostLine(void){
+
+	/* Some locals */
+	int i;
+
+	if(shorted||masterLow){
+		return 0;
+	}
+
+	for(i=0;i<deviceCount;i++){
+		if((now>=devices[i].low_from)&&(now<devices[i].low_until)){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+
+/* Start of a slot: a device sending a 0 holds the line low */
+static void deviceFall(HOST_DEVICE *device){
+
+	/* Some locals */
+	unsigned char level = 1;
+
+	switch(device->step){
+		case DEV_SEND:
+			if(device->count<device->tx_len){
+				level = (device->tx[device->count]>>device->bits)&0x01;
+				if(++device->bits==8){
+					device->bits = 0;
+					device->count++;
+				}
+			}
+			break;
+
+		case DEV_SEARCH:
+			if(device->search_slot<2){
+				level = (device->rom[device->count>>3]>>(device->count&0x07))&0x01;
+				if(device->search_slot==1){
+					level = !level;
+				}
+			}
+			device->search_slot++;
+			break;
+
+		case DEV_STATUS:
+			level = (now>=device->busy_until);
+			break;
+
+		default:
+			break;
+	}
+
+	if(!level){
+		device->low_from = now;
+		device->low_until = now+SEND_ZERO;
+	}
+}
+
+
+
+/* End of the master low: reset, or a bit written to a receiving device */
+static void deviceRise(HOST_DEVICE *device, unsigned long long low){
+
+	/* Some locals */
+	unsigned char level;
+
+	if(low>=RESET_MIN){
+		device->low_from = now+PRESENCE_START;
+		device->low_until = now+PRESENCE_END;
+		device->step = DEV_ROM_CMD;
+		device->byte = 0;
+		device->bits = 0;
+		device->count = 0;
+		return;
+	}
+
+	level = (low<WRITE_ONE_MAX);
+
+	switch(device->step){
+		case DEV_ROM_CMD:
+		case DEV_MATCH:
+		case DEV_FUNC_CMD:
+		case DEV_WRITE:
+			device->byte |= level<<device->bits;
+			if(++device->bits==8){
+				deviceByte(device);
+				device->byte = 0;
+				device->bits = 0;
+			}
+			break;
+
+		case DEV_SEND:
+			/* Last bit sent: go on with the next step */
+			if(device->count>=device->tx_len){
+				device->step = device->next;
+				device->byte = 0;
+				device->bits = 0;
+				device->count = 0;
+			}
+			break;
+
+		case DEV_SEARCH:
+			if(device->search_slot==3){
+				/* Devices with a different bit drop out until the next reset */
+				if(level!=((device->rom[device->count>>3]>>(device->count&0x07))&0x01)){
+					device->step = DEV_IDLE;
+				}else if(++device->count==64){
+					device->step = DEV_FUNC_CMD;
+				}
+				device->search_slot = 0;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+
+/* A whole byte was received */
+static void deviceByte(HOST_DEVICE *device){
+
+	/* Some locals */
+	unsigned char family = device->rom[0];
+
+	switch(device->step){
+		case DEV_ROM_CMD:
+			switch(device->byte){
+				case 0x33:	// Read ROM
+					deviceSend(device, device->rom, 8, DEV_FUNC_CMD);
+					break;
+				case 0x55:	// Match ROM
+					device->step = DEV_MATCH;
+					device->count = 0;
+					break;
+				case 0xCC:	// Skip ROM
+					device->step = DEV_FUNC_CMD;
+					break;
+				case 0xF0:	// Search ROM
+					device->step = DEV_SEARCH;
+					device->count = 0;
+					device->search_slot = 0;
+					break;
+				default:
+					device->step = DEV_IDLE;
+					break;
+			}
+			break;
+
+		case DEV_MATCH:
+			device->rx[device->count++] = device->byte;
+			if(device->count==8){
+				device->step = memcmp(device->rx, device->rom, 8) ? DEV_IDLE : DEV_FUNC_CMD;
+			}
+			break;
+
+		case DEV_FUNC_CMD:
+			switch(device->byte){
+				case 0x44:	// Convert T
+					if(family==FAMILY_DS1820){
+						device->busy_until = now+DS1820_CONV;
+					}else{
+						device->busy_until = now+(DS18B20_CONV_9<<(deviceBits(device)-9));
+					}
+					deviceConvert(device);
+					device->step = DEV_STATUS;
+					break;
+				case 0xBE:	// Read scratchpad
+					deviceSend(device, device->scratch, 9, DEV_IDLE);
+					break;
+				case 0x4E:	// Write scratchpad
+					device->step = DEV_WRITE;
+					device->count = 0;
+					break;
+				case 0x48:	// Copy scratchpad
+					memcpy(device->eeprom, &device->scratch[2], 3);
+					device->busy_until = now+COPY_TIME;
+					device->step = DEV_STATUS;
+					break;
+				default:
+					device->step = DEV_IDLE;
+					break;
+			}
+			break;
+
+		case DEV_WRITE:
+			/* TH, TL and, on the DS18B20, the configuration */
+			if(device->count==2){
+				device->scratch[4] = device->byte|0x1F;
+			}else{
+				device->scratch[2+device->count] = device->byte;
+			}
+			device->count++;
+			device->scratch[8] = host_bus_crc(device->scratch, 8);
+			if(device->count==((family==FAMILY_DS1820) ? 2 : 3)){
+				device->step = DEV_IDLE;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+
+/* Send bytes, then 1s until the next reset */
+static void deviceSend(HOST_DEVICE *device, unsigned char *tx, unsigned char len, unsigned char next){
+
+	device->tx = tx;
+	device->tx_len = len;
+	device->count = 0;
+	device->bits = 0;
+	device->step = DEV_SEND;
+	device->next = next;
+}
+
+
+
+/* Put the temperature in the scratchpad.  The DS1820 gives half degrees and
+   the count remaining, the DS18B20 leaves the bits below its resolution
+   undefined: they are set here to catch a reader that does not mask them */
+static void deviceConvert(HOST_DEVICE *device){
+
+	/* Some locals */
+	int t = device->temp16;
+	int raw;
+	unsigned char undefined;
+
+	if(device->rom[0]==FAMILY_DS1820){
+		raw = (t+4)>>3;
+		device->scratch[0] = (unsigned char)raw;
+		device->scratch[1] = (raw<0) ? 0xFF : 0x00;
+		device->scratch[5] = 0xFF;
+		device->scratch[6] = 16-((t+4)&0x0F);
+		device->scratch[7] = 16;
+	}else{
+		undefined = (1<<(12-deviceBits(device)))-1;
+		raw = (t&~undefined)|undefined;
+		device->scratch[0] = (unsigned char)raw;
+		device->scratch[1] = (unsigned char)(raw>>8);
+		device->scratch[5] = 0xFF;
+		device->scratch[6] = 0x0C;
+		device->scratch[7] = 0x10;
+	}
+
+	device->scratch[8] = host_bus_crc(device->scratch, 8);
+}
+
+
+
+/* DS18B20 resolution from the configuration register */
+static unsigned char deviceBits(HOST_DEVICE *device){
+
+	return ((device->scratch[4]>>5)&0x03)+9;
+}
@@ -0,0 +1,26 @@
+#ifndef _ONEWIRE_BUS_H
+
+	#define _ONEWIRE_BUS_H
+
+	/* Defines */
+	#define HOST_STEP_NS		100		// Simulated time taken by a register access or an idle pass
+	#define HOST_MAX_DEVICES	8		// Devices the bus model can hold
+
+	/* Prototypes */
+	/* Bus setup */
+	extern void host_bus_clear(void);		// No device, line released, time 0
+	extern int host_bus_add(unsigned char family, unsigned long serial, int temp16);	// Returns the device index
+	extern void host_bus_short(unsigned char shorted);	// Hold the line low
+	extern void host_bus_rom(int device, unsigned char rom[8]);
+	extern void host_bus_temp(int device, int temp16);	// Temperature in 1/16 C
+	extern unsigned char host_bus_config(int device);	// DS18B20 configuration register
+	extern unsigned char host_bus_eeprom(int device);	// Its EEPROM copy
+	extern unsigned char host_bus_crc(unsigned char *data, unsigned char len);	// Reference bitwise CRC8
+
+	/* Time */
+	extern void host_idle(void);			// One pass of the main loop
+	extern unsigned long long host_time(void);	// Simulated time (ns)
+	extern unsigned long host_ien_off_max(void);	// Longest time with the interrupts held off by the engine (ns)
+	extern void host_ien_off_clear(void);
+
+#endif /* _ONEWIRE_BUS_H */
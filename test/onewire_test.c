@@ -0,0 +1,221 @@
+/* Runs the ds1820 library against the 1-Wire bus model: the interrupt
+   driven engine, the ROM search and the split phase readings */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <reg167.h>
+
+#include "ds1820.h"
+#include "onewire_bus.h"
+
+/* Defines */
+#define CHECK(cond)		check((cond), #cond, __LINE__)
+#define TIMEOUT_NS		5000000000ULL	// Longest operation let run (5 s simulated)
+#define IEN_OFF_MAX_NS	12000UL			// Interrupts held off per slot (~11 usec)
+
+/* Globals */
+static int checks;
+static int failures;
+
+/* Prototypes */
+static void check(int cond, char *text, int line);
+static void waitEngine(void);
+static short pollAll(long centi[], unsigned char *devices);
+static long expectCenti(int temp16);
+
+
+
+/* The condition must hold */
+static void check(int cond, char *text, int line){
+
+	checks++;
+	if(!cond){
+		failures++;
+		printf("onewire_test.c:%d: failed: %s\n", line, text);
+	}
+}
+
+
+
+/* Let the main loop run until the background transaction is done */
+static void waitEngine(void){
+
+	/* Some locals */
+	unsigned long long start = host_time();
+
+	while((Status_1W()==ONEWIRE_BUSY)&&((host_time()-start)<TIMEOUT_NS)){
+		host_idle();
+	}
+}
+
+
+
+/* Poll a split phase operation to the end.  Every reading is turned into
+   centi-degrees in centi[device].  Returns the last error, or DS1820_IDLE */
+static short pollAll(long centi[], unsigned char *devices){
+
+	/* Some locals */
+	unsigned long long start = host_time();
+	unsigned char device;
+	unsigned char data[4];
+	short result = DS1820_IDLE;
+	short status;
+
+	*devices = 0;
+
+	while((host_time()-start)<TIMEOUT_NS){
+		status = ds1820_poll_temp(&device, &data[0], &data[1], &data[2], &data[3]);
+		if(status==DS1820_BUSY){
+			host_idle();
+			continue;
+		}
+		if(status==DS1820_IDLE){
+			return result;
+		}
+		if(status==0){
+			centi[device] = Do_1W_Temperature_Full_Centi(data[0], data[1], data[2], data[3]);
+			(*devices)++;
+		}else{
+			result = status;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/* A reading of temp16/16 C in centi-degrees, halves rounded up */
+static long expectCenti(int temp16){
+
+	/* Some locals */
+	long scaled = 25L*temp16+2;
+
+	return (scaled>=0) ? scaled/4 : -((-scaled+3)/4);
+}
+
+
+
+int main(void){
+
+	/* Some locals */
+	unsigned char tx[1];
+	unsigned char rx[8];
+	unsigned char rom[8];
+	unsigned char sn[8];
+	long centi[DS1820_MAX_DEVICES];
+	unsigned char devices;
+	int board, probe1, probe2;
+
+	/* Engine: Read ROM of the only device, with the interrupts held off
+	   only for the start of each slot */
+	host_bus_clear();
+	board = host_bus_add(DS18B20_FAMILY, 0x123456, 0);
+	host_bus_rom(board, rom);
+	host_ien_off_clear();
+	tx[0] = 0x33;
+	CHECK(Start_1W(1, tx, 1, rx, 8)==0);
+	CHECK(Start_1W(1, tx, 1, rx, 8)!=0);	// Busy
+	waitEngine();
+	CHECK(Status_1W()==ONEWIRE_DONE);
+	CHECK(memcmp(rx, rom, 8)==0);
+	CHECK(host_ien_off_max()>0);
+	CHECK(host_ien_off_max()<=IEN_OFF_MAX_NS);
+	printf("engine: interrupts held off for %lu ns at most\n", host_ien_off_max());
+
+	/* Blocking primitives give the same */
+	memset(rx, 0, 8);
+	CHECK(ds1820_read_rom(rx)==0);
+	CHECK(memcmp(rx, rom, 8)==0);
+
+	/* Engine: nobody on the bus, then a shorted bus */
+	host_bus_clear();
+	CHECK(Start_1W(1, tx, 1, rx, 8)==0);
+	waitEngine();
+	CHECK(Status_1W()==ONEWIRE_NO_PRESENCE);
+	host_bus_short(1);
+	CHECK(Start_1W(1, tx, 1, rx, 8)==0);
+	waitEngine();
+	CHECK(Status_1W()==ONEWIRE_SHORT);
+	CHECK(ds1820_init()!=0);
+
+	/* Alone on the bus, the on-board device answers Read ROM */
+	host_bus_clear();
+	board = host_bus_add(DS1820_FAMILY, 0x00FFFF, 2000);
+	host_bus_rom(board, rom);
+	CHECK(ds1820_init()==0);
+	CHECK(ds1820_get_count()==1);
+	CHECK((ds1820_get_sn(sn)==0)&&(memcmp(sn, rom, 8)==0));
+
+	/* A DS1820 probe plugged in later comes first in a new search (the ROM
+	   code goes bit 0 first), but the on-board device stays device 0 */
+	probe1 = host_bus_add(DS1820_FAMILY, 0x000002, 0);
+	CHECK(ds1820_search()==0);
+	CHECK(ds1820_get_count()==2);
+	CHECK((ds1820_get_rom(0, sn)==0)&&(memcmp(sn, rom, 8)==0));
+	CHECK((ds1820_get_sn(sn)==0)&&(memcmp(sn, rom, 8)==0));
+
+	/* Several devices at power up: Read ROM collides, the on-board DS1820
+	   is still device 0 and the serial number.  The DS18B20 probes follow
+	   in search order */
+	host_bus_clear();
+	probe2 = host_bus_add(DS18B20_FAMILY, 0x000001, 2000);	// 125.0 C
+	board = host_bus_add(DS1820_FAMILY, 0x00FFFF, 403);		// 25.1875 C
+	probe1 = host_bus_add(DS18B20_FAMILY, 0x000002, -880);	// -55.0 C
+	CHECK(ds1820_read_rom(sn)!=0);
+	CHECK(ds1820_init()==0);
+	CHECK(ds1820_get_count()==3);
+	host_bus_rom(board, rom);
+	CHECK((ds1820_get_sn(sn)==0)&&(memcmp(sn, rom, 8)==0));
+	CHECK((ds1820_get_rom(0, sn)==0)&&(memcmp(sn, rom, 8)==0));
+	host_bus_rom(probe1, rom);
+	CHECK((ds1820_get_rom(1, sn)==0)&&(memcmp(sn, rom, 8)==0));
+	host_bus_rom(probe2, rom);
+	CHECK((ds1820_get_rom(2, sn)==0)&&(memcmp(sn, rom, 8)==0));
+	CHECK(ds1820_get_resolution(0)==0);
+	CHECK(ds1820_get_resolution(1)==12);
+
+	/* Split phase reading of all of them */
+	CHECK(ds1820_start_temp()==0);
+	CHECK(ds1820_start_temp()!=0);	// Busy
+	CHECK(pollAll(centi, &devices)==DS1820_IDLE);
+	CHECK(devices==3);
+	CHECK(centi[0]==expectCenti(403));
+	CHECK(centi[1]==expectCenti(-880));
+	CHECK(centi[2]==expectCenti(2000));
+
+	/* Resolution change in the background: scratchpad, check and EEPROM copy */
+	CHECK(ds1820_set_resolution(0, 9)==-1);	// DS1820
+	CHECK(ds1820_set_resolution(1, 13)==-1);
+	CHECK(ds1820_set_resolution(1, 9)==0);
+	CHECK(ds1820_set_resolution(2, 9)==DS1820_BUSY);
+	CHECK(pollAll(centi, &devices)==DS1820_IDLE);
+	CHECK(devices==0);
+	CHECK(ds1820_get_resolution(1)==9);
+	CHECK(host_bus_config(probe1)==0x1F);
+	CHECK(host_bus_eeprom(probe1)==0x1F);
+	CHECK(host_bus_config(probe2)==0x7F);
+
+	/* At 9 bits the bits below half a degree are dropped */
+	host_bus_temp(probe1, 403);
+	CHECK(ds1820_start_temp()==0);
+	CHECK(pollAll(centi, &devices)==DS1820_IDLE);
+	CHECK(devices==3);
+	CHECK(centi[1]==expectCenti(400));
+
+	/* A warm restart takes the device list back without a search */
+	{
+		DS1820_STATE state;
+
+		ds1820_save(&state);
+		CHECK(ds1820_restore(&state)==0);
+		host_bus_rom(board, rom);
+		CHECK((ds1820_get_sn(sn)==0)&&(memcmp(sn, rom, 8)==0));
+		CHECK(ds1820_get_resolution(1)==9);
+	}
+
+	printf("onewire_test: %d checks, %d failures\n", checks, failures);
+
+	return failures ? 1 : 0;
+}
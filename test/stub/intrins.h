@@ -0,0 +1,15 @@
+/*
+ ****************************************************************************
+ *  INTRINS.H (host)
+ *
+ *  Host stand-in for the Keil intrins.h.
+ *
+ ****************************************************************************
+ */
+
+#ifndef HOST_INTRINS_H
+#define HOST_INTRINS_H
+
+#define _nop_()
+
+#endif /* HOST_INTRINS_H */
@@ -0,0 +1,25 @@
+/*
+ ****************************************************************************
+ *  ONEWIRE_PINS.H (host)
+ *
+ *  1-Wire port pin macros for the host build of the ds1820 library, in
+ *  place of the SK167 and AMBSI ones in ds1820.h.  The pin is driven into
+ *  the bus model in onewire_bus.c.
+ *
+ ****************************************************************************
+ */
+
+#ifndef HOST_ONEWIRE_PINS_H
+#define HOST_ONEWIRE_PINS_H
+
+extern unsigned char host_read_pin(void);
+extern void host_set_pin(unsigned char level);
+extern void host_set_output(unsigned char output);
+
+#define READ_PIN	host_read_pin()
+#define SET_PIN		host_set_pin(1)
+#define RESET_PIN	host_set_pin(0)
+#define SET_INPUT	host_set_output(0)
+#define SET_OUTPUT	host_set_output(1)
+
+#endif /* HOST_ONEWIRE_PINS_H */
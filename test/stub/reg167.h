@@ -0,0 +1,59 @@
+/*
+ ****************************************************************************
+ *  REG167.H (host)
+ *
+ *  Host stand-in for the Keil reg167.h.  Only the registers used by the
+ *  modules under test are there, and the bit fields follow the C167 layout.
+ *  Timer 2 is run by the 1-Wire bus model in onewire_bus.c: every access
+ *  moves the simulated time along.
+ *
+ ****************************************************************************
+ */
+
+#ifndef HOST_REG167_H
+#define HOST_REG167_H
+
+/* Keil C166 extensions */
+#define bit		unsigned char
+#define idata
+#define xhuge
+
+/* Timer 2 control register */
+typedef union {
+	unsigned short w;
+	struct {
+		unsigned short t2i:3;	/* Prescaler */
+		unsigned short t2m:3;	/* Mode */
+		unsigned short t2r:1;	/* Run bit */
+		unsigned short t2ud:1;	/* Count down */
+		unsigned short t2ude:1;	/* External up/down */
+		unsigned short :7;
+	} b;
+} HOST_T2CON;
+
+/* Interrupt control register */
+typedef union {
+	unsigned short w;
+	struct {
+		unsigned short glvl:2;	/* Group level */
+		unsigned short ilvl:4;	/* Priority level */
+		unsigned short ie:1;	/* Interrupt enable */
+		unsigned short ir:1;	/* Interrupt request */
+		unsigned short :8;
+	} b;
+} HOST_IC;
+
+extern HOST_T2CON host_t2con;
+extern HOST_IC host_t2ic;
+extern unsigned char host_ien;
+extern unsigned short *host_t2(void);
+
+#define T2CON	host_t2con.w
+#define T2R		host_t2con.b.t2r
+#define T2IC	host_t2ic.w
+#define T2IE	host_t2ic.b.ie
+#define T2IR	host_t2ic.b.ir
+#define T2		(*host_t2())
+#define IEN		host_ien
+
+#endif /* HOST_REG167_H */